@@ -0,0 +1,96 @@
+// count.c - what a tool allocates and reads, for "make bench"
+//
+// This program is licensed under the GNU Library General Public License, v2
+//
+//     LD_PRELOAD=bench/count.so BENCH_COUNTS=file ps aux
+//
+// adds one line to the file as the tool exits:
+//
+//     mallocs frees bytes opens reads syscr syscw
+//
+// mallocs counts malloc, calloc and realloc calls and bytes what they
+// asked for (all of a realloc's new size, so a table grown often shows).
+// opens and reads are libproc's own counts of the /proc files it went
+// through (replayed or not), and syscr and syscw the read and write
+// system calls the kernel saw, from /proc/self/io.  That's what is left
+// of a system call count without strace.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../proc/costs.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+// not all tools link libproc's counters in
+#pragma weak costs_enable
+#pragma weak costs
+
+static unsigned long mallocs, frees, bytes;
+
+void *malloc(size_t size){
+    __sync_fetch_and_add(&mallocs, 1);
+    __sync_fetch_and_add(&bytes, size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size){
+    __sync_fetch_and_add(&mallocs, 1);
+    __sync_fetch_and_add(&bytes, n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size){
+    __sync_fetch_and_add(&mallocs, 1);
+    __sync_fetch_and_add(&bytes, size);
+    return __libc_realloc(p, size);
+}
+
+void free(void *p){
+    if(p) __sync_fetch_and_add(&frees, 1);
+    __libc_free(p);
+}
+
+// the number after "key: " in /proc/self/io, or 0
+static unsigned long io_count(const char *buf, const char *key){
+    const char *s = strstr(buf, key);
+    return s ? strtoul(s + strlen(key), NULL, 10) : 0;
+}
+
+static void start(void) __attribute__((constructor));
+static void start(void){
+    if(costs_enable) costs_enable(1);
+}
+
+static void report(void) __attribute__((destructor));
+static void report(void){
+    const char *file = getenv("BENCH_COUNTS");
+    char buf[512], line[160];
+    unsigned long opens = 0, reads = 0;
+    ssize_t n = 0;
+    int fd;
+
+    if(!file) return;
+    fflush(NULL);    // the tool's last write(s) count too
+    if((fd = open("/proc/self/io", O_RDONLY)) != -1){
+        n = read(fd, buf, sizeof buf - 1);
+        close(fd);
+    }
+    buf[n > 0 ? n : 0] = '\0';
+    if(&costs){
+        opens = costs.opens;
+        reads = costs.reads;
+    }
+    n = snprintf(line, sizeof line, "%lu %lu %lu %lu %lu %lu %lu\n",
+                 mallocs, frees, bytes, opens, reads,
+                 io_count(buf, "syscr: "), io_count(buf, "syscw: "));
+    if((fd = open(file, O_WRONLY|O_APPEND|O_CREAT, 0644)) == -1) return;
+    if(write(fd, line, n) != n) {}
+    close(fd);
+}
@@ -0,0 +1,250 @@
+// escbench.c - time escape_strlist() on command lines, for "make bench-escape"
+//
+// This program is licensed under the GNU Library General Public License, v2
+//
+//     LC_ALL=C.UTF-8 PROCPS_REPLAY=bench/snap-10000.rec bench/escbench
+//
+// escapes each recorded process' command line, as ps does for ARGS, with
+// libproc's escape_strlist() and with the escape_str() it had before the
+// ASCII fast path, kept here to compare against.  Both must give the same
+// text.  escape_str() picks its UTF-8 or 8-bit code once, from the locale,
+// so each locale wants a run of its own; only UTF-8 has the fast path.
+
+#include <langinfo.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <ctype.h>
+
+#include "../proc/alloc.h"
+#include "../proc/costs.h"
+#include "../proc/escape.h"
+#include "../proc/replay.h"
+
+// proc/escape.c, less the ASCII fast path
+
+static int old_escape_str_utf8(char *restrict dst, const char *restrict src, int bufsize, int *maxcells){
+  int my_cells = 0;
+  int my_bytes = 0;
+  mbstate_t s;
+
+  memset(&s, 0, sizeof (s));
+
+  for(;;) {
+    wchar_t wc;
+    int len = 0;
+
+    if(my_cells >= *maxcells || my_bytes+1 >= bufsize)
+      break;
+
+    if (!(len = mbrtowc (&wc, src, MB_CUR_MAX, &s)))
+      break;
+
+    if (len < 0) {
+      memset (&s, 0, sizeof (s));
+      *(dst++) = '?';
+      src++;
+      my_cells++;
+      my_bytes++;
+    } else if (len==1) {
+      *(dst++) = isprint(*src) ? *src : '?';
+      src++;
+      my_cells++;
+      my_bytes++;
+    } else if (!iswprint(wc)) {
+      *(dst++) = '?';
+      src+=len;
+      my_cells++;
+      my_bytes++;
+    } else {
+      int wlen = wcwidth(wc);
+
+      if (wlen==0) {
+	*(dst++) = '?';
+	src+=len;
+	my_cells++;
+	my_bytes++;
+      } else {
+        if (my_cells+wlen > *maxcells || my_bytes+1+len >= bufsize) break;
+        if (memchr(src, 0x9B, len)) {
+	  *(dst++) = '?';
+	  src+=len;
+	  my_cells++;
+	  my_bytes++;
+        } else {
+	  memcpy(dst, src, len);
+	  my_cells += wlen;
+	  dst += len;
+	  my_bytes += len;
+          src += len;
+        }
+      }
+    }
+  }
+  *(dst++) = '\0';
+
+  *maxcells -= my_cells;
+  return my_bytes;
+}
+
+static int utf8;
+
+static int old_escape_str(char *restrict dst, const char *restrict src, int bufsize, int *maxcells){
+  unsigned char c;
+  int my_cells = 0;
+  int my_bytes = 0;
+  const char codes[] =
+  "Z-------------------------------"
+  "********************************"
+  "********************************"
+  "*******************************-"
+  "--------------------------------"
+  "********************************"
+  "********************************"
+  "********************************";
+
+  if (utf8)
+     return old_escape_str_utf8(dst, src, bufsize, maxcells);
+
+  if(bufsize > *maxcells+1) bufsize=*maxcells+1;
+
+  for(;;){
+    if(my_cells >= *maxcells || my_bytes+1 >= bufsize)
+      break;
+    c = (unsigned char) *(src++);
+    if(!c) break;
+    if(codes[c]=='-') c='?';
+    my_cells++;
+    my_bytes++;
+    *(dst++) = c;
+  }
+  *(dst++) = '\0';
+
+  *maxcells -= my_cells;
+  return my_bytes;
+}
+
+static int old_escape_strlist(char *restrict dst, const char *restrict const *restrict src, size_t bytes, int *cells){
+  size_t i = 0;
+
+  for(;;){
+    i += old_escape_str(dst+i, *src, bytes-i, cells);
+    if(bytes-i < 3) break;
+    src++;
+    if(!*src) break;
+    if (*cells<=1) break;
+    dst[i++] = ' ';
+    --*cells;
+  }
+  return i;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+#define OUTBUF 131072   // ps' own limit for a row
+
+static const char ***cmds;      // argv-style, as readproc() gives them
+static unsigned ncmds;
+static unsigned long nbytes;
+
+static void load(void){
+    const int32_t *pids;
+    unsigned i;
+
+    if(!replay_image){
+        fprintf(stderr, "escbench: PROCPS_REPLAY names no recording\n");
+        exit(1);
+    }
+    pids = (const int32_t *)((const char *)replay_image + replay_image->pids);
+    cmds = xmalloc(sizeof *cmds * (replay_image->npids + 1));
+    for(i = 0; i < replay_image->npids; i++){
+        char path[64], *buf;
+        const char *data, **argv;
+        unsigned len, n, j;
+
+        snprintf(path, sizeof path, "/proc/%d/cmdline", pids[i]);
+        if(!(data = replay_data(path, &len)) || !len) continue;   // kernel thread
+        buf = xmalloc(len + 1);
+        memcpy(buf, data, len);
+        buf[len] = '\0';
+        for(n = 1, j = 0; j + 1 < len; j++) n += !buf[j];
+        argv = xmalloc(sizeof *argv * (n + 1));
+        argv[0] = buf;
+        for(n = 1, j = 0; j + 1 < len; j++) if(!buf[j]) argv[n++] = buf + j + 1;
+        argv[n] = NULL;
+        cmds[ncmds++] = argv;
+        nbytes += len;
+    }
+    if(!ncmds){
+        fprintf(stderr, "escbench: no command lines recorded\n");
+        exit(1);
+    }
+}
+
+static char out_now[OUTBUF], out_before[OUTBUF];
+
+static void check(int columns){
+    unsigned i;
+
+    for(i = 0; i < ncmds; i++){
+        int a = columns, b = columns;
+        int na = escape_strlist(out_now, cmds[i], OUTBUF, &a);
+        int nb = old_escape_strlist(out_before, cmds[i], OUTBUF, &b);
+        if(na != nb || a != b || strcmp(out_now, out_before)){
+            fprintf(stderr, "escbench: differs at %d columns on %s\n", columns, out_before);
+            exit(1);
+        }
+    }
+}
+
+typedef int (*strlist_fn)(char *restrict dst, const char *restrict const *restrict src, size_t bytes, int *cells);
+
+// ns per command line
+static double time_escape(strlist_fn fn, int columns, unsigned rounds){
+    unsigned long long t = costs_now();
+    unsigned r, i;
+
+    for(r = 0; r < rounds; r++)
+        for(i = 0; i < ncmds; i++){
+            int cells = columns;
+            fn(out_now, cmds[i], OUTBUF, &cells);
+        }
+    return (double)(costs_now() - t) / ((double)rounds * ncmds);
+}
+
+// the best of a few tries each, taken in turns
+static void show(const char *what, int columns, unsigned rounds){
+    double now = 1e30, before = 1e30, t;
+    int i;
+
+    for(i = 0; i < 5; i++){
+        if((t = time_escape(escape_strlist, columns, rounds)) < now) now = t;
+        if((t = time_escape(old_escape_strlist, columns, rounds)) < before) before = t;
+    }
+    printf("%-14s %9.1f ns %9.1f ns %6.2fx\n", what, now, before, before / now);
+}
+
+int main(int argc, char *argv[]){
+    unsigned rounds;
+    const char *enc;
+
+    setlocale(LC_ALL, "");
+    enc = nl_langinfo(CODESET);
+    utf8 = enc && !strcasecmp(enc, "UTF-8");
+
+    load();
+    check(80);
+    check(OUTBUF - 1);
+    // 10 MB or so of command lines a try
+    rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000 / nbytes + 1;
+
+    printf("%u command lines of %lu bytes on average, %s, %u rounds\n",
+           ncmds, nbytes / ncmds, enc, rounds);
+    printf("%-14s %12s %12s %7s\n", "", "now", "before", "");
+    show("80 columns", 80, rounds);
+    show("unlimited", OUTBUF - 1, rounds);
+    return 0;
+}
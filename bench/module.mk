@@ -0,0 +1,53 @@
+# This file gets included into the main Makefile, in the top directory.
+
+# "make bench" records snapshots of this machine's /proc, copied out to
+# each of $(BENCH_SIZES) processes, and times the tools replaying them
+# (bench-tools), then libproc's parsers on what they recorded:
+#
+#     bench-stat    stat2proc and statm2proc, against sscanf
+#     bench-wchan   lookup_wchan's index, against a plain binary search
+#     bench-escape  escape_strlist() on command lines, UTF-8 and C locales
+#
+# Nothing here is built by "make all" or installed.  Without -j, so the
+# timings don't overlap.  For a quick look:
+#
+#     make bench BENCH_SIZES="1000 10000" BENCH_RUNS=3
+
+BENCH_SIZES := 1000 10000 100000
+BENCH_RUNS  := 5
+
+BENCH_SNAPS := $(addprefix bench/snap-,$(addsuffix .rec,$(BENCH_SIZES)))
+
+BENCH_X := module.mk run.sh count.c statbench.c wchanbench.c escbench.c
+TARFILES += $(addprefix bench/,$(BENCH_X))
+
+# the snapshots run to 6 kB a process
+CLEAN += bench/count.so bench/statbench bench/wchanbench bench/escbench bench/snap-*.rec
+DIRS  += bench/
+
+.PHONY: bench bench-tools bench-stat bench-wchan bench-escape
+
+bench: bench-tools bench-stat bench-wchan bench-escape
+
+bench-tools: $(ALL) bench/count.so $(BENCH_SNAPS)
+	sh bench/run.sh $(BENCH_RUNS) $(BENCH_SNAPS)
+
+bench-stat: bench/statbench $(BENCH_SNAPS)
+	for f in $(BENCH_SNAPS); do PROCPS_REPLAY=$$f bench/statbench || exit; done
+
+bench-wchan: bench/wchanbench $(BENCH_SNAPS)
+	for f in $(BENCH_SNAPS); do PROCPS_REPLAY=$$f bench/wchanbench || exit; done
+
+bench-escape: bench/escbench $(BENCH_SNAPS)
+	for f in $(BENCH_SNAPS); do for l in C.UTF-8 C; do \
+	  LC_ALL=$$l PROCPS_REPLAY=$$f bench/escbench || exit; done; done
+
+bench/snap-%.rec: | procrec
+	LD_LIBRARY_PATH=proc ./procrec -n $* $@
+
+bench/count.so: bench/count.c proc/costs.h
+	$(CC) $(ALL_CPPFLAGS) $(ALL_CFLAGS) $(FPIC) -shared -o $@ $< $(ALL_LDFLAGS)
+
+# linked with the objects, for what library.map doesn't export
+bench/statbench bench/wchanbench bench/escbench: %: %.o $(LIBOBJ)
+	$(CC) $(ALL_CFLAGS) $^ $(ALL_LDFLAGS) -o $@ -lpthread -lrt
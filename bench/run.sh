@@ -0,0 +1,76 @@
+#!/bin/sh
+# run.sh - time the tools against procrec snapshots, for "make bench"
+#
+# usage: bench/run.sh runs snapshot...
+#
+# Each snapshot is replayed (PROCPS_REPLAY) by ps, top -b, pgrep and w,
+# from the top directory.  A line per tool gives the best wall time of
+# 'runs' runs, then one more run under bench/count.so for allocations,
+# libproc's /proc file opens and reads, and the read and write system
+# calls; with strace around, the last column is every system call.
+#
+# top -b waits half a second before its first frame, in every run.
+# w still reads the live utmp, so it only has the users logged in now.
+
+runs=$1
+shift
+
+LD_LIBRARY_PATH=proc${LD_LIBRARY_PATH:+:$LD_LIBRARY_PATH}
+HOME=bench              # no ~/.toprc
+export LD_LIBRARY_PATH HOME
+
+out=${TMPDIR:-/tmp}/bench.$$
+trap 'rm -f $out' EXIT
+
+have_strace=
+command -v strace >/dev/null 2>&1 && have_strace=1
+
+# microseconds
+now() {
+    echo $(( $(date +%s%N) / 1000 ))
+}
+
+# label command...
+one() {
+    label=$1
+    shift
+    best=
+    i=0
+    while [ $i -lt $runs ]; do
+        t0=$(now)
+        "$@" >/dev/null 2>&1
+        t1=$(now)
+        t=$((t1 - t0))
+        [ -z "$best" ] || [ $t -lt $best ] && best=$t
+        i=$((i + 1))
+    done
+
+    : > $out
+    LD_PRELOAD=bench/count.so BENCH_COUNTS=$out "$@" >/dev/null 2>&1
+    read mallocs frees bytes opens reads syscr syscw < $out
+
+    calls=-
+    if [ -n "$have_strace" ]; then
+        strace -f -c -o $out "$@" >/dev/null 2>&1
+        calls=$(awk '$NF == "total" { print $4 }' $out)
+    fi
+
+    printf '%8s %-14s %6d.%03d %9s %9s %12s %8s %8s %7s %7s %9s\n' \
+        $procs "$label" $((best / 1000)) $((best % 1000)) \
+        $mallocs $frees $bytes $opens $reads $syscr $syscw $calls
+}
+
+printf '%8s %-14s %10s %9s %9s %12s %8s %8s %7s %7s %9s\n' \
+    procs tool ms mallocs frees bytes opens reads syscr syscw syscalls
+
+for snap in "$@"; do
+    PROCPS_REPLAY=$snap
+    export PROCPS_REPLAY
+    procs=$(ps/ps -e --no-headers | wc -l)
+
+    one "ps aux"       ps/ps aux
+    one "ps -eo"       ps/ps -eo pid,user,rss,vsz,stat,start,time,args
+    one "top -b -n 1"  ./top -b -n 1
+    one "pgrep -l sh"  ./pgrep -l sh
+    one "w"            ./w
+done
@@ -0,0 +1,203 @@
+// statbench.c - time the stat and statm parsers, for "make bench-stat"
+//
+// This program is licensed under the GNU Library General Public License, v2
+//
+//     PROCPS_REPLAY=bench/snap-10000.rec bench/statbench [rounds]
+//
+// parses each recorded process' /proc/#/stat and statm, over and over,
+// with libproc's stat2proc() and statm2proc() and with the sscanf()
+// formats they used before, kept here to compare against.  The two must
+// agree on every line first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../proc/alloc.h"
+#include "../proc/costs.h"
+#include "../proc/readproc.h"
+#include "../proc/replay.h"
+
+// the libproc parsers before they had their own scanner
+
+#define STAT_BASIC "%c %d %d %d %d %d "
+#define STAT_TIMES "%lu %lu %lu %lu %lu "                   \
+                   "%Lu %Lu %Lu %Lu " /* utime stime cutime cstime */ \
+                   "%ld %ld %d %ld %Lu " /* ... start_time */
+#define STAT_VM    "%lu %ld "                                \
+                   "%lu %"KLF"u %"KLF"u %"KLF"u %"KLF"u %"KLF"u " \
+                   "%*s %*s %*s %*s " /* discard, no RT signals & Linux 2.1 used hex */
+#define STAT_SCHED "%"KLF"u %*lu %*lu %d %d %lu %lu"
+
+static const char *const stat_formats[] = {
+    STAT_BASIC,
+    STAT_BASIC STAT_TIMES,
+    STAT_BASIC STAT_TIMES STAT_VM,
+    STAT_BASIC STAT_TIMES STAT_VM STAT_SCHED
+};
+
+static void old_stat2proc(const char *S, proc_t *restrict P, unsigned want){
+    unsigned num;
+    char *tmp;
+    const char *fmt;
+
+    P->processor = 0;
+    P->rtprio = -1;
+    P->sched = -1;
+    P->nlwp = 0;
+
+    S = strchr(S, '(') + 1;
+    tmp = strrchr(S, ')');
+    num = tmp - S;
+    if(num >= sizeof P->cmd) num = sizeof P->cmd - 1;
+    memcpy(P->cmd, S, num);
+    P->cmd[num] = '\0';
+    S = tmp + 2;
+
+    if     (want & PROC_FIELD_SCHED) fmt = stat_formats[3];
+    else if(want & PROC_FIELD_VM)    fmt = stat_formats[2];
+    else if(want & PROC_FIELD_TIMES) fmt = stat_formats[1];
+    else                             fmt = stat_formats[0];
+
+    sscanf(S, fmt,
+       &P->state,
+       &P->ppid, &P->pgrp, &P->session, &P->tty, &P->tpgid,
+       &P->flags, &P->min_flt, &P->cmin_flt, &P->maj_flt, &P->cmaj_flt,
+       &P->utime, &P->stime, &P->cutime, &P->cstime,
+       &P->priority, &P->nice,
+       &P->nlwp,
+       &P->alarm,
+       &P->start_time,
+       &P->vsize,
+       &P->rss,
+       &P->rss_rlim, &P->start_code, &P->end_code, &P->start_stack, &P->kstk_esp, &P->kstk_eip,
+       &P->wchan,
+       &P->exit_signal, &P->processor,
+       &P->rtprio, &P->sched
+    );
+
+    if(!P->nlwp && (want & PROC_FIELD_TIMES)) P->nlwp = 1;
+}
+
+static void old_statm2proc(const char *S, proc_t *restrict P){
+    sscanf(S, "%ld %ld %ld %ld %ld %ld %ld",
+           &P->size, &P->resident, &P->share,
+           &P->trs, &P->lrs, &P->drs, &P->dt);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+typedef struct line {
+    char *stat;
+    char *statm;
+} line;
+
+static line *lines;
+static unsigned nlines;
+
+// a file's text, NUL-terminated as file2str() leaves it
+static char *recorded(const char *restrict fmt, int pid){
+    char path[64];
+    const char *data;
+    unsigned len;
+    char *s;
+
+    snprintf(path, sizeof path, fmt, pid);
+    if(!(data = replay_data(path, &len)) || !len) return NULL;
+    s = xmalloc(len + 1);
+    memcpy(s, data, len);
+    s[len] = '\0';
+    return s;
+}
+
+static void load(void){
+    const int32_t *pids;
+    unsigned i;
+
+    if(!replay_image){
+        fprintf(stderr, "statbench: PROCPS_REPLAY names no recording\n");
+        exit(1);
+    }
+    pids = (const int32_t *)((const char *)replay_image + replay_image->pids);
+    lines = xmalloc(sizeof *lines * (replay_image->npids + 1));
+    for(i = 0; i < replay_image->npids; i++){
+        line *l = lines + nlines;
+        if(!(l->stat = recorded("/proc/%d/stat", pids[i]))) continue;
+        if(!(l->statm = recorded("/proc/%d/statm", pids[i]))){
+            free(l->stat);
+            continue;
+        }
+        nlines++;
+    }
+    if(!nlines){
+        fprintf(stderr, "statbench: no stat files recorded\n");
+        exit(1);
+    }
+}
+
+// the two parsers fill in the same fields from every line
+static void check(unsigned want){
+    static proc_t a, b;
+    unsigned i;
+
+    for(i = 0; i < nlines; i++){
+        memset(&a, 0, sizeof a);
+        memset(&b, 0, sizeof b);
+        stat2proc(lines[i].stat, &a, want);
+        old_stat2proc(lines[i].stat, &b, want);
+        statm2proc(lines[i].statm, &a);
+        old_statm2proc(lines[i].statm, &b);
+        if(memcmp(&a, &b, sizeof a)){
+            fprintf(stderr, "statbench: parsers differ on %s", lines[i].stat);
+            exit(1);
+        }
+    }
+}
+
+typedef void (*stat_fn)(const char *S, proc_t *restrict P, unsigned want);
+typedef void (*statm_fn)(const char *S, proc_t *restrict P);
+
+// ns per line
+static double time_stat(stat_fn fn, unsigned want, unsigned rounds){
+    static proc_t p;
+    unsigned long long t = costs_now();
+    unsigned r, i;
+
+    for(r = 0; r < rounds; r++)
+        for(i = 0; i < nlines; i++) fn(lines[i].stat, &p, want);
+    return (double)(costs_now() - t) / ((double)rounds * nlines);
+}
+
+static double time_statm(statm_fn fn, unsigned rounds){
+    static proc_t p;
+    unsigned long long t = costs_now();
+    unsigned r, i;
+
+    for(r = 0; r < rounds; r++)
+        for(i = 0; i < nlines; i++) fn(lines[i].statm, &p);
+    return (double)(costs_now() - t) / ((double)rounds * nlines);
+}
+
+static void show(const char *what, double now, double before){
+    printf("%-14s %9.1f ns %9.1f ns %6.2fx\n", what, now, before, before / now);
+}
+
+int main(int argc, char *argv[]){
+    unsigned rounds;
+
+    load();
+    check(PROC_FIELDS);
+    check(PROC_FIELD_BASIC);
+    // a million or so lines a row
+    rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000 / nlines + 1;
+
+    printf("%u processes, %u rounds\n", nlines, rounds);
+    printf("%-14s %12s %12s %7s\n", "", "scanner", "sscanf", "");
+    show("stat", time_stat(stat2proc, PROC_FIELDS, rounds),
+                 time_stat(old_stat2proc, PROC_FIELDS, rounds));
+    show("stat, basic", time_stat(stat2proc, PROC_FIELD_BASIC, rounds),
+                        time_stat(old_stat2proc, PROC_FIELD_BASIC, rounds));
+    show("statm", time_statm(statm2proc, rounds),
+                  time_statm(old_statm2proc, rounds));
+    return 0;
+}
@@ -0,0 +1,295 @@
+// wchanbench.c - time lookup_wchan()'s symbol index, for "make bench-wchan"
+//
+// This program is licensed under the GNU Library General Public License, v2
+//
+//     PROCPS_REPLAY=bench/snap-10000.rec bench/wchanbench [lookups]
+//
+// names WCHAN addresses with lookup_wchan() and, to compare, with the
+// plain binary search of {addr, name} pairs it used before, each behind
+// the same cache of answers.  The addresses come two ways:
+//
+//   recorded  each recorded process' wchan: the stat address, or where
+//             kernels give out only a name (/proc/#/wchan), a spot inside
+//             that function of this kernel's /proc/kallsyms
+//   spread    addresses all over the kernel's text, which miss the cache
+//             and so time the index itself
+//
+// Both ways must give the same names.  This wants root and kptr_restrict
+// 0 or 1, for /proc/kallsyms to have addresses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../proc/alloc.h"
+#include "../proc/costs.h"
+#include "../proc/readproc.h"
+#include "../proc/replay.h"
+#include "../proc/wchan.h"
+
+typedef struct symb {
+    unsigned KLONG addr;
+    const char *name;
+} symb;
+
+static symb *syms;              // the text symbols, on addr
+static unsigned nsyms;
+
+static int on_addr(const void *a, const void *b){
+    const symb *x = a, *y = b;
+    if(x->addr < y->addr) return -1;
+    return x->addr > y->addr;
+}
+
+static int on_name(const void *a, const void *b){
+    return strcmp(((const symb *)a)->name, ((const symb *)b)->name);
+}
+
+// /proc/kallsyms the way libproc's parse_kallsyms() takes it
+static void load_syms(void){
+    FILE *fp = fopen("/proc/kallsyms", "r");
+    unsigned room = 0;
+    char line[512];
+
+    if(!fp){
+        perror("wchanbench: /proc/kallsyms");
+        exit(1);
+    }
+    while(fgets(line, sizeof line, fp)){
+        unsigned KLONG addr;
+        char type, name[256];
+        if(sscanf(line, "%"KLF"x %c %255s", &addr, &type, name) != 3) continue;
+        if(type!='T' && type!='t' && type!='W' && type!='w') continue;
+        if(nsyms == room){
+            room = room ? room * 2 : 4096;
+            syms = xrealloc(syms, sizeof *syms * room);
+        }
+        syms[nsyms].addr = addr;
+        syms[nsyms].name = strcpy(xmalloc(strlen(name) + 1), name);
+        nsyms++;
+    }
+    fclose(fp);
+    qsort(syms, nsyms, sizeof *syms, on_addr);
+    if(!nsyms || !syms[nsyms - 1].addr){
+        printf("wchanbench: /proc/kallsyms has no addresses here, skipped\n");
+        exit(0);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+// what lookup_wchan() did before the Eytzinger index, for a kallsyms
+// with no System.map: search(), the cache, and the same trimming
+
+static const symb *search(unsigned KLONG address, symb *idx, unsigned count){
+    unsigned left, mid, right;
+    if(address < idx[0].addr) return NULL;
+    if(address >= idx[count-1].addr) return idx+count-1;
+    left  = 0;
+    right = count-1;
+    for(;;){
+        mid = (left + right) / 2;
+        if(address >= idx[mid].addr) left  = mid;
+        if(address <= idx[mid].addr) right = mid;
+        if(right-left <= 1) break;
+    }
+    if(address == idx[right].addr) return idx+right;
+    return idx+left;
+}
+
+#define WCHAN_CACHE_SIZE 1024
+#define MAX_OFFSET (0x1000*sizeof(long))
+
+static symb cache[WCHAN_CACHE_SIZE];
+static const symb fail = { .name = "?" };
+
+static const char *trim(const char *ret){
+    if(*ret=='.') ret++;
+    switch(*ret){
+      case 's': if(!strncmp(ret, "sys_", 4)) ret += 4;   break;
+      case 'd': if(!strncmp(ret, "do_",  3)) ret += 3;   break;
+      case '_': while(*ret=='_') ret++;                  break;
+    }
+    return ret;
+}
+
+static const symb *old_symbol(unsigned KLONG address){
+    const symb *good = search(address, syms, nsyms);
+    if(!good || address > good->addr + MAX_OFFSET) good = &fail;
+    return good;
+}
+
+static const char *old_lookup_wchan(unsigned KLONG address, unsigned pid){
+    static time_t stamp;
+    const char *ret;
+    unsigned hash;
+
+    (void)pid;
+    if(!address)  return "-";
+    if(!~address) return "*";
+    if(time(NULL) != stamp) stamp = time(NULL);   // read_and_parse()'s test
+    hash = (address >> 4) & (WCHAN_CACHE_SIZE-1);
+    if(cache[hash].addr == address) return cache[hash].name;
+    ret = trim(old_symbol(address)->name);
+    cache[hash].addr = address;
+    cache[hash].name = ret;
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+static unsigned KLONG *recorded, *spread;
+static unsigned nrecorded, nspread, distinct;
+
+// somewhere inside the function, as a sleeping task's wchan would be
+static unsigned KLONG inside(const symb *s){
+    unsigned long span = s + 1 < syms + nsyms ? s[1].addr - s->addr : 64;
+    if(span > MAX_OFFSET) span = MAX_OFFSET;
+    return s->addr + span / 2;
+}
+
+static void load_recorded(void){
+    const int32_t *pids;
+    symb *by_name, key;
+    unsigned i;
+
+    if(!replay_image){
+        fprintf(stderr, "wchanbench: PROCPS_REPLAY names no recording\n");
+        exit(1);
+    }
+    by_name = xmalloc(sizeof *syms * nsyms);
+    memcpy(by_name, syms, sizeof *syms * nsyms);
+    qsort(by_name, nsyms, sizeof *syms, on_name);
+
+    pids = (const int32_t *)((const char *)replay_image + replay_image->pids);
+    recorded = xmalloc(sizeof *recorded * (replay_image->npids + 1));
+    for(i = 0; i < replay_image->npids; i++){
+        char path[64], name[64];
+        static proc_t p;
+        const symb *s;
+        const char *data;
+        unsigned len;
+
+        snprintf(path, sizeof path, "/proc/%d/stat", pids[i]);
+        if((data = replay_data(path, &len))){
+            char *stat = strndup(data, len);
+            if(!stat) continue;
+            stat2proc(stat, &p, PROC_FIELDS);
+            free(stat);
+            if(p.wchan > 1 && ~p.wchan){
+                recorded[nrecorded++] = p.wchan;
+                continue;
+            }
+        }
+        snprintf(path, sizeof path, "/proc/%d/wchan", pids[i]);
+        if(replay_copy(path, name, sizeof name) < 1 || !strcmp(name, "0")) continue;
+        key.name = name;
+        if(!(s = bsearch(&key, by_name, nsyms, sizeof *syms, on_name))) continue;
+        recorded[nrecorded++] = inside(s);
+    }
+    free(by_name);
+}
+
+// a fixed pseudo-random walk over the kernel's text
+static void make_spread(unsigned n){
+    unsigned KLONG lo = syms[0].addr, range = syms[nsyms - 1].addr - lo;
+    unsigned long long x = 0x9e3779b97f4a7c15ULL;
+    unsigned i;
+
+    spread = xmalloc(sizeof *spread * n);
+    for(i = 0; i < n; i++){
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        spread[i] = lo + x % range;
+    }
+    nspread = n;
+}
+
+// Symbols sharing an address sort either way, so libproc may pick
+// another name for it than this program's own copy of the table does.
+static int same_symbol(const char *name, const symb *s){
+    const symb *t;
+
+    if(!strcmp(name, trim(s->name))) return 1;
+    if(s == &fail) return 0;
+    for(t = s; t > syms && t[-1].addr == s->addr; t--)
+        if(!strcmp(name, trim(t[-1].name))) return 1;
+    for(t = s; t + 1 < syms + nsyms && t[1].addr == s->addr; t++)
+        if(!strcmp(name, trim(t[1].name))) return 1;
+    return 0;
+}
+
+static void check(const unsigned KLONG *addr, unsigned n){
+    unsigned i;
+
+    for(i = 0; i < n; i++){
+        const char *now = lookup_wchan(addr[i], 0);
+        const symb *before = old_symbol(addr[i]);
+        if(!same_symbol(now, before)){
+            fprintf(stderr, "wchanbench: %"KLF"x is %s, was %s\n", addr[i], now, trim(before->name));
+            exit(1);
+        }
+    }
+}
+
+typedef const char *(*lookup_fn)(unsigned KLONG address, unsigned pid);
+
+static const char *volatile answer;     // so the lookups aren't dropped
+
+// ns per lookup, over at least 'lookups' of them
+static double time_lookups(lookup_fn fn, const unsigned KLONG *addr, unsigned n, unsigned lookups){
+    unsigned rounds = lookups / n + 1, r, i;
+    unsigned long long t = costs_now();
+
+    for(r = 0; r < rounds; r++)
+        for(i = 0; i < n; i++) answer = fn(addr[i], 0);
+    t = costs_now() - t;
+    return (double)t / ((double)rounds * n);
+}
+
+// the best of a few tries each, taken in turns, for a machine that's
+// doing other things
+static void show(const char *what, const unsigned KLONG *addr, unsigned n, unsigned lookups){
+    double now = 1e30, before = 1e30, t;
+    int i;
+
+    for(i = 0; i < 5; i++){
+        if((t = time_lookups(lookup_wchan, addr, n, lookups)) < now) now = t;
+        if((t = time_lookups(old_lookup_wchan, addr, n, lookups)) < before) before = t;
+    }
+    printf("%-10s %9u %9.1f ns %9.1f ns %6.2fx\n", what, n, now, before, before / now);
+}
+
+static int on_value(const void *a, const void *b){
+    unsigned KLONG x = *(const unsigned KLONG *)a, y = *(const unsigned KLONG *)b;
+    if(x < y) return -1;
+    return x > y;
+}
+
+int main(int argc, char *argv[]){
+    unsigned lookups = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    unsigned KLONG *sorted;
+    unsigned i;
+
+    load_syms();
+    load_recorded();
+    make_spread(1000000);
+
+    sorted = xmalloc(sizeof *sorted * (nrecorded + 1));
+    memcpy(sorted, recorded, sizeof *sorted * nrecorded);
+    qsort(sorted, nrecorded, sizeof *sorted, on_value);
+    for(i = 0; i < nrecorded; i++) distinct += !i || sorted[i] != sorted[i-1];
+    free(sorted);
+
+    check(recorded, nrecorded);
+    check(spread, nspread);
+
+    printf("%u processes, %u wchans recorded (%u addresses), %u text symbols\n",
+           replay_image->npids, nrecorded, distinct, nsyms);
+    printf("%-10s %9s %12s %12s %7s\n", "", "addresses", "Eytzinger", "bsearch", "");
+    if(nrecorded) show("recorded", recorded, nrecorded, lookups);
+    show("spread", spread, nspread, lookups);
+    return 0;
+}
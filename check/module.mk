@@ -0,0 +1,21 @@
+# This file gets included into the main Makefile, in the top directory.
+
+# "make check" runs libproc against what the checks set up themselves,
+# for the bugs that only show on a live system (threads and such).
+# Nothing here is built by "make all" or installed.
+
+CHECK_C := threads
+CHECKS  := $(addprefix check/,$(CHECK_C))
+
+TARFILES += check/module.mk $(addsuffix .c,$(CHECKS))
+
+CLEAN += $(CHECKS)
+DIRS  += check/
+
+.PHONY: check
+
+check: $(CHECKS)
+	for c in $(CHECKS); do LD_LIBRARY_PATH=proc $$c || exit; done
+
+$(CHECKS): %: %.o $(LIBPROC)
+	$(CC) $(ALL_CFLAGS) $^ $(ALL_LDFLAGS) -o $@ -lpthread
@@ -0,0 +1,132 @@
+// threads.c - libproc on a multithreaded process, for "make check"
+//
+// This program is licensed under the GNU Library General Public License, v2
+//
+// Starts a few threads that wait on pipes, then reads itself back
+// through libproc the ways ps and top do.  Each check prints a line;
+// the exit status is the number that failed.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "../proc/readproc.h"
+
+#define NTHREADS 3
+
+typedef struct slot {
+    pthread_t t;
+    volatile pid_t tid;
+    int fd[2];  // closing fd[1] lets this one go
+} slot;
+
+static slot slots[NTHREADS];
+static int fails;
+
+static void *waiter(void *vp){
+    slot *s = vp;
+    char c;
+
+    s->tid = syscall(SYS_gettid);
+    if(read(s->fd[0], &c, 1) < 0) {}
+    return NULL;
+}
+
+static void start(slot *s){
+    s->tid = 0;
+    if(pipe(s->fd) || pthread_create(&s->t, NULL, waiter, s)){
+        fprintf(stderr, "threads: can't start a thread\n");
+        exit(1);
+    }
+    while(!s->tid) usleep(1000);
+}
+
+static void stop(slot *s){
+    close(s->fd[1]);
+    pthread_join(s->t, NULL);
+    close(s->fd[0]);
+}
+
+static void report(const char *what, int ok){
+    printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+    fails += !ok;
+}
+
+// ps -o pid,wchan,nwchan wants stat and status, but none of the TIMES
+// fields; the stat nlwp must survive status2proc() quitting early
+static void nlwp_without_times(void){
+    pid_t pids[2] = { getpid(), 0 };
+    PROCTAB *PT = openproc(PROC_FILLSTAT | PROC_FILLSTATUS | PROC_FIELD_SCHED | PROC_PID, pids);
+    proc_t p;
+
+    memset(&p, 0, sizeof p);
+    if(!PT || !readproc(PT, &p)){
+        report("readproc() finds this process", 0);
+        return;
+    }
+    report("nlwp > 1 with PROC_FIELD_SCHED alone", p.nlwp > 1);
+    report("wchan marked for a threaded process", p.wchan != 0);
+    closeproc(PT);
+}
+
+// a frame of top -H: how many of the threads readtask() lists are the
+// live ones, and how many are not
+static int tasks_listed(unsigned flags, int *stale){
+    pid_t pids[2] = { getpid(), 0 };
+    PROCTAB *PT = openproc(flags | PROC_PID, pids);
+    int seen = 0, i;
+    proc_t p, t;
+
+    memset(&p, 0, sizeof p);
+    memset(&t, 0, sizeof t);
+    *stale = 0;
+    if(!PT) return 0;
+    if(readproc(PT, &p)){
+        while(readtask(PT, &p, &t)){
+            int found = 0;
+            if(t.tid == getpid()) continue;
+            for(i = 0; i < NTHREADS; i++) found |= t.tid == slots[i].tid;
+            if(found) seen++;
+            else ++*stale;
+        }
+    }
+    closeproc(PT);
+    return seen;
+}
+
+// A thread pool that replaces a worker keeps its thread count, so the
+// PROC_CACHEFD task list can't go by nlwp alone.  The new thread may be
+// a scan late; the old one must go at once.
+static void replaced_thread(unsigned flags, const char *what){
+    int ok, stale, i;
+
+    ok = tasks_listed(flags, &stale) == NTHREADS && !stale;
+    for(i = 0; i < NTHREADS; i++){
+        stop(&slots[i]);
+        start(&slots[i]);
+        tasks_listed(flags, &stale);
+        ok &= !stale;
+        ok &= tasks_listed(flags, &stale) == NTHREADS && !stale;
+    }
+    report(what, ok);
+}
+
+int main(void){
+    int i;
+
+    for(i = 0; i < NTHREADS; i++) start(&slots[i]);
+
+    nlwp_without_times();
+    replaced_thread(PROC_FILLSTAT | PROC_FILLSTATUS | PROC_CACHEFD,
+                    "PROC_CACHEFD tasks follow a replaced thread");
+    replaced_thread(PROC_FILLSTAT | PROC_FILLSTATUS | PROC_CACHEFD | PROC_FIELD_SCHED,
+                    "PROC_CACHEFD tasks follow a replaced thread, without TIMES");
+    replaced_thread(PROC_FILLSTATUS | PROC_CACHEFD,
+                    "PROC_CACHEFD tasks follow a replaced thread, status alone");
+
+    for(i = 0; i < NTHREADS; i++) stop(&slots[i]);
+    return fails;
+}
@@ -11,6 +11,7 @@
 
 #include "proc/sysinfo.h"
 #include "proc/version.h"
+#include "proc/interval.h"
 //#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
@@ -28,7 +29,7 @@ const char help_message[] =
 "  -o use old format (no -/+buffers/cache line)\n"
 "  -t display total for RAM + swap\n"
 "  -s update every [delay] seconds\n"
-"  -c update [count] times\n"
+"  -c update [count] times (every second, without -s)\n"
 "  -V display version information and exit\n"
 ;
 
@@ -36,10 +37,11 @@ int main(int argc, char *argv[]){
     int i;
     int count = 0;
     int shift = 10;
-    int pause_length = 0;
+    double pause_length = 0;
     int show_high = 0;
     int show_total = 0;
     int old_fmt = 0;
+    interval_t tick;
 
     /* check startup flags */
     while( (i = getopt(argc, argv, "bkmglotc:s:V") ) != -1 )
@@ -51,13 +53,17 @@ int main(int argc, char *argv[]){
         case 'l': show_high = 1; break;
         case 'o': old_fmt = 1; break;
         case 't': show_total = 1; break;
-        case 's': pause_length = 1000000 * atof(optarg); break;
+        case 's': pause_length = atof(optarg); break;
         case 'c': count = strtoul(optarg, NULL, 10); break;
 	case 'V': display_version(); exit(0);
         default:
             fwrite(help_message,1,strlen(help_message),stderr);
 	    return 1;
     }
+    if(count && pause_length <= 0) pause_length = 1;
+    // ticks on a fixed schedule: the time each report takes isn't added
+    // to the delay, and meminfo() rereads a descriptor it keeps open
+    if(pause_length > 0) interval_start(&tick, pause_length);
 
     do {
         meminfo();
@@ -111,12 +117,12 @@ int main(int argc, char *argv[]){
                 S(kb_main_free  + kb_swap_free)
             );
         }
-        if(pause_length){
+        if(pause_length > 0){
 	    fputc('\n', stdout);
 	    fflush(stdout);
-	    if (count != 1) usleep(pause_length);
+	    if (count != 1) interval_wait(&tick);
 	}
-    } while(pause_length && --count);
+    } while(pause_length > 0 && --count);
 
     return 0;
 }
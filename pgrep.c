@@ -26,8 +26,11 @@
 #include <grp.h>
 #include <regex.h>
 #include <errno.h>
+#include <getopt.h>
+#include <poll.h>
 
 #include "proc/readproc.h"
+#include "proc/procev.h"
 #include "proc/sig.h"
 #include "proc/devname.h"
 #include "proc/sysinfo.h"
@@ -57,6 +60,9 @@ static int opt_exact = 0;
 static int opt_signal = SIGTERM;
 static int opt_lock = 0;
 static int opt_case = 0;
+static int opt_mark = 0;
+static int opt_wait = 0;
+static int ev_fd = -1;		/* proc connector, for --wait */
 
 static const char *opt_delim = "\n";
 static union el *opt_pgrp = NULL;
@@ -67,7 +73,7 @@ static union el *opt_sid = NULL;
 static union el *opt_term = NULL;
 static union el *opt_euid = NULL;
 static union el *opt_ruid = NULL;
-static char *opt_pattern = NULL;
+static union el *opt_pattern = NULL;
 static char *opt_pidfile = NULL;
 
 static int usage (int opt) NORETURN;
@@ -79,10 +85,10 @@ static int usage (int opt)
 	if (i_am_pkill)
 		fprintf (fp, "Usage: pkill [-SIGNAL] [-fvx] ");
 	else
-		fprintf (fp, "Usage: pgrep [-flvx] [-d DELIM] ");
+		fprintf (fp, "Usage: pgrep [-flmvx] [-d DELIM] ");
 	fprintf (fp, "[-n|-o] [-P PPIDLIST] [-g PGRPLIST] [-s SIDLIST]\n"
 		 "\t[-u EUIDLIST] [-U UIDLIST] [-G GIDLIST] [-t TERMLIST] "
-		 "[PATTERN]\n");
+		 "[-E FILE] [--wait] [PATTERN...]\n");
 
 	exit(err ? EXIT_USAGE : EXIT_SUCCESS);
 }
@@ -212,6 +218,8 @@ static union el *read_pidfile(void)
 	if(*endp && !isspace(*endp))
 		goto out;
 	list = malloc(2 * sizeof *list);
+	if (list == NULL)
+		exit (EXIT_FATAL);
 	list[0].num = 1;
 	list[1].num = pid;
 out:
@@ -299,6 +307,48 @@ static int conv_str (const char *restrict name, union el *restrict e)
 }
 
 
+// patterns go in a list like the others, slot zero being the count
+static void add_pattern (const char *restrict pattern)
+{
+	int i = opt_pattern ? opt_pattern[0].num : 0;
+
+	// the size only ever goes 1, 2, 4, 8...
+	if (!(i & (i + 1))) {
+		opt_pattern = realloc (opt_pattern, (2 * i + 2) * sizeof *opt_pattern);
+		if (opt_pattern == NULL)
+			exit (EXIT_FATAL);
+	}
+	opt_pattern[++i].str = strdup (pattern);
+	if (opt_pattern[i].str == NULL)
+		exit (EXIT_FATAL);
+	opt_pattern[0].num = i;
+}
+
+// one pattern per line, blank lines ignored
+static int read_patfile (const char *restrict name)
+{
+	FILE *fp = strcmp (name, "-") ? fopen (name, "r") : stdin;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+
+	if (fp == NULL) {
+		fprintf (stderr, "%s: %s: %s\n", progname, name, strerror (errno));
+		return 0;
+	}
+	while ((len = getline (&line, &size, fp)) != -1) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len)
+			add_pattern (line);
+	}
+	free (line);
+	if (fp != stdin)
+		fclose (fp);
+	return 1;
+}
+
+
 static int match_numlist (long value, const union el *restrict list)
 {
 	int found = 0;
@@ -352,20 +402,24 @@ static void output_strlist (const union el *restrict list, int num)
 	}
 }
 
-static PROCTAB *do_openproc (void)
+static PROCTAB *do_openproc (pid_t *only)
 {
 	PROCTAB *ptp;
 	int flags = 0;
 
-	if (opt_pattern || opt_full)
+	if (opt_full)	/* else it's all /proc/#/stat's "cmd" */
 		flags |= PROC_FILLCOM;
-	if (opt_ruid || opt_rgid)
+	if (opt_ruid || opt_rgid || (opt_euid && opt_negate))
 		flags |= PROC_FILLSTATUS;
-	if (opt_oldest || opt_newest || opt_pgrp || opt_sid || opt_term)
-		flags |= PROC_FILLSTAT;
-	if (!(flags & PROC_FILLSTAT))
-		flags |= PROC_FILLSTATUS;  // FIXME: need one, and PROC_FILLANY broken
-	if (opt_euid && !opt_negate) {
+	flags |= PROC_FILLSTAT;  /* all that stat_match() and the name need */
+	flags |= PROC_FIELD_BASIC;  // no need to parse the rest of stat,status
+	if (opt_oldest || opt_newest)
+		flags |= PROC_FIELD_TIMES;
+	if (!i_am_pkill)	/* a signal goes by what /proc says now */
+		flags |= PROC_SHARED;
+	if (only) {
+		ptp = openproc (flags | PROC_PID, only);
+	} else if (opt_euid && !opt_negate) {
 		int num = opt_euid[0].num;
 		int i = num;
 		uid_t *uids = malloc (num * sizeof (uid_t));
@@ -382,73 +436,488 @@ static PROCTAB *do_openproc (void)
 	return ptp;
 }
 
-static regex_t * do_regcomp (void)
-{
-	regex_t *preg = NULL;
+/* The pattern, compiled into whatever is cheapest to test.  A plain
+ * string, which is what most "pkill -f worker" patterns are, never goes
+ * near the regex engine.  A real regex comes with a literal that any
+ * match has to contain, so that memmem() can turn most tasks away before
+ * regexec() gets called at all. */
+struct matcher {
+	regex_t *preg;		/* NULL for a plain string */
+	char *lit;		/* the string, or a literal the regex needs */
+	size_t litlen;		/* 0 if the regex has no such literal */
+};
 
-	if (opt_pattern) {
-		char *re;
-		char errbuf[256];
-		int re_err;
+/* A pattern is a plain string if it has none of these */
+static const char re_special[] = ".[]()*+?{}|^$\\";
 
-		preg = malloc (sizeof (regex_t));
-		if (preg == NULL)
+/* Finds the longest run of ordinary characters which any match of the
+ * extended regex 're' must contain, and copies it to 'out'.  Groups and
+ * bracket expressions are skipped over, a quantified character is dropped
+ * from the run, and a '|' anywhere means nothing is certain. */
+static size_t required_literal (const char *restrict re, char *restrict out)
+{
+	char *run = malloc (strlen (re) + 1);
+	size_t best = 0, len = 0;
+	int depth = 0;		/* inside how many () groups */
+	int lastlit = 0;	/* was the previous atom the end of run[]? */
+
+	if (run == NULL)
+		exit (EXIT_FATAL);
+	if (strchr (re, '|'))
+		goto out;
+	while (*re) {
+		int c = (unsigned char)*re++;
+		int lit = -1;
+
+		switch (c) {
+		case '[':
+			if (*re == '^')
+				re++;
+			if (*re == ']')
+				re++;
+			while (*re && *re != ']') {
+				/* [:alpha:] and friends may hold a ']' */
+				if (*re == '[' && re[1] && strchr (":.=", re[1])) {
+					char end[3] = { re[1], ']', '\0' };
+					const char *cp = strstr (re + 2, end);
+					re = cp ? cp + 2 : re + 1;
+					continue;
+				}
+				re++;
+			}
+			if (*re)
+				re++;
+			break;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (depth)
+				depth--;
+			break;
+		case '*':
+		case '?':
+		case '{':
+			/* the atom before this may not be there at all */
+			if (lastlit && len)
+				len--;
+			if (c == '{')
+				while (*re && *re++ != '}')
+					;
+			break;
+		case '+':
+			/* needed once, but the run can't go on past it */
+			lastlit = 0;
+			if (len > best) {
+				memcpy (out, run, len);
+				best = len;
+			}
+			len = 0;
+			continue;
+		case '\\':
+			c = (unsigned char)*re;
+			if (c && !isalnum (c) && !strchr ("<>`'", c)) {
+				lit = c;
+				re++;
+			} else if (c) {
+				re++;
+			}
+			break;
+		case '.':
+		case '^':
+		case '$':
+			break;
+		default:
+			lit = c;
+			break;
+		}
+		if (lit >= 0 && !depth) {
+			run[len++] = lit;
+			lastlit = 1;
+			continue;
+		}
+		if (len > best) {
+			memcpy (out, run, len);
+			best = len;
+		}
+		len = 0;
+		lastlit = 0;
+	}
+	if (len > best) {
+		memcpy (out, run, len);
+		best = len;
+	}
+out:
+	free (run);
+	out[best] = '\0';
+	return best;
+}
+
+/* Compiles one pattern into 'm' */
+static void do_regcomp (struct matcher *restrict m, const char *restrict pattern)
+{
+	const char *re = pattern;
+	char errbuf[256];
+	int re_err;
+
+	m->lit = malloc (strlen (pattern) + 1);
+	if (m->lit == NULL)
+		exit (EXIT_FATAL);
+	if (!opt_case && !strpbrk (pattern, re_special)) {
+		strcpy (m->lit, pattern);
+		m->litlen = strlen (m->lit);
+		return;
+	}
+	if (!opt_case)
+		m->litlen = required_literal (pattern, m->lit);
+
+	m->preg = malloc (sizeof (regex_t));
+	if (m->preg == NULL)
+		exit (EXIT_FATAL);
+	if (opt_exact) {
+		char *anchored = malloc (strlen (pattern) + 5);
+		if (anchored == NULL)
 			exit (EXIT_FATAL);
-		if (opt_exact) {
-			re = malloc (strlen (opt_pattern) + 5);
-			if (re == NULL)
-				exit (EXIT_FATAL);
-			sprintf (re, "^(%s)$", opt_pattern);
-		} else {
-		 	re = opt_pattern;
+		sprintf (anchored, "^(%s)$", pattern);
+		re = anchored;
+	}
+
+	re_err = regcomp (m->preg, re, REG_EXTENDED | REG_NOSUB | opt_case);
+	if (re_err) {
+		regerror (re_err, m->preg, errbuf, sizeof(errbuf));
+		fputs(errbuf,stderr);
+		exit (EXIT_USAGE);
+	}
+}
+
+/* Does 'str', which is 'len' bytes long, match? */
+static int do_match (const struct matcher *restrict m, const char *restrict str, size_t len)
+{
+	if (m->preg == NULL) {
+		if (opt_exact)
+			return len == m->litlen && !memcmp (str, m->lit, len);
+		return memmem (str, len, m->lit, m->litlen) != NULL;
+	}
+	if (m->litlen && !memmem (str, len, m->lit, m->litlen))
+		return 0;
+	return regexec (m->preg, str, 0, NULL, 0) == 0;
+}
+
+/* All the patterns.  Given two or more literals (plain patterns, or the
+ * literals that regexes need) they go into one Aho-Corasick automaton,
+ * so that a single pass over the name finds every one of them, however
+ * many patterns there are.  Only the regexes whose literal turned up,
+ * or which have none, then get to run. */
+struct patset {
+	struct matcher *m;	/* one per pattern, in opt_pattern order */
+	int n;
+	unsigned serial;	/* bumped for each name tried */
+	unsigned *seen;		/* seen[i] == serial: pattern i's literal is in there */
+	int *hit;		/* the patterns that matched, from patset_match() */
+	int *go;		/* NULL, or the automaton: go[state*nclass + class[c]] */
+	int *dlink;		/* the closest state down the failure links with a term */
+	int *term;		/* the first pattern whose literal ends in this state, or -1 */
+	int *nextpat;		/* the next pattern whose literal ends in the same state */
+	int nclass;
+	unsigned char class[256];	/* 0 for bytes in no literal */
+};
+
+/* Is the literal of pattern i in the automaton? */
+#define IN_AC(ps,i) ((ps)->go && (ps)->m[i].litlen)
+
+static void build_ac (struct patset *restrict ps)
+{
+	int states = 1;		/* root is 0 */
+	int nc = 1, nstates = 1;
+	int *fail, *queue;
+	int head = 0, tail = 0;
+	int i, k, nlit = 0;
+	size_t j;
+
+	for (i = 0; i < ps->n; i++) {
+		const struct matcher *m = &ps->m[i];
+		if (!m->litlen)
+			continue;
+		nlit++;
+		states += m->litlen;
+		for (j = 0; j < m->litlen; j++) {
+			unsigned char c = m->lit[j];
+			if (!ps->class[c])
+				ps->class[c] = nc++;
 		}
+	}
+	if (nlit < 2)	/* memmem() does one literal better */
+		return;
+
+	ps->nclass = nc;
+	ps->go = calloc (states * nc, sizeof (int));
+	ps->dlink = calloc (states, sizeof (int));
+	ps->term = malloc (states * sizeof (int));
+	ps->nextpat = malloc (ps->n * sizeof (int));
+	fail = calloc (states, sizeof (int));
+	queue = malloc (states * sizeof (int));
+	if (!ps->go || !ps->dlink || !ps->term || !ps->nextpat || !fail || !queue)
+		exit (EXIT_FATAL);
+	for (k = 0; k < states; k++)
+		ps->term[k] = -1;
+
+	/* the trie; 0 means no edge, as nothing leads back to the root yet */
+	for (i = 0; i < ps->n; i++) {
+		const struct matcher *m = &ps->m[i];
+		int s = 0;
+		if (!m->litlen)
+			continue;
+		for (j = 0; j < m->litlen; j++) {
+			int *t = &ps->go[s * nc + ps->class[(unsigned char)m->lit[j]]];
+			if (!*t)
+				*t = nstates++;
+			s = *t;
+		}
+		ps->nextpat[i] = ps->term[s];
+		ps->term[s] = i;
+	}
 
-		re_err = regcomp (preg, re, REG_EXTENDED | REG_NOSUB | opt_case);
-		if (re_err) {
-			regerror (re_err, preg, errbuf, sizeof(errbuf));
-			fputs(errbuf,stderr);
-			exit (EXIT_USAGE);
+	/* breadth first, so that each failure state is done before it's used */
+	for (k = 0; k < nc; k++)
+		if (ps->go[k])
+			queue[tail++] = ps->go[k];
+	while (head < tail) {
+		int s = queue[head++];
+		int f = fail[s];
+		ps->dlink[s] = ps->term[f] >= 0 ? f : ps->dlink[f];
+		for (k = 0; k < nc; k++) {
+			int *t = &ps->go[s * nc + k];
+			if (*t) {
+				fail[*t] = ps->go[f * nc + k];
+				queue[tail++] = *t;
+			} else {
+				*t = ps->go[f * nc + k];
+			}
 		}
 	}
-	return preg;
+	free (fail);
+	free (queue);
+}
+
+static struct patset * do_patset (void)
+{
+	struct patset *ps;
+	int i;
+
+	if (opt_pattern == NULL)
+		return NULL;
+	ps = calloc (1, sizeof *ps);
+	if (ps == NULL)
+		exit (EXIT_FATAL);
+	ps->n = opt_pattern[0].num;
+	ps->m = calloc (ps->n, sizeof *ps->m);
+	ps->seen = calloc (ps->n, sizeof *ps->seen);
+	ps->hit = malloc (ps->n * sizeof *ps->hit);
+	if (!ps->m || !ps->seen || !ps->hit)
+		exit (EXIT_FATAL);
+	for (i = 0; i < ps->n; i++)
+		do_regcomp (&ps->m[i], opt_pattern[i + 1].str);
+	build_ac (ps);
+	return ps;
 }
 
-static union el * select_procs (int *num)
+/* Fills ps->hit[] with the patterns that match 'str' and returns how many
+ * there are.  Unless all of them are wanted, for -m, the first one will do. */
+static int patset_match (struct patset *restrict ps, const char *restrict str, size_t len)
 {
+	int all = opt_mark;
+	int found = 0;
+	int i;
+
+	if (ps->go) {
+		const int *go = ps->go;
+		const unsigned char *class = ps->class;
+		int nc = ps->nclass;
+		int s = 0;
+		size_t at;
+
+		if (!++ps->serial) {	/* wrapped: old marks could look new */
+			memset (ps->seen, 0, ps->n * sizeof *ps->seen);
+			ps->serial = 1;
+		}
+		for (at = 0; at < len; at++) {
+			int t;
+			s = go[s * nc + class[(unsigned char)str[at]]];
+			for (t = s; t; t = ps->dlink[t]) {
+				for (i = ps->term[t]; i >= 0; i = ps->nextpat[i]) {
+					const struct matcher *m = &ps->m[i];
+					if (ps->seen[i] == ps->serial)
+						continue;
+					if (m->preg == NULL && opt_exact &&
+					    (at + 1 != len || m->litlen != len))
+						continue;
+					ps->seen[i] = ps->serial;
+					if (m->preg == NULL) {
+						ps->hit[found++] = i;
+						if (!all)
+							return found;
+					}
+				}
+			}
+		}
+	}
+	for (i = 0; i < ps->n; i++) {
+		const struct matcher *m = &ps->m[i];
+		if (IN_AC (ps, i)) {
+			if (ps->seen[i] != ps->serial)
+				continue;	/* that literal wasn't there */
+			if (m->preg == NULL)
+				continue;	/* already in hit[] */
+			if (regexec (m->preg, str, 0, NULL, 0))
+				continue;
+		} else if (!do_match (m, str, len)) {
+			continue;
+		}
+		ps->hit[found++] = i;
+		if (!all)
+			break;
+	}
+	return found;
+}
+
+/* What matched one pattern, or every pattern if they're not told apart */
+struct hits {
+	union el *list;
+	int num;
+	int size;
+	unsigned long long start_time;	/* for new/old support */
+	pid_t pid;			/* for new/old support */
+};
+
+static void add_hit (struct hits *restrict h, const proc_t *restrict task,
+		     const char *restrict subject, const char *restrict pattern)
+{
+	if (opt_newest) {
+		if (task->start_time < h->start_time)
+			return;
+		if (h->start_time == task->start_time && h->pid > task->XXXID)
+			return;
+		h->start_time = task->start_time;
+		h->pid = task->XXXID;
+		h->num = 0;
+	}
+	if (opt_oldest) {
+		if (task->start_time > h->start_time)
+			return;
+		if (h->start_time == task->start_time && h->pid < task->XXXID)
+			return;
+		h->start_time = task->start_time;
+		h->pid = task->XXXID;
+		h->num = 0;
+	}
+	if (h->num == h->size) {
+		h->size = h->size * 5 / 4 + 4;
+		h->list = realloc (h->list, h->size * sizeof *h->list);
+		if (h->list == NULL)
+			exit (EXIT_FATAL);
+	}
+	if (opt_long || opt_mark) {
+		/* "PATTERN<tab>PID NAME", leaving out what wasn't asked for */
+		char *buff = malloc ((pattern ? strlen (pattern) : 0) +
+				     strlen (subject) + 32);
+		int n = 0;
+		if (buff == NULL)
+			exit (EXIT_FATAL);
+		if (opt_mark)
+			n = sprintf (buff, "%s\t", pattern);
+		n += sprintf (buff + n, "%d", task->XXXID);
+		if (opt_long)
+			sprintf (buff + n, " %s", subject);
+		h->list[h->num++].str = buff;
+	} else {
+		h->list[h->num++].num = task->XXXID;
+	}
+}
+
+/* The tests that /proc/#/stat has all it takes for */
+static int stat_match (const proc_t *restrict task)
+{
+	if (opt_ppid && ! match_numlist (task->ppid, opt_ppid))
+		return 0;
+	if (opt_pid && ! match_numlist (task->tgid, opt_pid))
+		return 0;
+	if (opt_pgrp && ! match_numlist (task->pgrp, opt_pgrp))
+		return 0;
+	if (opt_sid && ! match_numlist (task->session, opt_sid))
+		return 0;
+	if (opt_term) {
+		char tty[256];
+		if (task->tty == 0)
+			return 0;
+		dev_to_tty (tty, sizeof(tty) - 1,
+			    task->tty, task->XXXID, ABBREV_DEV);
+		return match_strlist (tty, opt_term);
+	}
+	return 1;
+}
+
+static struct patset *name_pats;	/* the patterns, unless -f */
+
+/* Skips a task before status and cmdline get read, when stat already
+ * rules it out.  With -v the misses are what's wanted, so it can't. */
+static int prefilter (const proc_t *restrict const task)
+{
+	if (opt_negate)
+		return 1;
+	if (! stat_match (task))
+		return 0;
+	return !name_pats || patset_match (name_pats, task->cmd, strlen (task->cmd));
+}
+
+/* With 'only' set, just those processes (for --wait) */
+static union el * select_procs (int *num, pid_t *only)
+{
+	static struct patset *ps;	/* compiled once, for every call */
+	static int have_ps;
 	PROCTAB *ptp;
 	proc_t task;
-	unsigned long long saved_start_time;      // for new/old support
-	pid_t saved_pid = 0;                      // for new/old support
-	int matches = 0;
-	int size = 0;
-	regex_t *preg;
+	struct hits *hits;	/* one per pattern with -m, else just one */
+	int nhits = 1;
 	pid_t myself = getpid();
 	union el *list = NULL;
 	char cmd[4096];
+	int i;
 
-	ptp = do_openproc();
-	preg = do_regcomp();
-
-	if (opt_newest) saved_start_time =  0ULL;
-	if (opt_oldest) saved_start_time = ~0ULL;
-	if (opt_newest) saved_pid = 0;
-	if (opt_oldest) saved_pid = INT_MAX;
+	ptp = do_openproc(only);
+	if (!have_ps) {
+		ps = do_patset();
+		have_ps = 1;
+	}
+	if (!opt_full)
+		name_pats = ps;
+	ptp->prefilter = prefilter;
+
+	if (opt_mark)
+		nhits = ps->n;
+	hits = calloc (nhits, sizeof *hits);
+	if (hits == NULL)
+		exit (EXIT_FATAL);
+	for (i = 0; i < nhits; i++) {
+		if (opt_newest) hits[i].start_time =  0ULL;
+		if (opt_oldest) hits[i].start_time = ~0ULL;
+		if (opt_newest) hits[i].pid = 0;
+		if (opt_oldest) hits[i].pid = INT_MAX;
+	}
 	
 	memset(&task, 0, sizeof (task));
 	while(readproc(ptp, &task)) {
 		int match = 1;
+		int found = 0;
+		const char *subject = "";	/* the name or command line */
+		size_t len = 0;
 
 		if (task.XXXID == myself)
 			continue;
-		else if (opt_newest && task.start_time < saved_start_time)
-			match = 0;
-		else if (opt_oldest && task.start_time > saved_start_time)
-			match = 0;
-		else if (opt_ppid && ! match_numlist (task.ppid, opt_ppid))
+		else if (!opt_mark && opt_newest && task.start_time < hits[0].start_time)
 			match = 0;
-		else if (opt_pid && ! match_numlist (task.tgid, opt_pid))
+		else if (!opt_mark && opt_oldest && task.start_time > hits[0].start_time)
 			match = 0;
-		else if (opt_pgrp && ! match_numlist (task.pgrp, opt_pgrp))
+		else if (! stat_match (&task))
 			match = 0;
 		else if (opt_euid && ! match_numlist (task.euid, opt_euid))
 			match = 0;
@@ -456,74 +925,42 @@ static union el * select_procs (int *num)
 			match = 0;
 		else if (opt_rgid && ! match_numlist (task.rgid, opt_rgid))
 			match = 0;
-		else if (opt_sid && ! match_numlist (task.session, opt_sid))
-			match = 0;
-		else if (opt_term) {
-			if (task.tty == 0) {
-				match = 0;
-			} else {
-				char tty[256];
-				dev_to_tty (tty, sizeof(tty) - 1,
-					    task.tty, task.XXXID, ABBREV_DEV);
-				match = match_strlist (tty, opt_term);
-			}
-		}
-		if (opt_long || (match && opt_pattern)) {
+		if (opt_long || (match && ps)) {
 			if (opt_full && task.cmdline) {
-				int i = 0;
-				int bytes = sizeof (cmd) - 1;
-
-				/* make sure it is always NUL-terminated */
-				cmd[bytes] = 0;
-				/* make room for SPC in loop below */
-				--bytes;
-
-				strncpy (cmd, task.cmdline[i], bytes);
-				bytes -= strlen (task.cmdline[i++]);
-				while (task.cmdline[i] && bytes > 0) {
-					strncat (cmd, " ", bytes);
-					strncat (cmd, task.cmdline[i], bytes);
-					bytes -= strlen (task.cmdline[i++]) + 1;
+				/* the arguments joined by spaces, cut short if need be */
+				size_t room = sizeof (cmd) - 2;
+
+				len = 0;
+				for (i = 0; task.cmdline[i] && len < room; i++) {
+					size_t n = strlen (task.cmdline[i]);
+					if (i)
+						cmd[len++] = ' ';
+					if (n > room - len)
+						n = room - len;
+					memcpy (cmd + len, task.cmdline[i], n);
+					len += n;
 				}
+				cmd[len] = '\0';
+				subject = cmd;
 			} else {
-				strcpy (cmd, task.cmd);
+				subject = task.cmd;
+				len = strlen (task.cmd);
 			}
 		}
 
-		if (match && opt_pattern) {
-			if (regexec (preg, cmd, 0, NULL, 0) != 0)
+		if (match && ps) {
+			found = patset_match (ps, subject, len);
+			if (!found)
 				match = 0;
 		}
 
 		if (match ^ opt_negate) {	/* Exclusive OR is neat */
-			if (opt_newest) {
-				if (saved_start_time == task.start_time &&
-				    saved_pid > task.XXXID)
-					continue;
-				saved_start_time = task.start_time;
-				saved_pid = task.XXXID;
-				matches = 0;
-			}
-			if (opt_oldest) {
-				if (saved_start_time == task.start_time &&
-				    saved_pid < task.XXXID)
-					continue;
-				saved_start_time = task.start_time;
-				saved_pid = task.XXXID;
-				matches = 0;
-			}
-			if (matches == size) {
-				size = size * 5 / 4 + 4;
-				list = realloc(list, size * sizeof *list);
-				if (list == NULL)
-					exit (EXIT_FATAL);
-			}
-			if (opt_long) {
-				char buff[5096];  // FIXME
-				sprintf (buff, "%d %s", task.XXXID, cmd);
-				list[matches++].str = strdup (buff);
+			if (opt_mark) {
+				for (i = 0; i < found; i++)
+					add_hit (&hits[ps->hit[i]], &task, subject,
+						 opt_pattern[ps->hit[i] + 1].str);
 			} else {
-				list[matches++].num = task.XXXID;
+				add_hit (&hits[0], &task, subject, NULL);
 			}
 		}
 		
@@ -531,11 +968,30 @@ static union el * select_procs (int *num)
 	}
 	closeproc (ptp);
 
-	*num = matches;
+	/* with -m, pattern by pattern in the order they were given */
+	*num = hits[0].num;
+	list = hits[0].list;
+	for (i = 1; i < nhits; i++) {
+		if (!hits[i].num)
+			continue;
+		list = realloc (list, (*num + hits[i].num) * sizeof *list);
+		if (list == NULL)
+			exit (EXIT_FATAL);
+		memcpy (list + *num, hits[i].list, hits[i].num * sizeof *list);
+		*num += hits[i].num;
+		free (hits[i].list);
+	}
+	free (hits);
 	return list;
 }
 
 
+#define OPT_WAIT 256
+static const struct option longopts[] = {
+	{ "wait", no_argument, NULL, OPT_WAIT },
+	{ NULL, 0, NULL, 0 }
+};
+
 static void parse_opts (int argc, char **argv)
 {
 	char opts[32] = "";
@@ -561,15 +1017,22 @@ static void parse_opts (int argc, char **argv)
 		}
 	} else {
 		/* These options are for pgrep only */
-		strcat (opts, "ld:");
+		strcat (opts, "lmd:");
 	}
 			
-	strcat (opts, "LF:fnovxP:g:s:u:U:G:t:?V");
+	strcat (opts, "E:LF:fnovxP:g:s:u:U:G:t:?V");
 	
-	while ((opt = getopt (argc, argv, opts)) != -1) {
+	while ((opt = getopt_long (argc, argv, opts, longopts, NULL)) != -1) {
 		switch (opt) {
+		case OPT_WAIT:	// wait for a match to exec, if there's none now
+			opt_wait = 1;
+			break;
 //		case 'D':   // FreeBSD: print info about non-matches for debugging
 //			break;
+		case 'E':   // a file of patterns, one per line; any one may match
+			if (!read_patfile (optarg))
+				exit (EXIT_USAGE);
+			break;
 		case 'F':   // FreeBSD: the arg is a file containing a PID to match
 			opt_pidfile = strdup (optarg);
 			++criteria_count;
@@ -634,6 +1097,9 @@ static void parse_opts (int argc, char **argv)
 		case 'l':   // Solaris/OpenBSD: long output format (pgrep only) Should require -f for beyond argv[0] maybe?
 			opt_long = 1;
 			break;
+		case 'm':   // say which pattern each match was for (pgrep only)
+			opt_mark = 1;
+			break;
 		case 'n':   // Solaris/OpenBSD: match only the newest
 			if (opt_oldest|opt_negate|opt_newest)
 				usage (opt);
@@ -694,11 +1160,13 @@ static void parse_opts (int argc, char **argv)
 		}
 	}
 
-        if (argc - optind == 1)
-		opt_pattern = argv[optind];
-	else if (argc - optind > 1)
-		usage (0);
-	else if (criteria_count == 0) {
+	while (optind < argc)
+		add_pattern (argv[optind++]);
+	if (opt_mark && (!opt_pattern || opt_negate)) {
+		fprintf(stderr, "%s: -m needs a pattern, and not -v\n",progname);
+		usage(0);
+	}
+	if (!opt_pattern && criteria_count == 0) {
 		fprintf (stderr, "%s: No matching criteria specified\n",
 			 progname);
 		usage (0);
@@ -706,6 +1174,39 @@ static void parse_opts (int argc, char **argv)
 }
 
 
+/* Sleeps until some processes exec, then picks from just those.  The
+ * socket was opened before the first scan, so none get by in between. */
+static union el * wait_procs (int *num)
+{
+	struct pollfd pfd;
+	procev_t ev[64];
+	pid_t execs[65];
+	int got, n = 0, i;
+
+	pfd.fd = ev_fd;
+	pfd.events = POLLIN;
+	while (!n) {
+		if (poll (&pfd, 1, -1) == -1 && errno != EINTR)
+			break;
+		got = procev_read (ev_fd, ev, 64);
+		if (got == -1 && errno != ENOBUFS) {
+			fprintf (stderr, "%s: proc connector: %s\n",
+				 progname, strerror (errno));
+			exit (EXIT_FATAL);
+		}
+		/* with events dropped, look at everything */
+		if (got == -1)
+			return select_procs (num, NULL);
+		for (i = 0; i < got; i++) {
+			if (ev[i].what == PROCEV_EXEC)
+				execs[n++] = ev[i].tgid;
+		}
+	}
+	execs[n] = 0;
+	return select_procs (num, execs);
+}
+
+
 int main (int argc, char *argv[])
 {
 	union el *procs;
@@ -713,7 +1214,20 @@ int main (int argc, char *argv[])
 
 	parse_opts (argc, argv);
 
-	procs = select_procs (&num);
+	if (opt_wait)
+		ev_fd = procev_open ();
+	if (opt_wait && ev_fd == -1) {
+		fprintf (stderr, "%s: --wait needs the proc connector, and CAP_NET_ADMIN\n",
+			 progname);
+		exit (EXIT_FATAL);
+	}
+
+	procs = select_procs (&num, NULL);
+	while (opt_wait && !num) {
+		free (procs);
+		procs = wait_procs (&num);
+	}
+	procev_close (ev_fd);
 	if (i_am_pkill) {
 		int i;
 		for (i = 0; i < num; i++) {
@@ -723,7 +1237,7 @@ int main (int argc, char *argv[])
 				 procs[i].num, strerror (errno));
 		}
 	} else {
-		if (opt_long)
+		if (opt_long || opt_mark)
 			output_strlist(procs,num);
 		else
 			output_numlist(procs,num);
@@ -11,12 +11,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -24,13 +24,18 @@
 #include "proc/readproc.h"
 #include "proc/version.h"
 #include "proc/escape.h"
+#include "proc/maps.h"
+#include "proc/alloc.h"
 
 static void usage(void) NORETURN;
 static void usage(void){
   fprintf(stderr,
-    "Usage: pmap [-x | -d] [-q] [-A low,high] pid...\n"
+    "Usage: pmap [-x | -d | -N | -m] [-q] [-j n] [-A low,high] pid...\n"
     "-x  show details\n"
     "-d  show offset and device number\n"
+    "-N  show memory on each NUMA node\n"
+    "-m  add up the mappings of each file over all the processes\n"
+    "-j  read n processes at once\n"
     "-q  quiet; less header/footer info\n"
     "-V  show the version number\n"
     "-A  limit results to the given range\n"
@@ -47,15 +52,17 @@ static int r_option;  // ignored -- for SunOS compatibility
 static int x_option;
 static int d_option;
 static int q_option;
+static int N_option;
+static int m_option;
+static int j_option;
+static unsigned jobs = 1;  // with -j, processes read at once
 
 static unsigned shm_minor = ~0u;
 
-static void discover_shm_minor(void){
+static void discover_shm_minor(maps_t *m){
   void *addr;
   int shmid;
-  char mapbuf[256];
-
-  if(!freopen("/proc/self/maps", "r", stdin)) return;
+  int i;
 
   // create
   shmid = shmget(IPC_PRIVATE, 42, IPC_CREAT | 0666);
@@ -64,26 +71,16 @@ static void discover_shm_minor(void){
   addr = shmat(shmid, NULL, SHM_RDONLY);
   if(addr==(void*)-1) goto out_destroy;
 
-  while(fgets(mapbuf, sizeof mapbuf, stdin)){
-    char flags[32];
-    char *tmp; // to clean up unprintables
-    unsigned KLONG start, end;
-    unsigned long long file_offset, inode;
-    unsigned dev_major, dev_minor;
-    sscanf(mapbuf,"%"KLF"x-%"KLF"x %31s %Lx %x:%x %Lu", &start, &end, flags, &file_offset, &dev_major, &dev_minor, &inode);
-    tmp = strchr(mapbuf,'\n');
-    if(tmp) *tmp='\0';
-    tmp = mapbuf;
-    while(*tmp){
-      if(!isprint(*tmp)) *tmp='?';
-      tmp++;
-    }
-    if(start > (unsigned long)addr) continue;
-    if(dev_major) continue;
-    if(flags[3] != 's') continue;
-    if(strstr(mapbuf,"/SYSV")){
-      shm_minor = dev_minor;
-      break;
+  if(!read_maps(m, getpid(), 0)){
+    for(i = 0; i < m->n; i++){
+      const map_t *mp = &m->map[i];
+      if(mp->start > (unsigned long)addr) continue;
+      if(mp->dev_major) continue;
+      if(mp->flags[3] != 's') continue;
+      if(strstr(mp->name,"/SYSV")){
+        shm_minor = mp->dev_minor;
+        break;
+      }
     }
   }
 
@@ -96,12 +93,15 @@ out_destroy:
 }
 
 
-static const char *mapping_name(proc_t *p, unsigned KLONG addr, unsigned KLONG len, const char *mapbuf, unsigned showpath, unsigned dev_major, unsigned dev_minor, unsigned long long inode){
+// shmbuf is for a SysV segment's name: 64 bytes
+static const char *mapping_name(proc_t *p, const map_t *mp, unsigned showpath, char *shmbuf){
+  const char *mapbuf = mp->name;
+  unsigned KLONG addr = mp->start;
+  unsigned KLONG len = mp->end - mp->start;
   const char *cp;
 
-  if(!dev_major && dev_minor==shm_minor && strstr(mapbuf,"/SYSV")){
-    static char shmbuf[64];
-    snprintf(shmbuf, sizeof shmbuf, "  [ shmid=0x%Lx ]", inode);
+  if(!mp->dev_major && mp->dev_minor==shm_minor && strstr(mapbuf,"/SYSV")){
+    snprintf(shmbuf, 64, "  [ shmid=0x%Lx ]", mp->inode);
     return shmbuf;
   }
 
@@ -122,57 +122,74 @@ static const char *mapping_name(proc_t *p, unsigned KLONG addr, unsigned KLONG l
   return cp;
 }
 
-static int one_proc(proc_t *p){
-  char buf[32];
-  char mapbuf[9600];
-  char cmdbuf[512];
+// the -x columns, or "-" if smaps couldn't be read; buf is 24 bytes
+static const char *kb_field(const maps_t *m, unsigned long kb, char *buf){
+  if(!(m->flags & MAPS_SMAPS)) return "-";
+  snprintf(buf, 24, "%lu", kb);
+  return buf;
+}
+
+// with -N, a column for each node up to the last with pages, at least one
+static int numa_nodes(const maps_t *nm){
+  return nm->nodes ? nm->nodes : 1;
+}
+
+static const char *node_field(unsigned long kb, char *buf){
+  snprintf(buf, 24, "%lu", kb);
+  return buf;
+}
+
+// One process, shown on fp.  With -j this runs in several threads at
+// once, so all it keeps is in m and nm (numa_maps, for -N), which are
+// each thread's own, and on the stack.
+static int one_proc(maps_t *m, maps_t *nm, proc_t *p, const char *cmd, FILE *fp){
+  char shmbuf[64], kb1[24], kb2[24], kb3[24];
   unsigned long total_shared = 0ul;
   unsigned long total_private_readonly = 0ul;
   unsigned long total_private_writeable = 0ul;
+  unsigned long total_rss = 0ul, total_anon = 0ul, total_locked = 0ul;
+  unsigned long node_total[MAPS_NODES];
+  int i, j = 0;
 
-  // Overkill, but who knows what is proper? The "w" prog
-  // uses the tty width to determine this.
-  int maxcmd = 0xfffff;
-
-  sprintf(buf,"/proc/%u/maps",p->tgid);
-  if(!freopen(buf, "r", stdin)) return 1;
+  if(read_maps(m, p->tgid, x_option ? MAPS_SMAPS : 0)) return 1;
+  if(N_option && read_maps(nm, p->tgid, MAPS_NUMA)) nm->n = nm->nodes = 0;
 
-  escape_command(cmdbuf, p, sizeof cmdbuf, &maxcmd, ESC_ARGS|ESC_BRACKETS);
-  printf("%u:   %s\n", p->tgid, cmdbuf);
+  memset(node_total, 0, sizeof node_total);
+  fprintf(fp, "%u:   %s\n", p->tgid, cmd);
 
   if(!q_option && (x_option|d_option)){
     if(x_option){
-      if(sizeof(KLONG)==4) printf("Address   Kbytes     RSS    Anon  Locked Mode   Mapping\n");
-      else         printf("Address           Kbytes     RSS    Anon  Locked Mode   Mapping\n");
+      if(sizeof(KLONG)==4) fprintf(fp, "Address   Kbytes     RSS    Anon  Locked Mode   Mapping\n");
+      else         fprintf(fp, "Address           Kbytes     RSS    Anon  Locked Mode   Mapping\n");
     }
     if(d_option){
-      if(sizeof(KLONG)==4) printf("Address   Kbytes Mode  Offset           Device    Mapping\n");
-      else         printf("Address           Kbytes Mode  Offset           Device    Mapping\n");
+      if(sizeof(KLONG)==4) fprintf(fp, "Address   Kbytes Mode  Offset           Device    Mapping\n");
+      else         fprintf(fp, "Address           Kbytes Mode  Offset           Device    Mapping\n");
     }
   }
+  if(!q_option && N_option){
+    int n;
+    if(sizeof(KLONG)==4) fprintf(fp, "Address   Kbytes");
+    else         fprintf(fp, "Address           Kbytes");
+    for(n = 0; n < numa_nodes(nm); n++) fprintf(fp, " %6s%d", "N", n);
+    fprintf(fp, " Mode   Mapping\n");
+  }
 
-  while(fgets(mapbuf,sizeof mapbuf,stdin)){
-    char flags[32];
-    char *tmp; // to clean up unprintables
-    unsigned KLONG start, end, diff;
-    unsigned long long file_offset, inode;
-    unsigned dev_major, dev_minor;
-    sscanf(mapbuf,"%"KLF"x-%"KLF"x %31s %Lx %x:%x %Lu", &start, &end, flags, &file_offset, &dev_major, &dev_minor, &inode);
+  for(i = 0; i < m->n; i++){
+    const map_t *mp = &m->map[i];
+    char flags[8];
+    unsigned KLONG start = mp->start, diff;
 
     if(start > range_high)
       break;
-    if(end < range_low)
+    if(mp->end < range_low)
       continue;
 
-    tmp = strchr(mapbuf,'\n');
-    if(tmp) *tmp='\0';
-    tmp = mapbuf;
-    while(*tmp){
-      if(!isprint(*tmp)) *tmp='?';
-      tmp++;
-    }
-    
-    diff = end-start;
+    memcpy(flags, mp->flags, sizeof flags);
+    diff = mp->end-start;
+    total_rss    += mp->kb.rss;
+    total_anon   += mp->kb.anonymous;
+    total_locked += mp->kb.locked;
     if(flags[3]=='s') total_shared  += diff;
     if(flags[3]=='p'){
       flags[3] = '-';
@@ -186,34 +203,51 @@ static int one_proc(proc_t *p){
     flags[5] = '\0';
 
     if(x_option){
-      const char *cp = mapping_name(p, start, diff, mapbuf, 0, dev_major, dev_minor, inode);
-      printf(
+      const char *cp = mapping_name(p, mp, 0, shmbuf);
+      fprintf(fp,
         (sizeof(KLONG)==8)
-          ? "%016"KLF"x %7lu       -       -       - %s  %s\n"
-          :      "%08lx %7lu       -       -       - %s  %s\n",
+          ? "%016"KLF"x %7lu %7s %7s %7s %s  %s\n"
+          :      "%08lx %7lu %7s %7s %7s %s  %s\n",
         start,
         (unsigned long)(diff>>10),
+        kb_field(m, mp->kb.rss, kb1),
+        kb_field(m, mp->kb.anonymous, kb2),
+        kb_field(m, mp->kb.locked, kb3),
         flags,
         cp
       );
     }
     if(d_option){
-      const char *cp = mapping_name(p, start, diff, mapbuf, 0, dev_major, dev_minor, inode);
-      printf(
+      const char *cp = mapping_name(p, mp, 0, shmbuf);
+      fprintf(fp,
         (sizeof(KLONG)==8)
           ? "%016"KLF"x %7lu %s %016Lx %03x:%05x %s\n"
           :      "%08lx %7lu %s %016Lx %03x:%05x %s\n",
         start,
         (unsigned long)(diff>>10),
         flags,
-        file_offset,
-        dev_major, dev_minor,
+        mp->offset,
+        mp->dev_major, mp->dev_minor,
         cp
       );
     }
-    if(!x_option && !d_option){
-      const char *cp = mapping_name(p, start, diff, mapbuf, 1, dev_major, dev_minor, inode);
-      printf(
+    if(N_option){
+      const char *cp = mapping_name(p, mp, 0, shmbuf);
+      const map_t *np;
+      int n;
+      // numa_maps has the same mappings in the same order
+      while(j < nm->n && nm->map[j].start < start) j++;
+      np = (j < nm->n && nm->map[j].start == start) ? &nm->map[j] : NULL;
+      fprintf(fp, (sizeof(KLONG)==8) ? "%016"KLF"x %7lu" : "%08lx %7lu", start, (unsigned long)(diff>>10));
+      for(n = 0; n < numa_nodes(nm); n++){
+        if(np) node_total[n] += np->node_kb[n];
+        fprintf(fp, " %7s", np ? node_field(np->node_kb[n], kb1) : "-");
+      }
+      fprintf(fp, " %s  %s\n", flags, cp);
+    }
+    if(!x_option && !d_option && !N_option){
+      const char *cp = mapping_name(p, mp, 1, shmbuf);
+      fprintf(fp,
         (sizeof(KLONG)==8)
           ? "%016"KLF"x %6luK %s  %s\n"
           :      "%08lx %6luK %s  %s\n",
@@ -232,30 +266,43 @@ static int one_proc(proc_t *p){
   if(!q_option){
     if(x_option){
       if(sizeof(KLONG)==8){
-        printf("----------------  ------  ------  ------  ------\n");
-        printf(
-          "total kB %15ld       -       -       -\n",
-          (total_shared + total_private_writeable + total_private_readonly) >> 10
+        fprintf(fp, "----------------  ------  ------  ------  ------\n");
+        fprintf(fp,
+          "total kB %15ld %7s %7s %7s\n",
+          (total_shared + total_private_writeable + total_private_readonly) >> 10,
+          kb_field(m, total_rss, kb1),
+          kb_field(m, total_anon, kb2),
+          kb_field(m, total_locked, kb3)
         );
       }else{
-        printf("-------- ------- ------- ------- -------\n");
-        printf(
-          "total kB %7ld       -       -       -\n",
-          (total_shared + total_private_writeable + total_private_readonly) >> 10
+        fprintf(fp, "-------- ------- ------- ------- -------\n");
+        fprintf(fp,
+          "total kB %7ld %7s %7s %7s\n",
+          (total_shared + total_private_writeable + total_private_readonly) >> 10,
+          kb_field(m, total_rss, kb1),
+          kb_field(m, total_anon, kb2),
+          kb_field(m, total_locked, kb3)
         );
       }
     }
     if(d_option){
-        printf(
+        fprintf(fp,
           "mapped: %ldK    writeable/private: %ldK    shared: %ldK\n",
           (total_shared + total_private_writeable + total_private_readonly) >> 10,
           total_private_writeable >> 10,
           total_shared >> 10
         );
     }
-    if(!x_option && !d_option){
-      if(sizeof(KLONG)==8) printf(" total %16ldK\n", (total_shared + total_private_writeable + total_private_readonly) >> 10);
-      else                 printf(" total %8ldK\n",  (total_shared + total_private_writeable + total_private_readonly) >> 10);
+    if(N_option){
+      int n;
+      if(sizeof(KLONG)==8) fprintf(fp, "total kB %15ld", (total_shared + total_private_writeable + total_private_readonly) >> 10);
+      else                 fprintf(fp, "total kB %7ld",  (total_shared + total_private_writeable + total_private_readonly) >> 10);
+      for(n = 0; n < numa_nodes(nm); n++) fprintf(fp, " %7s", nm->n ? node_field(node_total[n], kb1) : "-");
+      fprintf(fp, "\n");
+    }
+    if(!x_option && !d_option && !N_option){
+      if(sizeof(KLONG)==8) fprintf(fp, " total %16ldK\n", (total_shared + total_private_writeable + total_private_readonly) >> 10);
+      else                 fprintf(fp, " total %8ldK\n",  (total_shared + total_private_writeable + total_private_readonly) >> 10);
     }
   }
 
@@ -263,11 +310,256 @@ static int one_proc(proc_t *p){
 }
 
 
+static void no_memory(void) NORETURN;
+static void no_memory(void){
+  fprintf(stderr, "pmap: out of memory\n");
+  exit(1);
+}
+
+// -m: each file's mappings added up over all the processes, found by
+// device and inode, so a library shows once however many map it.  The
+// table is open addressing, kept no more than half full.
+
+typedef struct file_sum {
+  unsigned long long inode;  // 0 for a slot not used
+  unsigned dev_major, dev_minor;
+  const char *name;          // the first one seen
+  unsigned long kb, rss, pss, swap;
+  unsigned procs;            // how many processes map it
+  unsigned last;             // the last of them to, numbered from 1
+} file_sum;
+
+static file_sum *sums;
+static unsigned sums_n, sums_size;
+static arena_t *sum_names;
+static pthread_mutex_t sums_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned sum_hash(unsigned major, unsigned minor, unsigned long long inode){
+  unsigned long long h = inode ^ ((unsigned long long)major << 52) ^ ((unsigned long long)minor << 32);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return (unsigned)h;
+}
+
+static void sums_grow(void){
+  file_sum *old = sums;
+  unsigned i, n = sums_size;
+
+  sums_size = n ? n * 2 : 256;
+  sums = calloc(sums_size, sizeof *sums);
+  if(!sums) no_memory();
+  for(i = 0; i < n; i++){
+    unsigned k;
+    if(!old[i].inode) continue;
+    k = sum_hash(old[i].dev_major, old[i].dev_minor, old[i].inode) & (sums_size - 1);
+    while(sums[k].inode) k = (k + 1) & (sums_size - 1);
+    sums[k] = old[i];
+  }
+  free(old);
+}
+
+static file_sum *sum_find(const map_t *mp){
+  file_sum *f;
+  unsigned k;
+
+  if(sums_n * 2 >= sums_size) sums_grow();
+  k = sum_hash(mp->dev_major, mp->dev_minor, mp->inode) & (sums_size - 1);
+  for(;;){
+    f = &sums[k];
+    if(!f->inode) break;
+    if(f->inode == mp->inode && f->dev_major == mp->dev_major && f->dev_minor == mp->dev_minor)
+      return f;
+    k = (k + 1) & (sums_size - 1);
+  }
+  f->inode = mp->inode;
+  f->dev_major = mp->dev_major;
+  f->dev_minor = mp->dev_minor;
+  f->name = strcpy(arena_alloc(sum_names, strlen(mp->name) + 1), mp->name);
+  sums_n++;
+  return f;
+}
+
+// Process number 'who' (from 1) into the sums.  Only the adding up is
+// done under the lock; the reading isn't.
+static int sum_proc(maps_t *m, const proc_t *p, unsigned who){
+  int i;
+
+  if(read_maps(m, p->tgid, MAPS_SMAPS)) return 1;
+  pthread_mutex_lock(&sums_lock);
+  for(i = 0; i < m->n; i++){
+    const map_t *mp = &m->map[i];
+    file_sum *f;
+    if(mp->start > range_high) break;
+    if(mp->end < range_low) continue;
+    if(!mp->inode) continue;  // anon, heap, stack and such
+    f = sum_find(mp);
+    f->kb   += (unsigned long)((mp->end - mp->start) >> 10);
+    f->rss  += mp->kb.rss;
+    f->pss  += mp->kb.pss;
+    f->swap += mp->kb.swap;
+    if(f->last != who){
+      f->last = who;
+      f->procs++;
+    }
+  }
+  pthread_mutex_unlock(&sums_lock);
+  return 0;
+}
+
+// the most PSS first; ties go by name, then inode, for output that
+// doesn't depend on which process was read first
+static int sum_cmp(const void *a, const void *b){
+  const file_sum *x = a, *y = b;
+  int c;
+  if(x->pss != y->pss) return x->pss < y->pss ? 1 : -1;
+  if(x->kb  != y->kb)  return x->kb  < y->kb  ? 1 : -1;
+  c = strcmp(x->name, y->name);
+  if(c) return c;
+  if(x->inode != y->inode) return x->inode < y->inode ? -1 : 1;
+  if(x->dev_major != y->dev_major) return x->dev_major < y->dev_major ? -1 : 1;
+  return x->dev_minor < y->dev_minor ? -1 : x->dev_minor > y->dev_minor;
+}
+
+static void show_sums(unsigned nprocs){
+  unsigned long kb = 0, rss = 0, pss = 0, swap = 0;
+  unsigned i, n = 0;
+
+  // squeeze out the empty slots; the table isn't needed after this
+  for(i = 0; i < sums_size; i++) if(sums[i].inode) sums[n++] = sums[i];
+  qsort(sums, n, sizeof *sums, sum_cmp);
+
+  if(!q_option) printf("  Kbytes      RSS      PSS     Swap  Procs  Mapping\n");
+  for(i = 0; i < n; i++){
+    const file_sum *f = &sums[i];
+    printf("%8lu %8lu %8lu %8lu %6u  %s\n", f->kb, f->rss, f->pss, f->swap, f->procs, f->name);
+    kb   += f->kb;
+    rss  += f->rss;
+    pss  += f->pss;
+    swap += f->swap;
+  }
+  if(!q_option){
+    printf("-------- -------- -------- --------\n");
+    printf("%8lu %8lu %8lu %8lu  total kB, %u files in %u processes\n", kb, rss, pss, swap, n, nprocs);
+  }
+}
+
+// -j: the processes are read first, in the order asked for; then
+// 'jobs' threads take them one at a time, each writing what it shows
+// to memory, and the main thread prints those in that same order.  The
+// threads get no more than 2*jobs ahead of the printing, so not much
+// waits in memory however many processes there are.
+
+typedef struct job_t {
+  proc_t p;
+  char cmd[512];
+  char *out;   // what one_proc showed
+  size_t len;
+  int ret;
+  int done;
+} job_t;
+
+static job_t *job;
+static unsigned njob, next_job, shown;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;  // one done, or one shown
+
+static void command_of(proc_t *p, char *cmd){
+  // Overkill, but who knows what is proper? The "w" prog
+  // uses the tty width to determine this.
+  int maxcmd = 0xfffff;
+
+  escape_command(cmd, p, 512, &maxcmd, ESC_ARGS|ESC_BRACKETS);
+}
+
+static void run_job(maps_t *m, maps_t *nm, job_t *jp, unsigned who){
+  FILE *fp;
+
+  if(m_option){
+    jp->ret = sum_proc(m, &jp->p, who);
+    return;
+  }
+  fp = open_memstream(&jp->out, &jp->len);
+  if(!fp) no_memory();
+  jp->ret = one_proc(m, nm, &jp->p, jp->cmd, fp);
+  if(fclose(fp)) no_memory();
+}
+
+static void *worker(void *unused){
+  maps_t m, nm;
+  unsigned i;
+
+  (void)unused;
+  memset(&m, 0, sizeof m);
+  memset(&nm, 0, sizeof nm);
+  pthread_mutex_lock(&job_lock);
+  for(;;){
+    while(next_job < njob && next_job >= shown + 2 * jobs)
+      pthread_cond_wait(&job_cond, &job_lock);
+    if(next_job >= njob) break;
+    i = next_job++;
+    pthread_mutex_unlock(&job_lock);
+    run_job(&m, &nm, &job[i], i + 1);
+    pthread_mutex_lock(&job_lock);
+    job[i].done = 1;
+    pthread_cond_broadcast(&job_cond);
+  }
+  pthread_mutex_unlock(&job_lock);
+  free_maps(&m);
+  free_maps(&nm);
+  return NULL;
+}
+
+// the processes PT finds, shown in the order found; returns how many
+static unsigned run_jobs(PROCTAB *PT, maps_t *m, maps_t *nm, int *ret){
+  pthread_t tid[256];
+  unsigned i, room = 0, nthreads;
+
+  for(;;){
+    if(njob == room){
+      room = room ? room * 2 : 64;
+      job = realloc(job, room * sizeof *job);
+      if(!job) no_memory();
+    }
+    memset(&job[njob], 0, sizeof *job);
+    if(!readproc(PT, &job[njob].p)) break;
+    command_of(&job[njob].p, job[njob].cmd);
+    if(job[njob].p.cmdline) free((void*)*job[njob].p.cmdline);
+    job[njob].p.cmdline = NULL;
+    njob++;
+  }
+
+  for(nthreads = 0; nthreads < jobs && nthreads < njob; nthreads++)
+    if(pthread_create(&tid[nthreads], NULL, worker, NULL)) break;
+
+  for(i = 0; i < njob; i++){
+    if(!nthreads){  // no threads to be had: do it here, in turn
+      run_job(m, nm, &job[i], i + 1);
+    }else{
+      pthread_mutex_lock(&job_lock);
+      while(!job[i].done) pthread_cond_wait(&job_cond, &job_lock);
+      pthread_mutex_unlock(&job_lock);
+    }
+    if(job[i].len) fwrite(job[i].out, 1, job[i].len, stdout);
+    free(job[i].out);
+    *ret |= job[i].ret;
+    pthread_mutex_lock(&job_lock);
+    shown++;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&job_lock);
+  }
+
+  for(i = 0; i < nthreads; i++) pthread_join(tid[i], NULL);
+  free(job);
+  return njob;
+}
+
 int main(int argc, char *argv[]){
   unsigned *pidlist;
-  unsigned count = 0;
+  unsigned count = 0, found = 0;
   PROCTAB* PT;
   proc_t p;
+  maps_t m, nm;
   int ret = 0;
 
   if(argc<2) usage();
@@ -298,6 +590,30 @@ int main(int argc, char *argv[]){
         case 'q':
           q_option++;
           break;
+        case 'N':
+          N_option++;
+          break;
+        case 'm':
+          m_option++;
+          break;
+        case 'j':{
+            char *arg1, *endp;
+            unsigned long n;
+            if(walk[1]){
+              arg1 = walk+1;
+              walk += strlen(walk)-1;
+            }else{
+              arg1 = *++argv;
+              if(!arg1)
+                usage();
+            }
+            n = strtoul(arg1, &endp, 10);
+            if(*endp || !*arg1 || n > 256) usage();
+            if(!n) n = sysconf(_SC_NPROCESSORS_ONLN);  // -j0: one per CPU
+            jobs = n < 1 ? 1 : n > 256 ? 256 : n;  // tid[] in run_jobs
+            j_option++;
+          }
+          break;
         case 'A':{
             char *arg1;
             if(walk[1]){
@@ -347,25 +663,40 @@ int main(int argc, char *argv[]){
     }
   }
 
-  if( (x_option|V_option|r_option|d_option|q_option) >> 1 ) usage(); // dupes
+  if( (x_option|V_option|r_option|d_option|q_option|N_option|m_option|j_option) >> 1 ) usage(); // dupes
   if(V_option){
-    if(count|x_option|r_option|d_option|q_option) usage();
+    if(count|x_option|r_option|d_option|q_option|N_option|m_option|j_option) usage();
     fprintf(stdout, "pmap (%s)\n", procps_version);
     return 0;
   }
   if(count<1) usage();   // no processes
-  if(d_option && x_option) usage();
+  if((d_option + x_option + N_option + m_option) > 1) usage();
 
-  discover_shm_minor();
+  memset(&m, 0, sizeof m);
+  memset(&nm, 0, sizeof nm);
+  discover_shm_minor(&m);
+  if(m_option) sum_names = arena_new();
 
   pidlist[count] = 0;  // old libproc interface is zero-terminated
   PT = openproc(PROC_FILLSTAT|PROC_FILLARG|PROC_PID, pidlist);
-  while(readproc(PT, &p)){
-    ret |= one_proc(&p);
-    if(p.cmdline) free((void*)*p.cmdline);
-    count--;
+  if(jobs > 1){
+    found = run_jobs(PT, &m, &nm, &ret);
+  }else{
+    while(readproc(PT, &p)){
+      char cmd[512];
+      found++;
+      if(m_option){
+        ret |= sum_proc(&m, &p, found);
+      }else{
+        command_of(&p, cmd);
+        ret |= one_proc(&m, &nm, &p, cmd, stdout);
+      }
+      if(p.cmdline) free((void*)*p.cmdline);
+    }
   }
   closeproc(PT);
+  if(m_option) show_sums(found);
+  count -= found;
 
   if(count) ret |= 42;  // didn't find all processes asked for
   return ret;
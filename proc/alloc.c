@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "alloc.h"
 
 void *xcalloc(void *pointer, int size) {
@@ -47,3 +48,95 @@ void *xrealloc(void *oldp, unsigned int size) {
     }
     return(p);
 }
+
+//////////////////////////////////////////////////////////////////////////
+// A bump allocator for things that all die together, like the cmdline and
+// environ vectors of one scan. Nothing in it is freed individually; use
+// arena_reset() to make all of the space available again (keeping it, so
+// the next scan won't need malloc) or arena_free() to give it back.
+
+#define ARENA_CHUNK (128*1024 - 64)   // leave room for malloc's own header
+#define ARENA_ALIGN (sizeof(void*)-1)
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    unsigned size;          // bytes of data[] available
+    unsigned used;
+    char data[];
+};
+
+struct arena_t {
+    struct arena_chunk *head;
+    struct arena_chunk *cur;    // allocating from here; later ones are empty
+};
+
+arena_t *arena_new(void) {
+    return xcalloc(NULL, sizeof(arena_t));
+}
+
+void *arena_alloc(arena_t *restrict a, unsigned size) {
+    struct arena_chunk *c = a->cur;
+    void *ret;
+
+    size = (size + ARENA_ALIGN) & ~ARENA_ALIGN;
+    while (!c || c->size - c->used < size) {
+        struct arena_chunk *fresh;
+        unsigned want;
+        // try a chunk left over from before the last arena_reset()
+        if (c && c->next && c->next->size >= size) {
+            c = c->next;
+            break;
+        }
+        want = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+        fresh = xmalloc(sizeof(struct arena_chunk) + want);
+        fresh->size = want;
+        fresh->used = 0;
+        if (c) {
+            fresh->next = c->next;
+            c->next = fresh;
+        } else {
+            fresh->next = a->head;
+            a->head = fresh;
+        }
+        c = fresh;
+    }
+    a->cur = c;
+    ret = c->data + c->used;
+    c->used += size;
+    return ret;
+}
+
+// Like realloc, but 'old' must be the most recent allocation (or NULL)
+// to be grown in place. Otherwise the data gets copied.
+void *arena_realloc(arena_t *restrict a, void *old, unsigned oldsize, unsigned size) {
+    struct arena_chunk *c = a->cur;
+    unsigned oldround = (oldsize + ARENA_ALIGN) & ~ARENA_ALIGN;
+    unsigned round = (size + ARENA_ALIGN) & ~ARENA_ALIGN;
+    void *ret;
+
+    if (old && c && (char*)old + oldround == c->data + c->used
+    && round - oldround <= c->size - c->used) {
+        c->used += round - oldround;
+        return old;
+    }
+    ret = arena_alloc(a, size);
+    if (old) memcpy(ret, old, oldsize < size ? oldsize : size);
+    return ret;
+}
+
+void arena_reset(arena_t *restrict a) {
+    struct arena_chunk *c;
+    for (c = a->head; c; c = c->next)
+        c->used = 0;
+    a->cur = a->head;
+}
+
+void arena_free(arena_t *restrict a) {
+    struct arena_chunk *c = a->head;
+    while (c) {
+        struct arena_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(a);
+}
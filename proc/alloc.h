@@ -9,6 +9,14 @@ extern void *xrealloc(void *oldp, unsigned int size) MALLOC;
 extern void *xmalloc(unsigned int size) MALLOC;
 extern void *xcalloc(void *pointer, int size) MALLOC;
 
+// bump allocator, see alloc.c
+typedef struct arena_t arena_t;
+extern arena_t *arena_new(void);
+extern void *arena_alloc(arena_t *restrict a, unsigned size) MALLOC;
+extern void *arena_realloc(arena_t *restrict a, void *old, unsigned oldsize, unsigned size);
+extern void arena_reset(arena_t *restrict a);
+extern void arena_free(arena_t *restrict a);
+
 EXTERN_C_END
 
 #endif
@@ -0,0 +1,121 @@
+// cgroup paths, shared, and what cgroupfs says about each cgroup
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// A node runs thousands of tasks in a few dozen cgroups, so every path
+// is kept once and the proc_t's point at it: grouping by cgroup is then
+// grouping by pointer, and there's nothing to free per task.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cgroup.h"
+#include "alloc.h"
+
+typedef struct cgname {
+    struct cgname *next;
+    unsigned hash;
+    char path[1];		// really as long as it needs to be
+} cgname;
+
+static cgname **cg_hash;
+static unsigned cg_size;	// buckets, a power of 2
+static unsigned cg_count;
+// readproctab2's threads all come through here
+static pthread_mutex_t cg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void cg_grow(void){
+    unsigned size = cg_size ? cg_size * 2 : 64;
+    cgname **hash = xcalloc(NULL, size * sizeof *hash);
+    unsigned u;
+
+    for(u = 0; u < cg_size; u++){
+        cgname *c = cg_hash[u];
+        while(c){
+            cgname *next = c->next;
+            c->next = hash[c->hash & (size - 1)];
+            hash[c->hash & (size - 1)] = c;
+            c = next;
+        }
+    }
+    free(cg_hash);
+    cg_hash = hash;
+    cg_size = size;
+}
+
+const char *cgroup_intern(const char *restrict path, unsigned len){
+    unsigned h = 0, u;
+    cgname *c;
+
+    for(u = 0; u < len; u++) h = h * 31 + (unsigned char)path[u];
+    pthread_mutex_lock(&cg_lock);
+    if(cg_count >= cg_size) cg_grow();
+    for(c = cg_hash[h & (cg_size - 1)]; c; c = c->next){
+        if(c->hash == h && !strncmp(c->path, path, len) && !c->path[len]) goto done;
+    }
+    c = xmalloc(sizeof *c + len);
+    c->hash = h;
+    memcpy(c->path, path, len);
+    c->path[len] = '\0';
+    c->next = cg_hash[h & (cg_size - 1)];
+    cg_hash[h & (cg_size - 1)] = c;
+    cg_count++;
+done:
+    pthread_mutex_unlock(&cg_lock);
+    return c->path;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// where cgroup2 is mounted, or the hybrid layout's "unified" v2 tree
+static const char *const v2_roots[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+
+static int cg_read(const char *root, const char *cgroup, const char *file, char *buf, int cap){
+    char name[4096];
+    int fd, n;
+
+    if(snprintf(name, sizeof name, "%s%s/%s", root, cgroup, file) >= (int)sizeof name) return -1;
+    fd = open(name, O_RDONLY);
+    if(fd == -1) return -1;
+    n = read(fd, buf, cap - 1);
+    close(fd);
+    if(n <= 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+int cgroup_stat(const char *restrict cgroup, cgstat_t *restrict st){
+    char buf[1024];
+    unsigned i;
+
+    memset(st, 0, sizeof *st);
+    if(!cgroup || *cgroup != '/') return 0;
+    for(i = 0; i < sizeof v2_roots / sizeof v2_roots[0]; i++){
+        if(!(st->have & CGSTAT_CPU) && cg_read(v2_roots[i], cgroup, "cpu.stat", buf, sizeof buf) > 0){
+            char *s = strstr(buf, "usage_usec ");
+            if(s){
+                st->usage_usec = strtoull(s + 11, NULL, 10);
+                st->have |= CGSTAT_CPU;
+            }
+        }
+        if(!(st->have & CGSTAT_MEM) && cg_read(v2_roots[i], cgroup, "memory.current", buf, sizeof buf) > 0){
+            st->memory = strtoull(buf, NULL, 10);
+            st->have |= CGSTAT_MEM;
+        }
+    }
+    // cgroup v1 keeps each controller in a tree of its own
+    if(!(st->have & CGSTAT_CPU) && cg_read("/sys/fs/cgroup/cpuacct", cgroup, "cpuacct.usage", buf, sizeof buf) > 0){
+        st->usage_usec = strtoull(buf, NULL, 10) / 1000;	// it counts ns
+        st->have |= CGSTAT_CPU;
+    }
+    if(!(st->have & CGSTAT_MEM) && cg_read("/sys/fs/cgroup/memory", cgroup, "memory.usage_in_bytes", buf, sizeof buf) > 0){
+        st->memory = strtoull(buf, NULL, 10);
+        st->have |= CGSTAT_MEM;
+    }
+    return st->have;
+}
@@ -0,0 +1,34 @@
+#ifndef PROCPS_PROC_CGROUP_H
+#define PROCPS_PROC_CGROUP_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include "procps.h"
+
+EXTERN_C_BEGIN
+
+// What the cgroup itself counts, so a per-cgroup total costs a couple of
+// reads in cgroupfs instead of one /proc walk over all of its tasks.  It
+// includes tasks that have already exited, and (for memory) page cache.
+#define CGSTAT_CPU 1
+#define CGSTAT_MEM 2
+
+typedef struct cgstat_t {
+    unsigned long long usage_usec;	// cpu.stat, or cpuacct.usage on cgroup v1
+    unsigned long long memory;		// memory.current (v1: usage_in_bytes), bytes
+    int have;				// CGSTAT_* for the ones that could be read
+} cgstat_t;
+
+// 'cgroup' is a proc_t's cgroup path.  Returns st->have, 0 if nothing was
+// readable (no cgroupfs, the cgroup is gone, the controller isn't on).
+extern int cgroup_stat(const char *restrict cgroup, cgstat_t *restrict st);
+
+// Internal to libproc: the one copy of a cgroup path, so that comparing
+// two proc_t's cgroups is comparing pointers.  Never freed.
+extern const char *cgroup_intern(const char *restrict path, unsigned len);
+
+EXTERN_C_END
+
+#endif
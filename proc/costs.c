@@ -0,0 +1,75 @@
+// Counting where the time goes
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// A phase's own time is its elapsed time less that of the phases nested
+// in it.  Each thread keeps the nested total for the phase it is in, so
+// readproctab2's threads can count at once; the sums are atomic adds.
+
+#include <string.h>
+#include <time.h>
+#include "costs.h"
+
+int costs_on;
+costs_t costs;
+
+const char *const cost_names[COST_PHASES] = {
+    "read", "parse", "names", "tty", "wchan", "sort", "output"
+};
+
+// ns taken by phases nested in the one this thread is in
+static __thread unsigned long long nested;
+
+unsigned long long costs_now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void costs_reset(void){
+    memset(&costs, 0, sizeof costs);
+    nested = 0;
+    costs.since = costs_now();
+}
+
+void costs_enable(int on){
+    if(on) costs_reset();
+    costs_on = on;
+}
+
+void cost_start(cost_mark *restrict m){
+    m->outer = nested;
+    nested = 0;
+    m->t = costs_now();
+}
+
+void cost_stop(int phase, const cost_mark *restrict m){
+    unsigned long long d = costs_now() - m->t;
+
+    __sync_fetch_and_add(&costs.ns[phase], d > nested ? d - nested : 0);
+    __sync_fetch_and_add(&costs.calls[phase], 1);
+    nested = m->outer + d;
+}
+
+void cost_io(unsigned opens, unsigned reads, long bytes){
+    if(opens) __sync_fetch_and_add(&costs.opens, opens);
+    __sync_fetch_and_add(&costs.reads, reads);
+    if(bytes > 0) __sync_fetch_and_add(&costs.bytes, bytes);
+}
+
+void costs_report(FILE *fp, const char *restrict who){
+    unsigned long long total = costs_now() - costs.since, rest = total;
+    int i;
+
+    fprintf(fp, "%s: %lu opens, %lu reads, %llu bytes\n", who, costs.opens, costs.reads, costs.bytes);
+    fprintf(fp, "%s: %-8s %10s %10s\n", who, "phase", "ms", "calls");
+    for(i = 0; i < COST_PHASES; i++){
+        rest -= costs.ns[i] < rest ? costs.ns[i] : rest;
+        fprintf(fp, "%s: %-8s %10.3f %10lu\n", who, cost_names[i], costs.ns[i] / 1e6, costs.calls[i]);
+    }
+    fprintf(fp, "%s: %-8s %10.3f\n", who, "other", rest / 1e6);
+    fprintf(fp, "%s: %-8s %10.3f\n", who, "total", total / 1e6);
+}
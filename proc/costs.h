@@ -0,0 +1,62 @@
+#ifndef PROCPS_PROC_COSTS_H
+#define PROCPS_PROC_COSTS_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include <stdio.h>
+#include "procps.h"
+
+EXTERN_C_BEGIN
+
+// Where a tool's time goes, counted by libproc (and the tool) itself, so
+// a slow ps or top can tell /proc from names from sorting without perf.
+// Each phase gets its own time only: a tty name looked up while drawing
+// counts as tty, not as output, and the phases add up to no more than
+// the total.  Off, a count costs a test of costs_on.
+#define COST_READ    0		// /proc files: open, read, pread
+#define COST_PARSE   1		// stat, statm, status and such into a proc_t
+#define COST_NAMES   2		// user and group names
+#define COST_TTY     3		// dev_to_tty
+#define COST_WCHAN   4		// lookup_wchan
+#define COST_SORT    5		// the tool's sorting (and forest)
+#define COST_OUTPUT  6		// the tool's formatting of rows
+#define COST_PHASES  7
+
+typedef struct costs_t {
+    unsigned long long ns[COST_PHASES];
+    unsigned long calls[COST_PHASES];
+    unsigned long opens, reads;
+    unsigned long long bytes;
+    unsigned long long since;	// when counting started, for the total
+} costs_t;
+
+// around a phase: COST_START(m); ...; COST_STOP(COST_PARSE, m);
+typedef struct cost_mark {
+    unsigned long long t;
+    unsigned long long outer;	// what enclosing phases had nested in them
+} cost_mark;
+
+extern int costs_on;
+extern costs_t costs;
+
+// turns counting on or off; on, the counts start again from 0
+extern void costs_enable(int on);
+extern void costs_reset(void);
+extern unsigned long long costs_now(void);	// ns, CLOCK_MONOTONIC
+extern const char *const cost_names[COST_PHASES];
+// the counts as a short table, each line starting with 'who'
+extern void costs_report(FILE *fp, const char *restrict who);
+
+extern void cost_start(cost_mark *restrict m);
+extern void cost_stop(int phase, const cost_mark *restrict m);
+extern void cost_io(unsigned opens, unsigned reads, long bytes);
+
+#define COST_START(m)     do{ if(unlikely(costs_on)) cost_start(&(m)); }while(0)
+#define COST_STOP(ph,m)   do{ if(unlikely(costs_on)) cost_stop((ph), &(m)); }while(0)
+#define COST_IO(o,r,b)    do{ if(unlikely(costs_on)) cost_io((o), (r), (b)); }while(0)
+
+EXTERN_C_END
+
+#endif
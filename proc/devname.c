@@ -16,8 +16,10 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include "alloc.h"
 #include "version.h"
 #include "devname.h"
+#include "costs.h"
 
 // This is the buffer size for a tty name. Any path is legal,
 // which makes PAGE_SIZE appropriate (see kernel source), but
@@ -53,22 +55,38 @@ typedef struct tty_map_node {
   char name[16];
 } tty_map_node;
 
-static tty_map_node *tty_map = NULL;
+// Indexed by major number; each chain holds that major's minor ranges,
+// most recently loaded first (as the single list used to be).
+#define TTY_MAP_SIZE 256  /* power of 2 */
+#define TTY_MAP_HASH(maj) ((maj) & (TTY_MAP_SIZE-1))
+
+static tty_map_node **tty_map = NULL;
 
 /* Load /proc/tty/drivers for device name mapping use. */
 static void load_drivers(void){
-  char buf[10000];
+  unsigned size = 4096;
+  char *buf = xmalloc(size);
   char *p;
   int fd;
-  int bytes;
+  int bytes = 0;
+  int n;
+  tty_map = xcalloc(NULL, TTY_MAP_SIZE * sizeof *tty_map);
   fd = open("/proc/tty/drivers",O_RDONLY);
   if(fd == -1) goto fail;
-  bytes = read(fd, buf, sizeof(buf) - 1);
-  if(bytes == -1) goto fail;
+  // a file of any size; this used to be silently cut at 10000 bytes
+  while((n = read(fd, buf + bytes, size - 1 - bytes)) > 0){
+    bytes += n;
+    if(bytes == (int)size - 1){
+      size *= 2;
+      buf = xrealloc(buf, size);
+    }
+  }
+  if(n == -1) goto fail;
   buf[bytes] = '\0';
   p = buf;
   while(( p = strstr(p, " /dev/") )){  // " /dev/" is the second column
     tty_map_node *tmn;
+    tty_map_node **head;
     int len;
     char *end;
     p += 6;
@@ -76,8 +94,6 @@ static void load_drivers(void){
     if(!end) continue;
     len = end - p;
     tmn = calloc(1, sizeof(tty_map_node));
-    tmn->next = tty_map;
-    tty_map = tmn;
     /* if we have a devfs type name such as /dev/tts/%d then strip the %d but
        keep a flag. */
     if(len >= 3 && !strncmp(end - 2, "%d", 2)){
@@ -94,20 +110,22 @@ static void load_drivers(void){
     while(*p == ' ') p++;
     switch(sscanf(p, "%u-%u", &tmn->minor_first, &tmn->minor_last)){
     default:
-      /* Can't finish parsing this line so we remove it from the list */
-      tty_map = tty_map->next;
+      /* Can't finish parsing this line so we drop it */
       free(tmn);
-      break;
+      continue;
     case 1:
       tmn->minor_last = tmn->minor_first;
       break;
     case 2:
       break;
     }
+    head = &tty_map[TTY_MAP_HASH(tmn->major_number)];
+    tmn->next = *head;
+    *head = tmn;
   }
 fail:
   if(fd != -1) close(fd);
-  if(!tty_map) tty_map = (tty_map_node *)-1;
+  free(buf);
 }
 
 /* Try to guess the device name from /proc/tty/drivers info. */
@@ -115,8 +133,7 @@ static int driver_name(char *restrict const buf, unsigned maj, unsigned min){
   struct stat sbuf;
   tty_map_node *tmn;
   if(!tty_map) load_drivers();
-  if(tty_map == (tty_map_node *)-1) return 0;
-  tmn = tty_map;
+  tmn = tty_map[TTY_MAP_HASH(maj)];
   for(;;){
     if(!tmn) return 0;
     if(tmn->major_number == maj && tmn->minor_first <= min && tmn->minor_last >= min) break;
@@ -273,25 +290,122 @@ static int link_name(char *restrict const buf, unsigned maj, unsigned min, int p
   return 1;
 }
 
+/* Caches for both directions, since each lookup above stats a file or
+ * two (or readlinks in /proc/#/fd) and ps wants the same ttys over and
+ * over.  The name a device number gets does not depend on which process
+ * asked, except that link_name() might only work for some of them; so
+ * a device that only link_name() could name is remembered as such, and
+ * just the pid-specific lookups are retried for it.  Names that don't
+ * stat() are remembered as -1 in the other direction.
+ */
+
+#define TTY_HASH_SIZE 64  /* starting size, power of 2 */
+
+typedef struct tty_cache_node {
+  struct tty_cache_node *next;
+  unsigned dev;     // 0 if dev_to_tty() found no name that wasn't per-pid
+  unsigned key;     // dev, or the name's hash for tty_to_dev()
+  int rdev;         // tty_to_dev() result
+  char name[];
+} tty_cache_node;
+
+typedef struct tty_cache {
+  tty_cache_node **hash;
+  unsigned size;
+  unsigned count;
+} tty_cache;
+
+static tty_cache dev_cache, name_cache;
+
+static unsigned name_hash(const char *s){
+  unsigned h = 0;
+  while(*s) h = h * 31 + (unsigned char)*s++;
+  return h;
+}
+
+static tty_cache_node *cache_find(const tty_cache *c, unsigned key, const char *name){
+  tty_cache_node *n;
+  if(!c->size) return NULL;
+  for(n = c->hash[key & (c->size-1)]; n; n = n->next){
+    if(n->key != key) continue;
+    if(!name || !strcmp(n->name, name)) return n;
+  }
+  return NULL;
+}
+
+static tty_cache_node *cache_add(tty_cache *c, unsigned key, const char *name){
+  tty_cache_node *n;
+  unsigned h;
+  if(c->count >= c->size){  // double it, keeping chains short
+    unsigned size = c->size ? c->size * 2 : TTY_HASH_SIZE;
+    tty_cache_node **hash = xcalloc(NULL, size * sizeof *hash);
+    unsigned i;
+    for(i = 0; i < c->size; i++){
+      while((n = c->hash[i])){
+        c->hash[i] = n->next;
+        n->next = hash[n->key & (size-1)];
+        hash[n->key & (size-1)] = n;
+      }
+    }
+    free(c->hash);
+    c->hash = hash;
+    c->size = size;
+  }
+  n = xmalloc(sizeof *n + strlen(name) + 1);
+  strcpy(n->name, name);
+  n->key = key;
+  h = key & (c->size-1);
+  n->next = c->hash[h];
+  c->hash[h] = n;
+  c->count++;
+  return n;
+}
+
 /* number --> name */
 unsigned dev_to_tty(char *restrict ret, unsigned chop, dev_t dev_t_dev, int pid, unsigned int flags) {
   static char buf[TTY_NAME_SIZE];
   char *restrict tmp = buf;
   unsigned dev = dev_t_dev;
   unsigned i = 0;
+  tty_cache_node *n;
   int c;
+  cost_mark cm;
+  COST_START(cm);
   if(dev == 0u) goto no_tty;
+  n = cache_find(&dev_cache, dev, NULL);
+  if(n && n->dev){
+    strcpy(tmp, n->name);
+    goto abbrev;
+  }
   if(linux_version_code > LINUX_VERSION(2, 7, 0)){  // not likely to make 2.6.xx
-    if(link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "tty"   )) goto abbrev;
+    if(link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "tty"   )) goto found;
   }
-  if(driver_name(tmp, MAJOR_OF(dev), MINOR_OF(dev)               )) goto abbrev;
-  if(  link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "fd/2"  )) goto abbrev;
-  if( guess_name(tmp, MAJOR_OF(dev), MINOR_OF(dev)               )) goto abbrev;
-  if(  link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "fd/255")) goto abbrev;
+  if(n) goto per_pid;  // the rest has been tried for this device already
+  if(driver_name(tmp, MAJOR_OF(dev), MINOR_OF(dev)               )) goto found;
+  if(  link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "fd/2"  )) goto found;
+  if( guess_name(tmp, MAJOR_OF(dev), MINOR_OF(dev)               )) goto found;
+  if(  link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "fd/255")) goto found;
+  n = cache_add(&dev_cache, dev, "");
+  n->dev = 0;
   // fall through if unable to find a device file
 no_tty:
   strcpy(ret, "?");
-  return 1;
+  i = 1;
+  goto done;
+per_pid:
+  if(  link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "fd/2"  )) goto found;
+  if(  link_name(tmp, MAJOR_OF(dev), MINOR_OF(dev), pid, "fd/255")) goto found;
+  goto no_tty;
+found:
+  if(n){  // was only known by a failure; a real name replaces it below
+    tty_cache_node **pp = &dev_cache.hash[dev & (dev_cache.size-1)];
+    while(*pp != n) pp = &(*pp)->next;
+    *pp = n->next;
+    dev_cache.count--;
+    free(n);
+  }
+  n = cache_add(&dev_cache, dev, tmp);
+  n->dev = dev;
 abbrev:
   if((flags&ABBREV_DEV) && !strncmp(tmp,"/dev/",5) && tmp[5]) tmp += 5;
   if((flags&ABBREV_TTY) && !strncmp(tmp,"tty",  3) && tmp[3]) tmp += 3;
@@ -311,13 +425,15 @@ abbrev:
     ret++;
   }
   *ret = '\0';
+done:
+  COST_STOP(COST_TTY, cm);
   return i;
 }
 
-/* name --> number */
-int tty_to_dev(const char *restrict const name) {
+/* name --> number, the hard way */
+static int lookup_tty(const char *restrict const name) {
   struct stat sbuf;
-  static char buf[32];
+  char buf[32];
   if(name[0]=='/' && stat(name, &sbuf) >= 0) return sbuf.st_rdev;
   snprintf(buf,32,"/dev/%s",name);
   if(stat(buf, &sbuf) >= 0) return sbuf.st_rdev;
@@ -327,3 +443,14 @@ int tty_to_dev(const char *restrict const name) {
   if(stat(buf, &sbuf) >= 0) return sbuf.st_rdev;
   return -1;
 }
+
+/* name --> number */
+int tty_to_dev(const char *restrict const name) {
+  unsigned key = name_hash(name);
+  tty_cache_node *n = cache_find(&name_cache, key, name);
+  if(!n){
+    n = cache_add(&name_cache, key, name);
+    n->rdev = lookup_tty(name);
+  }
+  return n->rdev;
+}
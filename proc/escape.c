@@ -24,6 +24,34 @@
 #endif
 
 #if (__GNU_LIBRARY__ >= 6)
+/* does the word hold a byte outside ' '..'~' (which includes the NUL)? */
+#define ONES    (~0UL/255)
+#define NOT_PRINTABLE(w) \
+  ((((w) - ONES*0x20) & ~(w)) | (((w) + ONES*(127-0x7e)) | (w))) & (ONES*0x80)
+
+/* how many bytes of plain printable ASCII src starts with, up to max;
+ * those need no mbrtowc() and are one cell each */
+static int ascii_run(const char *restrict src, int max){
+  const char *restrict p = src;
+  const char *restrict const end = src + max;
+
+  /* words are only read aligned, so never past the page the NUL is in */
+  while(p < end && ((unsigned long)p & (sizeof(unsigned long)-1))){
+    if((unsigned char)(*p - 0x20) > 0x7e - 0x20) return p - src;
+    p++;
+  }
+  while(end - p >= (long)sizeof(unsigned long)){
+    unsigned long w;
+    memcpy(&w, p, sizeof w);
+    if(NOT_PRINTABLE(w)) break;
+    p += sizeof w;
+  }
+  while(p < end && (unsigned char)(*p - 0x20) <= 0x7e - 0x20) p++;
+  return p - src;
+}
+#undef NOT_PRINTABLE
+#undef ONES
+
 static int escape_str_utf8(char *restrict dst, const char *restrict src, int bufsize, int *maxcells){
   int my_cells = 0;
   int my_bytes = 0;
@@ -37,6 +65,19 @@ static int escape_str_utf8(char *restrict dst, const char *restrict src, int buf
 	  
     if(my_cells >= *maxcells || my_bytes+1 >= bufsize) 
       break;
+
+    len = *maxcells - my_cells;
+    if (len > bufsize - 1 - my_bytes) len = bufsize - 1 - my_bytes;
+    len = ascii_run(src, len);
+    if (len) {
+      /* plain ASCII, usually the whole command line */
+      memcpy(dst, src, len);
+      dst += len;
+      src += len;
+      my_cells += len;
+      my_bytes += len;
+      continue;
+    }
     
     if (!(len = mbrtowc (&wc, src, MB_CUR_MAX, &s)))
       /* 'str' contains \0 */
@@ -0,0 +1,83 @@
+// Parent/child index over a table of processes
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// Finding each process's children by scanning the table is O(n) per
+// process, which hurts on hosts with 20k processes under one parent.
+// Here every pid is hashed once, each process's parent is looked up
+// once, and a counting sort on the parent index lays the children out
+// in one array (compressed sparse rows).  Everything is O(n).
+
+#include <stdlib.h>
+#include <string.h>
+#include "forest.h"
+#include "alloc.h"
+
+static unsigned hash_pid(int pid, unsigned mask){
+    return ((unsigned)pid * 2654435761u) & mask;
+}
+
+// table index + 1 of the first entry with this pid, or 0
+static int *hash_slot(const forest_t *restrict f, proc_t *const *tab, int pid){
+    unsigned mask = f->hashsize - 1;
+    unsigned h = hash_pid(pid, mask);
+
+    while(f->hash[h] && tab[f->hash[h] - 1]->XXXID != pid) h = (h + 1) & mask;
+    return &f->hash[h];
+}
+
+void build_forest(forest_t *restrict f, proc_t *const *tab, int n){
+    unsigned hashsize = 16;
+    int i, k;
+
+    if(n > f->size){
+        f->size = n;
+        f->first  = xrealloc(f->first,  (n + 1) * sizeof *f->first);
+        f->child  = xrealloc(f->child,  n * sizeof *f->child);
+        f->parent = xrealloc(f->parent, n * sizeof *f->parent);
+        f->root   = xrealloc(f->root,   n * sizeof *f->root);
+    }
+    if(!f->first) f->first = xmalloc(sizeof *f->first);
+    f->n = n;
+    f->nroots = 0;
+
+    while(hashsize < 2u * (unsigned)n) hashsize *= 2;
+    if(hashsize > f->hashsize){
+        f->hashsize = hashsize;
+        f->hash = xrealloc(f->hash, hashsize * sizeof *f->hash);
+    }
+    memset(f->hash, 0, f->hashsize * sizeof *f->hash);
+    for(i = 0; i < n; i++){
+        int *slot = hash_slot(f, tab, tab[i]->XXXID);
+        if(!*slot) *slot = i + 1;
+    }
+
+    // count each parent's children into first[p+1]...
+    memset(f->first, 0, (n + 1) * sizeof *f->first);
+    for(i = 0; i < n; i++){
+        int p = *hash_slot(f, tab, tab[i]->ppid) - 1;
+        f->parent[i] = p;
+        if(p < 0) f->root[f->nroots++] = i;
+        else      f->first[p + 1]++;
+    }
+    // ...so that first[p] becomes where p's children start...
+    for(k = 0; k < n; k++) f->first[k + 1] += f->first[k];
+    // ...then drop them in, which moves each first[p] up to first[p+1]
+    for(i = 0; i < n; i++){
+        int p = f->parent[i];
+        if(p >= 0) f->child[f->first[p]++] = i;
+    }
+    for(k = n; k > 0; k--) f->first[k] = f->first[k - 1];
+    f->first[0] = 0;
+}
+
+void free_forest(forest_t *restrict f){
+    free(f->first);
+    free(f->child);
+    free(f->parent);
+    free(f->root);
+    free(f->hash);
+    memset(f, 0, sizeof *f);
+}
@@ -0,0 +1,40 @@
+#ifndef PROCPS_PROC_FOREST_H
+#define PROCPS_PROC_FOREST_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include "procps.h"
+#include "readproc.h"
+
+EXTERN_C_BEGIN
+
+// The parent/child links of a table of processes, by index into that
+// table.  A process's parent is the entry whose XXXID is its ppid; one
+// that has none in the table is a root.  Node i's children are
+// child[first[i]] up to child[first[i+1]-1], in table order, so sorting
+// the table first decides the order siblings and roots come out in.
+//
+// The arrays are kept from one call to the next.  Start with a zeroed
+// forest_t.
+typedef struct forest_t {
+    int *first;		// n+1 offsets into child[]
+    int *child;		// n-nroots child indexes, grouped by parent
+    int *parent;	// index of the parent, or -1 for a root
+    int *root;		// nroots root indexes, in table order
+    int n;
+    int nroots;
+// private
+    int *hash;			// table index + 1, by pid
+    unsigned hashsize;
+    int size;			// room in the arrays above
+} forest_t;
+
+// O(n).  If several entries share a pid, the first one gets the children.
+extern void build_forest(forest_t *restrict f, proc_t *const *tab, int n);
+extern void free_forest(forest_t *restrict f);
+
+EXTERN_C_END
+
+#endif
@@ -0,0 +1,76 @@
+// Drift-free sampling intervals
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// sleep(delay) after each sample makes the period delay plus however
+// long the sample took, and the error piles up: vmstat 1 run for an hour
+// prints well short of 3600 lines.  Here the ticks are fixed in advance
+// and clock_nanosleep(TIMER_ABSTIME) wakes at the one due, so a slow
+// sample only makes its own line late.  One that takes longer than the
+// whole step costs a tick, which is counted rather than made up.
+
+#include <errno.h>
+#include "interval.h"
+
+#define NS 1000000000LL
+
+static long long ts_ns(const struct timespec *restrict ts){
+    return ts->tv_sec * NS + ts->tv_nsec;
+}
+
+static void ns_ts(struct timespec *restrict ts, long long ns){
+    ts->tv_sec  = ns / NS;
+    ts->tv_nsec = ns % NS;
+}
+
+void interval_start(interval_t *restrict it, double secs){
+    struct timespec mono, wall;
+    long long step = secs * NS;
+
+    if(step < 1000000) step = 1000000;	// 1 ms; a 0 would spin
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &wall);
+    it->step = step;
+    it->last = mono;
+    it->elapsed = 0;
+    it->missed = it->total_missed = 0;
+    // as far on in monotonic time as the wall clock is from its next multiple
+    ns_ts(&it->next, ts_ns(&mono) + step - ts_ns(&wall) % step);
+}
+
+int interval_left(const interval_t *restrict it){
+    struct timespec now;
+    long long left;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left = ts_ns(&it->next) - ts_ns(&now);
+    if(left <= 0) return 0;
+    return (left + 999999) / 1000000;
+}
+
+unsigned long interval_tick(interval_t *restrict it){
+    struct timespec now;
+    long long next, t;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    t = ts_ns(&now);
+    it->elapsed = (t - ts_ns(&it->last)) / (double)NS;
+    it->last = now;
+    next = ts_ns(&it->next) + it->step;
+    it->missed = 0;
+    if(next <= t){
+        it->missed = (t - next) / it->step + 1;
+        next += it->missed * it->step;
+    }
+    it->total_missed += it->missed;
+    ns_ts(&it->next, next);
+    return it->missed;
+}
+
+unsigned long interval_wait(interval_t *restrict it){
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &it->next, NULL) == EINTR)
+        ;
+    return interval_tick(it);
+}
@@ -0,0 +1,41 @@
+#ifndef PROCPS_PROC_INTERVAL_H
+#define PROCPS_PROC_INTERVAL_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include <time.h>
+#include "procps.h"
+
+EXTERN_C_BEGIN
+
+// A sampling clock for the tools that print every so many seconds.  The
+// ticks are due at fixed times, not a sleep after each sample, so the
+// time a sample takes doesn't push the following ones later; they fall
+// on whole multiples of the step in wall-clock time (a 0.1 s step ticks
+// at .0, .1, .2 ...), so two tools with the same step sample together.
+// It is kept on CLOCK_MONOTONIC, so a clock being set moves nothing.
+typedef struct interval_t {
+	struct timespec next;   // when the coming tick is due (monotonic)
+	struct timespec last;   // when the last one was taken
+	long long step;         // in ns
+	double elapsed;         // seconds, measured, from the tick before to the last
+	unsigned long missed;   // ticks the last interval_tick() passed over
+	unsigned long total_missed;
+} interval_t;
+
+// ticks every 'secs' seconds from now on; the first falls on the next
+// wall-clock multiple of the step
+extern void interval_start(interval_t *restrict it, double secs);
+// ms until the coming tick (0 if it's due), for poll() or select()
+extern int interval_left(const interval_t *restrict it);
+// take the tick that is due: fills in elapsed and missed, and moves next
+// on past now.  Returns missed.
+extern unsigned long interval_tick(interval_t *restrict it);
+// sleep until the coming tick, then take it
+extern unsigned long interval_wait(interval_t *restrict it);
+
+EXTERN_C_END
+
+#endif
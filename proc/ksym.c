@@ -23,8 +23,12 @@
 #include "version.h"
 #include "sysinfo.h" /* smp_num_cpus */
 #include "wchan.h"  // to verify prototypes
+#include "costs.h"
+#include "replay.h"
 
 #define KSYMS_FILENAME "/proc/ksyms"
+#define KALLSYMS_FILENAME "/proc/kallsyms"   /* Linux 2.6 and up */
+#define MODULES_FILENAME "/proc/modules"
 
 #if 0
 #undef KSYMS_FILENAME
@@ -111,7 +115,9 @@ typedef struct symb {
 
 /* These mostly rely on POSIX to make them zero. */
 
-static symb hashtable[256];
+// address -> abbreviated name, direct mapped
+#define WCHAN_CACHE_SIZE 1024  /* power of 2 */
+static symb hashtable[WCHAN_CACHE_SIZE];
 
 static char       *sysmap_data;
 static unsigned    sysmap_room;
@@ -200,6 +206,58 @@ static char *chop_version(char *arg){
 
 /***********************************/
 
+/* For lookup_wchan() the addresses are also kept apart from the names,
+ * in Eytzinger (breadth-first binary tree) order: key[1] is the median,
+ * the children of key[k] are key[2k] and key[2k+1].  The top levels of
+ * the tree share a few cache lines and the lower ones can be prefetched,
+ * where a plain binary search of the symb array misses on every probe.
+ * The names are in the same order, so the answer costs one more miss,
+ * not a trip back through the symb array.
+ */
+typedef struct eytz {
+  unsigned KLONG *key;   // [1..n], key[0] unused
+  const char **name;     // key[k]'s symbol
+  unsigned n;
+} eytz;
+
+static eytz ksyms_eytz, sysmap_eytz;
+
+static unsigned eytz_fill(eytz *restrict e, const symb *restrict idx, unsigned i, unsigned k){
+  if(k > e->n) return i;
+  i = eytz_fill(e, idx, i, 2*k);
+  e->key[k] = idx[i].addr;
+  e->name[k] = idx[i++].name;
+  return eytz_fill(e, idx, i, 2*k+1);
+}
+
+static void eytz_build(eytz *restrict e, const symb *restrict idx, unsigned count){
+  void *vp;
+  e->n = 0;
+  if(!idx || !count) return;
+  if(!(vp = realloc(e->key, sizeof(*e->key)*(count+1)))) return;
+  e->key = vp;
+  if(!(vp = realloc(e->name, sizeof(*e->name)*(count+1)))) return;
+  e->name = vp;
+  e->n = count;
+  eytz_fill(e, idx, 0, 1);
+}
+
+/* same answer as search() below, the last symbol at or before address,
+ * but copied to *out */
+static const symb *eytz_search(unsigned KLONG address, const eytz *restrict e, symb *restrict out){
+  unsigned k = 1;
+  unsigned best = 0;
+  while(k <= e->n){
+    __builtin_prefetch(e->key + 16*k);   // 4 levels down
+    if(e->key[k] <= address) best = k;
+    k = 2*k + (e->key[k] <= address);
+  }
+  if(!best) return NULL;   /* address is below them all (or no symbols) */
+  out->addr = e->key[best];
+  out->name = e->name[best];
+  return out;
+}
+
 static const symb *search(unsigned KLONG address, symb *idx, unsigned count){
   unsigned left;
   unsigned mid;
@@ -336,6 +394,76 @@ quiet_goodbye:
 
 /*********************************/
 
+static int compare_symb(const void *a, const void *b){
+  const symb *A = a, *B = b;
+  if(A->addr < B->addr) return -1;
+  return A->addr > B->addr;
+}
+
+/* /proc/kallsyms lines are "address type name[\t[module]]", which is to
+ * say System.map lines with the module name tacked on.  Only text symbols
+ * can be a wchan.  The module symbols come after the kernel's, in no
+ * particular order, so the index gets sorted once it's built. */
+static int parse_kallsyms(void) {
+  char *endp;
+  if(!ksyms_room || !ksyms_data) goto quiet_goodbye;
+  endp = ksyms_data;
+  ksyms_count = 0;
+  for(;;){
+    unsigned KLONG addr;
+    char *saved;
+    char type;
+    if(!*endp) break;
+    saved = endp;
+    addr = STRTOUKL(endp, &endp, 16);
+    if(endp==saved || endp[0] != ' ' || !endp[1] || endp[2] != ' ') goto bad_parse;
+    type = endp[1];
+    saved = endp + 3;
+    endp = saved + strcspn(saved, "\t\n");
+    if(*endp=='\t'){   // the module name is of no use
+      *endp++ = '\0';
+      endp = strchr(endp,'\n');
+      if(!endp) goto bad_parse;   /* no newline */
+    }
+    if(!*endp) goto bad_parse;    /* no newline */
+    *endp++ = '\0';
+    if(type!='T' && type!='t' && type!='W' && type!='w') continue;
+    if(ksyms_count >= idx_room){
+      void *vp;
+      idx_room = idx_room ? idx_room * 2 : 1024;
+      vp = realloc(ksyms_index, sizeof(symb)*idx_room);
+      if(!vp) goto bad_alloc;
+      ksyms_index = vp;
+    }
+    ksyms_index[ksyms_count].addr = addr;
+    ksyms_index[ksyms_count].name = saved;
+    ksyms_count++;
+  }
+  if(!ksyms_count) goto quiet_goodbye;
+  /* with kptr_restrict, everything is at address 0 */
+  if(!ksyms_index[ksyms_count-1].addr) goto quiet_goodbye;
+  qsort(ksyms_index, ksyms_count, sizeof(symb), compare_symb);
+  return 1;
+
+  if(0){
+bad_alloc:
+    fprintf(stderr, "Warning: not enough memory available\n");
+  }
+  if(0){
+bad_parse:
+    fprintf(stderr, "Warning: "KALLSYMS_FILENAME" not normal\n");
+  }
+quiet_goodbye:
+  idx_room = 0;
+  if(ksyms_data) free(ksyms_data) , ksyms_data = NULL;
+  ksyms_room = 0;
+  if(ksyms_index) free(ksyms_index) , ksyms_index = NULL;
+  ksyms_count = 0;
+  return 0;
+}
+
+/*********************************/
+
 #define VCNT 16
 
 static int sysmap_mmap(const char *restrict const filename, message_fn message) {
@@ -458,14 +586,44 @@ bad_open:
 
 /*********************************/
 
+/* A cheap fingerprint of the loaded modules: kallsyms only changes
+ * when they do, and at more than 10 MB it's worth not re-reading. */
+static unsigned modules_stamp(void){
+  char buf[4096];
+  unsigned h = 0;
+  ssize_t n;
+  int fd = open(MODULES_FILENAME, O_RDONLY);
+  if(fd<0) return 0;
+  while((n = read(fd, buf, sizeof buf)) > 0){
+    char *p = buf;
+    while(n--) h = h * 31 + (unsigned char)*p++;
+  }
+  close(fd);
+  return h;
+}
+
 static void read_and_parse(void){
   static time_t stamp;    /* after data gets old, load /proc/ksyms again */
-  if(time(NULL) != stamp){
+  static int kallsyms = -1;
+  static unsigned mods;
+  if(time(NULL) == stamp) return;
+  stamp = time(NULL);
+  if(kallsyms < 0) kallsyms = access(KSYMS_FILENAME, F_OK) && !access(KALLSYMS_FILENAME, R_OK);
+  if(kallsyms){
+    static int tried;
+    unsigned now = modules_stamp();
+    if(tried && now == mods) return;   /* still good, or still no use */
+    mods = now;
+    tried = 1;
+    if(!ksyms_room) ksyms_room = 4096;  /* do retry after a failure */
+    read_file(KALLSYMS_FILENAME, &ksyms_data, &ksyms_room);
+    parse_kallsyms();
+  }else{
     read_file(KSYMS_FILENAME, &ksyms_data, &ksyms_room);
     parse_ksyms();
-    memset((void*)hashtable,0,sizeof(hashtable)); /* invalidate cache */
-    stamp = time(NULL);
   }
+  eytz_build(&ksyms_eytz, ksyms_index, ksyms_count);
+  memset((void*)hashtable,0,sizeof(hashtable)); /* invalidate cache */
 }
 
 /*********************************/
@@ -549,17 +707,22 @@ int open_psdb(const char *restrict override) {
 
 static const char * read_wchan_file(unsigned pid){
   static char buf[64];
+  char path[32];
   const char *ret = buf;
   ssize_t num;
   int fd;
 
-  snprintf(buf, sizeof buf, "/proc/%d/wchan", pid);
-  fd = open(buf, O_RDONLY);
-  if(fd==-1) return "?";
-  num = read(fd, buf, sizeof buf - 1);
-  close(fd);
-  if(num<1) return "?"; // allow for "0"
-  buf[num] = '\0';
+  snprintf(path, sizeof path, "/proc/%d/wchan", pid);
+  if(unlikely(replay_image)){   // procrec keeps them
+    if(replay_copy(path, buf, sizeof buf) < 1) return "?";
+  }else{
+    fd = open(path, O_RDONLY);
+    if(fd==-1) return "?";
+    num = read(fd, buf, sizeof buf - 1);
+    close(fd);
+    if(num<1) return "?"; // allow for "0"
+    buf[num] = '\0';
+  }
 
   if(buf[0]=='0' && buf[1]=='\0') return "-";
 
@@ -583,26 +746,33 @@ static const char star[] = "*";
 
 #define MAX_OFFSET (0x1000*sizeof(long))  /* past this is generally junk */
 
-/* return pointer to temporary static buffer with function name */
-const char * lookup_wchan(unsigned KLONG address, unsigned pid) {
+static const char * wchan_name(unsigned KLONG address, unsigned pid) {
+  symb mod_found, map_found;
   const symb *mod_symb;
   const symb *map_symb;
   const symb *good_symb;
   const char *ret;
   unsigned hash;
 
-  // can't cache it due to a race condition :-(
-  if(use_wchan_file) return read_wchan_file(pid);
+  // The file can't be cached, since the process may have moved on by
+  // the time we see it :-( but when the kernel does give out addresses,
+  // /proc/kallsyms can name them without a file per process.
+  if(use_wchan_file){
+    if(address <= 1 || !~address) return read_wchan_file(pid);
+    read_and_parse();
+    if(!ksyms_count) return read_wchan_file(pid);
+  }
 
   if(!address)  return dash;
   if(!~address) return star;
 
-  read_and_parse();
-  hash = (address >> 4) & 0xff;  /* got 56/63 hits & 7/63 misses */
+  if(!use_wchan_file) read_and_parse();
+  hash = (address >> 4) & (WCHAN_CACHE_SIZE-1);  /* got 56/63 hits & 7/63 misses */
   if(hashtable[hash].addr == address) return hashtable[hash].name;
-  mod_symb = search(address, ksyms_index,  ksyms_count);
+  mod_symb = eytz_search(address, &ksyms_eytz,  &mod_found);
   if(!mod_symb) mod_symb = &fail;
-  map_symb = search(address, sysmap_index, sysmap_count);
+  if(sysmap_eytz.n != sysmap_count) eytz_build(&sysmap_eytz, sysmap_index, sysmap_count);
+  map_symb = eytz_search(address, &sysmap_eytz, &map_found);
   if(!map_symb) map_symb = &fail;
 
   /* which result is closest? */
@@ -611,6 +781,7 @@ const char * lookup_wchan(unsigned KLONG address, unsigned pid) {
             : map_symb
   ;
   if(address > good_symb->addr + MAX_OFFSET) good_symb = &fail;
+  if(good_symb == &fail && use_wchan_file) return read_wchan_file(pid);
 
   /* good_symb->name has the data, but needs to be trimmed */
   ret = good_symb->name;
@@ -629,3 +800,13 @@ const char * lookup_wchan(unsigned KLONG address, unsigned pid) {
 
   return ret;
 }
+
+/* return pointer to temporary static buffer with function name */
+const char * lookup_wchan(unsigned KLONG address, unsigned pid) {
+  const char *ret;
+  cost_mark cm;
+  COST_START(cm);
+  ret = wchan_name(address, pid);
+  COST_STOP(COST_WCHAN, cm);
+  return ret;
+}
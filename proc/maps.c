@@ -0,0 +1,277 @@
+// Reader for /proc/#/maps, /proc/#/smaps and /proc/#/numa_maps
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// Processes like JVMs and databases can have 100k mappings, which makes
+// for a 10 MB maps file or a 100+ MB smaps file.  So: no stdio, large
+// read()s into one buffer that is kept around, and each line is taken
+// apart right where it sits.  Only the names get copied out, into an
+// arena, so that the buffer can be refilled while streaming.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "maps.h"
+#include "alloc.h"
+#include "replay.h"
+
+#define MAPS_BUFSIZ (64*1024)
+
+// the smaps "Key: N kB" lines we keep
+#define KEY(k,m) { k, sizeof k - 1, offsetof(map_usage, m) }
+static const struct {
+    const char *key;
+    size_t len;
+    size_t at;
+} kb_keys[] = {
+    KEY("Rss",           rss),
+    KEY("Pss",           pss),
+    KEY("Size",          size),
+    KEY("Swap",          swap),
+    KEY("Locked",        locked),
+    KEY("SwapPss",       swap_pss),
+    KEY("Anonymous",     anonymous),
+    KEY("Referenced",    referenced),
+    KEY("Shared_Clean",  shared_clean),
+    KEY("Shared_Dirty",  shared_dirty),
+    KEY("Private_Clean", private_clean),
+    KEY("Private_Dirty", private_dirty),
+    KEY("AnonHugePages", anon_huge),
+    KEY("Shared_Hugetlb",  hugetlb),
+    KEY("Private_Hugetlb", hugetlb),
+};
+#undef KEY
+
+static unsigned long long hex(char **restrict S){
+    char *restrict p = *S;
+    unsigned long long v = 0;
+
+    for(;;){
+        unsigned c = (unsigned char)*p;
+        if(c - '0' <= 9u)               v = (v << 4) | (c - '0');
+        else if((c | 0x20) - 'a' <= 5u) v = (v << 4) | ((c | 0x20) - 'a' + 10);
+        else break;
+        p++;
+    }
+    *S = p;
+    return v;
+}
+
+static unsigned long long dec(char **restrict S){
+    char *restrict p = *S;
+    unsigned long long v = 0;
+
+    while(*p == ' ') p++;
+    while((unsigned)(*p - '0') <= 9u) v = v * 10 + (unsigned)(*p++ - '0');
+    *S = p;
+    return v;
+}
+
+// A mapping's header line starts with hex digits and a '-', which no
+// "Key:" line in smaps does.
+static int is_header(const char *p){
+    const char *q = p;
+    while((unsigned)(*q - '0') <= 9u || (unsigned)(*q - 'a') <= 5u) q++;
+    return q != p && *q == '-';
+}
+
+// "start-end flags offset major:minor inode   name"
+static void parse_header(maps_t *restrict m, map_t *restrict mp, char *S, char *eol, int flags){
+    char *name;
+    int i;
+
+    mp->start = hex(&S);
+    if(*S == '-') S++;
+    mp->end = hex(&S);
+    while(*S == ' ') S++;
+    for(i = 0; i < (int)sizeof mp->flags - 1 && S < eol && *S != ' '; i++)
+        mp->flags[i] = *S++;
+    mp->flags[i] = '\0';
+    while(*S == ' ') S++;
+    mp->offset = hex(&S);
+    while(*S == ' ') S++;
+    mp->dev_major = hex(&S);
+    if(*S == ':') S++;
+    mp->dev_minor = hex(&S);
+    mp->inode = dec(&S);
+    while(*S == ' ' || *S == '\t') S++;
+
+    if(S >= eol || (flags & MAPS_SUMONLY)){
+        mp->name = "";
+    }else{
+        name = arena_alloc(m->names, eol - S + 1);
+        for(i = 0; S < eol; i++, S++){
+            unsigned c = (unsigned char)*S;
+            name[i] = (c < 0x20 || c >= 0x7f) ? '?' : c;
+        }
+        name[i] = '\0';
+        mp->name = name;
+    }
+    memset(&mp->kb, 0, sizeof mp->kb);
+    memset(mp->node_kb, 0, sizeof mp->node_kb);
+}
+
+static void parse_kb(map_usage *restrict kb, map_usage *restrict total, char *S, char *eol){
+    char *colon = memchr(S, ':', eol - S);
+    size_t len, i;
+    unsigned long v;
+
+    if(!colon) return;
+    len = colon - S;
+    for(i = 0; i < sizeof kb_keys / sizeof kb_keys[0]; i++){
+        if(kb_keys[i].len != len || memcmp(kb_keys[i].key, S, len)) continue;
+        S = colon + 1;
+        v = dec(&S);
+        *(unsigned long *)((char *)kb + kb_keys[i].at) += v;
+        *(unsigned long *)((char *)total + kb_keys[i].at) += v;
+        return;
+    }
+}
+
+// "start policy key=value flag ... N0=pages N1=pages kernelpagesize_kB=4"
+// The page counts come before the page size, so they are scaled after.
+static void parse_numa(maps_t *restrict m, map_t *restrict mp, char *S, char *eol){
+    unsigned long pages[MAPS_NODES];
+    unsigned long pagekb = 4;
+    int i;
+
+    memset(mp, 0, sizeof *mp);
+    mp->name = "";
+    mp->start = hex(&S);
+    memset(pages, 0, sizeof pages);
+    while(S < eol){
+        while(*S == ' ') S++;
+        if(*S == 'N' && (unsigned)(S[1] - '0') <= 9u){
+            unsigned long long node;
+            S++;
+            node = dec(&S);
+            if(*S == '='){
+                S++;
+                if(node >= MAPS_NODES) node = MAPS_NODES - 1;
+                pages[node] += dec(&S);
+                if((int)node >= m->nodes) m->nodes = node + 1;
+            }
+        }else if(!strncmp(S, "kernelpagesize_kB=", 18)){
+            S += 18;
+            pagekb = dec(&S);
+        }
+        while(S < eol && *S != ' ') S++;
+    }
+    for(i = 0; i < MAPS_NODES; i++){
+        mp->node_kb[i] = pages[i] * pagekb;
+        m->node_total[i] += mp->node_kb[i];
+    }
+}
+
+// returns the map_t to fill in next, growing map[] as needed
+static map_t *next_map(maps_t *restrict m){
+    if(m->n >= m->size){
+        m->size = m->size ? m->size * 2 : 256;
+        m->map = xrealloc(m->map, m->size * sizeof *m->map);
+    }
+    return &m->map[m->n++];
+}
+
+static int read_file(maps_t *restrict m, int fd, int flags){
+    map_t scratch;              // the current mapping with MAPS_SUMONLY
+    map_t *mp = NULL;
+    unsigned keep = 0;          // unparsed partial line at the front of buf
+
+    if(!m->buf){
+        m->bufsize = MAPS_BUFSIZ;
+        m->buf = xmalloc(m->bufsize);
+    }
+    for(;;){
+        char *S, *end, *eol;
+        ssize_t r;
+
+        if(keep == m->bufsize - 1){     // one line fills the whole buffer
+            m->bufsize *= 2;
+            m->buf = xrealloc(m->buf, m->bufsize);
+        }
+        r = read(fd, m->buf + keep, m->bufsize - 1 - keep);
+        if(r < 0){
+            if(errno == EINTR) continue;
+            return -1;
+        }
+        end = m->buf + keep + r;
+        if(r == 0){
+            if(!keep) return 0;
+            *end++ = '\n';              // an unterminated last line
+        }
+        *end = '\0';
+
+        for(S = m->buf; (eol = memchr(S, '\n', end - S)); S = eol + 1){
+            *eol = '\0';
+            if(flags & MAPS_NUMA){
+                mp = (flags & MAPS_SUMONLY) ? &scratch : next_map(m);
+                parse_numa(m, mp, S, eol);
+            }else if(is_header(S)){
+                mp = (flags & MAPS_SUMONLY) ? &scratch : next_map(m);
+                parse_header(m, mp, S, eol, flags);
+            }else if(mp && (flags & MAPS_SMAPS)){
+                parse_kb(&mp->kb, &m->total, S, eol);
+            }
+        }
+        keep = end - S;
+        if(r == 0) return 0;
+        memmove(m->buf, S, keep);
+    }
+}
+
+// a recording has the maps (if they were readable), not the smaps
+static int maps_open(const char *restrict path){
+    if(replay_image) return replay_open(path);
+    return open(path, O_RDONLY);
+}
+
+int read_maps(maps_t *restrict m, unsigned pid, int flags){
+    char path[64];
+    int fd = -1;
+    int ret;
+
+    m->n = 0;
+    m->nodes = 0;
+    memset(&m->total, 0, sizeof m->total);
+    memset(m->node_total, 0, sizeof m->node_total);
+    if(m->names) arena_reset(m->names);
+    else         m->names = arena_new();
+
+    if(flags & MAPS_NUMA){
+        flags &= ~MAPS_SMAPS;
+        snprintf(path, sizeof path, "/proc/%u/numa_maps", pid);
+        fd = maps_open(path);
+        if(fd == -1) return -1;
+    }else if((flags & (MAPS_SMAPS|MAPS_ROLLUP)) == (MAPS_SMAPS|MAPS_ROLLUP)){
+        flags |= MAPS_SUMONLY;
+        snprintf(path, sizeof path, "/proc/%u/smaps_rollup", pid);
+        fd = maps_open(path);
+    }
+    if(fd == -1 && (flags & MAPS_SMAPS)){
+        snprintf(path, sizeof path, "/proc/%u/smaps", pid);
+        fd = maps_open(path);
+        if(fd == -1) flags &= ~MAPS_SMAPS;
+    }
+    if(fd == -1){
+        snprintf(path, sizeof path, "/proc/%u/maps", pid);
+        fd = maps_open(path);
+        if(fd == -1) return -1;
+    }
+    m->flags = flags & MAPS_SMAPS;
+    ret = read_file(m, fd, flags);
+    close(fd);
+    return ret;
+}
+
+void free_maps(maps_t *restrict m){
+    free(m->map);
+    free(m->buf);
+    if(m->names) arena_free(m->names);
+    memset(m, 0, sizeof *m);
+}
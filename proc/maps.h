@@ -0,0 +1,83 @@
+#ifndef PROCPS_PROC_MAPS_H
+#define PROCPS_PROC_MAPS_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include "procps.h"
+
+EXTERN_C_BEGIN
+
+// per-mapping memory use from /proc/#/smaps, all in kB
+typedef struct map_usage {
+    unsigned long
+	size,		// Size             virtual size of the mapping
+	rss,		// Rss              resident
+	pss,		// Pss              resident, shared pages split among sharers
+	shared_clean,	// Shared_Clean
+	shared_dirty,	// Shared_Dirty
+	private_clean,	// Private_Clean
+	private_dirty,	// Private_Dirty    (USS is private_clean+private_dirty)
+	referenced,	// Referenced
+	anonymous,	// Anonymous
+	swap,		// Swap
+	swap_pss,	// SwapPss          Linux 4.3
+	locked,		// Locked
+	anon_huge,	// AnonHugePages    transparent huge pages
+	hugetlb;	// Shared_Hugetlb + Private_Hugetlb
+} map_usage;
+
+// NUMA nodes that numa_maps counts are kept apart up to this many; pages
+// on higher nodes than that are counted with the last one
+#define MAPS_NODES 8
+
+// one line of /proc/#/maps, or one record of /proc/#/smaps
+typedef struct map_t {
+    unsigned KLONG
+	start,		// first address
+	end;		// one past the last address
+    unsigned long long
+	offset,		// file offset
+	inode;
+    const char *name;	// path, [heap], etc. or "" -- unprintables become '?'
+    unsigned
+	dev_major,
+	dev_minor;
+    char flags[8];	// "rwxp" or "rw-s", the way the kernel wrote it
+    map_usage kb;	// zero unless read from smaps
+    unsigned long node_kb[MAPS_NODES];	// kB on each node, from numa_maps
+} map_t;
+
+// The map[] array, the names and the read buffer are all kept from one
+// call to the next, so rereading (another process, or the same one later)
+// normally doesn't need malloc at all.  Start with a zeroed maps_t.
+typedef struct maps_t {
+    map_t *map;		// n mappings, in address order
+    int n;
+    int flags;		// what was actually read: MAPS_SMAPS or not
+    map_usage total;	// sum over all mappings (smaps only)
+    unsigned long node_total[MAPS_NODES];	// likewise (numa_maps only)
+    int nodes;		// 1 + the highest node numa_maps had pages on
+// private
+    int size;			// room in map[]
+    unsigned bufsize;
+    char *buf;
+    struct arena_t *names;
+} maps_t;
+
+#define MAPS_SMAPS   0x1 // read smaps for the kb numbers, else plain maps
+#define MAPS_SUMONLY 0x2 // just the totals; leaves map[] empty (n is 0)
+#define MAPS_ROLLUP  0x4 // with MAPS_SMAPS: totals from smaps_rollup if there
+#define MAPS_NUMA    0x8 // read numa_maps instead: only start and node_kb are set
+
+// Fills in m for process 'pid' in one pass over the file.  If smaps was
+// asked for but can't be read, plain maps is tried.  Returns 0, or -1 with
+// errno set if neither file could be opened.  MAPS_NUMA has no fallback.
+extern int read_maps(maps_t *restrict m, unsigned pid, int flags);
+
+// give back everything a maps_t holds, leaving it zeroed
+extern void free_maps(maps_t *restrict m);
+
+EXTERN_C_END
+#endif
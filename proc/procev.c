@@ -0,0 +1,361 @@
+// Process events from the kernel's proc connector
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// A netlink socket joined to the connector's CN_IDX_PROC group gets a
+// message for every fork, exec and exit on the system.  pgrep --wait
+// sleeps in poll() on one until the right exec comes along, and top
+// keeps its set of live processes from them instead of reading the
+// /proc directory every frame -- which, with 50k processes, is a lot
+// of getdents() for a list that has barely changed.
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include "procev.h"
+#include "alloc.h"
+#include "replay.h"
+
+#define CAP_NET_ADMIN_BIT 12
+#define ACK_MSECS 250		// the kernel answers LISTEN at once, if at all
+
+// The kernel ignores LISTEN, without even an error back, from outside
+// the initial user and pid namespaces.  Checking here saves waiting out
+// ACK_MSECS for an answer that won't come.
+static int can_listen(void){
+    char buf[4096];
+    FILE *fp;
+    unsigned long long caps = 0;
+    int nspids = 1;
+    unsigned long a, b, c;
+
+    fp = fopen("/proc/self/status", "r");
+    if(!fp) return 0;
+    while(fgets(buf, sizeof buf, fp)){
+        if(!strncmp(buf, "CapEff:", 7)) caps = strtoull(buf + 7, NULL, 16);
+        if(!strncmp(buf, "NSpid:", 6)){
+            char *s = buf + 6;
+            nspids = 0;
+            while(strtol(s, &s, 10)) nspids++;
+        }
+    }
+    fclose(fp);
+    if(!(caps & (1ull << CAP_NET_ADMIN_BIT)) || nspids != 1) return 0;
+
+    fp = fopen("/proc/self/uid_map", "r");
+    if(!fp) return 1;			// no user namespaces at all
+    if(fscanf(fp, "%lu %lu %lu", &a, &b, &c) != 3) a = 1;
+    fclose(fp);
+    return a == 0 && b == 0 && c == 4294967295ul;
+}
+
+static int send_op(int fd, enum proc_cn_mcast_op op){
+    union {
+        struct nlmsghdr nl;
+        char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))];
+    } u;
+    struct cn_msg *cn = NLMSG_DATA(&u.nl);
+
+    memset(&u, 0, sizeof u);
+    u.nl.nlmsg_len = NLMSG_LENGTH(sizeof *cn + sizeof op);
+    u.nl.nlmsg_type = NLMSG_DONE;
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof op;
+    memcpy(cn->data, &op, sizeof op);
+    return send(fd, &u, u.nl.nlmsg_len, 0) == (ssize_t)u.nl.nlmsg_len ? 0 : -1;
+}
+
+// One datagram's events into ev[], returning how many, or -1 (errno set).
+// The kernel sends each event in a message of its own, so n is only a
+// guard.  An ack, if one is wanted, goes into *ack: 0 or the errno.
+static int get_msg(int fd, procev_t *restrict ev, int n, int *restrict ack){
+    union {
+        struct nlmsghdr nl;
+        char buf[4096];
+    } u;
+    struct sockaddr_nl from;
+    socklen_t fromlen = sizeof from;
+    struct nlmsghdr *nl;
+    int len, got = 0;
+
+    len = recvfrom(fd, &u, sizeof u, MSG_DONTWAIT, (struct sockaddr *)&from, &fromlen);
+    if(len < 0) return -1;
+    if(from.nl_pid != 0) return 0;	// only the kernel says what happened
+    for(nl = &u.nl; NLMSG_OK(nl, (unsigned)len); nl = NLMSG_NEXT(nl, len)){
+        const struct cn_msg *cn = NLMSG_DATA(nl);
+        const struct proc_event *pe = (const struct proc_event *)cn->data;
+
+        if(nl->nlmsg_type == NLMSG_NOOP || nl->nlmsg_type == NLMSG_ERROR) continue;
+        if(cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC) continue;
+        if(got >= n) break;
+        switch(pe->what){
+        case PROC_EVENT_NONE:
+            if(ack) *ack = pe->event_data.ack.err;
+            break;
+        case PROC_EVENT_FORK:
+            ev[got].what  = PROCEV_FORK;
+            ev[got].pid   = pe->event_data.fork.child_pid;
+            ev[got].tgid  = pe->event_data.fork.child_tgid;
+            ev[got].ptgid = pe->event_data.fork.parent_tgid;
+            got++;
+            break;
+        case PROC_EVENT_EXEC:
+            ev[got].what  = PROCEV_EXEC;
+            ev[got].pid   = pe->event_data.exec.process_pid;
+            ev[got].tgid  = pe->event_data.exec.process_tgid;
+            ev[got].ptgid = 0;
+            got++;
+            break;
+        case PROC_EVENT_EXIT:
+            ev[got].what  = PROCEV_EXIT;
+            ev[got].pid   = pe->event_data.exit.process_pid;
+            ev[got].tgid  = pe->event_data.exit.process_tgid;
+            ev[got].ptgid = 0;
+            got++;
+            break;
+        default:			// uid, sid, comm and such changes
+            break;
+        }
+    }
+    return got;
+}
+
+int procev_open(void){
+    struct sockaddr_nl sa;
+    int fd, ack = -1;
+    int size = 4 << 20;			// a fork storm's worth
+    procev_t ev[1];
+    struct pollfd pfd;
+
+    if(replay_image) return -1;	// a recording has nothing to tell
+    if(!can_listen()) return -1;
+    fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if(fd == -1) return -1;
+    memset(&sa, 0, sizeof sa);
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = CN_IDX_PROC;
+    if(bind(fd, (struct sockaddr *)&sa, sizeof sa) == -1) goto fail;
+    if(setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof size) == -1)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+    if(send_op(fd, PROC_CN_MCAST_LISTEN) == -1) goto fail;
+
+    // wait for the answer, passing over any events that beat it here
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while(ack == -1){
+        if(poll(&pfd, 1, ACK_MSECS) != 1) goto fail;
+        if(get_msg(fd, ev, 1, &ack) == -1 && errno != EAGAIN && errno != ENOBUFS) goto fail;
+    }
+    if(ack) goto fail;
+    return fd;
+fail:
+    close(fd);
+    return -1;
+}
+
+int procev_read(int fd, procev_t *restrict ev, int n){
+    int got = 0;
+
+    while(got < n){
+        int k = get_msg(fd, ev + got, n - got, NULL);
+        if(k == -1){
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if(errno == EINTR) continue;
+            return -1;
+        }
+        got += k;
+    }
+    return got;
+}
+
+void procev_close(int fd){
+    if(fd == -1) return;
+    send_op(fd, PROC_CN_MCAST_IGNORE);
+    close(fd);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+#define WORD_BITS (8 * sizeof(unsigned long))
+
+// room for the bit of pid, growing past a raised pid_max if need be
+static int live_fits(proclive_t *restrict pl, pid_t pid){
+    unsigned want;
+
+    if(pid <= 0) return 0;
+    if((unsigned)pid / WORD_BITS < pl->nwords) return 1;
+    want = (unsigned)pid / WORD_BITS + 1;
+    pl->bits = xrealloc(pl->bits, want * sizeof *pl->bits);
+    memset(pl->bits + pl->nwords, 0, (want - pl->nwords) * sizeof *pl->bits);
+    pl->nwords = want;
+    return 1;
+}
+
+static void live_set(proclive_t *restrict pl, pid_t pid){
+    if(live_fits(pl, pid)) pl->bits[pid / WORD_BITS] |= 1ul << (pid % WORD_BITS);
+}
+
+static void live_clear(proclive_t *restrict pl, pid_t pid){
+    if(live_fits(pl, pid)) pl->bits[pid / WORD_BITS] &= ~(1ul << (pid % WORD_BITS));
+}
+
+// A zombie is still there when its exit event comes, and nothing comes
+// when it is reaped, so until kill() says it's gone it is asked again.
+// One that isn't a zombie has threads left, and the last to go will
+// send an exit of its own.
+static void dying_add(proclive_t *restrict pl, pid_t tgid){
+    unsigned i;
+
+    for(i = 0; i < pl->ndying; i++) if(pl->dying[i] == tgid) return;
+    if(pl->ndying == pl->dyroom){
+        pl->dyroom = pl->dyroom ? pl->dyroom * 2 : 16;
+        pl->dying = xrealloc(pl->dying, pl->dyroom * sizeof *pl->dying);
+    }
+    pl->dying[pl->ndying++] = tgid;
+}
+
+static void dying_drop(proclive_t *restrict pl, pid_t tgid){
+    unsigned i;
+
+    for(i = 0; i < pl->ndying; i++){
+        if(pl->dying[i] != tgid) continue;
+        pl->dying[i] = pl->dying[--pl->ndying];
+        return;
+    }
+}
+
+// 1 if /proc/#/stat says Z (or X), 0 if not, -1 if it can't be read
+static int zombie(pid_t tgid){
+    char buf[512], *cp;
+    ssize_t n;
+    int fd;
+
+    snprintf(buf, sizeof buf, "/proc/%d/stat", tgid);
+    fd = open(buf, O_RDONLY);
+    if(fd == -1) return -1;
+    n = read(fd, buf, sizeof buf - 1);
+    close(fd);
+    if(n <= 0) return -1;
+    buf[n] = '\0';
+    cp = strrchr(buf, ')');		// the command may have one too
+    if(!cp || cp[1] != ' ') return -1;
+    return cp[2] == 'Z' || cp[2] == 'X';
+}
+
+// those that are gone now are cleared, and the live ones forgotten
+static void dying_check(proclive_t *restrict pl){
+    unsigned i = 0;
+
+    while(i < pl->ndying){
+        pid_t tgid = pl->dying[i];
+        int z = zombie(tgid);
+        if(z == -1 && kill(tgid, 0) == -1 && errno == ESRCH) live_clear(pl, tgid);
+        else if(z == 1){
+            i++;
+            continue;
+        }
+        pl->dying[i] = pl->dying[--pl->ndying];
+    }
+}
+
+// the slow way, to start with and whenever events went missing
+static void live_rescan(proclive_t *restrict pl){
+    DIR *d;
+    struct dirent *ent;
+
+    memset(pl->bits, 0, pl->nwords * sizeof *pl->bits);
+    pl->ndying = 0;			// zombies are in /proc, and go when reaped
+    d = opendir("/proc");
+    if(!d) return;
+    while((ent = readdir(d))){
+        if(*ent->d_name > '0' && *ent->d_name <= '9') live_set(pl, strtoul(ent->d_name, NULL, 10));
+    }
+    closedir(d);
+    pl->stale = 0;
+}
+
+proclive_t *proclive_open(void){
+    proclive_t *pl;
+    unsigned long pid_max = 32768;
+    FILE *fp;
+    int fd;
+
+    fd = procev_open();
+    if(fd == -1) return NULL;
+    fp = fopen("/proc/sys/kernel/pid_max", "r");
+    if(fp){
+        if(fscanf(fp, "%lu", &pid_max) != 1) pid_max = 32768;
+        fclose(fp);
+    }
+    pl = xcalloc(NULL, sizeof *pl);
+    pl->fd = fd;
+    pl->nwords = pid_max / WORD_BITS + 1;
+    pl->bits = xcalloc(NULL, pl->nwords * sizeof *pl->bits);
+    pl->stale = 1;			// the first call reads /proc
+    return pl;
+}
+
+pid_t *proclive_pids(proclive_t *restrict pl){
+    procev_t ev[64];
+    unsigned w, n = 0;
+    int got, i;
+
+    while((got = procev_read(pl->fd, ev, 64)) > 0){
+        for(i = 0; i < got; i++){
+            switch(ev[i].what){
+            case PROCEV_FORK:
+                if(ev[i].pid != ev[i].tgid) break;
+                live_set(pl, ev[i].tgid);
+                dying_drop(pl, ev[i].tgid);	// the pid came round again
+                break;
+            case PROCEV_EXIT:
+                // a leader can go before its threads, and the last thread
+                // to go needn't be the leader -- so ask whether it's gone
+                if(kill(ev[i].tgid, 0) == -1 && errno == ESRCH) live_clear(pl, ev[i].tgid);
+                else dying_add(pl, ev[i].tgid);
+                break;
+            }
+        }
+    }
+    if(got < 0 || pl->stale) live_rescan(pl);
+    else dying_check(pl);
+
+    for(w = 0; w < pl->nwords; w++) n += __builtin_popcountl(pl->bits[w]);
+    if(n + 1 > pl->npids){
+        pl->npids = n + 1 + n / 4;
+        free(pl->pids);
+        pl->pids = xmalloc(pl->npids * sizeof *pl->pids);
+    }
+    n = 0;
+    for(w = 0; w < pl->nwords; w++){
+        unsigned long bits = pl->bits[w];
+        while(bits){
+            pl->pids[n++] = w * WORD_BITS + __builtin_ctzl(bits);
+            bits &= bits - 1;
+        }
+    }
+    pl->pids[n] = 0;
+    return pl->pids;
+}
+
+void proclive_close(proclive_t *restrict pl){
+    if(!pl) return;
+    procev_close(pl->fd);
+    free(pl->bits);
+    free(pl->pids);
+    free(pl->dying);
+    free(pl);
+}
@@ -0,0 +1,60 @@
+#ifndef PROCPS_PROC_PROCEV_H
+#define PROCPS_PROC_PROCEV_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include <sys/types.h>
+#include "procps.h"
+
+EXTERN_C_BEGIN
+
+// Fork, exec and exit events from the kernel's proc connector.  Getting
+// them takes CAP_NET_ADMIN, in the initial pid namespace; without that,
+// or with no connector in the kernel, procev_open() fails and the caller
+// just goes on scanning /proc.
+
+#define PROCEV_FORK 1
+#define PROCEV_EXEC 2
+#define PROCEV_EXIT 3
+
+typedef struct procev_t {
+    int what;		// PROCEV_*
+    pid_t pid;		// the task (for a fork, the new one)
+    pid_t tgid;		// its thread group
+    pid_t ptgid;	// fork only: the parent's thread group
+} procev_t;
+
+// A socket to poll() on, or -1.
+extern int procev_open(void);
+// Up to n events that are already waiting; it doesn't block.  -1 with
+// errno ENOBUFS means some were dropped, and anything built from them
+// has to be rebuilt.
+extern int procev_read(int fd, procev_t *restrict ev, int n);
+extern void procev_close(int fd);
+
+// The set of live processes, kept up to date from the events, so that a
+// scan needn't read the /proc directory.  A bit per pid up to pid_max.
+typedef struct proclive_t {
+    unsigned long *bits;	// set for each live tgid
+    pid_t *pids;		// what proclive_pids() last returned
+    pid_t *dying;		// exited, but not reaped yet: asked again each call
+    unsigned nwords;
+    unsigned npids;		// room in pids
+    unsigned ndying;
+    unsigned dyroom;		// room in dying
+    int fd;
+    int stale;			// events got lost, so read /proc again
+} proclive_t;
+
+// NULL where procev_open() would fail.
+extern proclive_t *proclive_open(void);
+// Takes in the events so far, then gives the live tgids, ascending and
+// 0-terminated as openproc(PROC_PID) wants them.  Good until the next call.
+extern pid_t *proclive_pids(proclive_t *restrict pl);
+extern void proclive_close(proclive_t *restrict pl);
+
+EXTERN_C_END
+
+#endif
@@ -14,64 +14,198 @@
 #include <pwd.h>
 #include "alloc.h"
 #include "pwcache.h"
+#include "costs.h"
 #include <grp.h>
 
 // might as well fill cache lines... else we waste memory anyway
 
-#define	HASHSIZE	64		/* power of 2 */
-#define	HASH(x)		((x) & (HASHSIZE - 1))
+#define	HASHSIZE	64		/* starting size, power of 2 */
 
-static struct pwbuf {
-    struct pwbuf *next;
-    uid_t uid;
-    char name[P_G_SZ];
-} *pwhash[HASHSIZE];
+// One table type serves uid->user, gid->group and user->uid.  The tables
+// double whenever they hold more entries than buckets, so chains stay
+// short even with thousands of (say, LDAP) accounts.  IDs and names that
+// don't resolve are cached too, so each costs at most one NSS lookup.
+
+typedef struct idbuf {
+    struct idbuf *next;
+    unsigned id;
+    int found;                  // 0 if NSS didn't know it
+    char name[P_G_SZ];          // for user->uid, just the first P_G_SZ-1
+} idbuf;
+
+typedef struct idtab {
+    idbuf **hash;
+    unsigned size;              // buckets, 0 until first use
+    unsigned count;             // entries
+} idtab;
+
+static idtab pwtab, grptab, pwnametab;
+
+static unsigned hash_name(const char *s) {
+    unsigned h = 0;
+    while (*s)
+	h = h * 31 + (unsigned char)*s++;
+    return h;
+}
+
+// the key of an entry: its id, except in the by-name table
+static unsigned key_of(const idtab *t, const idbuf *b) {
+    return t == &pwnametab ? hash_name(b->name) : b->id;
+}
+
+static void grow(idtab *t) {
+    unsigned size = t->size ? t->size * 2 : HASHSIZE;
+    idbuf **hash = xcalloc(NULL, size * sizeof *hash);
+    unsigned i;
+
+    for (i = 0; i < t->size; i++) {
+	idbuf *b = t->hash[i];
+	while (b) {
+	    idbuf *next = b->next;
+	    unsigned h = key_of(t, b) & (size - 1);
+	    b->next = hash[h];
+	    hash[h] = b;
+	    b = next;
+	}
+    }
+    free(t->hash);
+    t->hash = hash;
+    t->size = size;
+}
+
+// returns the bucket to search for 'key', growing the table if need be
+static idbuf **bucket(idtab *t, unsigned key) {
+    if (t->count >= t->size)
+	grow(t);
+    return &t->hash[key & (t->size - 1)];
+}
+
+static idbuf *find_id(idtab *t, unsigned id) {
+    idbuf *b;
+
+    if (!t->size)
+	return NULL;
+    for (b = t->hash[id & (t->size - 1)]; b; b = b->next)
+	if (b->id == id)
+	    return b;
+    return NULL;
+}
+
+static idbuf *add(idtab *t, unsigned key) {
+    idbuf **h = bucket(t, key);
+    idbuf *b = xmalloc(sizeof *b);
+
+    b->next = *h;
+    *h = b;
+    t->count++;
+    return b;
+}
+
+static void set_name(idbuf *b, const char *name, unsigned id) {
+    if (!name || strlen(name) >= P_G_SZ)
+	sprintf(b->name, "%u", id);
+    else
+	strcpy(b->name, name);
+}
 
 char *user_from_uid(uid_t uid) {
-    struct pwbuf **p;
     struct passwd *pw;
+    idbuf *b;
+    cost_mark cm;
 
-    p = &pwhash[HASH(uid)];
-    while (*p) {
-	if ((*p)->uid == uid)
-	    return((*p)->name);
-	p = &(*p)->next;
+    COST_START(cm);
+    if (!(b = find_id(&pwtab, uid))) {
+	pw = getpwuid(uid);
+	b = add(&pwtab, uid);
+	b->id = uid;
+	b->found = !!pw;
+	set_name(b, pw ? pw->pw_name : NULL, uid);
     }
-    *p = (struct pwbuf *) xmalloc(sizeof(struct pwbuf));
-    (*p)->uid = uid;
-    pw = getpwuid(uid);
-    if(!pw || strlen(pw->pw_name) >= P_G_SZ)
-	sprintf((*p)->name, "%u", uid);
-    else
-        strcpy((*p)->name, pw->pw_name);
+    COST_STOP(COST_NAMES, cm);
+    return b->name;
+}
 
-    (*p)->next = NULL;
-    return((*p)->name);
+char *group_from_gid(gid_t gid) {
+    struct group *gr;
+    idbuf *b;
+    cost_mark cm;
+
+    COST_START(cm);
+    if (!(b = find_id(&grptab, gid))) {
+	gr = getgrgid(gid);
+	b = add(&grptab, gid);
+	b->id = gid;
+	b->found = !!gr;
+	set_name(b, gr ? gr->gr_name : NULL, gid);
+    }
+    COST_STOP(COST_NAMES, cm);
+    return b->name;
 }
 
-static struct grpbuf {
-    struct grpbuf *next;
-    gid_t gid;
-    char name[P_G_SZ];
-} *grphash[HASHSIZE];
+// the reverse of user_from_uid: 0 and *uid set, or -1 for no such user
+int uid_from_user(const char *restrict name, uid_t *restrict uid) {
+    struct passwd *pw;
+    unsigned h = hash_name(name);
+    idbuf *b;
 
-char *group_from_gid(gid_t gid) {
-    struct grpbuf **g;
+    if (strlen(name) >= P_G_SZ) {       // too long to cache, so just ask
+	pw = getpwnam(name);
+	if (!pw)
+	    return -1;
+	*uid = pw->pw_uid;
+	return 0;
+    }
+    if (pwnametab.size)
+	for (b = pwnametab.hash[h & (pwnametab.size - 1)]; b; b = b->next)
+	    if (!strcmp(b->name, name))
+		goto done;
+    pw = getpwnam(name);
+    b = add(&pwnametab, h);
+    strcpy(b->name, name);
+    b->found = !!pw;
+    b->id = pw ? pw->pw_uid : 0;
+    if (pw && !find_id(&pwtab, b->id)) {        // now we know this one too
+	idbuf *u = add(&pwtab, b->id);
+	u->id = b->id;
+	u->found = 1;
+	strcpy(u->name, name);
+    }
+done:
+    if (!b->found)
+	return -1;
+    *uid = b->id;
+    return 0;
+}
+
+// Optionally fill the caches from /etc/passwd and /etc/group in one pass
+// each, rather than one NSS lookup per ID.  Entries already cached win,
+// as do earlier lines, same as getpwuid() would see them.
+void pwcache_preload(void) {
+    struct passwd *pw;
     struct group *gr;
+    FILE *fp;
+    idbuf *b;
 
-    g = &grphash[HASH(gid)];
-    while (*g) {
-        if ((*g)->gid == gid)
-            return((*g)->name);
-        g = &(*g)->next;
+    if ((fp = fopen("/etc/passwd", "r"))) {
+	while ((pw = fgetpwent(fp))) {
+	    if (find_id(&pwtab, pw->pw_uid))
+		continue;
+	    b = add(&pwtab, pw->pw_uid);
+	    b->id = pw->pw_uid;
+	    b->found = 1;
+	    set_name(b, pw->pw_name, pw->pw_uid);
+	}
+	fclose(fp);
+    }
+    if ((fp = fopen("/etc/group", "r"))) {
+	while ((gr = fgetgrent(fp))) {
+	    if (find_id(&grptab, gr->gr_gid))
+		continue;
+	    b = add(&grptab, gr->gr_gid);
+	    b->id = gr->gr_gid;
+	    b->found = 1;
+	    set_name(b, gr->gr_name, gr->gr_gid);
+	}
+	fclose(fp);
     }
-    *g = (struct grpbuf *) malloc(sizeof(struct grpbuf));
-    (*g)->gid = gid;
-    gr = getgrgid(gid);
-    if (!gr || strlen(gr->gr_name) >= P_G_SZ)
-        sprintf((*g)->name, "%u", gid);
-    else
-        strcpy((*g)->name, gr->gr_name);
-    (*g)->next = NULL;
-    return((*g)->name);
 }
@@ -11,6 +11,8 @@ EXTERN_C_BEGIN
 
 extern char *user_from_uid(uid_t uid);
 extern char *group_from_gid(gid_t gid);
+extern int uid_from_user(const char *restrict name, uid_t *restrict uid);
+extern void pwcache_preload(void);
 
 EXTERN_C_END
 
@@ -15,10 +15,18 @@
 #include "pwcache.h"
 #include "devname.h"
 #include "procps.h"
+#include "sysinfo.h"
+#include "maps.h"
+#include "taskstats.h"
+#include "cgroup.h"
+#include "replay.h"
+#include "share.h"
+#include "costs.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
@@ -26,6 +34,8 @@
 #include <sys/dir.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
+#include <pthread.h>
 
 // sometimes it's easier to do this manually, w/o gcc helping
 #ifdef PROF
@@ -81,10 +91,12 @@ typedef struct status_table_struct {
 // and the number of entries (we mask with 63 for now). The table
 // must be padded out to 64 entries, maybe 128 in the future.
 
-static void status2proc(char *S, proc_t *restrict P, int is_proc){
+static void status2proc(char *S, proc_t *restrict P, int is_proc, unsigned want){
     long Threads = 0;
     long Tgid = 0;
     long Pid = 0;
+    unsigned left = 7;   // Name State Tgid Pid PPid Uid Gid, then the wanted groups
+    cost_mark cm;
 
   // 128 entries because we trust the kernel to use ASCII names
   static const unsigned char asso[] =
@@ -166,17 +178,36 @@ static void status2proc(char *S, proc_t *restrict P, int is_proc){
 #undef F
 #undef NUL
 
-ENTER(0x220);
+// a key we were waiting for has been parsed; quit if it was the last one
+#define FOUND(group) \
+    if(((group)==PROC_FIELD_BASIC || (want & (group))) && !--left) goto done
 
-    P->vm_size = 0;
-    P->vm_lock = 0;
-    P->vm_rss  = 0;
-    P->vm_data = 0;
-    P->vm_stack= 0;
-    P->vm_exe  = 0;
-    P->vm_lib  = 0;
-    P->nlwp    = 0;
-    P->signal[0] = '\0';  // so we can detect it as missing for very old kernels
+ENTER(0x220);
+    COST_START(cm);
+
+    if(want & PROC_FIELD_VM){
+        P->vm_size = 0;
+        P->vm_lock = 0;
+        P->vm_rss  = 0;
+        P->vm_data = 0;
+        P->vm_stack= 0;
+        P->vm_exe  = 0;
+        P->vm_lib  = 0;
+        left += 8;
+    }
+    if(want & PROC_FIELD_TIMES){
+        P->nlwp    = 0;
+        left += 1;
+    }
+    if(want & PROC_FIELD_SIGS){
+        P->signal[0] = '\0';  // so we can detect it as missing for very old kernels
+        left += 5;
+    }
+    if(want & PROC_FIELD_CSW){
+        P->nvcsw  = 0;
+        P->nivcsw = 0;
+        left += 2;
+    }
 
     goto base;
 
@@ -196,8 +227,18 @@ ENTER(0x220);
         colon = strchr(S, ':');
         if(unlikely(!colon)) break;
         if(unlikely(colon[1]!='\t')) break;
-        if(unlikely(colon-S != entry.len)) continue;
-        if(unlikely(memcmp(entry.name,S,colon-S))) continue;
+        if(unlikely(colon-S != entry.len) || unlikely(memcmp(entry.name,S,colon-S))){
+            // the context switch counts (Linux 2.6.23) are too long for the table
+            if(!(want & PROC_FIELD_CSW)) continue;
+            if(colon-S == 23 && !memcmp(S, "voluntary_ctxt_switches", 23)){
+                P->nvcsw = strtoul(colon+2,&S,10);
+                FOUND(PROC_FIELD_CSW);
+            }else if(colon-S == 26 && !memcmp(S, "nonvoluntary_ctxt_switches", 26)){
+                P->nivcsw = strtoul(colon+2,&S,10);
+                FOUND(PROC_FIELD_CSW);
+            }
+            continue;
+        }
 
         S = colon+2; // past the '\t'
 
@@ -223,96 +264,122 @@ ENTER(0x220);
         }
         P->cmd[u] = '\0';
         S--;   // put back the '\n' or '\0'
+        FOUND(PROC_FIELD_BASIC);
         continue;
     }
 #ifdef SIGNAL_STRING
     case_ShdPnd:
         memcpy(P->signal, S, 16);
         P->signal[16] = '\0';
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigBlk:
         memcpy(P->blocked, S, 16);
         P->blocked[16] = '\0';
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigCgt:
         memcpy(P->sigcatch, S, 16);
         P->sigcatch[16] = '\0';
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigIgn:
         memcpy(P->sigignore, S, 16);
         P->sigignore[16] = '\0';
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigPnd:
         memcpy(P->_sigpnd, S, 16);
         P->_sigpnd[16] = '\0';
+        FOUND(PROC_FIELD_SIGS);
         continue;
 #else
     case_ShdPnd:
         P->signal = unhex(S);
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigBlk:
         P->blocked = unhex(S);
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigCgt:
         P->sigcatch = unhex(S);
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigIgn:
         P->sigignore = unhex(S);
+        FOUND(PROC_FIELD_SIGS);
         continue;
     case_SigPnd:
         P->_sigpnd = unhex(S);
+        FOUND(PROC_FIELD_SIGS);
         continue;
 #endif
     case_State:
         P->state = *S;
+        FOUND(PROC_FIELD_BASIC);
         continue;
     case_Tgid:
         Tgid = strtol(S,&S,10);
+        FOUND(PROC_FIELD_BASIC);
         continue;
     case_Pid:
         Pid = strtol(S,&S,10);
+        FOUND(PROC_FIELD_BASIC);
         continue;
     case_PPid:
         P->ppid = strtol(S,&S,10);
+        FOUND(PROC_FIELD_BASIC);
         continue;
     case_Threads:
         Threads = strtol(S,&S,10);
+        FOUND(PROC_FIELD_TIMES);
         continue;
     case_Uid:
         P->ruid = strtol(S,&S,10);
         P->euid = strtol(S,&S,10);
         P->suid = strtol(S,&S,10);
         P->fuid = strtol(S,&S,10);
+        FOUND(PROC_FIELD_BASIC);
         continue;
     case_Gid:
         P->rgid = strtol(S,&S,10);
         P->egid = strtol(S,&S,10);
         P->sgid = strtol(S,&S,10);
         P->fgid = strtol(S,&S,10);
+        FOUND(PROC_FIELD_BASIC);
         continue;
     case_VmData:
         P->vm_data = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_VmExe:
         P->vm_exe = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_VmLck:
         P->vm_lock = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_VmLib:
         P->vm_lib = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_VmRSS:
         P->vm_rss = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_VmSize:
         P->vm_size = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_VmStk:
         P->vm_stack = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_VmSwap: // Linux 2.6.34
         P->vm_swap = strtol(S,&S,10);
+        FOUND(PROC_FIELD_VM);
         continue;
     case_CapBnd:
     case_CapEff:
@@ -326,6 +393,8 @@ ENTER(0x220);
     case_VmPeak: // 2005, peak VmSize unless VmSize is bigger
         continue;
     }
+done:
+#undef FOUND
 
 #if 0
     // recent kernels supply per-tgid pending signals
@@ -336,16 +405,18 @@ ENTER(0x220);
 #endif
 
     // recent kernels supply per-tgid pending signals
+    if(want & PROC_FIELD_SIGS){
 #ifdef SIGNAL_STRING
-    if(!is_proc || !P->signal[0]){
-	memcpy(P->signal, P->_sigpnd, 16);
-	P->signal[16] = '\0';
-    }
+        if(!is_proc || !P->signal[0]){
+            memcpy(P->signal, P->_sigpnd, 16);
+            P->signal[16] = '\0';
+        }
 #else
-    if(!is_proc || !have_process_pending){
-	P->signal = P->_sigpnd;
-    }
+        if(!is_proc || !have_process_pending){
+            P->signal = P->_sigpnd;
+        }
 #endif
+    }
 
     // Linux 2.4.13-pre1 to max 2.4.xx have a useless "Tgid"
     // that is not initialized for built-in kernel tasks.
@@ -355,24 +426,74 @@ ENTER(0x220);
        P->nlwp = Threads;
        P->tgid = Tgid;     // the POSIX PID value
        P->tid  = Pid;      // the thread ID
+    }else if(Tgid && !(want & PROC_FIELD_TIMES)){
+       // quit before "Threads"; stat2proc() read it if it got to the VM
+       // fields, else there's no clue
+       if(!(want & (PROC_FIELD_VM|PROC_FIELD_SCHED))) P->nlwp = 0;
+       P->tgid = Tgid;
+       P->tid  = Pid;
     }else{
        P->nlwp = 1;
        P->tgid = Pid;
        P->tid  = Pid;
     }
 
+    COST_STOP(COST_PARSE, cm);
 LEAVE(0x220);
 }
 
 ///////////////////////////////////////////////////////////////////////
 
+// The kernel writes these files with plain "%d"/"%lu" style numbers, so
+// there's no need for sscanf with its locale and varargs overhead.  Each
+// call takes one space-separated decimal number (maybe negative); at the
+// end of the data it returns 0 leaving *S and *val alone, so missing
+// fields on older kernels keep their defaults just as they did with sscanf.
+static inline int next_num(const char **restrict S, unsigned long long *restrict val){
+    const char *restrict p = *S;
+    unsigned long long v = 0;
+    int neg = 0;
+
+    while(*p == ' ') p++;
+    if(*p == '-'){
+        neg = 1;
+        p++;
+    }
+    if(unlikely((unsigned)(*p - '0') > 9u)) return 0;
+    do v = v * 10 + (unsigned)(*p++ - '0');
+    while((unsigned)(*p - '0') <= 9u);
+    *S = p;
+    *val = neg ? -v : v;
+    return 1;
+}
+
+// skip a field we don't want, whatever it looks like
+static inline int skip_field(const char **restrict S){
+    const char *restrict p = *S;
+
+    while(*p == ' ') p++;
+    if(unlikely(!*p || *p == '\n')) return 0;
+    while(*p && *p != ' ' && *p != '\n') p++;
+    *S = p;
+    return 1;
+}
+
+#define NUM(dst) \
+    do{ if(unlikely(!next_num(&S, &v))) goto done; (dst) = v; }while(0)
+#define SKIP() \
+    do{ if(unlikely(!skip_field(&S))) goto done; }while(0)
+
 // Reads /proc/*/stat files, being careful not to trip over processes with
-// names like ":-) 1 2 3 4 5 6".
-static void stat2proc(const char* S, proc_t *restrict P) {
+// names like ":-) 1 2 3 4 5 6".  The fields come in a fixed order, so we
+// simply quit after the last group the caller wants.
+void stat2proc(const char* S, proc_t *restrict P, unsigned want) {
+    unsigned long long v;
     unsigned num;
     char* tmp;
+    cost_mark cm;
 
 ENTER(0x160);
+    COST_START(cm);
 
     /* fill in default values for older kernels */
     P->processor = 0;
@@ -388,106 +509,461 @@ ENTER(0x160);
     P->cmd[num] = '\0';
     S = tmp + 2;                 // skip ") "
 
-    num = sscanf(S,
-       "%c "
-       "%d %d %d %d %d "
-       "%lu %lu %lu %lu %lu "
-       "%Lu %Lu %Lu %Lu "  /* utime stime cutime cstime */
-       "%ld %ld "
-       "%d "
-       "%ld "
-       "%Lu "  /* start_time */
-       "%lu "
-       "%ld "
-       "%lu %"KLF"u %"KLF"u %"KLF"u %"KLF"u %"KLF"u "
-       "%*s %*s %*s %*s " /* discard, no RT signals & Linux 2.1 used hex */
-       "%"KLF"u %*lu %*lu "
-       "%d %d "
-       "%lu %lu",
-       &P->state,
-       &P->ppid, &P->pgrp, &P->session, &P->tty, &P->tpgid,
-       &P->flags, &P->min_flt, &P->cmin_flt, &P->maj_flt, &P->cmaj_flt,
-       &P->utime, &P->stime, &P->cutime, &P->cstime,
-       &P->priority, &P->nice,
-       &P->nlwp,
-       &P->alarm,
-       &P->start_time,
-       &P->vsize,
-       &P->rss,
-       &P->rss_rlim, &P->start_code, &P->end_code, &P->start_stack, &P->kstk_esp, &P->kstk_eip,
-/*     P->signal, P->blocked, P->sigignore, P->sigcatch,   */ /* can't use */
-       &P->wchan, /* &P->nswap, &P->cnswap, */  /* nswap and cnswap dead for 2.4.xx and up */
+    if(unlikely(!*S)) goto done;
+    P->state = *S++;
+    NUM(P->ppid); NUM(P->pgrp); NUM(P->session); NUM(P->tty); NUM(P->tpgid);
+    if(!(want & (PROC_FIELD_TIMES|PROC_FIELD_VM|PROC_FIELD_SCHED))) goto done;
+
+    NUM(P->flags); NUM(P->min_flt); NUM(P->cmin_flt); NUM(P->maj_flt); NUM(P->cmaj_flt);
+    NUM(P->utime); NUM(P->stime); NUM(P->cutime); NUM(P->cstime);
+    NUM(P->priority); NUM(P->nice);
+    NUM(P->nlwp);
+    NUM(P->alarm);
+    NUM(P->start_time);
+    if(!(want & (PROC_FIELD_VM|PROC_FIELD_SCHED))) goto done;
+
+    NUM(P->vsize);
+    NUM(P->rss);
+    NUM(P->rss_rlim); NUM(P->start_code); NUM(P->end_code); NUM(P->start_stack);
+    NUM(P->kstk_esp); NUM(P->kstk_eip);
+    SKIP(); SKIP(); SKIP(); SKIP(); /* discard, no RT signals & Linux 2.1 used hex */
+    if(!(want & PROC_FIELD_SCHED)) goto done;
+
+    NUM(P->wchan);
+    SKIP(); SKIP();  /* nswap and cnswap dead for 2.4.xx and up */
 /* -- Linux 2.0.35 ends here -- */
-       &P->exit_signal, &P->processor,  /* 2.2.1 ends with "exit_signal" */
+    NUM(P->exit_signal); NUM(P->processor);  /* 2.2.1 ends with "exit_signal" */
 /* -- Linux 2.2.8 to 2.5.17 end here -- */
-       &P->rtprio, &P->sched  /* both added to 2.5.18 */
-    );
+    NUM(P->rtprio); NUM(P->sched);  /* both added to 2.5.18 */
 
-    if(!P->nlwp){
+done:
+    if(!P->nlwp && (want & PROC_FIELD_TIMES)){
       P->nlwp = 1;
     }
 
+    COST_STOP(COST_PARSE, cm);
 LEAVE(0x160);
 }
 
 /////////////////////////////////////////////////////////////////////////
 
-static void statm2proc(const char* s, proc_t *restrict P) {
-    int num;
-    num = sscanf(s, "%ld %ld %ld %ld %ld %ld %ld",
-	   &P->size, &P->resident, &P->share,
-	   &P->trs, &P->lrs, &P->drs, &P->dt);
-/*    fprintf(stderr, "statm2proc converted %d fields.\n",num); */
+void statm2proc(const char* S, proc_t *restrict P) {
+    unsigned long long v;
+    cost_mark cm;
+
+    COST_START(cm);
+    NUM(P->size); NUM(P->resident); NUM(P->share);
+    NUM(P->trs); NUM(P->lrs); NUM(P->drs); NUM(P->dt);
+done:
+    COST_STOP(COST_PARSE, cm);
+}
+
+#undef NUM
+#undef SKIP
+
+// PSS and USS, from smaps_rollup where the kernel has it and otherwise by
+// adding up all of smaps.  Left at zero if neither can be read, as is the
+// case for other users' processes.
+static void smaps2proc(proc_t *restrict P) {
+    maps_t m;
+
+    P->pss = P->uss = P->swap_pss = P->anon_huge = P->hugetlb = 0;
+    memset(&m, 0, sizeof m);
+    if (read_maps(&m, P->tgid, MAPS_SMAPS|MAPS_ROLLUP) == 0 && (m.flags & MAPS_SMAPS)) {
+	P->pss      = m.total.pss;
+	P->uss      = m.total.private_clean + m.total.private_dirty;
+	P->swap_pss = m.total.swap_pss;
+	P->anon_huge = m.total.anon_huge;
+	P->hugetlb  = m.total.hugetlb;
+    }
+    free_maps(&m);
+}
+
+// PROC_FILLNUMA: the node of each cpu, from sysfs (-1 for a cpu in none)
+static int *cpu_node;
+static int  cpu_node_n;
+static pthread_once_t cpu_node_once = PTHREAD_ONCE_INIT;
+
+static void cpu_node_init(void) {
+    DIR *d = opendir("/sys/devices/system/node");
+    struct direct *ent;
+
+    if (!d) return;				/* not NUMA: remote stays 0 */
+    while ((ent = readdir(d))) {
+	char path[300], buf[1024], *S;
+	int node, fd, n;
+
+	if (strncmp(ent->d_name, "node", 4) || (unsigned)(ent->d_name[4] - '0') > 9u)
+	    continue;
+	node = atoi(ent->d_name + 4);
+	snprintf(path, sizeof path, "/sys/devices/system/node/%s/cpulist", ent->d_name);
+	if ((fd = open(path, O_RDONLY)) == -1) continue;
+	n = read(fd, buf, sizeof buf - 1);
+	close(fd);
+	if (n <= 0) continue;
+	buf[n] = '\0';
+	for (S = buf; (unsigned)(*S - '0') <= 9u; ) {	/* "0-3,8-11" */
+	    unsigned long lo = strtoul(S, &S, 10), hi = lo;
+	    if (*S == '-') hi = strtoul(S + 1, &S, 10);
+	    if (hi >= 65536) break;
+	    if ((int)hi >= cpu_node_n) {
+		int old = cpu_node_n;
+		cpu_node_n = hi + 1;
+		cpu_node = xrealloc(cpu_node, cpu_node_n * sizeof *cpu_node);
+		while (old < cpu_node_n) cpu_node[old++] = -1;
+	    }
+	    while (lo <= hi) cpu_node[lo++] = node;
+	    if (*S == ',') S++;
+	}
+    }
+    closedir(d);
+}
+
+// what isn't on the node of the cpu the task last ran on (0 if that's unknown)
+static void remote2proc(proc_t *restrict P) {
+    int here, i;
+
+    P->numa_remote = 0;
+    if (P->processor < 0 || P->processor >= cpu_node_n) return;
+    here = cpu_node[P->processor];
+    if (here < 0) return;
+    if (here >= PROC_NODES) here = PROC_NODES - 1;
+    for (i = 0; i < PROC_NODES; i++)
+	if (i != here) P->numa_remote += P->node_kb[i];
+}
+
+static void numa2proc(proc_t *restrict P) {
+    maps_t m;
+    int i;
+
+    pthread_once(&cpu_node_once, cpu_node_init);
+    memset(P->node_kb, 0, sizeof P->node_kb);
+    P->numa_node = -1;
+    memset(&m, 0, sizeof m);
+    if (read_maps(&m, P->tgid, MAPS_NUMA|MAPS_SUMONLY) == 0) {
+	unsigned long most = 0;
+	for (i = 0; i < PROC_NODES && i < MAPS_NODES; i++) {
+	    P->node_kb[i] = m.node_total[i];
+	    if (P->node_kb[i] > most) {
+		most = P->node_kb[i];
+		P->numa_node = i;
+	    }
+	}
+    }
+    free_maps(&m);
+    remote2proc(P);
+}
+
+// /proc/#/io: "name: value" lines, in this order since Linux 2.6.20
+static void io2proc(const char *S, proc_t *restrict P) {
+    static const struct { char name[24]; size_t off; } table[] = {
+	{ "rchar",                 offsetof(proc_t, rchar)                 },
+	{ "wchar",                 offsetof(proc_t, wchar)                 },
+	{ "syscr",                 offsetof(proc_t, syscr)                 },
+	{ "syscw",                 offsetof(proc_t, syscw)                 },
+	{ "read_bytes",            offsetof(proc_t, read_bytes)            },
+	{ "write_bytes",           offsetof(proc_t, write_bytes)           },
+	{ "cancelled_write_bytes", offsetof(proc_t, cancelled_write_bytes) },
+    };
+    unsigned i;
+
+    for(i = 0; i < sizeof table / sizeof table[0]; i++){
+	size_t len = strlen(table[i].name);
+	char *end;
+	if(unlikely(strncmp(S, table[i].name, len) || S[len] != ':')) break;
+	*(unsigned long long *)((char *)P + table[i].off) = strtoull(S+len+1, &end, 10);
+	S = strchr(end, '\n');
+	if(unlikely(!S)) break;
+	S++;
+    }
+}
+
+// /proc/#/cgroup: "hierarchy-ID:controllers:path" lines, "0::path" for v2
+static void cgroup2proc(const char *S, proc_t *restrict P) {
+    const char *v2 = NULL, *v1 = NULL;
+    unsigned v2len = 0, v1len = 0;
+
+    while(*S){
+	const char *path = strchr(S, ':');
+	const char *end;
+	unsigned len;
+	if(unlikely(!path) || unlikely(!(path = strchr(path+1, ':')))) break;
+	path++;
+	end = strchrnul(path, '\n');
+	len = end - path;
+	if(S[0] == '0' && S[1] == ':' && S[2] == ':'){
+	    v2 = path;
+	    v2len = len;
+	}else if(!v1 && !(len == 1 && *path == '/')){
+	    v1 = path;			/* first hierarchy not at its root */
+	    v1len = len;
+	}
+	if(!*end) break;
+	S = end + 1;
+    }
+    if(v2 && (v2len != 1 || !v1)) P->cgroup = cgroup_intern(v2, v2len);
+    else if(v1) P->cgroup = cgroup_intern(v1, v1len);
+    else P->cgroup = NULL;
 }
 
 static int file2str(const char *directory, const char *what, char *ret, int cap) {
-    static char filename[80];
+    char filename[80];
     int fd, num_read;
+    cost_mark cm;
 
+    COST_START(cm);
     sprintf(filename, "%s/%s", directory, what);
+    if (unlikely(replay_image) && strcmp(directory, "/proc/self")) {	/* we are live */
+	num_read = replay_copy(filename, ret, cap);
+	COST_IO(1, 1, num_read);
+	goto done;
+    }
+    num_read = -1;
     fd = open(filename, O_RDONLY, 0);
-    if(unlikely(fd==-1)) return -1;
+    if(unlikely(fd==-1)) goto out;
     num_read = read(fd, ret, cap - 1);
     close(fd);
-    if(unlikely(num_read<=0)) return -1;
+    if(unlikely(num_read<=0)) num_read = -1;
+    else ret[num_read] = '\0';
+out:
+    COST_IO(1, fd != -1, num_read);
+done:
+    COST_STOP(COST_READ, cm);
+    return num_read;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// PROC_CACHEFD support: keep /proc/#/stat, statm, status and io open from one scan
+// to the next, then pread() them. Entries live across PROCTABs (top opens a
+// new one every frame) and are keyed on tid, with tasks kept apart from the
+// processes since the thread group leader has both kinds of path.
+//
+// A process' entry also keeps the tids found in its task directory, which
+// is only read again once the thread count or start time in its stat no
+// longer match what they were then, or one of those tasks went missing.
+
+#define FDC_STAT   0
+#define FDC_STATM  1
+#define FDC_STATUS 2
+#define FDC_IO     3
+#define FDC_CGROUP 4
+#define FDC_NFILES 5
+
+typedef struct fdcache_t {
+    struct fdcache_t *next;
+    int      tid;
+    unsigned task:1;            // 1 if /proc/#/task/#, else 0
+    unsigned gen:31;            // scan in which this task was last seen
+    int      fd[FDC_NFILES];    // FDC_STAT, FDC_STATM, FDC_STATUS, FDC_IO, FDC_CGROUP (or -1)
+    int     *tids;              // processes: /proc/#/task as last read, or NULL
+    unsigned ntids, room;       // ntids 0 reads /proc/#/task again
+    unsigned long long start;   // the start_time tids was read for (~0 for none yet)
+} fdcache_t;
+
+static fdcache_t **fdc_hash;
+static unsigned    fdc_size;    // number of buckets, a power of 2
+static unsigned    fdc_count;   // number of entries
+static unsigned    fdc_gen;     // bumped by every openproc(PROC_CACHEFD), 31 bits
+static unsigned    fdc_nfds;    // number of fds held open
+static unsigned    fdc_maxfds;  // stay well away from RLIMIT_NOFILE
+static fdcache_t  *fdc_freelist;
+
+#define FDC_HASH(tid,task) ( ((unsigned)(tid)*2u + (unsigned)(task)) & (fdc_size-1) )
+
+static void fdc_grow(void){
+    unsigned old_size = fdc_size;
+    fdcache_t **old_hash = fdc_hash;
+    unsigned u;
+
+    if(!fdc_maxfds){
+        struct rlimit rl;
+        fdc_maxfds = 768;
+        if(!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur > 1024)
+            fdc_maxfds = rl.rlim_cur - 256;
+        if(fdc_maxfds > 3000000) fdc_maxfds = 3000000;
+    }
+    fdc_size = old_size ? old_size*2 : 1024;
+    fdc_hash = xcalloc(NULL, fdc_size * sizeof *fdc_hash);
+    for(u=0; u<old_size; u++){
+        fdcache_t *ent = old_hash[u];
+        while(ent){
+            fdcache_t *next = ent->next;
+            unsigned h = FDC_HASH(ent->tid, ent->task);
+            ent->next = fdc_hash[h];
+            fdc_hash[h] = ent;
+            ent = next;
+        }
+    }
+    free(old_hash);
+}
+
+// find (or make) the entry for a task, marking it as seen in this scan
+static fdcache_t *fdc_lookup(int tid, int task){
+    fdcache_t *ent;
+    unsigned h;
+
+    if(unlikely(fdc_count >= fdc_size)) fdc_grow();
+    h = FDC_HASH(tid, task);
+    for(ent = fdc_hash[h]; ent; ent = ent->next){
+        if(ent->tid == tid && ent->task == (unsigned)task) goto found;
+    }
+    if(fdc_freelist){
+        ent = fdc_freelist;
+        fdc_freelist = ent->next;
+    }else{
+        ent = xmalloc(sizeof *ent);
+    }
+    ent->tid = tid;
+    ent->task = task;
+    ent->fd[FDC_STAT] = ent->fd[FDC_STATM] = ent->fd[FDC_STATUS] = ent->fd[FDC_IO] = ent->fd[FDC_CGROUP] = -1;
+    ent->tids = NULL;
+    ent->ntids = ent->room = 0;
+    ent->start = ~0ull;
+    ent->next = fdc_hash[h];
+    fdc_hash[h] = ent;
+    fdc_count++;
+found:
+    ent->gen = fdc_gen;
+    return ent;
+}
+
+// drop every task that was not seen during the scan that just ended
+static void fdc_sweep(void){
+    unsigned u;
+    for(u=0; u<fdc_size; u++){
+        fdcache_t **pp = &fdc_hash[u];
+        while(*pp){
+            fdcache_t *ent = *pp;
+            int i;
+            if(ent->gen == fdc_gen){
+                pp = &ent->next;
+                continue;
+            }
+            for(i=0; i<FDC_NFILES; i++){
+                if(ent->fd[i] == -1) continue;
+                close(ent->fd[i]);
+                fdc_nfds--;
+            }
+            free(ent->tids);
+            *pp = ent->next;
+            ent->next = fdc_freelist;
+            fdc_freelist = ent;
+            fdc_count--;
+        }
+    }
+}
+
+// like file2str, but the file is kept open in *fdp for next time
+static int fd2str(int *restrict fdp, const char *directory, const char *what, char *ret, int cap) {
+    char filename[PROCPATHLEN+16];
+    int fd, num_read;
+    cost_mark cm;
+
+    if(unlikely(replay_image)){     // nothing to keep open
+        snprintf(filename, sizeof filename, "%s/%s", directory, what);
+        return replay_copy(filename, ret, cap);
+    }
+    if(likely(*fdp != -1)){
+        COST_START(cm);
+        num_read = pread(*fdp, ret, cap - 1, 0);
+        COST_IO(0, 1, num_read);
+        COST_STOP(COST_READ, cm);
+        if(likely(num_read > 0)){
+            ret[num_read] = '\0';
+            return num_read;
+        }
+        // the task died, maybe with the tid now reused; try opening again
+        close(*fdp);
+        *fdp = -1;
+        fdc_nfds--;
+    }
+    if(unlikely(fdc_nfds >= fdc_maxfds)) return file2str(directory, what, ret, cap);
+    snprintf(filename, sizeof filename, "%s/%s", directory, what);
+    COST_START(cm);
+    fd = open(filename, O_RDONLY|O_CLOEXEC, 0);
+    num_read = (fd != -1) ? read(fd, ret, cap - 1) : -1;
+    COST_IO(1, fd != -1, num_read);
+    COST_STOP(COST_READ, cm);
+    if(unlikely(num_read<=0)){
+        if(fd!=-1) close(fd);
+        return -1;
+    }
+    *fdp = fd;
+    fdc_nfds++;
     ret[num_read] = '\0';
     return num_read;
 }
 
-static char** file2strvec(const char* directory, const char* what) {
+static char** strvec(char *rbuf, int tot, arena_t *restrict const arena);
+
+// With an arena, the vector comes from there and must not be free()d.
+static char** file2strvec(const char* directory, const char* what, arena_t *restrict const arena) {
     char buf[2048];	/* read buf bytes at a time */
-    char *p, *rbuf = 0, *endbuf, **q, **ret;
-    int fd, tot = 0, n, c, end_of_file = 0;
-    int align;
+    char *rbuf = 0;
+    int fd, tot = 0, n, end_of_file = 0;
+    int reads = 0;
+    cost_mark cm;
 
     sprintf(buf, "%s/%s", directory, what);
+    if (unlikely(replay_image)) {
+	unsigned len;
+	const char *d = replay_data(buf, &len);
+	COST_IO(1, 1, d ? (long)len : 0);
+	if (!d || !len)
+	    return NULL;
+	tot = len + (d[len-1] != '\0');	/* with a null-terminator */
+	rbuf = arena ? arena_realloc(arena, NULL, 0, tot) : xmalloc(tot);
+	memcpy(rbuf, d, len);
+	rbuf[tot-1] = '\0';
+	return strvec(rbuf, tot, arena);
+    }
+    COST_START(cm);
     fd = open(buf, O_RDONLY, 0);
-    if(fd==-1) return NULL;
+    if(fd==-1){
+	COST_IO(1, 0, 0);
+	COST_STOP(COST_READ, cm);
+	return NULL;
+    }
 
     /* read whole file into a memory buffer, allocating as we go */
     while ((n = read(fd, buf, sizeof buf - 1)) > 0) {
+	reads++;
 	if (n < (int)(sizeof buf - 1))
 	    end_of_file = 1;
 	if (n == 0 && rbuf == 0)
 	    return NULL;	/* process died between our open and read */
 	if (n < 0) {
-	    if (rbuf)
+	    if (rbuf && !arena)
 		free(rbuf);
 	    return NULL;	/* read error */
 	}
 	if (end_of_file && buf[n-1])		/* last read char not null */
 	    buf[n++] = '\0';			/* so append null-terminator */
-	rbuf = xrealloc(rbuf, tot + n);		/* allocate more memory */
+	if (arena)				/* allocate more memory */
+	    rbuf = arena_realloc(arena, rbuf, tot, tot + n);
+	else
+	    rbuf = xrealloc(rbuf, tot + n);
 	memcpy(rbuf + tot, buf, n);		/* copy buffer into it */
 	tot += n;				/* increment total byte ctr */
 	if (end_of_file)
 	    break;
     }
     close(fd);
+    COST_IO(1, reads + (n <= 0), tot);
+    COST_STOP(COST_READ, cm);
     if (n <= 0 && !end_of_file) {
-	if (rbuf) free(rbuf);
+	if (rbuf && !arena) free(rbuf);
 	return NULL;		/* read error */
     }
+    return strvec(rbuf, tot, arena);
+}
+
+// rbuf's tot bytes, NUL-terminated strings, with the pointers to them put
+// after them (so free(*ret) frees all); from the arena if there is one
+static char** strvec(char *rbuf, int tot, arena_t *restrict const arena) {
+    char *p, *endbuf, **q, **ret;
+    int c, align;
+
     endbuf = rbuf + tot;			/* count space for pointers */
     align = (sizeof(char*)-1) - ((tot + sizeof(char*)-1) & (sizeof(char*)-1));
     for (c = 0, p = rbuf; p < endbuf; p++)
@@ -495,7 +971,10 @@ static char** file2strvec(const char* directory, const char* what) {
 	    c += sizeof(char*);
     c += sizeof(char*);				/* one extra for NULL term */
 
-    rbuf = xrealloc(rbuf, tot + c + align);	/* make room for ptrs AT END */
+    if (arena)					/* make room for ptrs AT END */
+	rbuf = arena_realloc(arena, rbuf, tot, tot + c + align);
+    else
+	rbuf = xrealloc(rbuf, tot + c + align);
     endbuf = rbuf + tot;			/* addr just past data buf */
     q = ret = (char**) (endbuf+align);		/* ==> free(*ret) to dealloc */
     *q++ = p = rbuf;				/* point ptrs to the strings */
@@ -508,17 +987,39 @@ static char** file2strvec(const char* directory, const char* what) {
     return ret;
 }
 
+// The same vector readproc() gives p->cmdline, for one task, malloc()ed:
+// free(v[0]) when done.  NULL if it's empty (a kernel thread, a zombie).
+char **read_cmdline_vec(unsigned pid){
+    char path[PROCPATHLEN];
+    snprintf(path, sizeof path, "/proc/%u", pid);
+    return file2strvec(path, "cmdline", NULL);
+}
+
 // warning: interface may change
 int read_cmdline(char *restrict const dst, unsigned sz, unsigned pid){
     char name[32];
-    int fd;
+    int fd, reads = 0;
     unsigned n = 0;
+    cost_mark cm;
     dst[0] = '\0';
     snprintf(name, sizeof name, "/proc/%u/cmdline", pid);
+    if(unlikely(replay_image)){
+        const char *d = replay_data(name, &n);
+        if(!d) return 0;
+        if(n > sz) n = sz;
+        memcpy(dst, d, n);
+        goto got;
+    }
+    COST_START(cm);
     fd = open(name, O_RDONLY);
-    if(fd==-1) return 0;
+    if(fd==-1){
+        COST_IO(1, 0, 0);
+        COST_STOP(COST_READ, cm);
+        return 0;
+    }
     for(;;){
         ssize_t r = read(fd,dst+n,sz-n);
+        reads++;
         if(r==-1){
             if(errno==EINTR) continue;
             break;
@@ -528,6 +1029,9 @@ int read_cmdline(char *restrict const dst, unsigned sz, unsigned pid){
         if(r==0) break;  // EOF
     }
     close(fd);
+    COST_IO(1, reads, n);
+    COST_STOP(COST_READ, cm);
+got:
     if(n){
         int i;
         if(n==sz) n--;
@@ -561,74 +1065,173 @@ int read_cmdline(char *restrict const dst, unsigned sz, unsigned pid){
 	    i < n && l[i] == x;			\
 	} )
 
+// A long PROC_UID list is sorted by openproc, into PT->vp, so it can be
+// searched in O(log n) rather than scanned for every process.
+#define UID_SORT_MIN 16
+
+static int uid_cmp(const void *a, const void *b) {
+    uid_t x = *(const uid_t *)a, y = *(const uid_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int uid_listed(const PROCTAB *restrict const PT, uid_t uid) {
+    if (PT->vp)
+	return bsearch(&uid, PT->vp, PT->nuid, sizeof(uid_t), uid_cmp) != NULL;
+    return XinLN(uid_t, uid, PT->uids, PT->nuid);
+}
+
+/* some number->text resolving which is time consuming and kind of insane */
+static void fill_names(proc_t *restrict const p, unsigned flags) {
+    if (flags & PROC_FILLUSR){
+	memcpy(p->euser,   user_from_uid(p->euid), sizeof p->euser);
+        if(flags & PROC_FILLSTATUS) {
+            memcpy(p->ruser,   user_from_uid(p->ruid), sizeof p->ruser);
+            memcpy(p->suser,   user_from_uid(p->suid), sizeof p->suser);
+            memcpy(p->fuser,   user_from_uid(p->fuid), sizeof p->fuser);
+        }
+    }
+    if (flags & PROC_FILLGRP){
+        memcpy(p->egroup, group_from_gid(p->egid), sizeof p->egroup);
+        if(flags & PROC_FILLSTATUS) {
+            memcpy(p->rgroup, group_from_gid(p->rgid), sizeof p->rgroup);
+            memcpy(p->sgroup, group_from_gid(p->sgid), sizeof p->sgroup);
+            memcpy(p->fgroup, group_from_gid(p->fgid), sizeof p->fgroup);
+        }
+    }
+}
+
+static inline int proc_stat(const char *restrict path, struct stat *restrict sb) {
+    if (unlikely(replay_image)) return replay_stat(path, sb);
+    return stat(path, sb);
+}
+
+static int simple_nexttid(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict const t, char *restrict const path);
+
+// PROC_FILLTSUM: each thread's stat, parsed into the one scratch proc_t and
+// summed up in p.  The walk has a PROCTAB of its own, so that whatever the
+// caller does with readtask() is left alone.  p's stat was read with times.
+static void tsum2proc(proc_t *restrict const p) {
+    char sbuf[1024];
+    char path[PROCPATHLEN];
+    PROCTAB tp;
+    proc_t t;
+    int nrun = 0, found = 0;
+    unsigned long long most = 0, start = 0;
+
+    p->nlwp_run = p->state == 'R';
+    p->thr_time = p->utime + p->stime;
+    p->thr_start = p->start_time;
+    if (p->nlwp == 1 || task_dir_missing)
+	return;
+
+    memset(&tp, 0, sizeof tp);
+    tp.taskdir_user = -1;
+    tp.taskfinder = unlikely(replay_image) ? replay_nexttid : simple_nexttid;
+    while (tp.taskfinder(&tp, p, &t, path)) {
+	if (unlikely( file2str(path, "stat", sbuf, sizeof sbuf) == -1 ))
+	    continue;				/* gone since the readdir() */
+	stat2proc(sbuf, &t, PROC_FIELD_TIMES);
+	if (t.state == 'R') nrun++;
+	if (!found++ || t.utime + t.stime > most) {
+	    most = t.utime + t.stime;
+	    start = t.start_time;
+	}
+    }
+    if (tp.taskdir) closedir(tp.taskdir);
+    if (!found) return;			/* keep what the process' stat said */
+    p->nlwp_run = nrun;
+    p->thr_time = most;
+    p->thr_start = start;
+}
+
+// read one of stat/statm/status/io into sbuf, through the fd cache if wanted
+#define READ_PROC_FILE(which, what) ( fdc                                   \
+    ? fd2str(&fdc->fd[which], path, what, sbuf, sizeof sbuf)                \
+    : file2str(path, what, sbuf, sizeof sbuf) )
+
 //////////////////////////////////////////////////////////////////////////////////
 // This reads process info from /proc in the traditional way, for one process.
 // The pid (tgid? tid?) is already in p, and a path to it in path, with some
 // room to spare.
 static proc_t* simple_readproc(PROCTAB *restrict const PT, proc_t *restrict const p) {
-    static struct stat sb;		// stat() buffer
-    static char sbuf[1024];	// buffer for stat,statm
+    struct stat sb;		// stat() buffer
+    char sbuf[4096];		// buffer for stat,statm,status (over 1k these days)
     char *restrict const path = PT->path;
     unsigned flags = PT->flags;
+    unsigned want = flags & PROC_FIELDS;	// openproc() made it non-zero
+    fdcache_t *fdc = NULL;
 
-    if (unlikely(stat(path, &sb) == -1))	/* no such dirent (anymore) */
+    if (unlikely(proc_stat(path, &sb) == -1))	/* no such dirent (anymore) */
 	goto next_proc;
 
-    if ((flags & PROC_UID) && !XinLN(uid_t, sb.st_uid, PT->uids, PT->nuid))
+    if ((flags & PROC_UID) && !uid_listed(PT, sb.st_uid))
 	goto next_proc;			/* not one of the requested uids */
 
     p->euid = sb.st_uid;			/* need a way to get real uid */
     p->egid = sb.st_gid;			/* need a way to get real gid */
 
+    if (flags & PROC_CACHEFD)
+	fdc = fdc_lookup(p->tid, 0);
+
     if (flags & PROC_FILLSTAT) {         /* read, parse /proc/#/stat */
-	if (unlikely( file2str(path, "stat", sbuf, sizeof sbuf) == -1 ))
+	if (unlikely( READ_PROC_FILE(FDC_STAT, "stat") == -1 ))
 	    goto next_proc;			/* error reading /proc/#/stat */
-	stat2proc(sbuf, p);				/* parse /proc/#/stat */
+	stat2proc(sbuf, p, want);			/* parse /proc/#/stat */
     }
 
+    if (PT->prefilter && !PT->prefilter(p))
+	goto next_proc;			/* the caller can already tell */
+
     if (unlikely(flags & PROC_FILLMEM)) {	/* read, parse /proc/#/statm */
-	if (likely( file2str(path, "statm", sbuf, sizeof sbuf) != -1 ))
+	if (likely( READ_PROC_FILE(FDC_STATM, "statm") != -1 ))
 	    statm2proc(sbuf, p);		/* ignore statm errors here */
     }						/* statm fields just zero */
 
+    if (unlikely(flags & PROC_FILLSMAPS))	/* read, sum /proc/#/smaps_rollup */
+	smaps2proc(p);
+
+    if (unlikely(flags & PROC_FILLNUMA))	/* read, sum /proc/#/numa_maps */
+	numa2proc(p);
+
     if (flags & PROC_FILLSTATUS) {         /* read, parse /proc/#/status */
-       if (likely( file2str(path, "status", sbuf, sizeof sbuf) != -1 )){
-           status2proc(sbuf, p, 1);
+       if (likely( READ_PROC_FILE(FDC_STATUS, "status") != -1 )){
+           status2proc(sbuf, p, 1, want);
        }
+       // a listed pid can be a thread, whose /proc/TID is hidden but works
+       if (unlikely(flags & PROC_PID) && unlikely(p->tgid != p->tid))
+           goto next_proc;
     }
 
-    // if multithreaded, some values are crap
-    if(p->nlwp > 1){
-      p->wchan = (KLONG)~0ull;
+    if (unlikely(flags & PROC_FILLIO)) {	/* read, parse /proc/#/io */
+	p->rchar = p->wchar = p->syscr = p->syscw = 0;
+	p->read_bytes = p->write_bytes = p->cancelled_write_bytes = 0;
+	if (likely( READ_PROC_FILE(FDC_IO, "io") != -1 ))
+	    io2proc(sbuf, p);		/* no permission: fields just zero */
     }
 
-    /* some number->text resolving which is time consuming and kind of insane */
-    if (flags & PROC_FILLUSR){
-	memcpy(p->euser,   user_from_uid(p->euid), sizeof p->euser);
-        if(flags & PROC_FILLSTATUS) {
-            memcpy(p->ruser,   user_from_uid(p->ruid), sizeof p->ruser);
-            memcpy(p->suser,   user_from_uid(p->suid), sizeof p->suser);
-            memcpy(p->fuser,   user_from_uid(p->fuid), sizeof p->fuser);
-        }
+    p->cgroup = NULL;
+    if (unlikely(flags & PROC_FILLCGROUP)) {	/* read, parse /proc/#/cgroup */
+	if (likely( READ_PROC_FILE(FDC_CGROUP, "cgroup") != -1 ))
+	    cgroup2proc(sbuf, p);
     }
 
-    /* some number->text resolving which is time consuming and kind of insane */
-    if (flags & PROC_FILLGRP){
-        memcpy(p->egroup, group_from_gid(p->egid), sizeof p->egroup);
-        if(flags & PROC_FILLSTATUS) {
-            memcpy(p->rgroup, group_from_gid(p->rgid), sizeof p->rgroup);
-            memcpy(p->sgroup, group_from_gid(p->sgid), sizeof p->sgroup);
-            memcpy(p->fgroup, group_from_gid(p->fgid), sizeof p->fgroup);
-        }
+    if (unlikely(flags & PROC_FILLTSUM))	/* read, sum /proc/#/task/#/stat */
+	tsum2proc(p);
+
+    // if multithreaded, some values are crap
+    if(p->nlwp > 1){
+      p->wchan = (KLONG)~0ull;
     }
 
+    fill_names(p, flags);
+
     if ((flags & PROC_FILLCOM) || (flags & PROC_FILLARG))	/* read+parse /proc/#/cmdline */
-	p->cmdline = file2strvec(path, "cmdline");
+	p->cmdline = file2strvec(path, "cmdline", PT->arena);
     else
         p->cmdline = NULL;
 
     if (unlikely(flags & PROC_FILLENV))			/* read+parse /proc/#/environ */
-	p->environ = file2strvec(path, "environ");
+	p->environ = file2strvec(path, "environ", PT->arena);
     else
         p->environ = NULL;
     
@@ -637,31 +1240,82 @@ next_proc:
     return NULL;
 }
 
+//////////////////////////////////////////////////////////////////////////////////
+// PROC_SHARED: processes from the collector's snapshot, with no /proc at all.
+// Threads still come from /proc/#/task.
+
+// what a PROC_SHARED openproc() can ask for and still read a snapshot, if
+// share_get() finds one with those fills
+#define SHARE_OK (PROC_SHARED | PROC_FILLSTAT | PROC_FILLSTATUS | PROC_FILLMEM \
+    | PROC_FILLCOM | PROC_FILLARG | PROC_FILLUSR | PROC_FILLGRP | PROC_FILLWCHAN \
+    | PROC_LOOSE_TASKS | PROC_CACHEFD | PROC_PARALLEL | PROC_UID | PROC_FIELDS)
+
+// the snapshot's processes, in its order; PT->u is the next one
+static int share_nextpid(PROCTAB *restrict const PT, proc_t *restrict const p) {
+    if (PT->u >= share_procs(PT->share)) return 0;
+    share_fill(PT->share, PT->u++, p);
+    snprintf(PT->path, PROCPATHLEN, "/proc/%d", p->tgid);
+    return 1;
+}
+
+static proc_t* share_readproc(PROCTAB *restrict const PT, proc_t *restrict const p) {
+    unsigned flags = PT->flags;
+    const char *args;
+    unsigned len;
+
+    // by euid, where /proc would go by the owner of /proc/# (the same,
+    // but for a process that isn't dumpable)
+    if ((flags & PROC_UID) && !uid_listed(PT, p->euid))
+	return NULL;
+    if (PT->prefilter && !PT->prefilter(p))
+	return NULL;
+    p->cgroup = NULL;
+    p->environ = NULL;
+    fill_names(p, flags);
+    p->cmdline = NULL;
+    if ((flags & PROC_FILLCOM) || (flags & PROC_FILLARG)) {
+	if ((args = share_args(PT->share, PT->u - 1, &len))) {
+	    char *rbuf = PT->arena ? arena_realloc(PT->arena, NULL, 0, len) : xmalloc(len);
+	    memcpy(rbuf, args, len);
+	    p->cmdline = strvec(rbuf, len, PT->arena);
+	}
+    }
+    return p;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // This reads /proc/*/task/* data, for one task.
 // p is the POSIX process (task group summary) (not needed by THIS implementation)
 // t is the POSIX thread (task group member, generally not the leader)
 // path is a path to the task, with some room to spare.
 static proc_t* simple_readtask(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict const t, char *restrict const path) {
-    static struct stat sb;		// stat() buffer
-    static char sbuf[1024];	// buffer for stat,statm
+    struct stat sb;		// stat() buffer
+    char sbuf[4096];		// buffer for stat,statm,status (over 1k these days)
     unsigned flags = PT->flags;
+    unsigned want = flags & PROC_FIELDS;	// openproc() made it non-zero
+    fdcache_t *fdc = NULL;
+
+    // status has the thread's own uids, and a task that is gone fails its
+    // read as a stat() of the directory would; short of status, a thread
+    // may have called setresuid() for itself, so it has to be the stat().
+    if (flags & PROC_FILLSTATUS) {
+	t->euid = p->euid;		/* until status2proc() says */
+	t->egid = p->egid;
+    } else {
+	if (unlikely(proc_stat(path, &sb) == -1))	/* no such dirent (anymore) */
+	    goto next_task;
+	t->euid = sb.st_uid;			/* need a way to get real uid */
+	t->egid = sb.st_gid;			/* need a way to get real gid */
+    }
 
-//printf("hhh\n");
-    if (unlikely(stat(path, &sb) == -1))	/* no such dirent (anymore) */
-	goto next_task;
-
-//    if ((flags & PROC_UID) && !XinLN(uid_t, sb.st_uid, PT->uids, PT->nuid))
-//	goto next_task;			/* not one of the requested uids */
-
-    t->euid = sb.st_uid;			/* need a way to get real uid */
-    t->egid = sb.st_gid;			/* need a way to get real gid */
+    if (flags & PROC_CACHEFD)
+	fdc = fdc_lookup(t->tid, 1);
 
 //printf("iii\n");
     if (flags & PROC_FILLSTAT) {         /* read, parse /proc/#/stat */
-	if (unlikely( file2str(path, "stat", sbuf, sizeof sbuf) == -1 ))
+	if (unlikely( READ_PROC_FILE(FDC_STAT, "stat") == -1 ))
 	    goto next_task;			/* error reading /proc/#/stat */
-	stat2proc(sbuf, t);				/* parse /proc/#/stat */
+	stat2proc(sbuf, t, want);			/* parse /proc/#/stat */
     }
 
     if (unlikely(flags & PROC_FILLMEM)) {	/* read, parse /proc/#/statm */
@@ -679,40 +1333,50 @@ static proc_t* simple_readtask(PROCTAB *restrict const PT, const proc_t *restric
 #endif
     }						/* statm fields just zero */
 
+    if (unlikely(flags & PROC_FILLSMAPS)) {	/* threads share the process' mm */
+	t->pss      = p->pss;
+	t->uss      = p->uss;
+	t->swap_pss = p->swap_pss;
+	t->anon_huge = p->anon_huge;
+	t->hugetlb  = p->hugetlb;
+    }
+
+    if (unlikely(flags & PROC_FILLNUMA)) {	/* the same mm, but its own cpu */
+	memcpy(t->node_kb, p->node_kb, sizeof t->node_kb);
+	t->numa_node = p->numa_node;
+	remote2proc(t);
+    }
+
     if (flags & PROC_FILLSTATUS) {         /* read, parse /proc/#/status */
-       if (likely( file2str(path, "status", sbuf, sizeof sbuf) != -1 )){
-           status2proc(sbuf, t, 0);
-       }
+       if (likely( READ_PROC_FILE(FDC_STATUS, "status") != -1 )){
+           status2proc(sbuf, t, 0, want);
+       } else if (errno == ENOENT)
+	   goto next_task;			/* the task is gone */
     }
 
-    /* some number->text resolving which is time consuming */
-    if (flags & PROC_FILLUSR){
-	memcpy(t->euser,   user_from_uid(t->euid), sizeof t->euser);
-        if(flags & PROC_FILLSTATUS) {
-            memcpy(t->ruser,   user_from_uid(t->ruid), sizeof t->ruser);
-            memcpy(t->suser,   user_from_uid(t->suid), sizeof t->suser);
-            memcpy(t->fuser,   user_from_uid(t->fuid), sizeof t->fuser);
-        }
+    if (unlikely(flags & PROC_FILLIO)) {	/* read, parse /proc/#/io */
+	t->rchar = t->wchar = t->syscr = t->syscw = 0;
+	t->read_bytes = t->write_bytes = t->cancelled_write_bytes = 0;
+	if (likely( READ_PROC_FILE(FDC_IO, "io") != -1 ))
+	    io2proc(sbuf, t);		/* no permission: fields just zero */
     }
 
-    /* some number->text resolving which is time consuming */
-    if (flags & PROC_FILLGRP){
-        memcpy(t->egroup, group_from_gid(t->egid), sizeof t->egroup);
-        if(flags & PROC_FILLSTATUS) {
-            memcpy(t->rgroup, group_from_gid(t->rgid), sizeof t->rgroup);
-            memcpy(t->sgroup, group_from_gid(t->sgid), sizeof t->sgroup);
-            memcpy(t->fgroup, group_from_gid(t->fgid), sizeof t->fgroup);
-        }
+    t->cgroup = NULL;
+    if (unlikely(flags & PROC_FILLCGROUP)) {	/* threaded cgroups: per task */
+	if (likely( READ_PROC_FILE(FDC_CGROUP, "cgroup") != -1 ))
+	    cgroup2proc(sbuf, t);
     }
 
+    fill_names(t, flags);
+
 #if 0
     if ((flags & PROC_FILLCOM) || (flags & PROC_FILLARG))	/* read+parse /proc/#/cmdline */
-	t->cmdline = file2strvec(path, "cmdline");
+	t->cmdline = file2strvec(path, "cmdline", PT->arena);
     else
         t->cmdline = NULL;
 
     if (unlikely(flags & PROC_FILLENV))			/* read+parse /proc/#/environ */
-	t->environ = file2strvec(path, "environ");
+	t->environ = file2strvec(path, "environ", PT->arena);
     else
         t->environ = NULL;
 #else
@@ -724,9 +1388,98 @@ static proc_t* simple_readtask(PROCTAB *restrict const PT, const proc_t *restric
 
     return t;
 next_task:
+    if ((flags & PROC_CACHEFD) && errno == ENOENT)
+	fdc_lookup(p->tgid, 0)->ntids = 0;	/* gone: read /proc/#/task next time */
     return NULL;
 }
 
+//////////////////////////////////////////////////////////////////////////////////
+// PROC_FILLDELAY: openproc() puts these in the reader and taskreader slots.
+// They add the delay totals to what the simple readers get.
+static void delay2proc(const char *restrict const path, proc_t *restrict const p, int group) {
+    char sbuf[128];
+
+    if (taskstats_fill(group ? p->tgid : p->tid, group, p) == 0)
+	return;
+    // schedstat: on-cpu ns, waiting ns, timeslices
+    p->cpu_delay = p->blkio_delay = p->swapin_delay = 0;
+    if (file2str(path, "schedstat", sbuf, sizeof sbuf) != -1) {
+	char *S = sbuf;
+	strtoull(S, &S, 10);
+	p->cpu_delay = strtoull(S, NULL, 10);
+    }
+}
+
+static proc_t* delay_readproc(PROCTAB *restrict const PT, proc_t *restrict const p) {
+    if (!simple_readproc(PT, p))
+	return NULL;
+    delay2proc(PT->path, p, 1);
+    return p;
+}
+
+static proc_t* delay_readtask(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict const t, char *restrict const path) {
+    if (!simple_readtask(PT, p, t, path))
+	return NULL;
+    delay2proc(path, t, 0);
+    return t;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// The rest of a task, for a caller that read only what it needed to choose and
+// sort, and wants more about just the few it will show.  Only the statm,
+// smaps, status, io and cgroup reads, and the names, are done here.
+proc_t* fillproc(proc_t *restrict const p, int flags, int task) {
+    char path[PROCPATHLEN];
+    char sbuf[4096];		// buffer for statm,status,io,cgroup
+    fdcache_t *fdc = NULL;
+    proc_t *ret = p;
+
+    if (task)
+	snprintf(path, sizeof path, "/proc/%d/task/%d", p->tgid, p->tid);
+    else
+	snprintf(path, sizeof path, "/proc/%d", p->tgid);
+
+    // still in there from the scan that found p, unless that was long ago
+    if (flags & PROC_CACHEFD)
+	fdc = fdc_lookup(p->tid, task);
+
+    if (flags & PROC_FILLMEM) {
+	p->size = p->resident = p->share = p->trs = p->lrs = p->drs = p->dt = 0;
+	if (likely( READ_PROC_FILE(FDC_STATM, "statm") != -1 ))
+	    statm2proc(sbuf, p);
+    }
+
+    if (flags & PROC_FILLSMAPS)
+	smaps2proc(p);
+
+    if (flags & PROC_FILLNUMA)
+	numa2proc(p);
+
+    if (flags & PROC_FILLSTATUS) {
+	if (likely( READ_PROC_FILE(FDC_STATUS, "status") != -1 ))
+	    status2proc(sbuf, p, !task, PROC_FIELDS);
+	else
+	    ret = NULL;			// gone since the scan
+    }
+
+    if (flags & PROC_FILLIO) {
+	p->rchar = p->wchar = p->syscr = p->syscw = 0;
+	p->read_bytes = p->write_bytes = p->cancelled_write_bytes = 0;
+	if (likely( READ_PROC_FILE(FDC_IO, "io") != -1 ))
+	    io2proc(sbuf, p);
+    }
+
+    if (flags & PROC_FILLCGROUP) {
+	p->cgroup = NULL;
+	if (likely( READ_PROC_FILE(FDC_CGROUP, "cgroup") != -1 ))
+	    cgroup2proc(sbuf, p);
+    }
+
+    // the real, saved and fs names too: whatever ids p has
+    fill_names(p, (unsigned)flags | PROC_FILLSTATUS);
+    return ret;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // This finds processes in /proc in the traditional way.
 // Return non-zero on success.
@@ -749,7 +1502,7 @@ static int simple_nextpid(PROCTAB *restrict const PT, proc_t *restrict const p)
 // This finds tasks in /proc/*/task/ in the traditional way.
 // Return non-zero on success.
 static int simple_nexttid(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict const t, char *restrict const path) {
-  static struct direct *ent;		/* dirent handle */
+  struct direct *ent;		/* dirent handle */
   if(PT->taskdir_user != p->tgid){
     if(PT->taskdir){
       closedir(PT->taskdir);
@@ -772,6 +1525,44 @@ static int simple_nexttid(PROCTAB *restrict const PT, const proc_t *restrict con
   return 1;
 }
 
+//////////////////////////////////////////////////////////////////////////////////
+// With PROC_CACHEFD: tasks from the list kept with the process' fd cache
+// entry, read again from /proc/#/task only when it looks out of date.  PT->i
+// walks the list, up to PT->u: simple_readtask() empties it, for the next
+// scan, when a task turns out to be gone.  Return non-zero on success.
+static int cached_nexttid(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict const t, char *restrict const path) {
+  fdcache_t *fdc = fdc_lookup(p->tgid, 0);
+  if(PT->taskdir_user != p->tgid){
+    if(fdc->start != p->start_time || fdc->ntids != (unsigned)p->nlwp){
+      struct direct *ent;
+      DIR *d;
+      snprintf(path, PROCPATHLEN, "/proc/%d/task", p->tgid);
+      d = opendir(path);
+      if(!d) return 0;
+      fdc->ntids = 0;
+      while((ent = readdir(d))){
+        if(unlikely(*ent->d_name <= '0') || unlikely(*ent->d_name > '9')) continue;
+        if(fdc->ntids == fdc->room){
+          fdc->room = fdc->room ? fdc->room*2 : 8;
+          fdc->tids = xrealloc(fdc->tids, fdc->room * sizeof *fdc->tids);
+        }
+        fdc->tids[fdc->ntids++] = strtoul(ent->d_name, NULL, 10);
+      }
+      closedir(d);
+      fdc->start = p->start_time;
+    }
+    PT->taskdir_user = p->tgid;
+    PT->i = 0;
+    PT->u = fdc->ntids;
+  }
+  if((unsigned)PT->i >= PT->u) return 0;
+  t->tid = fdc->tids[PT->i++];
+  t->tgid = p->tgid;
+  t->ppid = p->ppid;
+  snprintf(path, PROCPATHLEN, "/proc/%d/task/%d", p->tgid, t->tid);
+  return 1;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // This "finds" processes in a list that was given to openproc().
 // Return non-zero on success. (tgid was handy)
@@ -832,7 +1623,7 @@ out:
 // pointer (boolean false).  Use the passed buffer instead of allocating
 // space if it is non-NULL.
 proc_t* readtask(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict t) {
-  static char path[PROCPATHLEN];       // must hold /proc/2000222000/task/2000222000/cmdline
+  char path[PROCPATHLEN];       // must hold /proc/2000222000/task/2000222000/cmdline
   proc_t *ret;
   proc_t *saved_t;
 
@@ -841,7 +1632,8 @@ proc_t* readtask(PROCTAB *restrict const PT, const proc_t *restrict const p, pro
 
   // 1. got to fake a thread for old kernels
   // 2. for single-threaded processes, this is faster (but must patch up stuff that differs!)
-  if(task_dir_missing || p->nlwp < 2){
+  //    (nlwp is 0 if PROC_FIELD_TIMES was left out, so then we look)
+  if(task_dir_missing || (p->nlwp && p->nlwp < 2)){
     if(PT->did_fake) goto out;
     PT->did_fake=1;
     memcpy(t,p,sizeof(proc_t));
@@ -883,19 +1675,50 @@ PROCTAB* openproc(int flags, ...) {
     }
     PT->taskdir = NULL;
     PT->taskdir_user = -1;
+    PT->arena = NULL;
+    PT->prefilter = NULL;
     PT->taskfinder = simple_nexttid;
     PT->taskreader = simple_readtask;
+    PT->share = NULL;
 
     PT->reader = simple_readproc;
+    if (flags & PROC_FILLDELAY) {	// not thread-safe, so no PROC_PARALLEL
+	PT->reader = delay_readproc;
+	PT->taskreader = delay_readtask;
+    }
     if (flags & PROC_PID){
       PT->procfs = NULL;
       PT->finder = listed_nextpid;
+    }else if (unlikely(replay_image)){
+      PT->procfs = NULL;
+      PT->finder = replay_nextpid;
+      PT->u = 0;
+    }else if ((flags & PROC_SHARED) && !(flags & ~SHARE_OK) && (PT->share = share_get(flags))){
+      PT->procfs = NULL;
+      PT->finder = share_nextpid;
+      PT->reader = share_readproc;
+      PT->u = 0;
+      // the snapshot is already in memory
+      flags &= ~(PROC_CACHEFD | PROC_PARALLEL);
     }else{
       PT->procfs = opendir("/proc");
       if(!PT->procfs) return NULL;
       PT->finder = simple_nextpid;
     }
+    if (unlikely(replay_image)){
+      // nothing to keep open, no pids to list for threads, no netlink
+      flags &= ~(PROC_CACHEFD | PROC_PARALLEL | PROC_FILLDELAY);
+      PT->reader = simple_readproc;
+      PT->taskfinder = replay_nexttid;
+      PT->taskreader = simple_readtask;
+    }
+    if (flags & PROC_CACHEFD) PT->taskfinder = cached_nexttid;
     PT->flags = flags;
+    if (!(flags & PROC_FIELDS)) PT->flags |= PROC_FIELDS;  // all of stat+status
+    if (flags & PROC_FILLTSUM) PT->flags |= PROC_FILLSTAT | PROC_FIELD_TIMES;
+    if (flags & PROC_FILLNUMA) PT->flags |= PROC_FILLSTAT | PROC_FIELD_SCHED;
+    if (flags & PROC_CACHEFD) PT->flags |= PROC_FIELD_TIMES;  // cached_nexttid() checks start_time
+    if (flags & PROC_CACHEFD) fdc_gen = (fdc_gen + 1) & 0x7fffffff;
 
     va_start(ap, flags);		/*  Init args list */
     if (flags & PROC_PID)
@@ -903,6 +1726,12 @@ PROCTAB* openproc(int flags, ...) {
     else if (flags & PROC_UID) {
     	PT->uids = va_arg(ap, uid_t*);
 	PT->nuid = va_arg(ap, int);
+	PT->vp = NULL;
+	if (PT->nuid >= UID_SORT_MIN) {
+	    PT->vp = xmalloc(PT->nuid * sizeof(uid_t));
+	    memcpy(PT->vp, PT->uids, PT->nuid * sizeof(uid_t));
+	    qsort(PT->vp, PT->nuid, sizeof(uid_t), uid_cmp);
+	}
     }
     va_end(ap);				/*  Clean up args list */
 
@@ -912,8 +1741,11 @@ PROCTAB* openproc(int flags, ...) {
 // terminate a process table scan
 void closeproc(PROCTAB* PT) {
     if (PT){
+        if (PT->flags & PROC_CACHEFD) fdc_sweep();
+        if (PT->flags & PROC_UID) free(PT->vp);
         if (PT->procfs) closedir(PT->procfs);
         if (PT->taskdir) closedir(PT->taskdir);
+        if (PT->share) share_put(PT->share);
         memset(PT,'#',sizeof(PROCTAB));
         free(PT);
     }
@@ -941,7 +1773,7 @@ void look_up_our_self(proc_t *p) {
         fprintf(stderr, "Error, do this: mount -t proc none /proc\n");
         _exit(47);
     }
-    stat2proc(sbuf, p);    // parse /proc/self/stat
+    stat2proc(sbuf, p, PROC_FIELDS);    // parse /proc/self/stat
 }
 
 HIDDEN_ALIAS(readproc);
@@ -955,7 +1787,7 @@ HIDDEN_ALIAS(readtask);
 proc_t** readproctab(int flags, ...) {
     PROCTAB* PT = NULL;
     proc_t** tab = NULL;
-    int n = 0;
+    int n = 0, room = 0;
     va_list ap;
 
     va_start(ap, flags);		/* pass through args to openproc */
@@ -976,14 +1808,184 @@ proc_t** readproctab(int flags, ...) {
 	PT = openproc(flags);
     va_end(ap);
     do {					/* read table: */
-	tab = xrealloc(tab, (n+1)*sizeof(proc_t*));/* realloc as we go, using */
+	if (n == room) {			/* double as we go, using */
+	    room = room ? room*2 : 256;
+	    tab = xrealloc(tab, room*sizeof(proc_t*));
+	}
 	tab[n] = readproc_direct(PT, NULL);     /* final null to terminate */
     } while (tab[n++]);				  /* stop when NULL reached */
     closeproc(PT);
     return tab;
 }
 
-// Try again, this time with threads and selection.
+//////////////////////////////////////////////////////////////////////////////////
+// PROC_PARALLEL support for readproctab2: the calling thread lists the pids,
+// then a few threads claim them one at a time and read them into their own
+// arrays. Merging goes by pid list order, so the result matches a serial scan.
+// Name lookups (pwcache isn't thread-safe), the fd cache and the want_proc()
+// and want_task() callbacks all stay on the calling thread.
+
+#define SCAN_MAX_THREADS 16
+#define SCAN_MIN_PIDS    256      // not worth starting threads for less
+
+typedef struct scan_job {
+    pid_t    *pids;
+    unsigned  npids;
+    unsigned  next;               // next pid to claim, __sync_fetch_and_add
+    unsigned *first;              // per pid: index of its proc_t in its worker's data
+    unsigned *count;              // per pid: the process plus its tasks (0 if gone)
+    unsigned char *owner;         // per pid: which worker read it
+} scan_job;
+
+typedef struct scan_worker {
+    PROCTAB   pt;                 // private path, taskdir and flags
+    scan_job *job;
+    proc_t   *data;               // each process followed by its tasks
+    unsigned  n_alloc;
+    unsigned  n_used;
+    int       id;
+    pthread_t thread;
+} scan_worker;
+
+static void *scan_worker_main(void *vp) {
+    scan_worker *restrict const w = vp;
+    scan_job *restrict const job = w->job;
+    int loose = w->pt.flags & PROC_LOOSE_TASKS;
+
+    for(;;){
+        unsigned i = __sync_fetch_and_add(&job->next, 1);
+        unsigned first;
+        proc_t *p;
+        if(i >= job->npids) break;
+        job->count[i] = 0;
+        if(w->n_alloc == w->n_used){
+            w->n_alloc = w->n_alloc*5/4+30;  // grow by over 25%
+            w->data = xrealloc(w->data, sizeof(proc_t)*w->n_alloc);
+        }
+        first = w->n_used;
+        p = w->data + first;
+        p->tgid = p->tid = job->pids[i];
+        snprintf(w->pt.path, PROCPATHLEN, "/proc/%d", p->tgid);
+        if(!w->pt.reader(&w->pt, p)) continue;
+        w->n_used++;
+        job->first[i] = first;
+        job->count[i] = 1;
+        job->owner[i] = w->id;
+        if(!loose) continue;
+        w->pt.did_fake = 0;
+        for(;;){
+            if(w->n_alloc == w->n_used){
+                w->n_alloc = w->n_alloc*5/4+30;  // grow by over 25%
+                w->data = xrealloc(w->data, sizeof(proc_t)*w->n_alloc);
+            }
+            if(!readtask_direct(&w->pt, w->data+first, w->data+w->n_used)) break;
+            w->n_used++;
+            job->count[i]++;
+        }
+    }
+    return NULL;
+}
+
+// Returns 0 if it didn't do anything, leaving the scan to the caller.
+static int parallel_scan(int(*want_proc)(proc_t *buf), int(*want_task)(proc_t *buf), PROCTAB *restrict const PT,
+                         arena_t *restrict const arena, proc_t ***ptab_p, unsigned *n_proc_p, proc_t ***ttab_p, unsigned *n_task_p) {
+    scan_worker W[SCAN_MAX_THREADS];
+    scan_job job;
+    unsigned n_alloc = 0;
+    unsigned long n_used = 0;
+    unsigned total = 0;
+    unsigned n_proc = 0, n_task = 0;
+    proc_t **ptab, **ttab;
+    proc_t *data;
+    unsigned i;
+    int nw, k;
+    unsigned keep = PROC_FILLUSR | PROC_FILLGRP;  // done here, not by workers
+
+    if(PT->reader != simple_readproc || PT->taskreader != simple_readtask) return 0;
+    nw = smp_num_cpus;
+    if(nw > SCAN_MAX_THREADS) nw = SCAN_MAX_THREADS;
+    if(nw < 2) return 0;
+
+    memset(&job, 0, sizeof job);
+    for(;;){
+        proc_t tmp;
+        if(n_alloc == job.npids){
+            n_alloc = n_alloc*5/4+1024;  // grow by over 25%
+            job.pids = xrealloc(job.pids, sizeof(pid_t)*n_alloc);
+        }
+        if(!PT->finder(PT, &tmp)) break;
+        job.pids[job.npids++] = tmp.tgid;
+    }
+    // too small to bother with threads; worker 0 is the calling thread
+    if(job.npids < (PT->flags & PROC_LOOSE_TASKS ? SCAN_MIN_PIDS/8 : SCAN_MIN_PIDS)) nw = 1;
+    if((unsigned)nw > job.npids) nw = job.npids ? job.npids : 1;
+    job.first = xmalloc(sizeof(unsigned)*job.npids);
+    job.count = xmalloc(sizeof(unsigned)*job.npids);
+    job.owner = xmalloc(job.npids);
+
+    for(k=0; k<nw; k++){
+        W[k].pt = *PT;
+        W[k].pt.procfs = NULL;
+        W[k].pt.taskdir = NULL;
+        W[k].pt.taskdir_user = -1;
+        W[k].pt.flags &= ~(keep | PROC_CACHEFD);
+        W[k].pt.taskfinder = simple_nexttid;  // cached_nexttid's lists aren't locked
+        W[k].pt.arena = NULL;         // not thread-safe, so these use malloc
+        W[k].job = &job;
+        W[k].data = NULL;
+        W[k].n_alloc = W[k].n_used = 0;
+        W[k].id = k;
+    }
+    // the calling thread is worker 0; if a thread can't start, the rest still cope
+    for(k=1; k<nw; k++){
+        if(pthread_create(&W[k].thread, NULL, scan_worker_main, &W[k])) break;
+    }
+    nw = k;
+    scan_worker_main(&W[0]);
+    for(k=1; k<nw; k++) pthread_join(W[k].thread, NULL);
+
+    for(k=0; k<nw; k++){
+        total += W[k].n_used;
+        if(W[k].pt.taskdir) closedir(W[k].pt.taskdir);
+    }
+    data = arena_alloc(arena, sizeof(proc_t)*(total+1));
+    ptab = xmalloc(sizeof(proc_t*)*(job.npids+1));
+    ttab = xmalloc(sizeof(proc_t*)*(total+1));
+
+    for(i=0; i<job.npids; i++){
+        const proc_t *src;
+        unsigned c;
+        if(!job.count[i]) continue;
+        src = W[job.owner[i]].data + job.first[i];
+        data[n_used] = *src;
+        fill_names(data+n_used, PT->flags);
+        if(!want_proc(data+n_used)) continue;
+        ptab[n_proc++] = data + n_used++;
+        for(c=1; c<job.count[i]; c++){
+            data[n_used] = src[c];
+            fill_names(data+n_used, PT->flags);
+            if(!want_task(data+n_used)) continue;
+            ttab[n_task++] = data + n_used++;
+        }
+    }
+
+    for(k=0; k<nw; k++) free(W[k].data);
+    free(job.pids);
+    free(job.first);
+    free(job.count);
+    free(job.owner);
+
+    *ptab_p = ptab;
+    *n_proc_p = n_proc;
+    *ttab_p = ttab;
+    *n_task_p = n_task;
+    return 1;
+}
+
+// Try again, this time with threads and selection.  The proc_t's come
+// from PT->arena if the caller set one, so that the arena (cmdline and
+// environ too) lets go of the whole table at once; else from an arena of
+// their own, which lives as long as the program does.
 proc_data_t *readproctab2(int(*want_proc)(proc_t *buf), int(*want_task)(proc_t *buf), PROCTAB *restrict const PT) {
     proc_t** ptab = NULL;
     unsigned n_proc_alloc = 0;
@@ -993,55 +1995,45 @@ proc_data_t *readproctab2(int(*want_proc)(proc_t *buf), int(*want_task)(proc_t *
     unsigned n_task_alloc = 0;
     unsigned n_task = 0;
 
-    proc_t*  data = NULL;
-    unsigned n_alloc = 0;
-    unsigned long n_used = 0;
-
+    arena_t *arena = PT->arena ? PT->arena : arena_new();
+    proc_t *buf = NULL;      // the next one to read into, not kept yet
     proc_data_t *pd;
 
+    if(PT->flags & PROC_PARALLEL){
+        if(parallel_scan(want_proc, want_task, PT, arena, &ptab, &n_proc, &ttab, &n_task))
+            goto done;
+    }
+
     for(;;){
         proc_t *tmp;
-        if(n_alloc == n_used){
-          //proc_t *old = data;
-          n_alloc = n_alloc*5/4+30;  // grow by over 25%
-          data = realloc(data,sizeof(proc_t)*n_alloc);
-          //if(!data) return NULL;
-        }
+        if(!buf) buf = arena_alloc(arena, sizeof(proc_t));
         if(n_proc_alloc == n_proc){
-          //proc_t **old = ptab;
-          n_proc_alloc = n_proc_alloc*5/4+30;  // grow by over 25%
-          ptab = realloc(ptab,sizeof(proc_t*)*n_proc_alloc);
-          //if(!ptab) return NULL;
+          n_proc_alloc = n_proc_alloc ? n_proc_alloc*2 : 256;
+          ptab = xrealloc(ptab, sizeof(proc_t*)*n_proc_alloc);
         }
-        tmp = readproc_direct(PT, data+n_used);
+        tmp = readproc_direct(PT, buf);
         if(!tmp) break;
         if(!want_proc(tmp)) continue;
-        ptab[n_proc++] = (proc_t*)(n_used++);
+        ptab[n_proc++] = tmp;
+        buf = NULL;
         if(!(  PT->flags & PROC_LOOSE_TASKS  )) continue;
         for(;;){
           proc_t *t;
-          if(n_alloc == n_used){
-            proc_t *old = data;
-            n_alloc = n_alloc*5/4+30;  // grow by over 25%
-            data = realloc(data,sizeof(proc_t)*n_alloc);
-	    // have to move tmp too
-	    tmp = data+(tmp-old);
-            //if(!data) return NULL;
-          }
+          if(!buf) buf = arena_alloc(arena, sizeof(proc_t));
           if(n_task_alloc == n_task){
-            //proc_t **old = ttab;
-            n_task_alloc = n_task_alloc*5/4+1;  // grow by over 25%
-            ttab = realloc(ttab,sizeof(proc_t*)*n_task_alloc);
-            //if(!ttab) return NULL;
+            n_task_alloc = n_task_alloc ? n_task_alloc*2 : 256;
+            ttab = xrealloc(ttab, sizeof(proc_t*)*n_task_alloc);
           }
-          t = readtask_direct(PT, tmp, data+n_used);
+          t = readtask_direct(PT, tmp, buf);
           if(!t) break;
           if(!want_task(t)) continue;
-          ttab[n_task++] = (proc_t*)(n_used++);
+          ttab[n_task++] = t;
+          buf = NULL;
         }
     }
 
-    pd = malloc(sizeof(proc_data_t));
+done:
+    pd = xmalloc(sizeof(proc_data_t));
     pd->proc = ptab;
     pd->task = ttab;
     pd->nproc = n_proc;
@@ -1053,10 +2045,6 @@ proc_data_t *readproctab2(int(*want_proc)(proc_t *buf), int(*want_task)(proc_t *
       pd->tab = ptab;
       pd->n   = n_proc;
     }
-    // change array indexes to pointers
-    while(n_proc--) ptab[n_proc] = data+(long)(ptab[n_proc]);
-    while(n_task--) ttab[n_task] = data+(long)(ttab[n_task]);
-
     return pd;
 }
 
@@ -1067,7 +2055,7 @@ proc_data_t *readproctab2(int(*want_proc)(proc_t *buf), int(*want_task)(proc_t *
  * and filled out proc_t structure.
  */
 proc_t * get_proc_stats(pid_t pid, proc_t *p) {
-	static char path[PATH_MAX], sbuf[1024];
+	static char path[PATH_MAX], sbuf[4096];
 	struct stat statbuf;
 
 	sprintf(path, "/proc/%d", pid);
@@ -1077,11 +2065,11 @@ proc_t * get_proc_stats(pid_t pid, proc_t *p) {
 	}
 
 	if (file2str(path, "stat", sbuf, sizeof sbuf) >= 0)
-		stat2proc(sbuf, p);	/* parse /proc/#/stat */
+		stat2proc(sbuf, p, PROC_FIELDS);	/* parse /proc/#/stat */
 	if (file2str(path, "statm", sbuf, sizeof sbuf) >= 0)
 		statm2proc(sbuf, p);	/* ignore statm errors here */
 	if (file2str(path, "status", sbuf, sizeof sbuf) >= 0)
-		status2proc(sbuf, p, 0 /*FIXME*/);
+		status2proc(sbuf, p, 0 /*FIXME*/, PROC_FIELDS);
 
 	return p;
 }
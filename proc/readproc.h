@@ -30,6 +30,9 @@ EXTERN_C_BEGIN
 // neither tgid nor tid seemed correct. (in other words, FIXME)
 #define XXXID tid
 
+// NUMA nodes kept apart in node_kb (the same as MAPS_NODES)
+#define PROC_NODES 8
+
 // Basic data structure which holds all information we can get about a process.
 // (unless otherwise specified, fields are read from /proc/#/stat)
 //
@@ -101,6 +104,13 @@ typedef struct proc_t {
 	vm_swap,        // status          based on "swap ents", Linux 2.6.34
 	vm_exe,         // status          executable size
 	vm_lib,         // status          library size (all pages, not just used ones)
+	pss,            // smaps_rollup    proportional set size in kb, shared pages split among sharers
+	uss,            // smaps_rollup    unique set size in kb, the private pages
+	swap_pss,       // smaps_rollup    proportional swap in kb, Linux 4.3
+	anon_huge,      // smaps_rollup    transparent huge pages in kb (AnonHugePages)
+	hugetlb,        // smaps_rollup    hugetlbfs pages in kb
+	node_kb[PROC_NODES], // numa_maps  kb on each NUMA node (higher ones count as the last)
+	numa_remote,    // numa_maps       kb on nodes other than that of the cpu last run on
 	rtprio,		// stat            real-time priority
 	sched,		// stat            scheduling class
 	vsize,		// stat            number of pages of virtual memory ...
@@ -109,10 +119,30 @@ typedef struct proc_t {
 	min_flt,	// stat            number of minor page faults since process start
 	maj_flt,	// stat            number of major page faults since process start
 	cmin_flt,	// stat            cumulative min_flt of process and child processes
-	cmaj_flt;	// stat            cumulative maj_flt of process and child processes
+	cmaj_flt,	// stat            cumulative maj_flt of process and child processes
+	nvcsw,		// status          voluntary context switches
+	nivcsw;		// status          involuntary context switches
+    unsigned long long
+    // the next 7 members come from /proc/#/io, which only the owner (or root) may read
+	rchar,		// io              bytes passed to read() and the like
+	wchar,		// io              bytes passed to write() and the like
+	syscr,		// io              read syscalls
+	syscw,		// io              write syscalls
+	read_bytes,	// io              bytes the storage layer was asked to fetch
+	write_bytes,	// io              bytes sent (or to be sent) to the storage layer
+	cancelled_write_bytes,	// io      of write_bytes, what truncation threw away
+    // the next 3 members are in nanoseconds, and need PROC_FILLDELAY
+	cpu_delay,	// taskstats       waiting on a run queue (or schedstat)
+	blkio_delay,	// taskstats       waiting for block I/O to complete
+	swapin_delay,	// taskstats       waiting for pages to come back from swap
+    // the next 2 members need PROC_FILLTSUM, like nlwp_run
+	thr_time,	// task/#/stat     utime+stime of the thread that has used the most
+	thr_start;	// task/#/stat     start_time of that thread
     char
 	**environ,	// (special)       environment string vector (/proc/#/environ)
 	**cmdline;	// (special)       command line string vector (/proc/#/cmdline)
+    const char
+	*cgroup;	// cgroup          path of the task's cgroup, shared (never free it)
     char
 	// Be compatible: Digital allows 16 and NT allows 14 ???
     	euser[P_G_SZ],	// stat(),status   effective user name
@@ -131,6 +161,8 @@ typedef struct proc_t {
 	pgrp,		// stat            process group id
 	session,	// stat            session id
 	nlwp,		// stat,status     number of threads, or 0 if no clue
+	nlwp_run,	// task/#/stat     threads in state R (PROC_FILLTSUM)
+	numa_node,	// numa_maps       the node with most of its memory, or -1
 	tgid,		// (special)       task group ID, the POSIX PID (see also: tid)
 	tty,		// stat            full device number of controlling terminal
         euid, egid,     // stat(),status   effective
@@ -169,9 +201,17 @@ typedef struct PROCTAB {
     int         i;  // generic
     unsigned	flags;
     unsigned    u;  // generic
-    void *      vp; // generic
+    void *      vp; // generic (openproc keeps a sorted PROC_UID list here)
     char        path[PROCPATHLEN];  // must hold /proc/2000222000/task/2000222000/cmdline
     unsigned pathlen;        // length of string in the above (w/o '\0')
+    struct arena_t *arena;   // if set by the caller, cmdline+environ go here (not freeproc-able),
+                             // and readproctab2's proc_t's too
+    // if set by the caller: a process it returns 0 for is skipped before
+    // anything past /proc/#/stat is read.  It sees the dirent's euid+egid,
+    // the pid, and (with PROC_FILLSTAT) the stat fields.  readproctab2 may
+    // call it from several threads at once.
+    int(*prefilter)(const proc_t *restrict const);
+    struct share_image *share;  // PROC_SHARED: the snapshot being read, or NULL
 } PROCTAB;
 
 // initialize a PROCTAB structure holding needed call-to-call persistent data
@@ -202,9 +242,19 @@ extern void closeproc(PROCTAB* PT);
 extern proc_t* readproc(PROCTAB *restrict const PT, proc_t *restrict p);
 extern proc_t* readtask(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict t);
 
+// Fill in what 'flags' asks for beyond what p was read with: any of
+// PROC_FILLMEM, PROC_FILLSMAPS, PROC_FILLNUMA, PROC_FILLSTATUS, PROC_FILLIO,
+// PROC_FILLCGROUP, PROC_FILLUSR and PROC_FILLGRP, through the files
+// PROC_CACHEFD kept open.
+// 'task' is 1 for a proc_t from readtask().  NULL if it has gone away.
+extern proc_t* fillproc(proc_t *restrict const p, int flags, int task);
+
 // warning: interface may change
 extern int read_cmdline(char *restrict const dst, unsigned sz, unsigned pid);
 
+// /proc/#/cmdline as a string vector, to be kept from one readproc() to the next
+extern char **read_cmdline_vec(unsigned pid);
+
 extern void look_up_our_self(proc_t *p);
 
 // deallocate space allocated by readproc
@@ -239,16 +289,69 @@ extern proc_t * get_proc_stats(pid_t pid, proc_t *p);
 #define PROC_FILLARG         0x0100 // alloc and fill in `cmdline'
 
 #define PROC_LOOSE_TASKS     0x0200 // threat threads as if they were processes
+#define PROC_CACHEFD         0x0400 // keep stat,statm,status open (and task lists) for the next scan
+#define PROC_PARALLEL        0x0800 // readproctab2 may use several threads
 
 // Obsolete, consider only processes with one of the passed:
-#define PROC_PID             0x1000  // process id numbers ( 0   terminated)
+#define PROC_PID             0x1000  // process id numbers ( 0   terminated, threads skipped with PROC_FILLSTATUS)
 #define PROC_UID             0x4000  // user id numbers    ( length needed )
 
+// If any of these are given, stat and status only fill in the named groups
+// of proc_t members (BASIC always, the rest are left alone) and parsing stops
+// once those are done.  With none of them, everything is filled in as before.
+#define PROC_FIELD_BASIC 0x00010000 // cmd,state,ppid,pgrp,session,tty,tpgid,tgid, uids+gids
+#define PROC_FIELD_TIMES 0x00020000 // flags,faults,times,priority,nice,nlwp,alarm,start_time
+#define PROC_FIELD_VM    0x00040000 // vsize,rss,rss_rlim,code+stack addresses, vm_*
+#define PROC_FIELD_SCHED 0x00080000 // wchan,exit_signal,processor,rtprio,sched
+#define PROC_FIELD_SIGS  0x00100000 // signal,blocked,sigignore,sigcatch,_sigpnd
+#define PROC_FIELD_CSW   0x00800000 // nvcsw,nivcsw (all the way at the end of status)
+#define PROC_FIELDS      0x009f0000
+
+// smaps_rollup (or all of smaps, before Linux 4.14) -- pss, uss and swap_pss.
+// Costly, since the kernel walks the page tables to produce it.
+#define PROC_FILLSMAPS   0x00200000
+
+// /proc/#/io -- rchar, wchar, syscr, syscw, read_bytes, write_bytes and
+// cancelled_write_bytes.  Left at zero where it can't be read.
+#define PROC_FILLIO      0x00400000
+
+// cpu_delay, blkio_delay and swapin_delay, from taskstats (netlink, which
+// wants CAP_NET_ADMIN) and summed over the threads for a process.  Short
+// of that, cpu_delay is /proc/#/schedstat's (the one thread's), and the
+// other two stay zero.
+#define PROC_FILLDELAY   0x10000000
+
+// cgroup -- the cgroup v2 path, or for a task that v2 has at the root, the
+// first v1 hierarchy that puts it somewhere else.  Equal paths are the
+// same pointer.  NULL where /proc/#/cgroup can't be read.
+#define PROC_FILLCGROUP  0x20000000
+
+// nlwp_run, thr_time and thr_start -- a summary of the threads, from each
+// one's stat, without a proc_t (or a readtask()) per thread.  Single-
+// threaded processes get it from their own stat for free.
+#define PROC_FILLTSUM    0x40000000
+
+// numa_maps -- node_kb, numa_node, and numa_remote (which wants processor,
+// so PROC_FIELD_SCHED).  Slow like smaps: the kernel walks the page tables.
+// The memory is the process', so threads get node_kb from it.
+#define PROC_FILLNUMA    0x00008000
+
+// From the snapshot a collector (procshare) keeps in the shared memory that
+// PROCPS_SHARE names, if there is a fresh one with the fills asked for, and
+// nothing beyond stat, status, statm and cmdline is.  No /proc I/O then,
+// but what the collector saw, up to an interval ago.  See share.h.
+#define PROC_SHARED      0x2000
+
 // it helps to give app code a few spare bits
 #define PROC_SPARE_1     0x01000000
 #define PROC_SPARE_2     0x02000000
 #define PROC_SPARE_3     0x04000000
 #define PROC_SPARE_4     0x08000000
 
+// Internal to libproc (bench/statbench.c times them): /proc/#/stat and
+// statm text into a proc_t.  want is the PROC_FIELD_* groups to parse.
+extern void stat2proc(const char *S, proc_t *restrict P, unsigned want);
+extern void statm2proc(const char *S, proc_t *restrict P);
+
 EXTERN_C_END
 #endif
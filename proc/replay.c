@@ -0,0 +1,149 @@
+// Reading a recording of /proc instead of /proc
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// With PROCPS_REPLAY naming a file procrec wrote, libproc reads
+// processes and the system-wide files from there: the same tasks, the
+// same numbers, run after run, however busy (or idle) the machine the
+// tools run on.  That is what makes timing ps or top meaningful.  The
+// file is mmap()ed, so a file read costs a lookup and a memcpy().
+//
+// The lowest levels do the switching -- file2str(), the stat() of a
+// task's directory, FILE_TO_BUF and such -- so that everything above
+// them, parsing included, runs just as it does on a live system.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "replay.h"
+
+const replay_head *replay_image;
+
+static const replay_ent  *replay_files;
+static const int32_t     *replay_pids;
+static const replay_task *replay_tasks;
+
+#define AT(off) ((const char *)replay_image + (off))
+
+static void replay_fail(const char *restrict name, const char *restrict why){
+    fprintf(stderr, "PROCPS_REPLAY: %s: %s\n", name, why);
+    exit(1);	// going on with the real /proc would be worse
+}
+
+void replay_init(void){
+    const char *name = secure_getenv("PROCPS_REPLAY");
+    const replay_head *h;
+    struct stat sb;
+    void *map;
+    int fd;
+
+    if(!name || !*name) return;
+    fd = open(name, O_RDONLY|O_CLOEXEC);
+    if(fd == -1 || fstat(fd, &sb) == -1) replay_fail(name, "can't open");
+    if((size_t)sb.st_size < sizeof *h) replay_fail(name, "not a recording");
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) replay_fail(name, "can't map");
+    h = map;
+    if(memcmp(h->magic, REPLAY_MAGIC, sizeof h->magic) || h->size != (uint64_t)sb.st_size
+    || h->files + (uint64_t)h->nfiles * sizeof *replay_files > h->size
+    || h->pids  + (uint64_t)h->npids  * sizeof *replay_pids  > h->size
+    || h->tasks + (uint64_t)h->ntasks * sizeof *replay_tasks > h->size)
+        replay_fail(name, "not a recording");
+    replay_image = h;
+    replay_files = (const replay_ent *)AT(h->files);
+    replay_pids  = (const int32_t *)AT(h->pids);
+    replay_tasks = (const replay_task *)AT(h->tasks);
+}
+
+static const replay_ent *replay_find(const char *restrict path){
+    unsigned lo = 0, hi = replay_image->nfiles;
+
+    while(lo < hi){
+        unsigned mid = (lo + hi) / 2;
+        int c = strcmp(path, AT(replay_files[mid].name));
+        if(!c) return &replay_files[mid];
+        if(c < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+const char *replay_data(const char *restrict path, unsigned *restrict len){
+    const replay_ent *e = replay_find(path);
+
+    if(!e || S_ISDIR(e->mode)) return NULL;
+    *len = e->len;
+    return AT(e->data);
+}
+
+int replay_copy(const char *restrict path, char *restrict buf, int cap){
+    unsigned len;
+    const char *d = replay_data(path, &len);
+
+    if(!d || !len) return -1;
+    if(len > (unsigned)cap - 1) len = cap - 1;
+    memcpy(buf, d, len);
+    buf[len] = '\0';
+    return len;
+}
+
+int replay_stat(const char *restrict path, struct stat *restrict sb){
+    const replay_ent *e = replay_find(path);
+
+    if(!e) return -1;
+    memset(sb, 0, sizeof *sb);
+    sb->st_mode = e->mode;
+    sb->st_uid  = e->uid;
+    sb->st_gid  = e->gid;
+    sb->st_size = e->len;
+    return 0;
+}
+
+int replay_open(const char *restrict path){
+    unsigned len;
+    const char *d = replay_data(path, &len);
+    int fd;
+
+    if(!d) return -1;
+    fd = memfd_create("replay", MFD_CLOEXEC);
+    if(fd == -1) return -1;
+    if(write(fd, d, len) != (ssize_t)len || lseek(fd, 0, SEEK_SET) == -1){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// openproc() starts PT->u at 0
+int replay_nextpid(PROCTAB *restrict const PT, proc_t *restrict const p){
+    if(PT->u >= replay_image->npids) return 0;
+    p->tgid = p->tid = replay_pids[PT->u++];
+    snprintf(PT->path, PROCPATHLEN, "/proc/%d", p->tgid);
+    return 1;
+}
+
+// PT->i walks a process' run of tasks, found by tgid the first time
+int replay_nexttid(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict const t, char *restrict const path){
+    if(PT->taskdir_user != p->tgid){
+        unsigned lo = 0, hi = replay_image->ntasks;
+        while(lo < hi){
+            unsigned mid = (lo + hi) / 2;
+            if(replay_tasks[mid].tgid < p->tgid) lo = mid + 1;
+            else hi = mid;
+        }
+        PT->i = lo;
+        PT->taskdir_user = p->tgid;
+    }
+    if((unsigned)PT->i >= replay_image->ntasks || replay_tasks[PT->i].tgid != p->tgid) return 0;
+    t->tid = replay_tasks[PT->i++].tid;
+    t->tgid = p->tgid;
+    t->ppid = p->ppid;
+    snprintf(path, PROCPATHLEN, "/proc/%d/task/%d", p->tgid, t->tid);
+    return 1;
+}
@@ -0,0 +1,72 @@
+#ifndef PROCPS_PROC_REPLAY_H
+#define PROCPS_PROC_REPLAY_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include "procps.h"
+#include "readproc.h"
+
+EXTERN_C_BEGIN
+
+// A recording of /proc, as procrec makes them, for libproc to read in
+// place of the real thing when PROCPS_REPLAY names one.  It is used as
+// it is, mmap()ed: everything is an offset from the start of the file,
+// in the byte order of the machine that wrote it.
+#define REPLAY_MAGIC "procrec1"
+
+typedef struct replay_head {
+    char     magic[8];		// REPLAY_MAGIC, without its NUL
+    uint32_t nfiles;		// replay_ent's, sorted on name with strcmp()
+    uint32_t npids;		// the /proc/# directories, in the order found
+    uint32_t ntasks;		// replay_task's, sorted on tgid
+    uint32_t ncpus;		// for smp_num_cpus
+    uint64_t files;		// where the three tables start
+    uint64_t pids;		//   (an int32_t each)
+    uint64_t tasks;
+    uint64_t size;		// of the whole file
+} replay_head;
+
+typedef struct replay_ent {
+    uint64_t name;		// a path, "/proc/1/stat", NUL-terminated
+    uint64_t data;		// the contents, with a NUL after them
+    uint32_t len;		// not counting that NUL
+    uint32_t mode;		// as from stat(); directories have no contents
+    uint32_t uid, gid;
+} replay_ent;
+
+typedef struct replay_task {
+    int32_t tgid, tid;
+} replay_task;
+
+// Everything below is internal to libproc.
+
+// NULL unless replaying
+extern const replay_head *replay_image;
+
+// Maps the recording PROCPS_REPLAY names, if it does; from init_libproc.
+extern void replay_init(void);
+
+// The recorded contents of 'path' in 'buf', NUL-terminated and cut to
+// fit, like file2str: the length, or -1 for a file not there or empty.
+extern int replay_copy(const char *restrict path, char *restrict buf, int cap);
+
+// The contents in place, and their length; NULL for a file not there.
+extern const char *replay_data(const char *restrict path, unsigned *restrict len);
+
+// stat() for the owner and type of what was recorded
+extern int replay_stat(const char *restrict path, struct stat *restrict sb);
+
+// A descriptor to read a recorded file through, for code that wants one.
+extern int replay_open(const char *restrict path);
+
+// PROCTAB finders going by the recording's tables instead of readdir()
+extern int replay_nextpid(PROCTAB *restrict const PT, proc_t *restrict const p);
+extern int replay_nexttid(PROCTAB *restrict const PT, const proc_t *restrict const p, proc_t *restrict const t, char *restrict const path);
+
+EXTERN_C_END
+
+#endif
@@ -0,0 +1,381 @@
+// Publishing one scan of /proc for all the tools, and reading it back
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// The collector builds each snapshot in memory of its own, then copies it
+// into the segment inside a seqlock.  Readers never map the segment: they
+// pread() the head, then the snapshot, then the seq again, into memory of
+// their own.  So a segment that grows, or a collector that dies halfway,
+// can't hurt them, and every PROCTAB keeps the snapshot it started with.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "alloc.h"
+#include "share.h"
+
+// the proc_t members a snapshot has: all that stat, status and statm give
+typedef struct share_col {
+    unsigned short off, size;
+} share_col;
+
+#define COL(m) { offsetof(proc_t, m), sizeof(((proc_t *)0)->m) }
+static const share_col cols[] = {
+    COL(tid), COL(ppid), COL(state), COL(utime), COL(stime), COL(cutime),
+    COL(cstime), COL(start_time), COL(signal), COL(blocked), COL(sigignore),
+    COL(sigcatch), COL(_sigpnd), COL(start_code), COL(end_code),
+    COL(start_stack), COL(kstk_esp), COL(kstk_eip), COL(wchan),
+    COL(priority), COL(nice), COL(rss), COL(alarm), COL(size), COL(resident),
+    COL(share), COL(trs), COL(lrs), COL(drs), COL(dt), COL(vm_size),
+    COL(vm_lock), COL(vm_rss), COL(vm_data), COL(vm_stack), COL(vm_swap),
+    COL(vm_exe), COL(vm_lib), COL(rtprio), COL(sched), COL(vsize),
+    COL(rss_rlim), COL(flags), COL(min_flt), COL(maj_flt), COL(cmin_flt),
+    COL(cmaj_flt), COL(nvcsw), COL(nivcsw), COL(cmd), COL(pgrp),
+    COL(session), COL(nlwp), COL(tgid), COL(tty), COL(euid), COL(egid),
+    COL(ruid), COL(rgid), COL(suid), COL(sgid), COL(fuid), COL(fgid),
+    COL(tpgid), COL(exit_signal), COL(processor)
+};
+#undef COL
+#define NCOLS (sizeof cols / sizeof *cols)
+
+// what the collector reads; reading more than that means going to /proc
+#define SHARE_FILLS (PROC_FILLSTAT | PROC_FILLSTATUS | PROC_FILLMEM | PROC_FILLARG)
+
+#define ALIGN8(n) (((n) + 7) & ~(uint64_t)7)
+
+// A hash of the columns and of the structures as this libproc has them,
+// so that a snapshot is only read by a libproc that lays it out the same.
+static uint32_t share_layout(void){
+    uint32_t h = 2166136261u;
+    unsigned i;
+
+#define MIX(x) (h = (h ^ (uint32_t)(x)) * 16777619u)
+    for(i = 0; i < NCOLS; i++){
+        MIX(cols[i].off);
+        MIX(cols[i].size);
+    }
+    MIX(sizeof(proc_t));
+    MIX(sizeof(sysinfo_snap));
+    MIX(sizeof(share_head));
+#undef MIX
+    return h;
+}
+
+static uint64_t mono_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// the collector must see /proc, whatever PROCPS_SHARE says
+static int collecting;
+
+/***********************************************************************
+ * Collector side
+ */
+
+static char *img;		// the snapshot being built
+static uint64_t img_room;
+static proc_t *procs;
+static unsigned procs_room;
+static char *strs;
+static uint64_t strs_len, strs_room;
+static uint32_t *args;
+
+static int seg_fd = -1;
+static char *seg;
+static uint64_t seg_size;
+
+static void strs_add(const char *restrict s, uint64_t len){
+    if(strs_len + len > strs_room){
+        while(strs_len + len > strs_room) strs_room = strs_room ? strs_room * 2 : 65536;
+        strs = xrealloc(strs, strs_room);
+    }
+    memcpy(strs + strs_len, s, len);
+    strs_len += len;
+}
+
+// the segment, with room for 'size'; it only ever grows
+static int seg_room(const char *restrict name, uint64_t size){
+    if(seg_fd == -1){
+        int fd = shm_open(name, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+        if(fd == -1) return -1;
+        if(flock(fd, LOCK_EX|LOCK_NB) == -1){
+            close(fd);
+            errno = EBUSY;
+            return -1;
+        }
+        fchmod(fd, 0644);   // readers don't trust what others may write
+        seg_fd = fd;
+    }
+    if(size <= seg_size) return 0;
+    size = ALIGN8(size + size / 4);
+    if(ftruncate(seg_fd, size) == -1) return -1;
+    if(seg) munmap(seg, seg_size);
+    seg = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, seg_fd, 0);
+    if(seg == MAP_FAILED){
+        seg = NULL;
+        seg_size = 0;
+        return -1;
+    }
+    seg_size = size;
+    return 0;
+}
+
+int share_publish(const char *restrict name, double secs){
+    static uint64_t version;
+    share_head h, *sh;
+    PROCTAB *PT;
+    uint64_t off, size, seq;
+    unsigned n = 0, i, c;
+
+    collecting = 1;
+    memset(&h, 0, sizeof h);
+    h.taken = mono_ns();
+    PT = openproc(SHARE_FILLS | PROC_CACHEFD);
+    if(!PT) return -1;
+    strs_len = 0;
+    for(;;){
+        if(n == procs_room){
+            procs_room = procs_room ? procs_room * 2 : 512;
+            procs = xrealloc(procs, sizeof *procs * procs_room);
+            args = xrealloc(args, sizeof *args * (procs_room + 1));
+        }
+        memset(&procs[n], 0, sizeof *procs);
+        if(!readproc(PT, &procs[n])) break;
+        args[n] = strs_len;
+        if(procs[n].cmdline){
+            char **v = procs[n].cmdline;
+            while(*v) v++;
+            strs_add(*procs[n].cmdline, v[-1] + strlen(v[-1]) + 1 - *procs[n].cmdline);
+            free((void*)*procs[n].cmdline);
+        }
+        n++;
+    }
+    args[n] = strs_len;
+    closeproc(PT);
+    sysinfo_snapshot(&h.sys, SNAP_ALL);
+
+    off = ALIGN8(sizeof h);
+    for(c = 0; c < NCOLS; c++) off += ALIGN8((uint64_t)n * cols[c].size);
+    h.args = off;
+    h.strs = off + ALIGN8(sizeof *args * (n + 1));
+    size = h.strs + strs_len;
+    if(size > img_room){
+        img_room = ALIGN8(size + size / 4);
+        img = xrealloc(img, img_room);
+    }
+
+    // the columns: one member of every process, then the next member
+    off = ALIGN8(sizeof h);
+    for(c = 0; c < NCOLS; c++){
+        char *col = img + off;
+        for(i = 0; i < n; i++)
+            memcpy(col + i * cols[c].size, (char *)&procs[i] + cols[c].off, cols[c].size);
+        off += ALIGN8((uint64_t)n * cols[c].size);
+    }
+    memcpy(img + h.args, args, sizeof *args * (n + 1));
+    memcpy(img + h.strs, strs, strs_len);
+
+    if(seg_room(name, size) == -1) return -1;
+
+    memcpy(h.magic, SHARE_MAGIC, sizeof h.magic);
+    h.size = size;
+    h.version = ++version;
+    h.step = secs * 1e9;
+    h.layout = share_layout();
+    h.flags = SHARE_FILLS;
+    h.nprocs = n;
+    memcpy(img, &h, sizeof h);
+
+    // seqlock: odd, the snapshot (all but seq itself), even again
+    sh = (share_head *)seg;
+    seq = sh->seq | 1;
+    sh->seq = seq;
+    __sync_synchronize();
+    memcpy(seg, img, offsetof(share_head, seq));
+    memcpy(seg + offsetof(share_head, size), img + offsetof(share_head, size),
+           size - offsetof(share_head, size));
+    __sync_synchronize();
+    sh->seq = seq + 1;
+    return 0;
+}
+
+int share_unlink(const char *restrict name){
+    if(seg) munmap(seg, seg_size);
+    if(seg_fd != -1) close(seg_fd);
+    seg = NULL;
+    seg_size = 0;
+    seg_fd = -1;
+    return shm_unlink(name);
+}
+
+/***********************************************************************
+ * Reader side
+ */
+
+struct share_image {
+    unsigned refs;		// the current one holds one, each PROCTAB one
+    unsigned nprocs;
+    const char *col[NCOLS];
+    const uint32_t *args;
+    const char *strs;
+    uint64_t nstrs;
+    share_head h;		// the copy starts here; the rest follows
+};
+
+static pthread_mutex_t share_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char *share_name;	// PROCPS_SHARE
+static int share_looked;	// for it yet
+static int share_fd = -1;
+static share_image *current;
+
+// the segment, if it is one a reader may believe
+static int share_open(const char *restrict name){
+    struct stat sb;
+    int fd;
+
+    fd = shm_open(name, O_RDONLY|O_NOFOLLOW|O_CLOEXEC, 0);
+    if(fd == -1) return -1;
+    if(fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)
+    || (sb.st_uid && sb.st_uid != geteuid()) || (sb.st_mode & (S_IWGRP|S_IWOTH))){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void image_drop(share_image *restrict im){
+    if(im && !--im->refs) free(im);
+}
+
+// a fresh copy of the snapshot in the segment, or NULL
+static share_image *image_read(const share_head *restrict h0){
+    share_image *im;
+    uint64_t seq, off;
+    unsigned c;
+
+    if(h0->size < sizeof *h0 || h0->size > (1ull << 32)) return NULL;
+    im = malloc(offsetof(share_image, h) + h0->size);
+    if(!im) return NULL;
+    if(pread(share_fd, &im->h, h0->size, 0) != (ssize_t)h0->size
+    || pread(share_fd, &seq, sizeof seq, offsetof(share_head, seq)) != sizeof seq
+    || seq != h0->seq || im->h.seq != seq)
+        goto bad;
+    im->nprocs = im->h.nprocs;
+    off = ALIGN8(sizeof im->h);
+    for(c = 0; c < NCOLS; c++){
+        im->col[c] = (const char *)&im->h + off;
+        off += ALIGN8((uint64_t)im->nprocs * cols[c].size);
+    }
+    if(off > im->h.args || im->h.args + sizeof(uint32_t) * (im->nprocs + 1ull) > im->h.strs
+    || im->h.strs > im->h.size)
+        goto bad;
+    im->args = (const uint32_t *)((const char *)&im->h + im->h.args);
+    im->strs = (const char *)&im->h + im->h.strs;
+    im->nstrs = im->h.size - im->h.strs;
+    im->refs = 1;
+    return im;
+bad:
+    free(im);
+    return NULL;
+}
+
+share_image *share_get(unsigned flags){
+    share_image *im = NULL;
+    share_head h0;
+    int tries;
+
+    if(collecting) return NULL;
+    pthread_mutex_lock(&share_lock);
+    if(!share_looked){
+        share_name = secure_getenv("PROCPS_SHARE");
+        share_looked = 1;
+    }
+    // a collector started since, or again, makes a new segment: so a
+    // reader that finds none, or a bad or stale one, looks again next time
+    if(share_name && *share_name && share_fd == -1) share_fd = share_open(share_name);
+    for(tries = 0; share_fd >= 0; tries++){
+        if(tries == 8) goto out;	// a collector writing all the time?
+        if(pread(share_fd, &h0, sizeof h0, 0) != sizeof h0) break;
+        if(memcmp(h0.magic, SHARE_MAGIC, sizeof h0.magic) || h0.layout != share_layout()) break;
+        if(h0.seq & 1){		// being written: it takes well under a ms
+            sched_yield();
+            continue;
+        }
+        // stale: the collector has missed a tick too many, or is gone
+        if(mono_ns() - h0.taken > 2 * h0.step + 100000000ull) break;
+        if(!current || current->h.seq != h0.seq || current->h.version != h0.version
+        || current->h.taken != h0.taken){
+            share_image *fresh = image_read(&h0);
+            if(!fresh) continue;
+            image_drop(current);
+            current = fresh;
+        }
+        if(!(flags & SHARE_FILLS & ~current->h.flags)){
+            im = current;
+            im->refs++;
+        }
+        goto out;
+    }
+    if(share_fd >= 0){
+        close(share_fd);
+        share_fd = -1;
+    }
+out:
+    pthread_mutex_unlock(&share_lock);
+    return im;
+}
+
+void share_put(share_image *restrict im){
+    pthread_mutex_lock(&share_lock);
+    image_drop(im);
+    pthread_mutex_unlock(&share_lock);
+}
+
+unsigned share_procs(const share_image *restrict im){
+    return im->nprocs;
+}
+
+void share_fill(const share_image *restrict im, unsigned i, proc_t *restrict p){
+    unsigned c;
+
+    for(c = 0; c < NCOLS; c++)
+        memcpy((char *)p + cols[c].off, im->col[c] + i * cols[c].size, cols[c].size);
+}
+
+const char *share_args(const share_image *restrict im, unsigned i, unsigned *restrict len){
+    uint32_t a = im->args[i], b = im->args[i + 1];
+
+    if(a >= b || b > im->nstrs) return NULL;
+    *len = b - a;
+    return im->strs + a;
+}
+
+int share_sysinfo(sysinfo_snap *restrict s, unsigned what){
+    share_image *im = share_get(0);
+    int ok;
+
+    if(!im) return 0;
+    what &= SNAP_ALL;
+    ok = (im->h.sys.have & what) == what;
+    if(ok){
+        *s = im->h.sys;
+        s->have = what;
+    }
+    share_put(im);
+    return ok;
+}
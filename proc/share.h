@@ -0,0 +1,78 @@
+#ifndef PROCPS_PROC_SHARE_H
+#define PROCPS_PROC_SHARE_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include <stdint.h>
+#include "procps.h"
+#include "readproc.h"
+#include "sysinfo.h"
+
+EXTERN_C_BEGIN
+
+// One scan of /proc, published in a shared memory segment for every tool
+// on the machine to read in place of /proc.  A collector (procshare)
+// calls share_publish() once an interval; tools that openproc() with
+// PROC_SHARED, with PROCPS_SHARE naming the segment, get their processes
+// from the latest snapshot without opening a single /proc file.  With no
+// collector running, or one that has stopped, or a snapshot that doesn't
+// have what was asked for, openproc() reads /proc as ever.
+//
+// The segment, from its start: a share_head; the columns, one after the
+// other, each nprocs entries of one proc_t member (as share.c lists
+// them), rounded up to 8 bytes; nprocs+1 uint32_t offsets into the
+// command lines; and those, each with its NULs as /proc/#/cmdline has
+// them.  A snapshot is never changed once written: the next one replaces
+// it whole, with seq odd while that happens, so a reader that sees the
+// same even seq before and after its copy has a consistent one.
+#define SHARE_MAGIC "procshr1"
+
+typedef struct share_head {
+    char     magic[8];		// SHARE_MAGIC, without its NUL
+    volatile uint64_t seq;	// odd while a snapshot is being written
+    uint64_t size;		// of the snapshot, this head included
+    uint64_t version;		// snapshots published so far
+    uint64_t taken;		// when its scan was, CLOCK_MONOTONIC ns
+    uint64_t step;		// the collector's interval, ns
+    uint32_t layout;		// share_layout() of the libproc that wrote it
+    uint32_t flags;		// the PROC_FILL* the scan was made with
+    uint32_t nprocs;
+    uint32_t pad;
+    uint64_t args;		// where the cmdline offsets start
+    uint64_t strs;		// and the cmdlines
+    sysinfo_snap sys;		// SNAP_ALL, from the same moment
+} share_head;
+
+// Collector side.  Scans /proc and publishes the snapshot under 'name'
+// (for shm_open, "/procps"), creating the segment the first time; 'secs'
+// is how often it will be called, so that readers can tell a stale one.
+// Returns 0, or -1 with errno set (EBUSY: another collector has it).
+extern int share_publish(const char *restrict name, double secs);
+// removes the segment, so that readers go back to /proc
+extern int share_unlink(const char *restrict name);
+
+// Everything below is internal to libproc.
+
+// the snapshot openproc() reads from, counted so that a scan in progress
+// keeps its own
+typedef struct share_image share_image;
+
+// The latest snapshot, if PROCPS_SHARE names a segment that a trusted
+// collector (root, or the same user) keeps fresh, and its scan has the
+// PROC_FILL* of 'flags'.  NULL otherwise.
+extern share_image *share_get(unsigned flags);
+extern void share_put(share_image *restrict im);
+extern unsigned share_procs(const share_image *restrict im);
+// process i's columns into p
+extern void share_fill(const share_image *restrict im, unsigned i, proc_t *restrict p);
+// its cmdline, with the NULs, and the length; NULL if it has none
+extern const char *share_args(const share_image *restrict im, unsigned i, unsigned *restrict len);
+// The 'what' parts of the snapshot's sysinfo_snap into s; 0 if there
+// is no such snapshot to be had.
+extern int share_sysinfo(sysinfo_snap *restrict s, unsigned what);
+
+EXTERN_C_END
+
+#endif
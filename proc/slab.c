@@ -1,4 +1,4 @@
-/* 
+/*
  * slab.c - slab related functions for libproc
  *
  * Chris Rivera <cmrivera@ufl.edu>
@@ -12,46 +12,26 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <limits.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/time.h>
 
 #include "slab.h"
 #include "procps.h"
+#include "alloc.h"
 
-#define SLABINFO_LINE_LEN	2048
-#define SLABINFO_VER_LEN	100
+#define SLABINFO_BUFSIZ		(64*1024)
 #define SLABINFO_FILE		"/proc/slabinfo"
-
-static struct slab_info *free_index;
-
-/*
- * get_slabnode - allocate slab_info structures using a free list
- *
- * In the fast path, we simply return a node off the free list.  In the slow
- * list, we malloc() a new node.  The free list is never automatically reaped,
- * both for simplicity and because the number of slab caches is fairly
- * constant.
- */
-static struct slab_info *get_slabnode(void)
-{
-	struct slab_info *node;
-
-	if (free_index) {
-		node = free_index;
-		free_index = free_index->next;
-	} else {
-		node = malloc(sizeof(struct slab_info));
-		if (!node)
-			perror("malloc");
-	}
-
-	return node;
-}
+#define SLABINFO_SYSFS		"/sys/kernel/slab"
 
 /*
  * slab_badname_detect - return true if current slab was declared with
- *                       whitespaces for instance 
+ *                       whitespaces for instance
  *			 FIXME :Other cases ?
  */
 
@@ -61,36 +41,58 @@ static int slab_badname_detect(const char *restrict buffer)
 	while (*buffer){
 		if((*buffer)==' ')
 			numberarea=1;
-		if(isalpha(*buffer)&&numberarea)	
+		if(isalpha(*buffer)&&numberarea)
 			return 1;
-		buffer++;	
+		buffer++;
 	}
 	return 0;
 }
 
 /*
- * put_slabinfo - return all allocated nodes to the free list
+ * next_slab - return the record to fill in next, growing slab[] as needed
  */
-void put_slabinfo(struct slab_info *head)
+static struct slab_info *next_slab(slabs_t *restrict s)
+{
+	struct slab_info *curr;
+
+	if (s->n >= s->size) {
+		s->size = s->size ? s->size * 2 : 256;
+		s->slab = xrealloc(s->slab, s->size * sizeof *s->slab);
+	}
+	curr = &s->slab[s->n++];
+	memset(curr, 0, sizeof *curr);
+	return curr;
+}
+
+/* the next number in the line, or -1 if there isn't one */
+static int next_num(char **restrict S, unsigned *restrict v)
 {
-	free_index = head;
+	char *end;
+	unsigned long n = strtoul(*S, &end, 10);
+
+	if (end == *S)
+		return -1;
+	*v = n;
+	*S = end;
+	return 0;
 }
 
-/*
- * free_slabinfo - deallocate the memory associated with each node in the
- * slab_info linked list
- */
-void free_slabinfo(struct slab_info *list)
+/* copies the first word of the line to 'name', returning what follows */
+static char *get_name(char *restrict S, char *restrict name)
 {
-	while (list) {
-		struct slab_info *temp = list->next;
-		free(list);
-		list = temp;
+	int i = 0;
+
+	while (*S && !isspace((unsigned char)*S)) {
+		if (i < SLAB_INFO_NAME_LEN - 1)
+			name[i++] = *S;
+		S++;
 	}
+	name[i] = '\0';
+	return S;
 }
 
 // parse_slabinfo20 - actual parse routine for slabinfo 2.x (2.6 kernels)
-// Note: difference between 2.0 and 2.1 is in the ": globalstat" part where version 2.1 
+// Note: difference between 2.0 and 2.1 is in the ": globalstat" part where version 2.1
 // has extra column <nodeallocs>. We don't use ": globalstat" part in both versions.
 //
 // Formats (we don't use "statistics" extensions)
@@ -106,7 +108,7 @@ void free_slabinfo(struct slab_info *list)
 //  : slabdata <active_slabs> <num_slabs> <sharedavail> \
 //  : globalstat <listallocs> <maxobjs> <grown> <reaped> <error> <maxfreeable> <freelimit> <nodeallocs> \
 //  : cpustat <allochit> <allocmiss> <freehit> <freemiss>
-//             
+//
 //  slabinfo - version: 2.0
 //  # name            <active_objs> <num_objs> <objsize> <objperslab> <pagesperslab> \
 //  : tunables <batchcount> <limit> <sharedfactor> \
@@ -118,123 +120,345 @@ void free_slabinfo(struct slab_info *list)
 //  : slabdata <active_slabs> <num_slabs> <sharedavail> \
 //  : globalstat <listallocs> <maxobjs> <grown> <reaped> <error> <maxfreeable> <freelimit> \
 //  : cpustat <allochit> <allocmiss> <freehit> <freemiss>
-static int parse_slabinfo20(struct slab_info **list, struct slab_stat *stats,
-				FILE *f)
+static int parse_slabinfo20(slabs_t *restrict s, char *S)
 {
-	struct slab_info *curr = NULL, *prev = NULL;
-	char buffer[SLABINFO_LINE_LEN];
-	int entries = 0;
-	int page_size = getpagesize();
+	char *eol;
 
-	stats->min_obj_size = INT_MAX;
-	stats->max_obj_size = 0;
+	for (; *S; S = eol) {
+		struct slab_info *curr;
+
+		eol = strchrnul(S, '\n');
+		if (*eol)
+			*eol++ = '\0';
+		if (S[0] == '#' || !S[0])
+			continue;
+
+		curr = next_slab(s);
+		S = get_name(S, curr->name);
+		if (next_num(&S, &curr->nr_active_objs) ||
+		    next_num(&S, &curr->nr_objs) ||
+		    next_num(&S, &curr->obj_size) ||
+		    next_num(&S, &curr->objs_per_slab) ||
+		    next_num(&S, &curr->pages_per_slab) ||
+		    !(S = strstr(S, ": slabdata")) ||
+		    !(S += sizeof ": slabdata" - 1) ||
+		    next_num(&S, &curr->nr_active_slabs) ||
+		    next_num(&S, &curr->nr_slabs)) {
+			fprintf(stderr, "unrecognizable data in slabinfo!\n");
+			fprintf(stderr, "\rerror reading slabinfo!\n");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * parse_slabinfo11 - actual parsing routine for slabinfo 1.1 (2.4 kernels)
+ */
+static int parse_slabinfo11(slabs_t *restrict s, char *S)
+{
+	int page_size = getpagesize();
+	char *eol;
 
-	while (fgets(buffer, SLABINFO_LINE_LEN, f)) {
-		int assigned;
+	for (; *S; S = eol) {
+		struct slab_info *curr;
+		char *line = S;
 
-		if (buffer[0] == '#')
+		eol = strchrnul(S, '\n');
+		if (*eol)
+			*eol++ = '\0';
+		if (!S[0])
 			continue;
-	
-		curr = get_slabnode();
-		if (!curr)
-			break;
 
-		if (entries++ == 0)
-			*list = curr;
-		else
-			prev->next = curr;
+		curr = next_slab(s);
+		S = get_name(S, curr->name);
+		if (next_num(&S, &curr->nr_active_objs) ||
+		    next_num(&S, &curr->nr_objs) ||
+		    next_num(&S, &curr->obj_size) ||
+		    next_num(&S, &curr->nr_active_slabs) ||
+		    next_num(&S, &curr->nr_slabs)) {
+			fprintf(stderr, "unrecognizable data in  your slabinfo version 1.1\n\r");
+			if(slab_badname_detect(line))
+				fprintf(stderr, "Found an error in cache name at line %s\n", line);
+			fprintf(stderr, "\rerror reading slabinfo!\n");
+			return 1;
+		}
+		next_num(&S, &curr->pages_per_slab);
 
-		assigned = sscanf(buffer, "%" STRINGIFY(SLAB_INFO_NAME_LEN)
-				"s %d %d %d %d %d : tunables %*d %*d %*d : \
-				slabdata %d %d %*d", curr->name, 
-				&curr->nr_active_objs, &curr->nr_objs, 
-				&curr->obj_size, &curr->objs_per_slab,
-				&curr->pages_per_slab, &curr->nr_active_slabs,
-				&curr->nr_slabs);
+		if (curr->obj_size)
+			curr->objs_per_slab = curr->pages_per_slab *
+					page_size / curr->obj_size;
+	}
+	return 0;
+}
 
-		if (assigned < 8) {
-			fprintf(stderr, "unrecognizable data in slabinfo!\n");
-			curr = NULL;
+/*
+ * parse_slabinfo10 - actual parsing routine for slabinfo 1.0 (2.2 kernels)
+ *
+ * Not yet implemented.  Please feel free.
+ */
+static int parse_slabinfo10(slabs_t *restrict s, char *S)
+{
+	(void) s, (void) S;
+	fprintf(stderr, "slabinfo version 1.0 not yet supported\n");
+	return 1;
+}
+
+/*
+ * read_slabinfo - all of /proc/slabinfo in one go, into s->buf
+ */
+static int read_slabinfo(slabs_t *restrict s)
+{
+	unsigned len = 0;
+	int major, minor;
+	char *S;
+	int fd;
+
+	fd = open(SLABINFO_FILE, O_RDONLY);
+	if (fd == -1)
+		return -1;
+	if (!s->buf) {
+		s->bufsize = SLABINFO_BUFSIZ;
+		s->buf = xmalloc(s->bufsize);
+	}
+	for (;;) {
+		ssize_t r = read(fd, s->buf + len, s->bufsize - 1 - len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (r == 0)
 			break;
+		len += r;
+		if (len == s->bufsize - 1) {
+			s->bufsize *= 2;
+			s->buf = xrealloc(s->buf, s->bufsize);
 		}
+	}
+	close(fd);
+	s->buf[len] = '\0';
 
-		if (curr->obj_size < stats->min_obj_size)
-			stats->min_obj_size = curr->obj_size;
-		if (curr->obj_size > stats->max_obj_size)
-			stats->max_obj_size = curr->obj_size;
+	if (!len) {
+		fprintf(stderr, "cannot read from slabinfo\n");
+		return 1;
+	}
+	if (sscanf(s->buf, "slabinfo - version: %d.%d", &major, &minor) != 2) {
+		fprintf(stderr, "not the good old slabinfo we know\n");
+		return 1;
+	}
+	S = strchrnul(s->buf, '\n');
+	if (*S)
+		S++;
 
-		curr->cache_size = (unsigned long)curr->nr_slabs * curr->pages_per_slab * page_size;
+	if (major == 2)
+		return parse_slabinfo20(s, S);
+	if (major == 1 && minor == 1)
+		return parse_slabinfo11(s, S);
+	if (major == 1 && minor == 0)
+		return parse_slabinfo10(s, S);
+	fprintf(stderr, "unrecognizable slabinfo version\n");
+	return 1;
+}
 
-		if (curr->nr_objs) {
-			curr->use = 100 * curr->nr_active_objs / curr->nr_objs;
-			stats->nr_active_caches++;
-		} else
-			curr->use = 0;
+/*
+ * sysfs_num - the number at the start of /sys/kernel/slab/<dir>/<file>
+ */
+static int sysfs_num(int dfd, const char *dir, const char *file, unsigned *v)
+{
+	char path[2 * SLAB_INFO_NAME_LEN + 32];
+	char buf[64];
+	char *S = buf;
+	ssize_t r;
+	int fd;
+
+	snprintf(path, sizeof path, "%s/%s", dir, file);
+	fd = openat(dfd, path, O_RDONLY);
+	if (fd == -1)
+		return -1;
+	r = read(fd, buf, sizeof buf - 1);
+	close(fd);
+	if (r <= 0)
+		return -1;
+	buf[r] = '\0';
+	return next_num(&S, v);
+}
 
-		stats->nr_objs += curr->nr_objs;
-		stats->nr_active_objs += curr->nr_active_objs;
-		stats->total_size += (unsigned long)curr->nr_objs * curr->obj_size;
-		stats->active_size += (unsigned long)curr->nr_active_objs * curr->obj_size;
-		stats->nr_pages += curr->nr_slabs * curr->pages_per_slab;
-		stats->nr_slabs += curr->nr_slabs;
-		stats->nr_active_slabs += curr->nr_active_slabs;
+struct sysfs_cache {
+	char dir[SLAB_INFO_NAME_LEN];
+	char alias[SLAB_INFO_NAME_LEN];
+};
+
+static int cmp_sysfs(const void *a, const void *b)
+{
+	return strcmp(((const struct sysfs_cache *)a)->dir,
+		      ((const struct sysfs_cache *)b)->dir);
+}
 
-		prev = curr;
+static int cmp_name(const void *a, const void *b)
+{
+	return strcmp(((const struct slab_info *)a)->name,
+		      ((const struct slab_info *)b)->name);
+}
+
+/*
+ * read_sysfs - SLUB's /sys/kernel/slab, where each cache is a directory.
+ * Caches the kernel merged live in ":<size>" directories, with the names
+ * pointing at them as symlinks; we call those after the first alias, in
+ * order, since nothing says which one slabinfo would use.  Unlike
+ * slabinfo, this is readable without root.
+ */
+static int read_sysfs(slabs_t *restrict s)
+{
+	struct sysfs_cache *dirs = NULL;
+	int ndirs = 0, size = 0;
+	struct dirent *ent;
+	DIR *d;
+	int dfd, i;
+
+	d = opendir(SLABINFO_SYSFS);
+	if (!d)
+		return -1;
+	dfd = dirfd(d);
+
+	// directories first, so that the aliases can be looked up
+	while ((ent = readdir(d))) {
+		if (ent->d_name[0] == '.' || ent->d_type == DT_LNK)
+			continue;
+		if (strlen(ent->d_name) >= SLAB_INFO_NAME_LEN)
+			continue;
+		if (ndirs == size) {
+			size = size ? size * 2 : 256;
+			dirs = xrealloc(dirs, size * sizeof *dirs);
+		}
+		strcpy(dirs[ndirs].dir, ent->d_name);
+		dirs[ndirs].alias[0] = '\0';
+		ndirs++;
 	}
+	qsort(dirs, ndirs, sizeof *dirs, cmp_sysfs);
 
-	if (!curr) {
-		fprintf(stderr, "\rerror reading slabinfo!\n");
-		return 1;
+	rewinddir(d);
+	while ((ent = readdir(d))) {
+		struct sysfs_cache key, *target;
+		char link[PATH_MAX];
+		const char *base;
+		ssize_t r;
+
+		if (ent->d_type != DT_LNK || strlen(ent->d_name) >= SLAB_INFO_NAME_LEN)
+			continue;
+		r = readlinkat(dfd, ent->d_name, link, sizeof link - 1);
+		if (r <= 0)
+			continue;
+		link[r] = '\0';
+		base = strrchr(link, '/');
+		base = base ? base + 1 : link;
+		if (base[0] != ':' || strlen(base) >= SLAB_INFO_NAME_LEN)
+			continue;
+		strcpy(key.dir, base);
+		target = bsearch(&key, dirs, ndirs, sizeof *dirs, cmp_sysfs);
+		if (target && (!target->alias[0] || strcmp(ent->d_name, target->alias) < 0))
+			strcpy(target->alias, ent->d_name);
 	}
 
-	curr->next = NULL;
-	stats->nr_caches = entries;
-	if (stats->nr_objs)
-		stats->avg_obj_size = stats->total_size / stats->nr_objs;
+	for (i = 0; i < ndirs; i++) {
+		struct slab_info *curr;
+		const char *dir = dirs[i].dir;
+		unsigned order = 0;
 
+		curr = next_slab(s);
+		strcpy(curr->name, dirs[i].alias[0] ? dirs[i].alias : dir);
+		if (sysfs_num(dfd, dir, "objects", &curr->nr_active_objs)) {
+			s->n--;		// gone already, or not a cache at all
+			continue;
+		}
+		// total_objects and slabs need CONFIG_SLUB_DEBUG
+		if (sysfs_num(dfd, dir, "total_objects", &curr->nr_objs))
+			curr->nr_objs = curr->nr_active_objs;
+		if (sysfs_num(dfd, dir, "slab_size", &curr->obj_size))
+			sysfs_num(dfd, dir, "object_size", &curr->obj_size);
+		sysfs_num(dfd, dir, "objs_per_slab", &curr->objs_per_slab);
+		sysfs_num(dfd, dir, "order", &order);
+		curr->pages_per_slab = 1u << order;
+		if (sysfs_num(dfd, dir, "slabs", &curr->nr_slabs) && curr->objs_per_slab)
+			curr->nr_slabs = (curr->nr_objs + curr->objs_per_slab - 1) / curr->objs_per_slab;
+		curr->nr_active_slabs = curr->nr_slabs;
+	}
+	closedir(d);
+	free(dirs);
+	qsort(s->slab, s->n, sizeof *s->slab, cmp_name);
 	return 0;
 }
 
+static unsigned hash_name(const char *S)
+{
+	unsigned h = 0;
+	while (*S)
+		h = h * 31 + (unsigned char)*S++;
+	return h;
+}
+
 /*
- * parse_slabinfo11 - actual parsing routine for slabinfo 1.1 (2.4 kernels)
+ * match_prev - for each cache, how its active objects changed since the
+ * last read.  The kernel's order hardly ever changes, so the record at the
+ * same index is tried first, and a hash of the old names is the fallback.
+ */
+static void match_prev(slabs_t *restrict s)
+{
+	unsigned mask = 0;
+	int i;
+
+	for (i = 0; i < s->n; i++) {
+		struct slab_info *curr = &s->slab[i];
+		const struct slab_info *old = NULL;
+
+		if (i < s->nprev && !strcmp(s->prev[i].name, curr->name)) {
+			old = &s->prev[i];
+		} else if (s->nprev) {
+			unsigned h;
+			int j;
+
+			if (!mask) {	// first miss: hash the old names
+				if (s->hashsize < 2u * s->nprev) {
+					while (s->hashsize < 2u * s->nprev)
+						s->hashsize = s->hashsize ? s->hashsize * 2 : 512;
+					free(s->hash);
+					s->hash = xmalloc(s->hashsize * sizeof *s->hash);
+				}
+				mask = s->hashsize - 1;
+				memset(s->hash, -1, s->hashsize * sizeof *s->hash);
+				for (j = 0; j < s->nprev; j++) {
+					h = hash_name(s->prev[j].name) & mask;
+					while (s->hash[h] != -1)
+						h = (h + 1) & mask;
+					s->hash[h] = j;
+				}
+			}
+			for (h = hash_name(curr->name) & mask; (j = s->hash[h]) != -1; h = (h + 1) & mask) {
+				if (!strcmp(s->prev[j].name, curr->name)) {
+					old = &s->prev[j];
+					break;
+				}
+			}
+		}
+		curr->active_objs_delta = old ? (long)curr->nr_active_objs - (long)old->nr_active_objs : 0;
+	}
+}
+
+/*
+ * slab_totals - the derived numbers for each cache, and the sums
  */
-static int parse_slabinfo11(struct slab_info **list, struct slab_stat *stats,
-				FILE *f)
+static void slab_totals(slabs_t *restrict s)
 {
-	struct slab_info *curr = NULL, *prev = NULL;
-	char buffer[SLABINFO_LINE_LEN];
-	int entries = 0;
+	struct slab_stat *stats = &s->stats;
 	int page_size = getpagesize();
+	int i;
 
+	memset(stats, 0, sizeof *stats);
 	stats->min_obj_size = INT_MAX;
 	stats->max_obj_size = 0;
 
-	while (fgets(buffer, SLABINFO_LINE_LEN, f)) {
-		int assigned;
-
-		curr = get_slabnode();
-		if (!curr)
-			break;
-
-		if (entries++ == 0)
-			*list = curr;
-		else
-			prev->next = curr;
-
-		assigned = sscanf(buffer, "%" STRINGIFY(SLAB_INFO_NAME_LEN)
-				"s %d %d %d %d %d %d",
-				curr->name, &curr->nr_active_objs,
-				&curr->nr_objs, &curr->obj_size,
-				&curr->nr_active_slabs, &curr->nr_slabs,
-				&curr->pages_per_slab);
-
-		if (assigned < 6) {
-			fprintf(stderr, "unrecognizable data in  your slabinfo version 1.1\n\r");
-			if(slab_badname_detect(buffer))
-				fprintf(stderr, "Found an error in cache name at line %s\n", buffer); 
-			curr = NULL;
-			break;
-		}
+	for (i = 0; i < s->n; i++) {
+		struct slab_info *curr = &s->slab[i];
 
 		if (curr->obj_size < stats->min_obj_size)
 			stats->min_obj_size = curr->obj_size;
@@ -249,10 +473,6 @@ static int parse_slabinfo11(struct slab_info **list, struct slab_stat *stats,
 		} else
 			curr->use = 0;
 
-		if (curr->obj_size)
-			curr->objs_per_slab = curr->pages_per_slab *
-					page_size / curr->obj_size;		
-
 		stats->nr_objs += curr->nr_objs;
 		stats->nr_active_objs += curr->nr_active_objs;
 		stats->total_size += (unsigned long)curr->nr_objs * curr->obj_size;
@@ -260,78 +480,110 @@ static int parse_slabinfo11(struct slab_info **list, struct slab_stat *stats,
 		stats->nr_pages += curr->nr_slabs * curr->pages_per_slab;
 		stats->nr_slabs += curr->nr_slabs;
 		stats->nr_active_slabs += curr->nr_active_slabs;
-
-		prev = curr;
-	}
-
-	if (!curr) {
-		fprintf(stderr, "\rerror reading slabinfo!\n");
-		return 1;
 	}
 
-	curr->next = NULL;
-	stats->nr_caches = entries;
+	stats->nr_caches = s->n;
 	if (stats->nr_objs)
 		stats->avg_obj_size = stats->total_size / stats->nr_objs;
-
-	return 0;
 }
 
-/*
- * parse_slabinfo10 - actual parsing routine for slabinfo 1.0 (2.2 kernels)
- *
- * Not yet implemented.  Please feel free.
- */
-static int parse_slabinfo10(struct slab_info **list, struct slab_stat *stats,
-				FILE *f)
+static void swap_slabs(slabs_t *restrict s)
 {
-	(void) list, (void) stats, (void) f;
-	fprintf(stderr, "slabinfo version 1.0 not yet supported\n");
-	return 1;
+	struct slab_info *tmp = s->prev;
+	int size = s->prevsize;
+
+	s->prev = s->slab;
+	s->prevsize = s->size;
+	s->nprev = s->n;
+	s->slab = tmp;
+	s->size = size;
+	s->n = 0;
 }
 
 /*
- * slabinfo - parse the system's slabinfo and fill out both a linked list of
- * slab_info structures and the slab_stat structure
+ * read_slabs - parse the system's slab caches into s->slab[] and s->stats
  *
- * The function returns zero on success, in which case 'list' and 'stats' are
- * valid.  Nonzero is returned on failure and the state of 'list' and 'stats'
- * are undefined.
+ * The function returns zero on success.  Nonzero is returned on failure,
+ * and then 's' holds what the previous successful call read.
  */
-int get_slabinfo(struct slab_info **list, struct slab_stat *stats)
+int read_slabs(slabs_t *restrict s, int flags)
 {
-	FILE *slabfile;
-	char buffer[SLABINFO_VER_LEN];
-	int major, minor, ret = 0;
-
-	slabfile = fopen(SLABINFO_FILE, "r");
-	if (!slabfile) {
-		perror("fopen " SLABINFO_FILE);
-		return 1;
+	struct timeval tv;
+	double now;
+	int ret = -1;
+
+	swap_slabs(s);
+	if (!(flags & SLABS_SYSFS))
+		ret = read_slabinfo(s);
+	if (ret == -1) {
+		int err = errno;
+		flags |= SLABS_SYSFS;
+		ret = read_sysfs(s);
+		if (ret == -1) {
+			errno = err;
+			perror("fopen " SLABINFO_FILE);
+		}
 	}
-
-	if (!fgets(buffer, SLABINFO_VER_LEN, slabfile)) {
-		fprintf(stderr, "cannot read from slabinfo\n");
+	if (ret) {
+		int n = s->nprev;	// put back what was there
+		swap_slabs(s);
+		s->n = n;
+		s->nprev = 0;
 		return 1;
 	}
+	s->flags = flags & SLABS_SYSFS;
 
-	if (sscanf(buffer, "slabinfo - version: %d.%d", &major, &minor) != 2) {
-		fprintf(stderr, "not the good old slabinfo we know\n");
-		return 1;
-	}
+	gettimeofday(&tv, NULL);
+	now = tv.tv_sec + tv.tv_usec / 1000000.0;
+	s->elapsed = s->stamp ? now - s->stamp : 0;
+	s->stamp = now;
 
-	if (major == 2)
-		ret = parse_slabinfo20(list, stats, slabfile);
-	else if (major == 1 && minor == 1)
-		ret = parse_slabinfo11(list, stats, slabfile);
-	else if (major == 1 && minor == 0)
-		ret = parse_slabinfo10(list, stats, slabfile);
-	else {
-		fprintf(stderr, "unrecognizable slabinfo version\n");
+	slab_totals(s);
+	match_prev(s);
+	return 0;
+}
+
+void free_slabs(slabs_t *restrict s)
+{
+	free(s->slab);
+	free(s->prev);
+	free(s->buf);
+	free(s->hash);
+	memset(s, 0, sizeof *s);
+}
+
+static slabs_t compat_slabs;
+
+/*
+ * get_slabinfo - the slab caches as a linked list, which stays good until
+ * the next call.  Returns zero on success.
+ */
+int get_slabinfo(struct slab_info **list, struct slab_stat *stats)
+{
+	int i;
+
+	if (read_slabs(&compat_slabs, 0))
 		return 1;
-	}
+	for (i = 0; i < compat_slabs.n; i++)
+		compat_slabs.slab[i].next = (i + 1 < compat_slabs.n) ? &compat_slabs.slab[i + 1] : NULL;
+	*list = compat_slabs.n ? compat_slabs.slab : NULL;
+	*stats = compat_slabs.stats;
+	return 0;
+}
 
-	fclose(slabfile);
+/*
+ * put_slabinfo - nothing to do: the next get_slabinfo() reuses the array
+ */
+void put_slabinfo(struct slab_info *head)
+{
+	(void) head;
+}
 
-	return ret;
+/*
+ * free_slabinfo - deallocate the memory get_slabinfo() was using
+ */
+void free_slabinfo(struct slab_info *list)
+{
+	(void) list;
+	free_slabs(&compat_slabs);
 }
@@ -5,7 +5,7 @@
 
 struct slab_info {
 	char name[SLAB_INFO_NAME_LEN];  /* name of this cache */
-	struct slab_info *next;
+	struct slab_info *next;         /* only for get_slabinfo() */
 	unsigned long cache_size;       /* size of entire cache */
 	unsigned nr_objs;               /* number of objects in this cache */
 	unsigned nr_active_objs;        /* number of active objects */
@@ -15,6 +15,7 @@ struct slab_info {
 	unsigned nr_slabs;              /* number of slabs in this cache */
 	unsigned nr_active_slabs;       /* number of active slabs */
 	unsigned use;                   /* percent full: total / active */
+	long active_objs_delta;         /* change in nr_active_objs since the last read_slabs() */
 };
 
 struct slab_stat {
@@ -32,6 +33,40 @@ struct slab_stat {
 	unsigned max_obj_size;          /* size of largest object */
 };
 
+/*
+ * All the caches, in one array that read_slabs() refills in place.  The
+ * records from the read before are kept too, so each cache can be matched
+ * up by name with what it was then: that's what active_objs_delta is.
+ * Start with a zeroed slabs_t.
+ */
+typedef struct slabs_t {
+	struct slab_info *slab;         /* n caches, in the kernel's order */
+	int n;
+	int flags;                      /* what was actually read: SLABS_SYSFS or not */
+	struct slab_stat stats;
+	double elapsed;                 /* seconds since the last read, 0 the first time */
+/* private */
+	struct slab_info *prev;         /* the last read's records */
+	int nprev;
+	int size, prevsize;             /* room in slab[] and prev[] */
+	unsigned bufsize;
+	char *buf;
+	int *hash;                      /* prev[] by name */
+	unsigned hashsize;
+	double stamp;
+} slabs_t;
+
+#define SLABS_SYSFS   0x1       /* read /sys/kernel/slab rather than /proc/slabinfo */
+
+/*
+ * read_slabs - fill in 's' from /proc/slabinfo, or from the SLUB directory
+ * /sys/kernel/slab if SLABS_SYSFS is given or slabinfo can't be read (it's
+ * only readable by root).  Returns 0, or nonzero with an error printed.
+ */
+extern int read_slabs(slabs_t *restrict s, int flags);
+extern void free_slabs(slabs_t *restrict s);
+
+/* the old linked-list interface, valid until the next get_slabinfo() */
 extern void put_slabinfo(struct slab_info *);
 extern void free_slabinfo(struct slab_info *);
 extern int get_slabinfo(struct slab_info **, struct slab_stat *);
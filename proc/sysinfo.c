@@ -11,14 +11,19 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 #include <locale.h>
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/time.h>
+#include "alloc.h"
 #include "version.h"
 #include "sysinfo.h" /* include self to verify prototypes */
+#include "replay.h"
+#include "share.h"
 
 #ifndef HZ
 #include <netinet/in.h>  /* htons */
@@ -39,9 +44,7 @@ static int uptime_fd = -1;
 #define LOADAVG_FILE "/proc/loadavg"
 static int loadavg_fd = -1;
 #define MEMINFO_FILE "/proc/meminfo"
-static int meminfo_fd = -1;
 #define VMINFO_FILE "/proc/vmstat"
-static int vminfo_fd = -1;
 
 // As of 2.6.24 /proc/meminfo seems to need 888 on 64-bit,
 // and would need 1258 if the obsolete fields were there.
@@ -53,6 +56,11 @@ static char buf[2048];
  */
 #define FILE_TO_BUF(filename, fd) do{				\
     static int local_n;						\
+    if (replay_image) {						\
+	if (replay_copy(filename, buf, sizeof buf) == -1)	\
+	    bad_open();						\
+	break;							\
+    }								\
     if (fd == -1 && (fd = open(filename, O_RDONLY)) == -1) {	\
 	fputs(BAD_OPEN_MESSAGE, stderr);			\
 	fflush(NULL);						\
@@ -70,6 +78,76 @@ static char buf[2048];
 /* evals 'x' twice */
 #define SET_IF_DESIRED(x,y) do{  if(x) *(x) = (y); }while(0)
 
+/***********************************************************************
+ * Snapshot support.  Unlike FILE_TO_BUF, nothing here touches a shared
+ * buffer or file offset: the file descriptors are opened once and then
+ * only read with pread(), into a buffer supplied by the caller that is
+ * replaced by a bigger heap one if the file does not fit.  So any number
+ * of threads may take snapshots at once.
+ */
+
+/* indexed by the bit number of the SNAP_* flags */
+static const char *const snap_names[] = {
+  STAT_FILE, MEMINFO_FILE, VMINFO_FILE, LOADAVG_FILE, UPTIME_FILE
+};
+static int snap_fds[] = { -1, -1, -1, -1, -1 };
+
+static int snap_index(unsigned which){
+  int i = 0;
+  while(!(which & 1u)){
+    which >>= 1;
+    i++;
+  }
+  return i;
+}
+
+/* Returns the NUL-terminated file contents in 'sbuf' or, if that was too
+ * small, in a malloc'd buffer that the caller must free.  NULL on error. */
+static char *snap_file(unsigned which, char *sbuf, size_t cap){
+  int i = snap_index(which);
+  int fd = snap_fds[i];
+  char *b = sbuf;
+  ssize_t n;
+
+  if(replay_image){
+    unsigned len;
+    const char *d = replay_data(snap_names[i], &len);
+    if(!d) return NULL;
+    if(len >= cap) b = xmalloc(len + 1);
+    memcpy(b, d, len);
+    b[len] = '\0';
+    return b;
+  }
+  if(fd == -1){
+    fd = open(snap_names[i], O_RDONLY|O_CLOEXEC);
+    if(fd == -1) return NULL;
+    if(!__sync_bool_compare_and_swap(&snap_fds[i], -1, fd)){
+      close(fd);      /* another thread got there first */
+      fd = snap_fds[i];
+    }
+  }
+  for(;;){
+    n = pread(fd, b, cap-1, 0);
+    if(n < 0) break;
+    if((size_t)n < cap-1){
+      b[n] = '\0';
+      return b;
+    }
+    /* it might have been truncated; use a bigger buffer and retry */
+    cap *= 2;
+    if(b == sbuf) b = xmalloc(cap);
+    else          b = xrealloc(b, cap);
+  }
+  if(b != sbuf) free(b);
+  return NULL;
+}
+
+static void bad_open(void){
+  fputs(BAD_OPEN_MESSAGE, stderr);
+  fflush(NULL);
+  _exit(102);
+}
+
 
 /***********************************************************************/
 int uptime(double *restrict uptime_secs, double *restrict idle_secs) {
@@ -211,6 +289,7 @@ static int check_for_privs(void){
 
 static void init_libproc(void) __attribute__((constructor));
 static void init_libproc(void){
+  replay_init();
   have_privs = check_for_privs();
   init_Linux_version();
   // ought to count CPUs in /proc/stat instead of relying
@@ -222,6 +301,7 @@ static void init_libproc(void){
   // _SC_NPROCESSORS_ONLN returns 1, which should work OK
   smp_num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
   if(smp_num_cpus<1) smp_num_cpus=1; /* SPARC glibc is buggy */
+  if(replay_image && replay_image->ncpus) smp_num_cpus = replay_image->ncpus;
 
   if(linux_version_code > LINUX_VERSION(2, 4, 0)){ 
     Hertz = find_elf_note(AT_CLKTCK);
@@ -383,13 +463,17 @@ void getstat(jiff *restrict cuse, jiff *restrict cice, jiff *restrict csys, jiff
   const char* b;
   buff[BUFFSIZE-1] = 0;  /* ensure null termination in buffer */
 
-  if(fd){
-    lseek(fd, 0L, SEEK_SET);
+  if(replay_image){
+    if(replay_copy("/proc/stat", buff, BUFFSIZE) == -1) crash("/proc/stat");
   }else{
-    fd = open("/proc/stat", O_RDONLY, 0);
-    if(fd == -1) crash("/proc/stat");
+    if(fd){
+      lseek(fd, 0L, SEEK_SET);
+    }else{
+      fd = open("/proc/stat", O_RDONLY, 0);
+      if(fd == -1) crash("/proc/stat");
+    }
+    read(fd,buff,BUFFSIZE-1);
   }
-  read(fd,buff,BUFFSIZE-1);
   *intr = 0; 
   *ciow = 0;  /* not separated out until the 2.5.41 kernel */
   *cxxx = 0;  /* not separated out until the 2.6.0-test4 kernel */
@@ -444,6 +528,141 @@ void getstat(jiff *restrict cuse, jiff *restrict cice, jiff *restrict csys, jiff
   }
 }
 
+/***********************************************************************/
+
+/* setlocale() is not thread-safe, so parse "123.45" by hand */
+static double snap_double(const char *restrict S, char **restrict endp){
+  double v, scale;
+  char *t;
+
+  v = strtoull(S, &t, 10);
+  if(*t == '.'){
+    for(scale = 0.1, t++; isdigit(*t); t++, scale /= 10)
+      v += (*t - '0') * scale;
+  }
+  *endp = t;
+  return v;
+}
+
+/* does the line at S begin with the keyword K (which includes the blank)? */
+#define KEY(S,K) (!strncmp((S), (K), sizeof(K)-1) && ((S) += sizeof(K)-1))
+
+static void parse_stat(char *head, sysinfo_snap *restrict s, int *restrict need_vmstat_file){
+  int seen_page = 0, seen_swap = 0, seen_procs = 0;
+  char *b = head;
+
+  while(*b){
+    if(KEY(b, "cpu ")){
+      s->cpu_use = strtoull(b, &b, 10);
+      s->cpu_nic = strtoull(b, &b, 10);
+      s->cpu_sys = strtoull(b, &b, 10);
+      s->cpu_idl = strtoull(b, &b, 10);
+      s->cpu_iow = strtoull(b, &b, 10);  /* not separated out until the 2.5.41 kernel */
+      s->cpu_xxx = strtoull(b, &b, 10);  /* not separated out until the 2.6.0-test4 kernel */
+      s->cpu_yyy = strtoull(b, &b, 10);  /* not separated out until the 2.6.0-test4 kernel */
+      s->cpu_zzz = strtoull(b, &b, 10);  /* not separated out until the 2.6.11 kernel */
+    }else if(KEY(b, "page ")){
+      s->vm_pgpgin  = strtoul(b, &b, 10);
+      s->vm_pgpgout = strtoul(b, &b, 10);
+      seen_page = 1;
+    }else if(KEY(b, "swap ")){
+      s->vm_pswpin  = strtoul(b, &b, 10);
+      s->vm_pswpout = strtoul(b, &b, 10);
+      seen_swap = 1;
+    }else if(KEY(b, "intr ")){
+      s->intr = strtoull(b, &b, 10);
+    }else if(KEY(b, "ctxt ")){
+      s->ctxt = strtoull(b, &b, 10);
+    }else if(KEY(b, "btime ")){
+      s->btime = strtoul(b, &b, 10);
+    }else if(KEY(b, "processes ")){
+      s->processes = strtoul(b, &b, 10);
+    }else if(KEY(b, "procs_running ")){
+      s->running = strtoul(b, &b, 10);
+      seen_procs++;
+    }else if(KEY(b, "procs_blocked ")){
+      s->blocked = strtoul(b, &b, 10);
+      seen_procs++;
+    }
+    b = strchr(b, '\n');
+    if(!b) break;
+    b++;
+  }
+  if(seen_procs < 2)    /* Linux 2.5.46 (approximately) and below */
+    getrunners(&s->running, &s->blocked);
+  *need_vmstat_file = !(seen_page && seen_swap);  /* Linux 2.5.40-bk4 and above */
+}
+
+#undef KEY
+
+static void parse_meminfo(char *head, sysinfo_snap *restrict s);
+static void parse_vmstat(char *head, sysinfo_snap *restrict s);
+
+int sysinfo_snapshot(sysinfo_snap *restrict s, unsigned what){
+  char sbuf[8192];  // big enough for all but /proc/stat on many-CPU boxes
+  int need_vmstat_file = 0;
+  char *b, *t;
+  int rc = 0;
+
+  if((what & SNAP_SHARED) && share_sysinfo(s, what)) return 0;
+  memset(s, 0, sizeof *s);
+  gettimeofday(&s->tv, NULL);
+
+  if(what & SNAP_STAT){
+    if((b = snap_file(SNAP_STAT, sbuf, sizeof sbuf))){
+      parse_stat(b, s, &need_vmstat_file);
+      if(b != sbuf) free(b);
+      s->have |= SNAP_STAT;
+    }else rc = -1;
+  }
+  if(what & SNAP_MEMINFO){
+    if((b = snap_file(SNAP_MEMINFO, sbuf, sizeof sbuf))){
+      parse_meminfo(b, s);
+      if(b != sbuf) free(b);
+      s->have |= SNAP_MEMINFO;
+    }else rc = -1;
+  }
+  if((what & SNAP_VMSTAT) || need_vmstat_file){
+    if((b = snap_file(SNAP_VMSTAT, sbuf, sizeof sbuf))){
+      parse_vmstat(b, s);
+      if(b != sbuf) free(b);
+      if(what & SNAP_VMSTAT) s->have |= SNAP_VMSTAT;
+    }else rc = -1;
+  }
+  if(what & SNAP_LOADAVG){
+    if((b = snap_file(SNAP_LOADAVG, sbuf, sizeof sbuf))){
+      s->loadavg[0] = snap_double(b, &t);
+      s->loadavg[1] = snap_double(t, &t);
+      s->loadavg[2] = snap_double(t, &t);
+      s->have |= SNAP_LOADAVG;
+    }else rc = -1;
+  }
+  if(what & SNAP_UPTIME){
+    if((b = snap_file(SNAP_UPTIME, sbuf, sizeof sbuf))){
+      s->uptime = snap_double(b, &t);
+      s->idle   = snap_double(t, &t);
+      s->have |= SNAP_UPTIME;
+    }else rc = -1;
+  }
+  return rc;
+}
+
+void sysinfo_delta(sysinfo_snap *restrict d, const sysinfo_snap *restrict now, const sysinfo_snap *restrict then){
+  *d = *now;
+#define DIFF(x) d->x = now->x - then->x
+  timersub(&now->tv, &then->tv, &d->tv);
+  DIFF(uptime);      DIFF(idle);
+  DIFF(cpu_use);     DIFF(cpu_nic);     DIFF(cpu_sys);     DIFF(cpu_idl);
+  DIFF(cpu_iow);     DIFF(cpu_xxx);     DIFF(cpu_yyy);     DIFF(cpu_zzz);
+  DIFF(intr);        DIFF(ctxt);        DIFF(processes);
+  DIFF(vm_pgpgin);   DIFF(vm_pgpgout);  DIFF(vm_pswpin);   DIFF(vm_pswpout);
+  DIFF(vm_pgalloc);  DIFF(vm_pgfree);   DIFF(vm_pgactivate); DIFF(vm_pgdeactivate);
+  DIFF(vm_pgfault);  DIFF(vm_pgmajfault); DIFF(vm_pgscan); DIFF(vm_pgrefill);
+  DIFF(vm_pgsteal);  DIFF(vm_kswapd_steal); DIFF(vm_pageoutrun);
+  DIFF(vm_allocstall); DIFF(vm_pgrotated);
+#undef DIFF
+}
+
 /***********************************************************************/
 /*
  * Copyright 1999 by Albert Cahalan; all rights reserved.
@@ -458,7 +677,7 @@ void getstat(jiff *restrict cuse, jiff *restrict cice, jiff *restrict csys, jiff
 
 typedef struct mem_table_struct {
   const char *name;     /* memory type name */
-  unsigned long *slot; /* slot in return struct */
+  size_t offset;        /* slot in a sysinfo_snap */
 } mem_table_struct;
 
 static int compare_mem_table_structs(const void *a, const void *b){
@@ -530,71 +749,106 @@ unsigned long kb_dirty;
 unsigned long kb_inactive;
 unsigned long kb_mapped;
 unsigned long kb_pagetables;
-// seen on a 2.6.x kernel:
-static unsigned long kb_vmalloc_chunk;
-static unsigned long kb_vmalloc_total;
-static unsigned long kb_vmalloc_used;
-// seen on 2.6.24-rc6-git12
-static unsigned long kb_anon_pages;
-static unsigned long kb_bounce;
-static unsigned long kb_commit_limit;
-static unsigned long kb_nfs_unstable;
-static unsigned long kb_swap_reclaimable;
-static unsigned long kb_swap_unreclaimable;
 
-void meminfo(void){
+#define SLOT(name,member) {name, offsetof(sysinfo_snap, member)}
+
+/* The kernel writes /proc/meminfo the same way every time, so after the
+ * first read each line's slot is known by its position alone.  The first
+ * parse notes, for each line, where its ':' is and its first letter --
+ * as a check -- and the slot it went to.  Later parses just walk the
+ * lines with that.  Should a line not match, or the count be off, that
+ * parse is done by name again; the layout first seen is kept. */
+#define MEM_NO_SLOT 0xffff
+typedef struct mem_line {
+  unsigned short offset;   /* slot in a sysinfo_snap, or MEM_NO_SLOT */
+  unsigned char colon;     /* the name's length */
+  char first;              /* the name's first letter */
+} mem_line;
+
+typedef struct mem_layout {
+  int n;
+  mem_line line[];
+} mem_layout;
+
+static mem_layout *mem_layout_seen;   /* set once, then only read */
+
+/* 0 if head was parsed by the layout, -1 to do it by name */
+static int parse_meminfo_fast(const char *head, sysinfo_snap *restrict s, const mem_layout *lay){
+  const char *end = head + strlen(head);
+  char *tail;
+  int i;
+
+  for(i = 0; i < lay->n; i++){
+    const mem_line *l = &lay->line[i];
+    if(head + l->colon >= end || head[l->colon] != ':' || *head != l->first) return -1;
+    head += l->colon + 1;
+    if(l->offset != MEM_NO_SLOT){
+      *(unsigned long *)((char *)s + l->offset) = strtoul(head, &tail, 10);
+      head = tail;
+    }
+    head = strchr(head, '\n');
+    if(!head) return i + 1 == lay->n ? 0 : -1;
+    head++;
+  }
+  return *head ? -1 : 0;
+}
+
+static void parse_meminfo(char *head, sysinfo_snap *restrict s){
   char namebuf[16]; /* big enough to hold any row name */
-  mem_table_struct findme = { namebuf, NULL};
+  mem_table_struct findme = { namebuf, 0};
   mem_table_struct *found;
-  char *head;
+  const mem_layout *lay = mem_layout_seen;
+  mem_line *line = NULL;
+  int noting = !lay, n = 0, room = 0;
   char *tail;
   static const mem_table_struct mem_table[] = {
-  {"Active",       &kb_active},       // important
-  {"AnonPages",    &kb_anon_pages},
-  {"Bounce",       &kb_bounce},
-  {"Buffers",      &kb_main_buffers}, // important
-  {"Cached",       &kb_main_cached},  // important
-  {"CommitLimit",  &kb_commit_limit},
-  {"Committed_AS", &kb_committed_as},
-  {"Dirty",        &kb_dirty},        // kB version of vmstat nr_dirty
-  {"HighFree",     &kb_high_free},
-  {"HighTotal",    &kb_high_total},
-  {"Inact_clean",  &kb_inact_clean},
-  {"Inact_dirty",  &kb_inact_dirty},
-  {"Inact_laundry",&kb_inact_laundry},
-  {"Inact_target", &kb_inact_target},
-  {"Inactive",     &kb_inactive},     // important
-  {"LowFree",      &kb_low_free},
-  {"LowTotal",     &kb_low_total},
-  {"Mapped",       &kb_mapped},       // kB version of vmstat nr_mapped
-  {"MemFree",      &kb_main_free},    // important
-  {"MemShared",    &kb_main_shared},  // important, but now gone!
-  {"MemTotal",     &kb_main_total},   // important
-  {"NFS_Unstable", &kb_nfs_unstable},
-  {"PageTables",   &kb_pagetables},   // kB version of vmstat nr_page_table_pages
-  {"ReverseMaps",  &nr_reversemaps},  // same as vmstat nr_page_table_pages
-  {"SReclaimable", &kb_swap_reclaimable}, // "swap reclaimable" (dentry and inode structures)
-  {"SUnreclaim",   &kb_swap_unreclaimable},
-  {"Slab",         &kb_slab},         // kB version of vmstat nr_slab
-  {"SwapCached",   &kb_swap_cached},
-  {"SwapFree",     &kb_swap_free},    // important
-  {"SwapTotal",    &kb_swap_total},   // important
-  {"VmallocChunk", &kb_vmalloc_chunk},
-  {"VmallocTotal", &kb_vmalloc_total},
-  {"VmallocUsed",  &kb_vmalloc_used},
-  {"Writeback",    &kb_writeback},    // kB version of vmstat nr_writeback
+  SLOT("Active",       kb_active),       // important
+  SLOT("Buffers",      kb_main_buffers), // important
+  SLOT("Cached",       kb_main_cached),  // important
+  SLOT("Committed_AS", kb_committed_as),
+  SLOT("Dirty",        kb_dirty),        // kB version of vmstat nr_dirty
+  SLOT("HighFree",     kb_high_free),
+  SLOT("HighTotal",    kb_high_total),
+  SLOT("Inact_clean",  kb_inact_clean),
+  SLOT("Inact_dirty",  kb_inact_dirty),
+  SLOT("Inact_laundry",kb_inact_laundry),
+  SLOT("Inact_target", kb_inact_target),
+  SLOT("Inactive",     kb_inactive),     // important
+  SLOT("LowFree",      kb_low_free),
+  SLOT("LowTotal",     kb_low_total),
+  SLOT("Mapped",       kb_mapped),       // kB version of vmstat nr_mapped
+  SLOT("MemFree",      kb_main_free),    // important
+  SLOT("MemShared",    kb_main_shared),  // important, but now gone!
+  SLOT("MemTotal",     kb_main_total),   // important
+  SLOT("PageTables",   kb_pagetables),   // kB version of vmstat nr_page_table_pages
+  SLOT("ReverseMaps",  nr_reversemaps),  // same as vmstat nr_page_table_pages
+  SLOT("Slab",         kb_slab),         // kB version of vmstat nr_slab
+  SLOT("SwapCached",   kb_swap_cached),
+  SLOT("SwapFree",     kb_swap_free),    // important
+  SLOT("SwapTotal",    kb_swap_total),   // important
+  SLOT("Writeback",    kb_writeback),    // kB version of vmstat nr_writeback
   };
   const int mem_table_count = sizeof(mem_table)/sizeof(mem_table_struct);
 
-  FILE_TO_BUF(MEMINFO_FILE,meminfo_fd);
+  s->kb_inactive = ~0UL;
 
-  kb_inactive = ~0UL;
+  if(lay && !parse_meminfo_fast(head, s, lay)) goto derived;
 
-  head = buf;
   for(;;){
     tail = strchr(head, ':');
     if(!tail) break;
     *tail = '\0';
+    if(noting){  /* the first time: note the layout as it goes by */
+      if(n == room){
+        room = room ? room * 2 : 64;
+        line = xrealloc(line, sizeof *line * room);
+      }
+      line[n].offset = MEM_NO_SLOT;
+      line[n].colon = tail - head;
+      line[n].first = *head;
+      if(tail == head || tail - head > 255) noting = 0;  /* can't be noted */
+      n++;
+    }
     if(strlen(head) >= sizeof(namebuf)){
       head = tail+1;
       goto nextline;
@@ -605,21 +859,71 @@ void meminfo(void){
     );
     head = tail+1;
     if(!found) goto nextline;
-    *(found->slot) = strtoul(head,&tail,10);
+    *(unsigned long *)((char *)s + found->offset) = strtoul(head,&tail,10);
+    if(noting) line[n-1].offset = found->offset;
 nextline:
     tail = strchr(head, '\n');
     if(!tail) break;
     head = tail+1;
   }
-  if(!kb_low_total){  /* low==main except with large-memory support */
-    kb_low_total = kb_main_total;
-    kb_low_free  = kb_main_free;
+  if(noting && n){
+    mem_layout *seen = xmalloc(sizeof *seen + sizeof *line * n);
+    seen->n = n;
+    memcpy(seen->line, line, sizeof *line * n);
+    if(!__sync_bool_compare_and_swap(&mem_layout_seen, NULL, seen))
+      free(seen);     /* another thread got there first */
   }
-  if(kb_inactive==~0UL){
-    kb_inactive = kb_inact_dirty + kb_inact_clean + kb_inact_laundry;
+  free(line);
+derived:
+  if(!s->kb_low_total){  /* low==main except with large-memory support */
+    s->kb_low_total = s->kb_main_total;
+    s->kb_low_free  = s->kb_main_free;
   }
-  kb_swap_used = kb_swap_total - kb_swap_free;
-  kb_main_used = kb_main_total - kb_main_free;
+  if(s->kb_inactive==~0UL){
+    s->kb_inactive = s->kb_inact_dirty + s->kb_inact_clean + s->kb_inact_laundry;
+  }
+  s->kb_swap_used = s->kb_swap_total - s->kb_swap_free;
+  s->kb_main_used = s->kb_main_total - s->kb_main_free;
+}
+
+void meminfo(void){
+  char sbuf[4096];
+  sysinfo_snap s;
+  char *b;
+
+  b = snap_file(SNAP_MEMINFO, sbuf, sizeof sbuf);
+  if(!b) bad_open();
+  memset(&s, 0, sizeof s);
+  parse_meminfo(b, &s);
+  if(b != sbuf) free(b);
+
+  kb_main_shared   = s.kb_main_shared;
+  kb_main_buffers  = s.kb_main_buffers;
+  kb_main_cached   = s.kb_main_cached;
+  kb_main_free     = s.kb_main_free;
+  kb_main_total    = s.kb_main_total;
+  kb_swap_free     = s.kb_swap_free;
+  kb_swap_total    = s.kb_swap_total;
+  kb_high_free     = s.kb_high_free;
+  kb_high_total    = s.kb_high_total;
+  kb_low_free      = s.kb_low_free;
+  kb_low_total     = s.kb_low_total;
+  kb_active        = s.kb_active;
+  kb_inact_laundry = s.kb_inact_laundry;
+  kb_inact_dirty   = s.kb_inact_dirty;
+  kb_inact_clean   = s.kb_inact_clean;
+  kb_inact_target  = s.kb_inact_target;
+  kb_swap_cached   = s.kb_swap_cached;
+  kb_swap_used     = s.kb_swap_used;
+  kb_main_used     = s.kb_main_used;
+  kb_writeback     = s.kb_writeback;
+  kb_slab          = s.kb_slab;
+  nr_reversemaps   = s.nr_reversemaps;
+  kb_committed_as  = s.kb_committed_as;
+  kb_dirty         = s.kb_dirty;
+  kb_inactive      = s.kb_inactive;
+  kb_mapped        = s.kb_mapped;
+  kb_pagetables    = s.kb_pagetables;
 }
 
 /*****************************************************************/
@@ -628,7 +932,8 @@ nextline:
 
 typedef struct vm_table_struct {
   const char *name;     /* VM statistic name */
-  unsigned long *slot;       /* slot in return struct */
+  size_t offset;        /* slot in a sysinfo_snap */
+  size_t part;          /* or else 1+ index of the total it is part of */
 } vm_table_struct;
 
 static int compare_vm_table_structs(const void *a, const void *b){
@@ -661,89 +966,71 @@ unsigned long vm_kswapd_steal; // pages reclaimed by kswapd
 unsigned long vm_pageoutrun;  // times kswapd ran page reclaim
 unsigned long vm_allocstall; // times a page allocator ran direct reclaim
 unsigned long vm_pgrotated; // pages rotated to the tail of the LRU for immediate reclaim
+
+#undef SLOT
+#define SLOT(name,member) {name, offsetof(sysinfo_snap, member), 0}
 // seen on a 2.6.8-rc1 kernel, apparently replacing old fields
-static unsigned long vm_pgalloc_dma;          // 
-static unsigned long vm_pgalloc_high;         // 
-static unsigned long vm_pgalloc_normal;       // 
-static unsigned long vm_pgrefill_dma;         // 
-static unsigned long vm_pgrefill_high;        // 
-static unsigned long vm_pgrefill_normal;      // 
-static unsigned long vm_pgscan_direct_dma;    // 
-static unsigned long vm_pgscan_direct_high;   // 
-static unsigned long vm_pgscan_direct_normal; // 
-static unsigned long vm_pgscan_kswapd_dma;    // 
-static unsigned long vm_pgscan_kswapd_high;   // 
-static unsigned long vm_pgscan_kswapd_normal; // 
-static unsigned long vm_pgsteal_dma;          // 
-static unsigned long vm_pgsteal_high;         // 
-static unsigned long vm_pgsteal_normal;       // 
-// seen on a 2.6.8-rc1 kernel
-static unsigned long vm_kswapd_inodesteal;    //
-static unsigned long vm_nr_unstable;          //
-static unsigned long vm_pginodesteal;         //
-static unsigned long vm_slabs_scanned;        //
+enum { PART_PGALLOC = 1, PART_PGREFILL, PART_PGSCAN, PART_PGSTEAL };
+#define PART(name,total) {name, 0, total}
 
-void vminfo(void){
-  char namebuf[16]; /* big enough to hold any row name */
-  vm_table_struct findme = { namebuf, NULL};
+static void parse_vmstat(char *head, sysinfo_snap *restrict s){
+  char namebuf[24]; /* big enough to hold any row name */
+  vm_table_struct findme = { namebuf, 0, 0};
   vm_table_struct *found;
-  char *head;
+  unsigned long parts[5] = {0};
   char *tail;
   static const vm_table_struct vm_table[] = {
-  {"allocstall",          &vm_allocstall},
-  {"kswapd_inodesteal",   &vm_kswapd_inodesteal},
-  {"kswapd_steal",        &vm_kswapd_steal},
-  {"nr_dirty",            &vm_nr_dirty},           // page version of meminfo Dirty
-  {"nr_mapped",           &vm_nr_mapped},          // page version of meminfo Mapped
-  {"nr_page_table_pages", &vm_nr_page_table_pages},// same as meminfo PageTables
-  {"nr_pagecache",        &vm_nr_pagecache},       // gone in 2.5.66+ kernels
-  {"nr_reverse_maps",     &vm_nr_reverse_maps},    // page version of meminfo ReverseMaps GONE
-  {"nr_slab",             &vm_nr_slab},            // page version of meminfo Slab
-  {"nr_unstable",         &vm_nr_unstable},
-  {"nr_writeback",        &vm_nr_writeback},       // page version of meminfo Writeback
-  {"pageoutrun",          &vm_pageoutrun},
-  {"pgactivate",          &vm_pgactivate},
-  {"pgalloc",             &vm_pgalloc},  // GONE (now separate dma,high,normal)
-  {"pgalloc_dma",         &vm_pgalloc_dma},
-  {"pgalloc_high",        &vm_pgalloc_high},
-  {"pgalloc_normal",      &vm_pgalloc_normal},
-  {"pgdeactivate",        &vm_pgdeactivate},
-  {"pgfault",             &vm_pgfault},
-  {"pgfree",              &vm_pgfree},
-  {"pginodesteal",        &vm_pginodesteal},
-  {"pgmajfault",          &vm_pgmajfault},
-  {"pgpgin",              &vm_pgpgin},     // important
-  {"pgpgout",             &vm_pgpgout},     // important
-  {"pgrefill",            &vm_pgrefill},  // GONE (now separate dma,high,normal)
-  {"pgrefill_dma",        &vm_pgrefill_dma},
-  {"pgrefill_high",       &vm_pgrefill_high},
-  {"pgrefill_normal",     &vm_pgrefill_normal},
-  {"pgrotated",           &vm_pgrotated},
-  {"pgscan",              &vm_pgscan},  // GONE (now separate direct,kswapd and dma,high,normal)
-  {"pgscan_direct_dma",   &vm_pgscan_direct_dma},
-  {"pgscan_direct_high",  &vm_pgscan_direct_high},
-  {"pgscan_direct_normal",&vm_pgscan_direct_normal},
-  {"pgscan_kswapd_dma",   &vm_pgscan_kswapd_dma},
-  {"pgscan_kswapd_high",  &vm_pgscan_kswapd_high},
-  {"pgscan_kswapd_normal",&vm_pgscan_kswapd_normal},
-  {"pgsteal",             &vm_pgsteal},  // GONE (now separate dma,high,normal)
-  {"pgsteal_dma",         &vm_pgsteal_dma},
-  {"pgsteal_high",        &vm_pgsteal_high},
-  {"pgsteal_normal",      &vm_pgsteal_normal},
-  {"pswpin",              &vm_pswpin},     // important
-  {"pswpout",             &vm_pswpout},     // important
-  {"slabs_scanned",       &vm_slabs_scanned},
+  SLOT("allocstall",          vm_allocstall),
+  PART("kswapd_inodesteal",   0),
+  SLOT("kswapd_steal",        vm_kswapd_steal),
+  SLOT("nr_dirty",            vm_nr_dirty),           // page version of meminfo Dirty
+  SLOT("nr_mapped",           vm_nr_mapped),          // page version of meminfo Mapped
+  SLOT("nr_page_table_pages", vm_nr_page_table_pages),// same as meminfo PageTables
+  SLOT("nr_pagecache",        vm_nr_pagecache),       // gone in 2.5.66+ kernels
+  SLOT("nr_reverse_maps",     vm_nr_reverse_maps),    // page version of meminfo ReverseMaps GONE
+  SLOT("nr_slab",             vm_nr_slab),            // page version of meminfo Slab
+  PART("nr_unstable",         0),
+  SLOT("nr_writeback",        vm_nr_writeback),       // page version of meminfo Writeback
+  SLOT("pageoutrun",          vm_pageoutrun),
+  SLOT("pgactivate",          vm_pgactivate),
+  SLOT("pgalloc",             vm_pgalloc),  // GONE (now separate dma,high,normal)
+  PART("pgalloc_dma",         PART_PGALLOC),
+  PART("pgalloc_high",        PART_PGALLOC),
+  PART("pgalloc_normal",      PART_PGALLOC),
+  SLOT("pgdeactivate",        vm_pgdeactivate),
+  SLOT("pgfault",             vm_pgfault),
+  SLOT("pgfree",              vm_pgfree),
+  PART("pginodesteal",        0),
+  SLOT("pgmajfault",          vm_pgmajfault),
+  SLOT("pgpgin",              vm_pgpgin),     // important
+  SLOT("pgpgout",             vm_pgpgout),     // important
+  SLOT("pgrefill",            vm_pgrefill),  // GONE (now separate dma,high,normal)
+  PART("pgrefill_dma",        PART_PGREFILL),
+  PART("pgrefill_high",       PART_PGREFILL),
+  PART("pgrefill_normal",     PART_PGREFILL),
+  SLOT("pgrotated",           vm_pgrotated),
+  SLOT("pgscan",              vm_pgscan),  // GONE (now separate direct,kswapd and dma,high,normal)
+  PART("pgscan_direct_dma",   PART_PGSCAN),
+  PART("pgscan_direct_high",  PART_PGSCAN),
+  PART("pgscan_direct_normal",PART_PGSCAN),
+  PART("pgscan_kswapd_dma",   PART_PGSCAN),
+  PART("pgscan_kswapd_high",  PART_PGSCAN),
+  PART("pgscan_kswapd_normal",PART_PGSCAN),
+  SLOT("pgsteal",             vm_pgsteal),  // GONE (now separate dma,high,normal)
+  PART("pgsteal_dma",         PART_PGSTEAL),
+  PART("pgsteal_high",        PART_PGSTEAL),
+  PART("pgsteal_normal",      PART_PGSTEAL),
+  SLOT("pswpin",              vm_pswpin),     // important
+  SLOT("pswpout",             vm_pswpout),     // important
+  PART("slabs_scanned",       0),
   };
   const int vm_table_count = sizeof(vm_table)/sizeof(vm_table_struct);
 
-  vm_pgalloc = 0;
-  vm_pgrefill = 0;
-  vm_pgscan = 0;
-  vm_pgsteal = 0;
-
-  FILE_TO_BUF(VMINFO_FILE,vminfo_fd);
+  s->vm_pgalloc = 0;
+  s->vm_pgrefill = 0;
+  s->vm_pgscan = 0;
+  s->vm_pgsteal = 0;
 
-  head = buf;
   for(;;){
     tail = strchr(head, ' ');
     if(!tail) break;
@@ -758,7 +1045,8 @@ void vminfo(void){
     );
     head = tail+1;
     if(!found) goto nextline;
-    *(found->slot) = strtoul(head,&tail,10);
+    if(found->offset) *(unsigned long *)((char *)s + found->offset) = strtoul(head,&tail,10);
+    else              parts[found->part] += strtoul(head,&tail,10);
 nextline:
 
 //if(found) fprintf(stderr,"%s=%d\n",found->name,*(found->slot));
@@ -768,17 +1056,52 @@ nextline:
     if(!tail) break;
     head = tail+1;
   }
-  if(!vm_pgalloc)
-    vm_pgalloc  = vm_pgalloc_dma + vm_pgalloc_high + vm_pgalloc_normal;
-  if(!vm_pgrefill)
-    vm_pgrefill = vm_pgrefill_dma + vm_pgrefill_high + vm_pgrefill_normal;
-  if(!vm_pgscan)
-    vm_pgscan   = vm_pgscan_direct_dma + vm_pgscan_direct_high + vm_pgscan_direct_normal
-                + vm_pgscan_kswapd_dma + vm_pgscan_kswapd_high + vm_pgscan_kswapd_normal;
-  if(!vm_pgsteal)
-    vm_pgsteal  = vm_pgsteal_dma + vm_pgsteal_high + vm_pgsteal_normal;
+  if(!s->vm_pgalloc)  s->vm_pgalloc  = parts[PART_PGALLOC];
+  if(!s->vm_pgrefill) s->vm_pgrefill = parts[PART_PGREFILL];
+  if(!s->vm_pgscan)   s->vm_pgscan   = parts[PART_PGSCAN];
+  if(!s->vm_pgsteal)  s->vm_pgsteal  = parts[PART_PGSTEAL];
 }
 
+void vminfo(void){
+  char sbuf[8192];  // 2.6.x has about 4k of it
+  sysinfo_snap s;
+  char *b;
+
+  b = snap_file(SNAP_VMSTAT, sbuf, sizeof sbuf);
+  if(!b) bad_open();
+  memset(&s, 0, sizeof s);
+  parse_vmstat(b, &s);
+  if(b != sbuf) free(b);
+
+  vm_nr_dirty            = s.vm_nr_dirty;
+  vm_nr_writeback        = s.vm_nr_writeback;
+  vm_nr_pagecache        = s.vm_nr_pagecache;
+  vm_nr_page_table_pages = s.vm_nr_page_table_pages;
+  vm_nr_reverse_maps     = s.vm_nr_reverse_maps;
+  vm_nr_mapped           = s.vm_nr_mapped;
+  vm_nr_slab             = s.vm_nr_slab;
+  vm_pgpgin              = s.vm_pgpgin;
+  vm_pgpgout             = s.vm_pgpgout;
+  vm_pswpin              = s.vm_pswpin;
+  vm_pswpout             = s.vm_pswpout;
+  vm_pgalloc             = s.vm_pgalloc;
+  vm_pgfree              = s.vm_pgfree;
+  vm_pgactivate          = s.vm_pgactivate;
+  vm_pgdeactivate        = s.vm_pgdeactivate;
+  vm_pgfault             = s.vm_pgfault;
+  vm_pgmajfault          = s.vm_pgmajfault;
+  vm_pgscan              = s.vm_pgscan;
+  vm_pgrefill            = s.vm_pgrefill;
+  vm_pgsteal             = s.vm_pgsteal;
+  vm_kswapd_steal        = s.vm_kswapd_steal;
+  vm_pageoutrun          = s.vm_pageoutrun;
+  vm_allocstall          = s.vm_allocstall;
+  vm_pgrotated           = s.vm_pgrotated;
+}
+
+#undef PART
+#undef SLOT
+
 ///////////////////////////////////////////////////////////////////////
 // based on Fabian Frederick's /proc/diskstats parser
 
@@ -855,6 +1178,202 @@ unsigned int getdiskstat(struct disk_stat **disks, struct partition_stat **parti
   return cDisk;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+
+#define DISKSTATS_FILE "/proc/diskstats"
+
+diskstats_t *diskstats_open(const char *const *only){
+  diskstats_t *ds;
+  int fd = open(DISKSTATS_FILE, O_RDONLY|O_CLOEXEC);
+
+  if(fd == -1) return NULL;
+  ds = xcalloc(NULL, sizeof *ds);
+  ds->fd = fd;
+  ds->only = only;
+  ds->bufsize = 8192;
+  ds->buf = xmalloc(ds->bufsize);
+  return ds;
+}
+
+void diskstats_close(diskstats_t *restrict ds){
+  if(!ds) return;
+  close(ds->fd);
+  free(ds->buf);
+  free(ds->disks);
+  free(ds->partitions);
+  free(ds->prev_disks);
+  free(ds->prev_partitions);
+  free(ds->disk_delta);
+  free(ds->partition_delta);
+  free(ds->disk_rates);
+  free(ds);
+}
+
+static int diskstats_wanted(const diskstats_t *restrict ds, const char *name, size_t len){
+  const char *const *o;
+  if(!ds->only) return 1;
+  for(o = ds->only; *o; o++){
+    if(!strncmp(*o, name, len) && !(*o)[len]) return 1;
+  }
+  return 0;
+}
+
+// where 'name' was in the read before, trying the same index first
+static int diskstats_prev(const char *name, const void *prev, unsigned n, size_t size, size_t off, unsigned guess){
+  unsigned i;
+  if(guess < n && !strcmp(name, (const char *)prev + guess*size + off)) return guess;
+  for(i = 0; i < n; i++){
+    if(!strcmp(name, (const char *)prev + i*size + off)) return i;
+  }
+  return -1;
+}
+
+#define GROWTH(f) (d->f = now->f - (then ? then->f : now->f))
+static void diskstats_deltas(diskstats_t *restrict ds){
+  unsigned i;
+  double secs = ds->interval > 0 ? ds->interval : 1;
+
+  ds->disk_delta = xrealloc(ds->disk_delta, (ds->disk_room ? ds->disk_room : 1) * sizeof(struct disk_stat));
+  ds->disk_rates = xrealloc(ds->disk_rates, (ds->disk_room ? ds->disk_room : 1) * sizeof(disk_rate));
+  ds->partition_delta = xrealloc(ds->partition_delta, (ds->partition_room ? ds->partition_room : 1) * sizeof(struct partition_stat));
+  for(i = 0; i < ds->ndisks; i++){
+    const struct disk_stat *now = &ds->disks[i], *then = NULL;
+    struct disk_stat *d = &ds->disk_delta[i];
+    disk_rate *r = &ds->disk_rates[i];
+    int k = diskstats_prev(now->disk_name, ds->prev_disks, ds->nprev_disks,
+                           sizeof(struct disk_stat), offsetof(struct disk_stat, disk_name), i);
+    if(k >= 0) then = &ds->prev_disks[k];
+    *d = *now;
+    GROWTH(reads);
+    GROWTH(merged_reads);
+    GROWTH(reads_sectors);
+    GROWTH(milli_reading);
+    GROWTH(writes);
+    GROWTH(merged_writes);
+    GROWTH(written_sectors);
+    GROWTH(milli_writing);
+    GROWTH(milli_spent_IO);
+    GROWTH(weighted_milli_spent_IO);
+    r->reads           = d->reads / secs;
+    r->writes          = d->writes / secs;
+    r->reads_sectors   = d->reads_sectors / secs;
+    r->written_sectors = d->written_sectors / secs;
+    r->util            = d->milli_spent_IO / (secs * 10.0);
+  }
+  for(i = 0; i < ds->npartitions; i++){
+    const struct partition_stat *now = &ds->partitions[i], *then = NULL;
+    struct partition_stat *d = &ds->partition_delta[i];
+    int k = diskstats_prev(now->partition_name, ds->prev_partitions, ds->nprev_partitions,
+                           sizeof(struct partition_stat), offsetof(struct partition_stat, partition_name), i);
+    if(k >= 0) then = &ds->prev_partitions[k];
+    *d = *now;
+    GROWTH(reads);
+    GROWTH(reads_sectors);
+    GROWTH(writes);
+    GROWTH(requested_writes);
+  }
+}
+#undef GROWTH
+
+int diskstats_read(diskstats_t *restrict ds){
+  struct timeval tv;
+  struct disk_stat *swap_d;
+  struct partition_stat *swap_p;
+  char *S;
+  ssize_t n;
+
+  for(;;){
+    n = pread(ds->fd, ds->buf, ds->bufsize - 1, 0);
+    if(n < 0) return -1;
+    if((size_t)n < ds->bufsize - 1) break;
+    ds->bufsize *= 2;             /* maybe cut short; try with more room */
+    ds->buf = xrealloc(ds->buf, ds->bufsize);
+  }
+  ds->buf[n] = '\0';
+  gettimeofday(&tv, NULL);
+
+  /* this read's numbers go in last time's arrays */
+  swap_d = ds->prev_disks;      ds->prev_disks = ds->disks;           ds->disks = swap_d;
+  swap_p = ds->prev_partitions; ds->prev_partitions = ds->partitions; ds->partitions = swap_p;
+  ds->nprev_disks = ds->ndisks;
+  ds->nprev_partitions = ds->npartitions;
+  ds->ndisks = ds->npartitions = 0;
+
+  for(S = ds->buf; *S; ){
+    unsigned long long v[11];
+    char *name, *end;
+    size_t len;
+    int nv = 0;
+
+    while(*S == ' ') S++;
+    strtoul(S, &S, 10);           /* major */
+    strtoul(S, &S, 10);           /* minor */
+    while(*S == ' ') S++;
+    name = S;
+    while(*S && *S != ' ' && *S != '\n') S++;
+    len = S - name;
+    end = strchr(S, '\n');
+    if(!end) end = S + strlen(S);
+    if(len && diskstats_wanted(ds, name, len)){
+      if(len > 15) len = 15;      /* cut to fit, as sscanf's %15s did */
+      while(nv < 11 && S < end){
+        char *next;
+        v[nv] = strtoull(S, &next, 10);
+        if(next == S) break;
+        S = next;
+        nv++;
+      }
+      if(nv == 11){
+        struct disk_stat *d;
+        if(ds->ndisks == ds->disk_room){
+          ds->disk_room = ds->disk_room * 2 + 16;
+          ds->disks = xrealloc(ds->disks, ds->disk_room * sizeof *ds->disks);
+          ds->prev_disks = xrealloc(ds->prev_disks, ds->disk_room * sizeof *ds->prev_disks);
+        }
+        d = &ds->disks[ds->ndisks++];
+        memcpy(d->disk_name, name, len);
+        d->disk_name[len] = '\0';
+        d->reads                   = v[0];
+        d->merged_reads            = v[1];
+        d->reads_sectors           = v[2];
+        d->milli_reading           = v[3];
+        d->writes                  = v[4];
+        d->merged_writes           = v[5];
+        d->written_sectors         = v[6];
+        d->milli_writing           = v[7];
+        d->inprogress_IO           = v[8];
+        d->milli_spent_IO          = v[9];
+        d->weighted_milli_spent_IO = v[10];
+        d->partitions              = 0;
+      }else if(nv >= 4){          /* a partition, from before Linux 2.6.25 */
+        struct partition_stat *p;
+        if(ds->npartitions == ds->partition_room){
+          ds->partition_room = ds->partition_room * 2 + 16;
+          ds->partitions = xrealloc(ds->partitions, ds->partition_room * sizeof *ds->partitions);
+          ds->prev_partitions = xrealloc(ds->prev_partitions, ds->partition_room * sizeof *ds->prev_partitions);
+        }
+        p = &ds->partitions[ds->npartitions++];
+        memcpy(p->partition_name, name, len);
+        p->partition_name[len] = '\0';
+        p->reads            = v[0];
+        p->reads_sectors    = v[1];
+        p->writes           = v[2];
+        p->requested_writes = v[3];
+        p->parent_disk      = ds->ndisks ? ds->ndisks - 1 : 0;
+        if(ds->ndisks) ds->disks[ds->ndisks-1].partitions++;
+      }
+    }
+    S = *end ? end + 1 : end;
+  }
+
+  if(ds->when){
+    ds->interval = (tv.tv_sec + tv.tv_usec / 1000000.0) - ds->when;
+    diskstats_deltas(ds);
+  }
+  ds->when = tv.tv_sec + tv.tv_usec / 1000000.0;
+  return 0;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // based on Fabian Frederick's /proc/slabinfo parser
 
@@ -893,10 +1412,14 @@ unsigned get_pid_digits(void){
 
   if(ret) goto out;
   ret = 5;
-  fd = open("/proc/sys/kernel/pid_max", O_RDONLY);
-  if(fd==-1) goto out;
-  rc = read(fd, pidbuf, sizeof pidbuf);
-  close(fd);
+  if(replay_image){
+    rc = replay_copy("/proc/sys/kernel/pid_max", pidbuf, sizeof pidbuf);
+  }else{
+    fd = open("/proc/sys/kernel/pid_max", O_RDONLY);
+    if(fd==-1) goto out;
+    rc = read(fd, pidbuf, sizeof pidbuf);
+    close(fd);
+  }
   if(rc<3) goto out;
   pidbuf[rc] = '\0';
   rc = strtol(pidbuf,&endp,10);
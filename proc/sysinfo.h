@@ -1,6 +1,7 @@
 #ifndef PROC_SYSINFO_H
 #define PROC_SYSINFO_H
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/dir.h>
 #include "procps.h"
 
@@ -91,6 +92,60 @@ extern unsigned long vm_allocstall;
 
 extern void vminfo(void);
 
+// A snapshot of the system-wide files, read in one go into memory the
+// caller owns.  Unlike meminfo(), vminfo() and getstat() this touches no
+// globals, so any number of threads may take snapshots at once.
+typedef struct sysinfo_snap {
+	struct timeval tv;       // when it was taken
+	// /proc/uptime
+	double uptime, idle;
+	// /proc/loadavg
+	double loadavg[3];
+	// /proc/stat -- counters
+	jiff cpu_use, cpu_nic, cpu_sys, cpu_idl, cpu_iow, cpu_xxx, cpu_yyy, cpu_zzz;
+	unsigned long long intr, ctxt;
+	unsigned long processes;
+	// /proc/stat -- levels
+	unsigned running, blocked;  // includes the caller, unlike getstat()
+	unsigned btime;
+	unsigned have;              // which SNAP_* parts were read
+	// /proc/meminfo -- levels, in kB
+	unsigned long kb_main_total, kb_main_free, kb_main_used, kb_main_shared;
+	unsigned long kb_main_buffers, kb_main_cached;
+	unsigned long kb_swap_total, kb_swap_free, kb_swap_used, kb_swap_cached;
+	unsigned long kb_high_total, kb_high_free, kb_low_total, kb_low_free;
+	unsigned long kb_active, kb_inactive;
+	unsigned long kb_inact_dirty, kb_inact_clean, kb_inact_laundry, kb_inact_target;
+	unsigned long kb_dirty, kb_writeback, kb_mapped, kb_slab;
+	unsigned long kb_committed_as, kb_pagetables, nr_reversemaps;
+	// /proc/vmstat -- levels, in pages
+	unsigned long vm_nr_dirty, vm_nr_writeback, vm_nr_pagecache, vm_nr_page_table_pages;
+	unsigned long vm_nr_reverse_maps, vm_nr_mapped, vm_nr_slab;
+	// /proc/vmstat -- counters (the first four also come from old /proc/stat)
+	unsigned long vm_pgpgin, vm_pgpgout, vm_pswpin, vm_pswpout;
+	unsigned long vm_pgalloc, vm_pgfree, vm_pgactivate, vm_pgdeactivate;
+	unsigned long vm_pgfault, vm_pgmajfault, vm_pgscan, vm_pgrefill, vm_pgsteal;
+	unsigned long vm_kswapd_steal, vm_pageoutrun, vm_allocstall, vm_pgrotated;
+} sysinfo_snap;
+
+#define SNAP_STAT     0x01  // /proc/stat
+#define SNAP_MEMINFO  0x02  // /proc/meminfo
+#define SNAP_VMSTAT   0x04  // /proc/vmstat
+#define SNAP_LOADAVG  0x08  // /proc/loadavg
+#define SNAP_UPTIME   0x10  // /proc/uptime
+#define SNAP_ALL      0x1f
+#define SNAP_SHARED   0x20  // may be the snapshot procshare published (share.h)
+
+// fill *s with the SNAP_* parts asked for; returns 0, or -1 if some
+// file could not be read (s->have tells which ones made it).  With
+// SNAP_SHARED, all of them may come from the collector's last scan
+// instead, tv saying when that was; no good for counters to take deltas
+// of at a shorter interval than the collector's.
+extern int sysinfo_snapshot(sysinfo_snap *restrict s, unsigned what);
+
+// counters become now - then (tv and uptime too), levels are taken from now
+extern void sysinfo_delta(sysinfo_snap *restrict d, const sysinfo_snap *restrict now, const sysinfo_snap *restrict then);
+
 typedef struct disk_stat{
 	unsigned long long reads_sectors;
 	unsigned long long written_sectors;
@@ -119,6 +174,48 @@ typedef struct partition_stat{
 extern unsigned int getpartitions_num(struct disk_stat *disks, int ndisks);
 extern unsigned int getdiskstat (struct disk_stat**,struct partition_stat**);
 
+// per second, over the time between two diskstats_read() calls
+typedef struct disk_rate{
+	double reads, writes;
+	double reads_sectors, written_sectors;
+	double util;		// percent of the time the device had I/O in flight
+}disk_rate;
+
+// A /proc/diskstats reader to keep from one interval to the next.  The
+// file stays open and is pread(), the arrays are reused, each line is
+// gone over once, and with a device list the others are passed over
+// before any of their numbers are converted.  The same disk/partition
+// split as getdiskstat(), which it replaces for repeated reads.
+typedef struct diskstats_t{
+	struct disk_stat      *disks;
+	struct partition_stat *partitions;
+	unsigned               ndisks, npartitions;
+	// once there have been two reads (else NULL): each counter's growth
+	// since the read before, levels like inprogress_IO as they are now,
+	// and the rates; a device that wasn't there then has zeros
+	struct disk_stat      *disk_delta;
+	struct partition_stat *partition_delta;
+	disk_rate             *disk_rates;
+	double                 interval;	// seconds between the two reads
+	// the rest is the reader's own
+	const char *const     *only;
+	struct disk_stat      *prev_disks;
+	struct partition_stat *prev_partitions;
+	unsigned               nprev_disks, nprev_partitions;
+	unsigned               disk_room, partition_room;
+	char                  *buf;
+	unsigned               bufsize;
+	int                    fd;
+	double                 when;
+}diskstats_t;
+
+// 'only' (kept, not copied) is a NULL-terminated list of device names,
+// or NULL for all of them.  NULL if /proc/diskstats can't be opened.
+extern diskstats_t *diskstats_open(const char *const *only);
+// 0, or -1 if the file could not be read (the last numbers are kept)
+extern int diskstats_read(diskstats_t *restrict ds);
+extern void diskstats_close(diskstats_t *restrict ds);
+
 typedef struct slab_cache{
 	char name[48];
 	unsigned active_objs;
@@ -0,0 +1,135 @@
+// Delay accounting from the kernel's taskstats (generic netlink) family
+//
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+//
+// A TASKSTATS_CMD_GET for one pid or tgid comes back as one binary
+// struct taskstats: times, faults, I/O, and the three delay totals that
+// /proc has no file for.  It's a send and a receive on a socket kept
+// open from one task to the next.  The kernel only fills in the delays
+// with delay accounting on (kernel.task_delayacct, or "delayacct" on
+// the kernel command line); otherwise they come back as zero.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+#include "taskstats.h"
+
+// what both ways of the conversation look like
+typedef struct ts_msg {
+    struct nlmsghdr n;
+    struct genlmsghdr g;
+    char buf[1024];
+} ts_msg;
+
+static int ts_fd = -1;
+static int ts_family;			// the id TASKSTATS got, or -1 for none
+static unsigned ts_seq;			// to pass over answers that came too late
+
+#define NLA_DATA(na)    ((char *)(na) + NLA_HDRLEN)
+#define NLA_PAYLOAD(na) ((int)(na)->nla_len - NLA_HDRLEN)
+#define NLA_NEXT(na)    ((struct nlattr *)((char *)(na) + NLA_ALIGN((na)->nla_len)))
+
+// one request with one attribute
+static int ts_send(int type, int cmd, int attr, const void *data, int len){
+    ts_msg m;
+    struct nlattr *na = (struct nlattr *)m.buf;
+
+    memset(&m, 0, sizeof m);
+    m.n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN) + NLA_ALIGN(NLA_HDRLEN + len);
+    m.n.nlmsg_type = type;
+    m.n.nlmsg_flags = NLM_F_REQUEST;
+    m.n.nlmsg_seq = ++ts_seq;
+    m.g.cmd = cmd;
+    m.g.version = TASKSTATS_GENL_VERSION;
+    na->nla_type = attr;
+    na->nla_len = NLA_HDRLEN + len;
+    memcpy(NLA_DATA(na), data, len);
+    return send(ts_fd, &m, m.n.nlmsg_len, 0) == (ssize_t)m.n.nlmsg_len ? 0 : -1;
+}
+
+// the answer's first attribute, or NULL; *end gets where they stop
+static struct nlattr *ts_recv(ts_msg *restrict m, char **end){
+    int len;
+
+    do{
+        len = recv(ts_fd, m, sizeof *m, 0);
+        if(len < 0 || !NLMSG_OK(&m->n, (unsigned)len)) return NULL;
+    }while(m->n.nlmsg_seq != ts_seq);
+    if(m->n.nlmsg_type == NLMSG_ERROR) return NULL;
+    *end = (char *)m + m->n.nlmsg_len;
+    return (struct nlattr *)m->buf;
+}
+
+static int ts_open(void){
+    struct sockaddr_nl sa;
+    struct nlattr *na;
+    ts_msg m;
+    char *end;
+    struct timeval tv = { 1, 0 };	// never hang a whole ps on this
+
+    ts_family = -1;
+    ts_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if(ts_fd == -1) return -1;
+    memset(&sa, 0, sizeof sa);
+    sa.nl_family = AF_NETLINK;
+    setsockopt(ts_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    if(bind(ts_fd, (struct sockaddr *)&sa, sizeof sa) == -1) goto fail;
+    if(ts_send(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+               TASKSTATS_GENL_NAME, sizeof TASKSTATS_GENL_NAME) == -1) goto fail;
+    for(na = ts_recv(&m, &end); na && (char *)na < end; na = NLA_NEXT(na)){
+        if(na->nla_len < NLA_HDRLEN) break;
+        if(na->nla_type == CTRL_ATTR_FAMILY_ID){
+            unsigned short id;
+            memcpy(&id, NLA_DATA(na), sizeof id);
+            ts_family = id;
+            return 0;
+        }
+    }
+fail:
+    close(ts_fd);
+    ts_fd = -1;
+    return -1;
+}
+
+int taskstats_fill(pid_t id, int group, proc_t *restrict p){
+    static int tried;
+    struct nlattr *na;
+    ts_msg m;
+    char *end;
+    __u32 pid = id;
+
+    if(!tried){
+        tried = 1;
+        ts_open();
+    }
+    if(ts_family < 0) return -1;
+    if(ts_send(ts_family, TASKSTATS_CMD_GET,
+               group ? TASKSTATS_CMD_ATTR_TGID : TASKSTATS_CMD_ATTR_PID,
+               &pid, sizeof pid) == -1) return -1;
+    na = ts_recv(&m, &end);
+    if(!na || (na->nla_type != TASKSTATS_TYPE_AGGR_PID && na->nla_type != TASKSTATS_TYPE_AGGR_TGID))
+        return -1;
+    // the aggregate holds the pid (or tgid), then the struct
+    end = (char *)na + na->nla_len;
+    for(na = (struct nlattr *)NLA_DATA(na); (char *)na < end; na = NLA_NEXT(na)){
+        if(na->nla_len < NLA_HDRLEN) break;
+        if(na->nla_type == TASKSTATS_TYPE_STATS){
+            struct taskstats ts;
+            int len = NLA_PAYLOAD(na);
+            memset(&ts, 0, sizeof ts);	// an older kernel sends less
+            memcpy(&ts, NLA_DATA(na), len < (int)sizeof ts ? len : (int)sizeof ts);
+            p->cpu_delay    = ts.cpu_delay_total;
+            p->blkio_delay  = ts.blkio_delay_total;
+            p->swapin_delay = ts.swapin_delay_total;
+            return 0;
+        }
+    }
+    return -1;
+}
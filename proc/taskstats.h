@@ -0,0 +1,21 @@
+#ifndef PROCPS_PROC_TASKSTATS_H
+#define PROCPS_PROC_TASKSTATS_H
+
+// This file is placed under the conditions of the GNU Library
+// General Public License, version 2, or any later version.
+// See file COPYING for information on distribution conditions.
+
+#include "procps.h"
+#include "readproc.h"
+
+EXTERN_C_BEGIN
+
+// Internal to libproc: the delay accounting numbers from the kernel's
+// taskstats netlink family, summed over the thread group if 'group' is
+// set.  0 when p got them; -1 without CAP_NET_ADMIN, without taskstats,
+// or once the task is gone.  Not thread-safe (one socket for everyone).
+extern int taskstats_fill(pid_t id, int group, proc_t *restrict p);
+
+EXTERN_C_END
+
+#endif
@@ -27,14 +27,13 @@
 static char buf[128];
 static double av[3];
 
-char *sprint_uptime(void) {
+static char *format_uptime(double uptime_secs, const double *restrict load) {
   struct utmp *utmpstruct;
   int upminutes, uphours, updays;
   int pos;
   struct tm *realtime;
   time_t realseconds;
   int numuser;
-  double uptime_secs, idle_secs;
 
 /* first get the current time */
 
@@ -43,9 +42,7 @@ char *sprint_uptime(void) {
   pos = sprintf(buf, " %02d:%02d:%02d ",
     realtime->tm_hour, realtime->tm_min, realtime->tm_sec);
 
-/* read and calculate the amount of uptime */
-
-  uptime(&uptime_secs, &idle_secs);
+/* calculate the amount of uptime */
 
   updays = (int) uptime_secs / (60*60*24);
   strcat (buf, "up ");
@@ -74,14 +71,24 @@ char *sprint_uptime(void) {
 
   pos += sprintf(buf + pos, "%2d user%s, ", numuser, numuser == 1 ? "" : "s");
 
-  loadavg(&av[0], &av[1], &av[2]);
-
   pos += sprintf(buf + pos, " load average: %.2f, %.2f, %.2f",
-		 av[0], av[1], av[2]);
+		 load[0], load[1], load[2]);
 
   return buf;
 }
 
+char *sprint_uptime(void) {
+  double uptime_secs, idle_secs;
+
+  uptime(&uptime_secs, &idle_secs);
+  loadavg(&av[0], &av[1], &av[2]);
+  return format_uptime(uptime_secs, av);
+}
+
+char *sprint_uptime_snap(const sysinfo_snap *restrict s) {
+  return format_uptime(s->uptime, s->loadavg);
+}
+
 void print_uptime(void) {
   printf("%s\n", sprint_uptime());
 }
@@ -2,11 +2,14 @@
 #define PROC_WHATTIME_H
 
 #include "procps.h"
+#include "sysinfo.h"
 
 EXTERN_C_BEGIN
 
 extern void print_uptime(void);
 extern char *sprint_uptime(void);
+// the same line from a snapshot taken with SNAP_UPTIME|SNAP_LOADAVG
+extern char *sprint_uptime_snap(const sysinfo_snap *restrict s);
 
 EXTERN_C_END
 
@@ -0,0 +1,413 @@
+// procrec.c - record /proc for libproc to replay
+//
+// This program is licensed under the GNU Library General Public License, v2
+//
+// Writes the processes, their tasks and the system-wide files the tools
+// read into one file, in the format of proc/replay.h.  Then
+//
+//     PROCPS_REPLAY=file ps aux
+//
+// shows that moment again, as often as wanted, whatever the machine is
+// doing now.  With -n the processes are copied (under new pids) until
+// there are that many, for timing the tools at a size the machine at
+// hand doesn't have.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "proc/replay.h"
+#include "proc/version.h"
+
+// what libproc reads for a process, or for a task in /proc/#/task
+static const char *const proc_files[] = {
+    "stat", "statm", "status", "cmdline", "cgroup", "io", "schedstat",
+    "maps", "smaps_rollup", "wchan"
+};
+static const char *const task_files[] = {
+    "stat", "statm", "status", "cmdline", "schedstat", "io"
+};
+static const char *const sys_files[] = {
+    "/proc/stat", "/proc/meminfo", "/proc/vmstat", "/proc/loadavg",
+    "/proc/uptime", "/proc/sys/kernel/pid_max"
+};
+
+typedef struct rec {
+    char *name;
+    char *data;
+    unsigned len, mode, uid, gid;
+} rec;
+
+// one process: its rec's and replay_task's, for copying it
+typedef struct span {
+    int pid;
+    unsigned rec0, nrec;
+    unsigned task0, ntask;
+} span;
+
+static rec *recs;
+static unsigned nrecs, recs_cap;
+static int32_t *pids;
+static unsigned npids, pids_cap;
+static replay_task *tasks;
+static unsigned ntasks, tasks_cap;
+
+static void die(const char *restrict what){
+    fprintf(stderr, "procrec: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static char *copy_str(const char *restrict s){
+    char *p = strdup(s);
+    if(!p) die("strdup");
+    return p;
+}
+
+static void *grow(void *p, unsigned *restrict cap, unsigned want, size_t size){
+    if(want <= *cap) return p;
+    *cap = *cap ? *cap * 2 : 1024;
+    if(*cap < want) *cap = want;
+    p = realloc(p, *cap * size);
+    if(!p) die("realloc");
+    return p;
+}
+
+static rec *new_rec(char *name, const struct stat *restrict sb){
+    rec *r;
+
+    recs = grow(recs, &recs_cap, nrecs + 1, sizeof *recs);
+    r = &recs[nrecs++];
+    r->name = name;
+    r->data = NULL;
+    r->len = 0;
+    r->mode = sb ? sb->st_mode : S_IFREG | 0444;
+    r->uid = sb ? sb->st_uid : 0;
+    r->gid = sb ? sb->st_gid : 0;
+    return r;
+}
+
+// the whole file, however long; /proc files have no size to go by
+static char *slurp(const char *restrict path, unsigned *restrict len){
+    unsigned cap = 4096, n = 0;
+    char *buf;
+    ssize_t got;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd == -1) return NULL;
+    buf = malloc(cap);
+    for(;;){
+        if(!buf) die("malloc");
+        got = read(fd, buf + n, cap - n - 1);
+        if(got <= 0) break;
+        n += got;
+        if(n == cap - 1) buf = realloc(buf, cap *= 2);
+    }
+    close(fd);
+    if(got < 0){		// no permission (io), or gone
+        free(buf);
+        return NULL;
+    }
+    buf[n] = '\0';
+    *len = n;
+    return buf;
+}
+
+static int add_file(const char *restrict path){
+    unsigned len;
+    char *data = slurp(path, &len);
+    rec *r;
+
+    if(!data) return -1;
+    r = new_rec(copy_str(path), NULL);
+    r->data = data;
+    r->len = len;
+    return 0;
+}
+
+// a /proc/# or /proc/#/task/# directory and the files in it
+static int add_dir(const char *restrict dir, const char *const *files, unsigned nfiles){
+    char path[64];
+    struct stat sb;
+    unsigned u, mark = nrecs;
+
+    if(stat(dir, &sb) == -1) return -1;
+    new_rec(copy_str(dir), &sb);
+    for(u = 0; u < nfiles; u++){
+        snprintf(path, sizeof path, "%s/%s", dir, files[u]);
+        if(add_file(path) == -1 && !u){
+            while(nrecs > mark) free(recs[--nrecs].name);	// gone already
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int cmp_tid(const void *a, const void *b){
+    return ((const replay_task *)a)->tid - ((const replay_task *)b)->tid;
+}
+
+static void add_tasks(int pid){
+    char dir[64];
+    struct dirent *ent;
+    unsigned first = ntasks;
+    DIR *d;
+
+    snprintf(dir, sizeof dir, "/proc/%d/task", pid);
+    d = opendir(dir);
+    if(!d) return;
+    while((ent = readdir(d))){
+        int tid = atoi(ent->d_name);
+        if(tid <= 0) continue;
+        snprintf(dir, sizeof dir, "/proc/%d/task/%d", pid, tid);
+        if(add_dir(dir, task_files, sizeof task_files / sizeof task_files[0]) == -1) continue;
+        tasks = grow(tasks, &tasks_cap, ntasks + 1, sizeof *tasks);
+        tasks[ntasks].tgid = pid;
+        tasks[ntasks++].tid = tid;
+    }
+    closedir(d);
+    qsort(tasks + first, ntasks - first, sizeof *tasks, cmp_tid);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// "/proc/PID[/task/TID]rest" with 'add' added to both numbers
+static char *rename_rec(const char *restrict name, int add){
+    char buf[128], *end;
+    long pid = strtol(name + 6, &end, 10);
+
+    if(!strncmp(end, "/task/", 6)){
+        long tid = strtol(end + 6, &end, 10);
+        snprintf(buf, sizeof buf, "/proc/%ld/task/%ld%s", pid + add, tid + add, end);
+    }else
+        snprintf(buf, sizeof buf, "/proc/%ld%s", pid + add, end);
+    return copy_str(buf);
+}
+
+// the copy's stat: the pid in front, the ppid after the state
+static char *restat(const rec *restrict r, int add, unsigned *restrict len){
+    const char *sp = strchr(r->data, ' ');
+    const char *s = strrchr(r->data, ')');
+    char *buf, *end;
+    long pid, ppid;
+
+    if(!sp || !s || s + 4 > r->data + r->len) return NULL;	// "pid (comm) S ppid ..."
+    pid = strtol(r->data, NULL, 10);
+    ppid = strtol(s + 4, &end, 10);
+    buf = malloc(r->len + 32);
+    if(!buf) die("malloc");
+    *len = sprintf(buf, "%ld%.*s%ld%s", pid + add, (int)(s + 4 - sp), sp, ppid ? ppid + add : 0, end);
+    return buf;
+}
+
+// the copy's status: Tgid, Pid and PPid lines
+static char *restatus(const rec *restrict r, int add, unsigned *restrict len){
+    static const char *const keys[] = { "Tgid:", "Pid:", "PPid:" };
+    const char *s = r->data;
+    char *buf = malloc(r->len + 64), *b;
+    unsigned u;
+
+    if(!buf) die("malloc");
+    b = buf;
+    while(*s){
+        const char *nl = strchr(s, '\n');
+        unsigned ll = nl ? (unsigned)(nl + 1 - s) : strlen(s);
+        for(u = 0; u < sizeof keys / sizeof keys[0]; u++){
+            unsigned kl = strlen(keys[u]);
+            if(!strncmp(s, keys[u], kl)){
+                long v = strtol(s + kl, NULL, 10);
+                b += sprintf(b, "%s\t%ld\n", keys[u], v ? v + add : 0);
+                break;
+            }
+        }
+        if(u == sizeof keys / sizeof keys[0]){
+            memcpy(b, s, ll);
+            b += ll;
+        }
+        s += ll;
+    }
+    *b = '\0';
+    *len = b - buf;
+    return buf;
+}
+
+static void copy_span(const span *restrict sp, int add){
+    unsigned u;
+
+    pids = grow(pids, &pids_cap, npids + 1, sizeof *pids);
+    pids[npids++] = sp->pid + add;
+    for(u = 0; u < sp->nrec; u++){
+        const rec o = recs[sp->rec0 + u];	// new_rec() may move recs
+        const char *base = strrchr(o.name, '/');
+        rec *r = new_rec(rename_rec(o.name, add), NULL);
+        r->mode = o.mode;
+        r->uid = o.uid;
+        r->gid = o.gid;
+        r->data = o.data;		// shared, nothing is freed
+        r->len = o.len;
+        if(o.data && !strcmp(base, "/stat"))
+            r->data = restat(&o, add, &r->len);
+        else if(o.data && !strcmp(base, "/status"))
+            r->data = restatus(&o, add, &r->len);
+        if(!r->data && o.data){
+            r->data = o.data;
+            r->len = o.len;
+        }
+    }
+    for(u = 0; u < sp->ntask; u++){
+        tasks = grow(tasks, &tasks_cap, ntasks + 1, sizeof *tasks);
+        tasks[ntasks].tgid = tasks[sp->task0 + u].tgid + add;
+        tasks[ntasks].tid = tasks[sp->task0 + u].tid + add;
+        ntasks++;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static int cmp_rec(const void *a, const void *b){
+    return strcmp(((const rec *)a)->name, ((const rec *)b)->name);
+}
+
+static int cmp_tgid(const void *a, const void *b){
+    const replay_task *x = a, *y = b;
+    if(x->tgid != y->tgid) return x->tgid < y->tgid ? -1 : 1;
+    return x->tid < y->tid ? -1 : x->tid > y->tid;
+}
+
+static void put(FILE *fp, const void *p, size_t n){
+    if(n && fwrite(p, n, 1, fp) != 1) die("write");
+}
+
+static void write_image(const char *restrict name){
+    static const char zeros[8];
+    replay_head h;
+    uint64_t off;
+    unsigned u;
+    FILE *fp;
+
+    qsort(recs, nrecs, sizeof *recs, cmp_rec);
+    qsort(tasks, ntasks, sizeof *tasks, cmp_tgid);
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, REPLAY_MAGIC, sizeof h.magic);
+    h.nfiles = nrecs;
+    h.npids = npids;
+    h.ntasks = ntasks;
+    h.ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    h.files = sizeof h;
+    h.pids = h.files + (uint64_t)nrecs * sizeof(replay_ent);
+    h.tasks = h.pids + (uint64_t)npids * sizeof *pids;
+    h.tasks = (h.tasks + 7) & ~7ull;
+    off = h.tasks + (uint64_t)ntasks * sizeof *tasks;
+    for(u = 0; u < nrecs; u++) off += strlen(recs[u].name) + 1 + recs[u].len + 1;
+    h.size = off;
+
+    fp = fopen(name, "w");
+    if(!fp) die(name);
+    put(fp, &h, sizeof h);
+    off = h.tasks + (uint64_t)ntasks * sizeof *tasks;
+    for(u = 0; u < nrecs; u++){
+        replay_ent e;
+        e.name = off;
+        off += strlen(recs[u].name) + 1;
+        e.data = off;
+        off += recs[u].len + 1;
+        e.len = recs[u].len;
+        e.mode = recs[u].mode;
+        e.uid = recs[u].uid;
+        e.gid = recs[u].gid;
+        put(fp, &e, sizeof e);
+    }
+    put(fp, pids, npids * sizeof *pids);
+    put(fp, zeros, h.tasks - (h.pids + (uint64_t)npids * sizeof *pids));
+    put(fp, tasks, ntasks * sizeof *tasks);
+    for(u = 0; u < nrecs; u++){
+        put(fp, recs[u].name, strlen(recs[u].name) + 1);
+        put(fp, recs[u].data ? recs[u].data : "", recs[u].len);
+        put(fp, "", 1);
+    }
+    if(fclose(fp)) die(name);
+}
+
+static const char help_message[] =
+"usage: procrec [-n processes] file\n"
+"  -n copy the processes recorded until there are this many\n"
+"  -V display version information and exit\n"
+;
+
+int main(int argc, char *argv[]){
+    struct dirent *ent;
+    span *spans = NULL;
+    unsigned nspans = 0, spans_cap = 0, want = 0, sys0, u;
+    int maxpid = 0, c;
+    DIR *d;
+
+    while((c = getopt(argc, argv, "n:V")) != -1)
+        switch(c){
+        case 'n': want = strtoul(optarg, NULL, 10); break;
+        case 'V': display_version(); return 0;
+        default:
+            fputs(help_message, stderr);
+            return 1;
+        }
+    if(optind != argc - 1){
+        fputs(help_message, stderr);
+        return 1;
+    }
+
+    d = opendir("/proc");
+    if(!d) die("/proc");
+    while((ent = readdir(d))){
+        char dir[32];
+        int pid;
+        span *sp;
+        if(*ent->d_name < '1' || *ent->d_name > '9') continue;
+        pid = atoi(ent->d_name);
+        snprintf(dir, sizeof dir, "/proc/%d", pid);
+        spans = grow(spans, &spans_cap, nspans + 1, sizeof *spans);
+        sp = &spans[nspans];
+        sp->pid = pid;
+        sp->rec0 = nrecs;
+        if(add_dir(dir, proc_files, sizeof proc_files / sizeof proc_files[0]) == -1) continue;
+        sp->task0 = ntasks;
+        add_tasks(pid);
+        sp->nrec = nrecs - sp->rec0;
+        sp->ntask = ntasks - sp->task0;
+        pids = grow(pids, &pids_cap, npids + 1, sizeof *pids);
+        pids[npids++] = pid;
+        if(pid > maxpid) maxpid = pid;
+        nspans++;
+    }
+    closedir(d);
+    sys0 = nrecs;
+    for(u = 0; u < sizeof sys_files / sizeof sys_files[0]; u++){
+        if(add_file(sys_files[u]) == -1) die(sys_files[u]);
+    }
+
+    if(want > npids && nspans){
+        int base = 10, k = 0;
+        char buf[32];
+        rec *r;
+        while(base <= maxpid) base *= 10;	// copies read as copies: 1234, 11234, 21234
+        while(npids < want){
+            if(!(u = npids % nspans)) k++;
+            copy_span(&spans[u], k * base);
+            if(spans[u].pid + k * base > maxpid) maxpid = spans[u].pid + k * base;
+        }
+        // pid_max is what the PID columns are as wide as
+        r = &recs[sys0 + sizeof sys_files / sizeof sys_files[0] - 1];
+        if(strtol(r->data, NULL, 10) <= maxpid){
+            snprintf(buf, sizeof buf, "%d\n", maxpid + 1);
+            r->data = copy_str(buf);
+            r->len = strlen(buf);
+        }
+    }
+
+    write_image(argv[optind]);
+    return 0;
+}
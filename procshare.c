@@ -0,0 +1,86 @@
+// procshare.c - scan /proc once for all the tools
+//
+// This program is licensed under the GNU Library General Public License, v2
+//
+// Every so often, reads the processes and the system-wide files and
+// publishes them in shared memory (see proc/share.h).  Then, with
+//
+//     PROCPS_SHARE=/procps ps aux
+//
+// ps, pgrep, w and uptime -d take that instead of reading /proc
+// themselves, however many of them there are and however often they run.
+// On the way out the segment is removed, and they go back to /proc.
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "proc/share.h"
+#include "proc/interval.h"
+#include "proc/version.h"
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig){
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(void) NORETURN;
+static void usage(void){
+    fprintf(stderr,
+        "usage: procshare [-d delay] [-n name] [-V]\n"
+        "  -d  scan every [delay] seconds (default 1)\n"
+        "  -n  the shared memory name (default /procps)\n"
+        "  -V  display version information and exit\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]){
+    const char *name = "/procps";
+    double delay = 1;
+    struct sigaction sa;
+    interval_t tick;
+    int opt, rc = 0;
+
+    while((opt = getopt(argc, argv, "d:n:V")) != -1)
+        switch(opt){
+        case 'd':
+            delay = strtod(optarg, NULL);
+            if(delay <= 0) usage();
+            break;
+        case 'n':
+            name = optarg;
+            break;
+        case 'V':
+            display_version();
+            return 0;
+        default:
+            usage();
+        }
+    if(optind < argc) usage();
+
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_signal;   // the loop ends at the next tick
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    interval_start(&tick, delay);
+    while(!stop){
+        if(share_publish(name, delay)){
+            fprintf(stderr, "procshare: %s: %s\n", name,
+                errno == EBUSY ? "another procshare has it" : strerror(errno));
+            return 1;   // and it isn't ours to remove
+        }
+        interval_wait(&tick);
+    }
+    if(share_unlink(name)){
+        perror(name);
+        rc = 1;
+    }
+    return rc;
+}
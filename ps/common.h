@@ -93,7 +93,7 @@
 #define CF_PRINT_AS_NEEDED    0x80000000 // means we have no clue, so assume EVERY TIME
 #define CF_PRINT_MASK         0xf0000000
 
-#define needs_for_select (PROC_FILLSTAT | PROC_FILLSTATUS)
+#define needs_for_select (PROC_FILLSTAT | PROC_FILLSTATUS | PROC_FIELD_BASIC)
 
 /* thread_flags */
 #define TF_B_H         0x0001
@@ -196,6 +196,9 @@ typedef struct selection_node {
   sel_union *u;  /* used if selection type has a list of values */
   int n;         /* used if selection type has a list of values */
   int typecode;
+  unsigned *set; /* long lists: u's values, hashed by compile_selection() */
+  unsigned set_mask;  /* set has set_mask+1 slots, 0 meaning empty... */
+  int set_zero;       /* ...so whether 0 is in the list goes here */
 } selection_node;
 
 typedef struct sort_node {
@@ -209,6 +212,7 @@ typedef struct sort_node {
 typedef struct format_node {
   struct format_node *next;
   char *name;                             /* user can override default name */
+  const char *spec;                       /* format specifier, or NULL if AIX filler */
   int (*pr)(char *restrict const outbuf, const proc_t *restrict const pp); // print function
 /*  int (* const sr)(const proc_t* P, const proc_t* Q); */ /* sort function */
   int width;
@@ -229,6 +233,21 @@ typedef struct format_struct {
   const int flags;
 } format_struct;
 
+/* a sort function's field as one unsigned number, for sorting on keys */
+typedef struct sort_key_struct {
+  int (*sr)(const proc_t* P, const proc_t* Q);
+  unsigned long long (*key)(const proc_t* P);  /* same order as sr */
+  int (*tie)(const proc_t* P, const proc_t* Q); /* sr if key is a string's first 8 bytes */
+} sort_key_struct;
+
+/* a task's counters as --interval first saw them, for the rate columns */
+typedef struct sample_t {
+  unsigned long long start_time;          /* so a reused tid isn't a match */
+  unsigned long long read_bytes, write_bytes;
+  unsigned long min_flt, maj_flt, nvcsw, nivcsw;
+  int tid;
+} sample_t;
+
 /* though ps-specific, needed by general file */
 typedef struct macro_struct {
   const char *spec; /* format specifier */
@@ -268,6 +287,11 @@ extern const format_struct *search_format_array(const char *findme);
 extern const macro_struct *search_macro_array(const char *findme);
 extern void init_output(void);
 extern int pr_nop(char *restrict const outbuf, const proc_t *restrict const pp);
+extern const sort_key_struct *search_sort_key(int (*sr)(const proc_t* P, const proc_t* Q));
+
+/* display.c */
+extern const sample_t *find_sample(const proc_t *pp);
+extern double sample_secs;  /* from the first sample to the second */
 
 /* global.c */
 extern void reset_global(void);
@@ -288,17 +312,21 @@ extern int             forest_type;
 extern unsigned        format_flags;     /* -l -f l u s -j... */
 extern format_node    *format_list; /* digested formatting options */
 extern unsigned        format_modifiers; /* -c -j -y -P -L... */
+extern int             group_by_cgroup;  /* --group-by=cgroup */
 extern int             header_gap;
 extern int             header_type; /* none, single, multi... */
 extern int             include_dead_children;
+extern int             jsonl_output; /* --jsonl: one JSON object per row */
 extern int             lines_to_next_header;
 extern int             max_line_width;
+extern int             max_rows;  /* --max-rows, or 0 for no limit */
 extern const char     *namelist_file;
 extern int             negate_selection;
 extern int             page_size;  // "int" for math reasons?
 extern unsigned        personality;
 extern int             prefer_bsd_defaults;
 extern int             running_only;
+extern int             sample_interval;  /* --interval, or 0 */
 extern int             screen_cols;
 extern int             screen_rows;
 extern time_t          seconds_since_boot;
@@ -324,6 +352,8 @@ extern void reset_sortformat(void);
 /* select.c */
 extern int want_this_proc(proc_t *buf);
 extern const char *select_bits_setup(void);
+extern pid_t *selected_pids(void);
+extern int prefilter_this_proc(const proc_t *restrict const buf);
 
 /* help.c */
 extern const char *help_message;
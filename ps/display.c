@@ -27,6 +27,7 @@
 #include <sys/sysmacros.h>
 
 #include <signal.h>   /* catch signals */
+#include <sys/time.h>
 
 #include "common.h"
 #include "../proc/wchan.h"
@@ -34,6 +35,10 @@
 #include "../proc/readproc.h"
 #include "../proc/sysinfo.h"
 #include "../proc/sig.h"
+#include "../proc/forest.h"
+#include "../proc/alloc.h"
+#include "../proc/cgroup.h"
+#include "../proc/costs.h"
 
 #ifndef SIGCHLD
 #define SIGCHLD SIGCLD
@@ -223,7 +228,7 @@ static unsigned task_format_needs;
 
 #define needs_for_format (proc_format_needs|task_format_needs)
 
-#define PROC_ONLY_FLAGS (PROC_FILLENV|PROC_FILLARG|PROC_FILLCOM|PROC_FILLMEM)
+#define PROC_ONLY_FLAGS (PROC_FILLENV|PROC_FILLARG|PROC_FILLCOM|PROC_FILLMEM|PROC_FILLSMAPS)
 
 /***** munge lists and determine openproc() flags */
 static void lists_and_needs(void){
@@ -324,62 +329,163 @@ static int want_this_proc_pcpu(proc_t *buf){
   return 1;
 }
 
+/***** openproc(), reading only the listed /proc/PID directories if it can */
+static PROCTAB *open_selected(unsigned flags){
+  static pid_t *pids;
+  static int checked;
+  PROCTAB *ptp;
+  if(!checked){
+    pids = selected_pids();
+    checked = 1;
+  }
+  if(pids) ptp = openproc(flags | PROC_PID, pids);
+  else     ptp = openproc(flags | PROC_SHARED);  /* procshare's, if running */
+  /* threads are picked one by one, so only then can a process go early */
+  if(ptp && (flags & PROC_FILLSTAT) && !(thread_flags & TF_show_task))
+    ptp->prefilter = prefilter_this_proc;
+  return ptp;
+}
+
+/***** --interval: look at every task once, wait, then show the rates */
+static sample_t *samples;
+static unsigned nsamples, samples_size;
+static int *sample_hash;       /* index + 1 into samples, or 0 */
+static unsigned sample_mask;
+double sample_secs;
+
+static unsigned sample_slot(int tid){
+  unsigned h = ((unsigned)tid * 2654435761u) & sample_mask;
+  while(sample_hash[h] && samples[sample_hash[h] - 1].tid != tid) h = (h + 1) & sample_mask;
+  return h;
+}
+
+static void add_sample(const proc_t *restrict p){
+  sample_t *s;
+  if(nsamples == samples_size){
+    samples_size = samples_size ? samples_size * 2 : 1024;
+    samples = xrealloc(samples, samples_size * sizeof *samples);
+  }
+  s = &samples[nsamples++];
+  s->tid         = p->tid;
+  s->start_time  = p->start_time;
+  s->min_flt     = p->min_flt;
+  s->maj_flt     = p->maj_flt;
+  s->nvcsw       = p->nvcsw;
+  s->nivcsw      = p->nivcsw;
+  s->read_bytes  = p->read_bytes;
+  s->write_bytes = p->write_bytes;
+}
+
+static void first_sample(void){
+  static const unsigned counters = PROC_FIELD_CSW | PROC_FILLIO;
+  struct timeval then, now;
+  proc_t buf, buf2;
+  PROCTAB *restrict ptp;
+  unsigned i;
+  /* sample what will be shown; with m, the main thread gets the process */
+  int tasks = (thread_flags & (TF_loose_tasks|TF_show_task)) != 0;
+  int procs = !tasks || (thread_flags & TF_show_proc);
+
+  gettimeofday(&then, NULL);
+  ptp = open_selected(PROC_FILLSTAT | PROC_FILLSTATUS | PROC_FIELD_TIMES | needs_for_threads
+                 | ((needs_for_format | needs_for_sort) & counters));
+  if(!ptp) {
+    fprintf(stderr, "Error: can not access /proc.\n");
+    exit(1);
+  }
+  memset(&buf, 0, sizeof buf);
+  while(readproc(ptp,&buf)){
+    if(procs) add_sample(&buf);
+    if(tasks) while(readtask(ptp,&buf,&buf2)){
+      if(procs && buf2.tid == buf.tid) continue;
+      add_sample(&buf2);
+    }
+  }
+  closeproc(ptp);
+
+  sample_mask = 15;
+  while(sample_mask < 2 * nsamples) sample_mask = sample_mask * 2 + 1;
+  sample_hash = xcalloc(NULL, (sample_mask + 1) * sizeof *sample_hash);
+  for(i = 0; i < nsamples; i++){
+    sample_hash[sample_slot(samples[i].tid)] = i + 1;
+  }
+
+  sleep(sample_interval);
+  gettimeofday(&now, NULL);
+  sample_secs = (now.tv_sec - then.tv_sec) + (now.tv_usec - then.tv_usec) / 1e6;
+}
+
+/* what first_sample() saw of this task, or NULL */
+const sample_t *find_sample(const proc_t *pp){
+  const sample_t *s;
+  int i;
+  if(!sample_hash) return NULL;
+  i = sample_hash[sample_slot(pp->tid)];
+  if(!i) return NULL;
+  s = &samples[i - 1];
+  if(s->start_time != pp->start_time) return NULL;  /* the tid was reused */
+  return s;
+}
+
 /***** just display */
 static void simple_spew(void){
   proc_t buf;
   PROCTAB* ptp;
-  ptp = openproc(needs_for_format | needs_for_sort | needs_for_select | needs_for_threads);
+  int rows_left = max_rows ? max_rows : -1;  /* never reaches 0 if no limit */
+  ptp = open_selected(needs_for_format | needs_for_sort | needs_for_select | needs_for_threads);
   if(!ptp) {
     fprintf(stderr, "Error: can not access /proc.\n");
     exit(1);
   }
+  ptp->arena = arena_new();  /* cmdline and environ, reused for each process */
   memset(&buf, '#', sizeof(proc_t));
   switch(thread_flags & (TF_show_proc|TF_loose_tasks|TF_show_task)){
   case TF_show_proc:                   // normal non-thread output
-    while(readproc(ptp,&buf)){
+    while(rows_left && readproc(ptp,&buf)){
       if(want_this_proc(&buf)){
         show_one_proc(&buf, proc_format_list);
+        rows_left--;
       }
-      if(buf.cmdline) free((void*)*buf.cmdline); // ought to reuse
-      if(buf.environ) free((void*)*buf.environ); // ought to reuse
+      arena_reset(ptp->arena);
     }
     break;
   case TF_show_proc|TF_loose_tasks:    // H option
-    while(readproc(ptp,&buf)){
+    while(rows_left && readproc(ptp,&buf)){
       proc_t buf2;
       // must still have the process allocated
-      while(readtask(ptp,&buf,&buf2)){
+      while(rows_left && readtask(ptp,&buf,&buf2)){
         if(!want_this_proc(&buf)) continue;
         show_one_proc(&buf2, task_format_list);
+        rows_left--;
       }
-      if(buf.cmdline) free((void*)*buf.cmdline); // ought to reuse
-      if(buf.environ) free((void*)*buf.environ); // ought to reuse
+      arena_reset(ptp->arena);
     }
     break;
   case TF_show_proc|TF_show_task:      // m and -m options
-    while(readproc(ptp,&buf)){
+    while(rows_left && readproc(ptp,&buf)){
       if(want_this_proc(&buf)){
         proc_t buf2;
         show_one_proc(&buf, proc_format_list);
         // must still have the process allocated
         while(readtask(ptp,&buf,&buf2)) show_one_proc(&buf2, task_format_list);
+        rows_left--;
       }
-      if(buf.cmdline) free((void*)*buf.cmdline); // ought to reuse
-      if(buf.environ) free((void*)*buf.environ); // ought to reuse
+      arena_reset(ptp->arena);
     }
     break;
   case TF_show_task:                   // -L and -T options
-    while(readproc(ptp,&buf)){
+    while(rows_left && readproc(ptp,&buf)){
       if(want_this_proc(&buf)){
         proc_t buf2;
         // must still have the process allocated
         while(readtask(ptp,&buf,&buf2)) show_one_proc(&buf2, task_format_list);
+        rows_left--;
       }
-      if(buf.cmdline) free((void*)*buf.cmdline); // ought to reuse
-      if(buf.environ) free((void*)*buf.environ); // ought to reuse
+      arena_reset(ptp->arena);
     }
     break;
   }
+  arena_free(ptp->arena);
   closeproc(ptp);
 }
 
@@ -427,6 +533,72 @@ static int compare_two_procs(const void *a, const void *b){
   return 0; /* no conclusion */
 }
 
+/***** sort by keys pulled out once, rather than walking sort_list each time */
+typedef struct key_use {
+  const sort_key_struct *sk;
+  unsigned long long flip;     /* ~0 if reversed */
+} key_use;
+
+static key_use *sort_keys;
+static int nkeys;              /* a row is nkeys keys, then an index */
+static proc_t **key_procs;     /* what the index is into */
+
+static int compare_key_rows(const void *a, const void *b){
+  const unsigned long long *restrict A = a;
+  const unsigned long long *restrict B = b;
+  int k;
+  for(k = 0; k < nkeys; k++){
+    if(A[k] != B[k]) return (A[k] < B[k]) ? -1 : 1;
+    if(sort_keys[k].sk->tie){  /* same first 8 bytes */
+      int result = (*sort_keys[k].sk->tie)(key_procs[A[nkeys]], key_procs[B[nkeys]]);
+      if(result) return (sort_keys[k].flip) ? -result : result;
+    }
+  }
+  /* keep the /proc order for ties */
+  return (A[nkeys] < B[nkeys]) ? -1 : (A[nkeys] > B[nkeys]);
+}
+
+static void sort_procs(proc_t **procs, int n){
+  sort_node *walk;
+  unsigned long long *rows, *row;
+  proc_t **sorted;
+  int i, k;
+  cost_mark cm;
+
+  COST_START(cm);
+  nkeys = 0;
+  for(walk = sort_list; walk; walk = walk->next) nkeys++;
+  sort_keys = xmalloc(nkeys * sizeof *sort_keys);
+  for(k = 0, walk = sort_list; walk; k++, walk = walk->next){
+    sort_keys[k].sk = search_sort_key(walk->sr);
+    sort_keys[k].flip = (walk->reverse) ? ~0ull : 0;
+    if(!sort_keys[k].sk){  /* not one we have a key for */
+      free(sort_keys);
+      qsort(procs, n, sizeof(proc_t*), compare_two_procs);
+      COST_STOP(COST_SORT, cm);
+      return;
+    }
+  }
+
+  rows = xmalloc(n * (nkeys+1) * sizeof *rows);
+  for(i = 0, row = rows; i < n; i++, row += nkeys+1){
+    for(k = 0; k < nkeys; k++){
+      row[k] = (*sort_keys[k].sk->key)(procs[i]) ^ sort_keys[k].flip;
+    }
+    row[nkeys] = i;
+  }
+  key_procs = procs;
+  qsort(rows, n, (nkeys+1) * sizeof *rows, compare_key_rows);
+
+  sorted = xmalloc(n * sizeof *sorted);
+  for(i = 0, row = rows; i < n; i++, row += nkeys+1) sorted[i] = procs[row[nkeys]];
+  memcpy(procs, sorted, n * sizeof *sorted);
+  free(sorted);
+  free(rows);
+  free(sort_keys);
+  COST_STOP(COST_SORT, cm);
+}
+
 /***** show pre-sorted array of process pointers */
 static void show_proc_array(PROCTAB *restrict ptp, int n){
   proc_t **p = processes;
@@ -447,11 +619,98 @@ static void show_proc_array(PROCTAB *restrict ptp, int n){
   }
 }
 
+/***** --max-rows with a sort: keep only the first max_rows, in a heap */
+static int proc_before(proc_t *a, proc_t *b){
+  return compare_two_procs(&a, &b) < 0;
+}
+
+/* the heap's root is the process that would be shown last */
+static void heap_up(proc_t **heap, int i){
+  while(i){
+    int parent = (i-1)/2;
+    proc_t *tmp;
+    if(!proc_before(heap[parent], heap[i])) break;
+    tmp = heap[parent];
+    heap[parent] = heap[i];
+    heap[i] = tmp;
+    i = parent;
+  }
+}
+
+static void heap_down(proc_t **heap, int n){
+  int i = 0;
+  for(;;){
+    int c = 2*i+1;
+    proc_t *tmp;
+    if(c >= n) break;
+    if(c+1 < n && proc_before(heap[c], heap[c+1])) c++;
+    if(!proc_before(heap[i], heap[c])) break;
+    tmp = heap[c];
+    heap[c] = heap[i];
+    heap[i] = tmp;
+    i = c;
+  }
+}
+
+static void release_proc(proc_t *p){
+  if(p->cmdline) free((void*)*p->cmdline);
+  if(p->environ) free((void*)*p->environ);
+  p->cmdline = NULL;
+  p->environ = NULL;
+}
+
+/* memory is max_rows+1 proc_t, however many processes there are */
+static void top_n_spew(void){
+  proc_t *pool;
+  proc_t *spare;
+  PROCTAB *restrict ptp;
+  int n = 0;
+
+  ptp = open_selected(needs_for_format | needs_for_sort | needs_for_select | needs_for_threads);
+  if(!ptp) {
+    fprintf(stderr, "Error: can not access /proc.\n");
+    exit(1);
+  }
+  /* max_rows can be up to 2e9: a size_t each, which x*alloc() don't take */
+  pool = calloc((size_t)max_rows+1, sizeof(proc_t));
+  processes = malloc((size_t)max_rows * sizeof(proc_t*));
+  if(!pool || !processes) {
+    fprintf(stderr, "Error: not enough memory for --max-rows %d.\n", max_rows);
+    exit(1);
+  }
+  spare = &pool[max_rows];
+  for(;;){
+    proc_t *p = (n < max_rows) ? &pool[n] : spare;
+    if(!readproc(ptp,p)) break;
+    if(!want_this_proc_pcpu(p)){
+      release_proc(p);
+      continue;
+    }
+    if(n < max_rows){
+      processes[n] = p;
+      heap_up(processes, n++);
+      continue;
+    }
+    if(!proc_before(p, processes[0])){
+      release_proc(p);
+      continue;
+    }
+    spare = processes[0];
+    release_proc(spare);
+    processes[0] = p;
+    heap_down(processes, n);
+  }
+  if(!n) return;  /* no processes */
+  sort_procs(processes, n);
+  show_proc_array(ptp,n);
+  closeproc(ptp);
+}
+
 /***** show tree */
-/* this needs some optimization work */
 #define ADOPTED(x) 1
-static void show_tree(const int self, const int n, const int level, const int have_sibling){
-  int i = 0;
+
+/* start one node: set its own prefix and show it */
+static void enter_tree(const int self, const int level, const int have_sibling){
   if(level){
     /* add prefix of "+" or "L" */
     if(have_sibling) forest_prefix[level-1] = '+';
@@ -459,54 +718,74 @@ static void show_tree(const int self, const int n, const int level, const int ha
     forest_prefix[level] = '\0';
   }
   show_one_proc(processes[self],format_list);  /* first show self */
-  /* no point freeing any of this -- won't need more mem */
-//  if(processes[self]->cmdline) free((void*)*processes[self]->cmdline);
-//  if(processes[self]->environ) free((void*)*processes[self]->environ);
-  for(;;){  /* look for children */
-    if(i >= n) return; /* no children */
-    if(processes[i]->ppid == processes[self]->XXXID) break;
-    i++;
-  }
+}
+
+/* the prefix its children get under it: "|" or " " */
+static void enter_children(const int level, const int have_sibling){
   if(level){
-    /* change our prefix to "|" or " " for the children */
     if(have_sibling) forest_prefix[level-1] = '|';
     else             forest_prefix[level-1] = ' ';
     forest_prefix[level] = '\0';
   }
-  for(;;){
-    int self_pid;
-    int more_children = 1;
-    if(i >= n) break; /* over the edge */
-    self_pid=processes[self]->XXXID;
-    if(i+1 >= n)
-      more_children = 0;
-    else
-      if(processes[i+1]->ppid != self_pid) more_children = 0;
-    if(self_pid==1 && ADOPTED(processes[i]) && forest_type!='u')
-      show_tree(i++, n, level,   more_children);
-    else
-      show_tree(i++, n, level+1, more_children);
-    if(!more_children) break;
-  }
-  /* chop prefix that children added -- do we need this? */
-  forest_prefix[level] = '\0';
-//  memset(processes[self], '$', sizeof(proc_t));  /* debug */
 }
 
-/***** show forest */
-static void show_forest(const int n){
-  int i = n;
-  int j;
-  while(i--){   /* cover whole array looking for trees */
-    j = n;
-    while(j--){   /* search for parent: if none, i is a tree! */
-      if(processes[j]->XXXID == processes[i]->ppid) goto not_root;
+/* one node whose children are being shown */
+typedef struct tree_frame {
+  int self;
+  int level;
+  int next;     /* index into forest.child[] of the next child to show */
+} tree_frame;
+
+/* depth-first, with an explicit stack so deep trees can't overflow ours */
+static void show_tree(const forest_t *restrict f, tree_frame *restrict stack, const int root){
+  int depth;
+  enter_tree(root, 0, 0);
+  if(f->first[root] == f->first[root+1]) return; /* no children */
+  enter_children(0, 0);
+  stack[0].self = root;
+  stack[0].level = 0;
+  stack[0].next = f->first[root];
+  depth = 1;
+  while(depth){
+    tree_frame *restrict top = &stack[depth-1];
+    const int end = f->first[top->self+1];
+    int i, level, more_children;
+    if(top->next >= end){
+      /* chop prefix that children added -- do we need this? */
+      forest_prefix[top->level] = '\0';
+      depth--;
+      continue;
     }
-    show_tree(i,n,0,0);
-not_root:
-    ;
+    i = f->child[top->next++];
+    more_children = top->next < end;
+    level = top->level + 1;
+    if(processes[top->self]->XXXID==1 && ADOPTED(processes[i]) && forest_type!='u')
+      level = top->level;
+    enter_tree(i, level, more_children);
+    if(f->first[i] == f->first[i+1]) continue; /* no children */
+    enter_children(level, more_children);
+    stack[depth].self = i;
+    stack[depth].level = level;
+    stack[depth].next = f->first[i];
+    depth++;
   }
-  /* don't free the array because it takes time and ps will exit anyway */
+}
+
+/***** show forest */
+static void show_forest(const int n){
+  forest_t f;
+  tree_frame *stack;
+  int r;
+  cost_mark cm;
+
+  memset(&f, 0, sizeof f);
+  COST_START(cm);
+  build_forest(&f, processes, n);
+  COST_STOP(COST_SORT, cm);
+  stack = xmalloc(n * sizeof *stack);
+  r = f.nroots;
+  while(r--) show_tree(&f, stack, f.root[r]);  /* last root first, as always */
+  /* don't free the index because it takes time and ps will exit anyway */
 }
 
 static int want_this_proc_nop(proc_t *dummy){
@@ -520,11 +799,12 @@ static void fancy_spew(void){
   PROCTAB *restrict ptp;
   int n = 0;  /* number of processes & index into array */
 
-  ptp = openproc(needs_for_format | needs_for_sort | needs_for_select | needs_for_threads);
+  ptp = open_selected(needs_for_format | needs_for_sort | needs_for_select | needs_for_threads | PROC_PARALLEL);
   if(!ptp) {
     fprintf(stderr, "Error: can not access /proc.\n");
     exit(1);
   }
+  ptp->arena = arena_new();  /* the whole table, for arena_free() to drop */
 
   if(thread_flags & TF_loose_tasks){
     pd = readproctab2(want_this_proc_nop, want_this_proc_pcpu, ptp);
@@ -536,13 +816,110 @@ static void fancy_spew(void){
 
   if(!n) return;  /* no processes */
   if(forest_type) prep_forest_sort();
-  qsort(processes, n, sizeof(proc_t*), compare_two_procs);
+  sort_procs(processes, n);
+  if(max_rows && n > max_rows) n = max_rows;
   if(forest_type) show_forest(n);
   else show_proc_array(ptp,n);
+  arena_free(ptp->arena);
   closeproc(ptp);
 }
 
 
+/***** --group-by=cgroup: a line per cgroup, its processes added up */
+typedef struct cg_row {
+  const char *cgroup;        /* libproc keeps one copy of each path */
+  unsigned nproc;
+  unsigned nlwp;
+  unsigned long long pcpu;   /* per-mill, each process figured like %CPU */
+  unsigned long long rss;    /* kB */
+} cg_row;
+
+static int compare_cg_rows(const void *a, const void *b){
+  const cg_row *A = a;
+  const cg_row *B = b;
+  if(A->cgroup == B->cgroup) return 0;
+  if(!A->cgroup) return -1;
+  if(!B->cgroup) return 1;
+  return strcmp(A->cgroup, B->cgroup);
+}
+
+/* like the TIME column: [dd-]hh:mm:ss */
+static void cg_time(char *restrict buf, unsigned long long usec){
+  unsigned long long t = usec / 1000000;
+  int c = 0;
+  if(t >= 86400) c = sprintf(buf, "%llu-", t / 86400);
+  sprintf(buf+c, "%02u:%02u:%02u", (unsigned)(t/3600%24), (unsigned)(t/60%60), (unsigned)(t%60));
+}
+
+static void group_spew(void){
+  PROCTAB *ptp;
+  proc_t buf;
+  cg_row *rows = NULL;
+  unsigned n = 0, room = 0, i, j;
+  cost_mark cm;
+
+  ptp = open_selected(needs_for_select | PROC_FILLSTAT | PROC_FIELD_TIMES | PROC_FIELD_VM | PROC_FILLCGROUP);
+  if(!ptp) {
+    fprintf(stderr, "Error: can not access /proc.\n");
+    exit(1);
+  }
+  ptp->arena = arena_new();
+  memset(&buf, '#', sizeof(proc_t));
+  while(readproc(ptp,&buf)){
+    if(want_this_proc(&buf)){
+      unsigned long long total_time = buf.utime + buf.stime;
+      unsigned long long seconds = seconds_since_boot - buf.start_time / Hertz;
+      if(include_dead_children) total_time += (buf.cutime + buf.cstime);
+      if(n == room){
+        room = room*2 + 64;
+        rows = xrealloc(rows, room * sizeof *rows);
+      }
+      rows[n].cgroup = buf.cgroup;
+      rows[n].nproc  = 1;
+      rows[n].nlwp   = buf.nlwp;
+      rows[n].pcpu   = seconds ? (total_time * 1000ULL / Hertz) / seconds : 0;
+      rows[n].rss    = (unsigned long long)buf.rss * (page_size / 1024);
+      n++;
+    }
+    arena_reset(ptp->arena);
+  }
+  arena_free(ptp->arena);
+  closeproc(ptp);
+
+  /* sorted by path, the members of a cgroup are side by side */
+  COST_START(cm);
+  if(n) qsort(rows, n, sizeof *rows, compare_cg_rows);
+  COST_STOP(COST_SORT, cm);
+  for(i = j = 0; i < n; i++){
+    if(j && rows[j-1].cgroup == rows[i].cgroup){
+      rows[j-1].nproc += rows[i].nproc;
+      rows[j-1].nlwp  += rows[i].nlwp;
+      rows[j-1].pcpu  += rows[i].pcpu;
+      rows[j-1].rss   += rows[i].rss;
+      continue;
+    }
+    rows[j++] = rows[i];
+  }
+  n = j;
+
+  if(header_type != HEAD_NONE)
+    printf("NPROC NLWP  %%CPU      RSS    CGMEM      CGTIME CGROUP\n");
+  for(i = 0; i < n; i++){
+    char pcpu[24], mem[24], tim[32];
+    cgstat_t st;
+    cgroup_stat(rows[i].cgroup, &st);   /* what cgroupfs has, dead tasks too */
+    if(rows[i].pcpu > 999) sprintf(pcpu, "%llu", rows[i].pcpu/10);
+    else sprintf(pcpu, "%llu.%llu", rows[i].pcpu/10, rows[i].pcpu%10);
+    if(st.have & CGSTAT_MEM) sprintf(mem, "%llu", st.memory >> 10);
+    else strcpy(mem, "-");
+    if(st.have & CGSTAT_CPU) cg_time(tim, st.usage_usec);
+    else strcpy(tim, "-");
+    printf("%5u %4u %5s %8llu %8s %11s %s\n", rows[i].nproc, rows[i].nlwp, pcpu,
+           rows[i].rss, mem, tim, rows[i].cgroup ? rows[i].cgroup : "-");
+  }
+  free(rows);
+}
+
 /***** no comment */
 int main(int argc, char *argv[]){
 #if (__GNU_LIBRARY__ >= 6)
@@ -586,8 +963,16 @@ int main(int argc, char *argv[]){
   init_output(); /* must be between parser and output */
 
   lists_and_needs();
+  if(sample_interval) first_sample();
 
-  if(forest_type || sort_list) fancy_spew(); /* sort or forest */
+  if(group_by_cgroup){
+    group_spew(); /* a line per cgroup, none per process */
+    return 0;
+  }
+  if(max_rows && sort_list && !forest_type
+  && (thread_flags & (TF_show_proc|TF_loose_tasks|TF_show_task)) == TF_show_proc)
+    top_n_spew(); /* sort, but only so many */
+  else if(forest_type || sort_list) fancy_spew(); /* sort or forest */
   else simple_spew(); /* no sort, no forest */
   show_one_proc((proc_t *)-1,format_list); /* no output yet? */
   return 0;
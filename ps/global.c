@@ -57,13 +57,17 @@ int             forest_type = -1;
 unsigned        format_flags = 0xffffffff;   /* -l -f l u s -j... */
 format_node    *format_list = (format_node *)0xdeadbeef; /* digested formatting options */
 unsigned        format_modifiers = 0xffffffff;   /* -c -j -y -P -L... */
+int             group_by_cgroup = -1;
 int             header_gap = -1;
 int             header_type = -1;
 int             include_dead_children = -1;
+int             jsonl_output = -1;
 int             lines_to_next_header = -1;
+int             max_rows = -1;
 const char     *namelist_file = (const char *)0xdeadbeef;
 int             negate_selection = -1;
 int             running_only = -1;
+int             sample_interval = -1;
 int             page_size = -1;  // "int" for math reasons?
 unsigned        personality = 0xffffffff;
 int             prefer_bsd_defaults = -1;
@@ -372,14 +376,18 @@ void reset_global(void){
   format_flags          = 0;   /* -l -f l u s -j... */
   format_list           = NULL; /* digested formatting options */
   format_modifiers      = 0;   /* -c -j -y -P -L... */
+  group_by_cgroup       = 0;
   header_gap            = -1;  /* send lines_to_next_header to -infinity */
   header_type           = HEAD_SINGLE;
   include_dead_children = 0;
+  jsonl_output          = 0;
   lines_to_next_header  = 1;
+  max_rows              = 0;
   namelist_file         = NULL;
   negate_selection      = 0;
   page_size             = getpagesize();
   running_only          = 0;
+  sample_interval       = 0;
   seconds_since_boot    = uptime(0,0);
   selection_list        = NULL;
   simple_select         = 0;
@@ -40,6 +40,7 @@
  */
  
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <grp.h>
 #include <limits.h>
@@ -61,6 +62,8 @@
 #include "../proc/procps.h"
 #include "../proc/devname.h"
 #include "../proc/escape.h"
+#include "../proc/costs.h"
+#include "../proc/alloc.h"
 #include "common.h"
 
 /* TODO:
@@ -88,10 +91,33 @@ static int sr_nop(const proc_t* a, const proc_t* b){
   (void)a;(void)b; /* shut up gcc */
   return 0;
 }
+static unsigned long long key_nop(const proc_t* P){
+  (void)P;
+  return 0;
+}
+
+/* Each sort function also gets a key function: the field as an unsigned
+ * number that sorts the same way, so that ps can pull all the keys out
+ * once and sort on those.  A string's key is only its first 8 bytes. */
+#define KEY_SIGN 0x8000000000000000ull
+#define KEY_SIGNED(v) ((__typeof__(v))-1 < (__typeof__(v))1)
+
+static unsigned long long key_prefix(const char *s){
+  unsigned long long k = 0;
+  int i;
+  for(i = 0; i < 8; i++){
+    k <<= 8;
+    if(*s) k |= (unsigned char)*s++;
+  }
+  return k;
+}
 
 #define CMP_STR(NAME) \
 static int sr_ ## NAME(const proc_t* P, const proc_t* Q) { \
     return strcmp(P->NAME, Q->NAME); \
+} \
+static unsigned long long key_ ## NAME (const proc_t* P) { \
+    return key_prefix(P->NAME); \
 }
 
 #define CMP_INT(NAME) \
@@ -99,6 +125,10 @@ static int sr_ ## NAME (const proc_t* P, const proc_t* Q) { \
     if (P->NAME < Q->NAME) return -1; \
     if (P->NAME > Q->NAME) return  1; \
     return 0; \
+} \
+static unsigned long long key_ ## NAME (const proc_t* P) { \
+    if (KEY_SIGNED(P->NAME)) return (unsigned long long)(long long)P->NAME ^ KEY_SIGN; \
+    return (unsigned long long)P->NAME; \
 }
 
 /* fast version, for values which either:
@@ -108,82 +138,108 @@ static int sr_ ## NAME (const proc_t* P, const proc_t* Q) { \
 #define CMP_SMALL(NAME) \
 static int sr_ ## NAME (const proc_t* P, const proc_t* Q) { \
     return (int)(P->NAME) - (int)(Q->NAME); \
-}
-
-CMP_INT(rtprio)
-CMP_SMALL(sched)
-CMP_INT(cutime)
-CMP_INT(cstime)
-CMP_SMALL(priority)                                             /* nice */
-CMP_SMALL(nlwp)
-CMP_SMALL(nice)                                                 /* priority */
-CMP_INT(rss)      /* resident set size from stat file */ /* vm_rss, resident */
-CMP_INT(alarm)
-CMP_INT(size)      /* total pages */                     /* vm_size, vsize */
-CMP_INT(resident)  /* resident pages */                     /* vm_rss, rss */
-CMP_INT(share)     /* shared pages */
-CMP_INT(trs)       /* executable pages */
-CMP_INT(lrs)       /* obsolete "library" pages above 0x60000000 */
-CMP_INT(drs)       /* other pages (assumed data?) */
-CMP_INT(dt)        /* dirty pages */
-
-CMP_INT(vm_size)    /* kB VM */                             /* size, vsize */
-CMP_INT(vm_lock)    /* kB locked */
-CMP_INT(vm_rss)     /* kB rss */                          /* rss, resident */
-CMP_INT(vm_data)    /* kB "data" == data-stack */
-CMP_INT(vm_stack)   /* kB stack */
-CMP_INT(vm_exe)     /* kB "exec" == exec-lib */
-CMP_INT(vm_lib)     /* kB "libraries" */
-CMP_INT(vsize)      /* pages VM */                        /* size, vm_size */
-CMP_INT(rss_rlim)
-CMP_SMALL(flags)
-CMP_INT(min_flt)
-CMP_INT(maj_flt)
-CMP_INT(cmin_flt)
-CMP_INT(cmaj_flt)
-CMP_INT(utime)
-CMP_INT(stime)    /* Old: sort by systime. New: show start time. Uh oh. */
-CMP_INT(start_code)
-CMP_INT(end_code)
-CMP_INT(start_stack)
-CMP_INT(kstk_esp)
-CMP_INT(kstk_eip)
-CMP_INT(start_time)
-CMP_INT(wchan)
-
-/* CMP_STR(*environ) */
-/* CMP_STR(*cmdline) */
-
-CMP_STR(ruser)
-CMP_STR(euser)
-CMP_STR(suser)
-CMP_STR(fuser)
-CMP_STR(rgroup)
-CMP_STR(egroup)
-CMP_STR(sgroup)
-CMP_STR(fgroup)
-CMP_STR(cmd)
-/* CMP_STR(ttyc) */    /* FIXME -- use strncmp with 8 max */
-
-CMP_INT(ruid)
-CMP_INT(rgid)
-CMP_INT(euid)
-CMP_INT(egid)
-CMP_INT(suid)
-CMP_INT(sgid)
-CMP_INT(fuid)
-CMP_INT(fgid)
-CMP_SMALL(tid)
-CMP_SMALL(tgid)
-CMP_SMALL(ppid)
-CMP_SMALL(pgrp)
-CMP_SMALL(session)
-CMP_INT(tty)
-CMP_SMALL(tpgid)
-
-CMP_SMALL(pcpu)
-
-CMP_SMALL(state)
+} \
+static unsigned long long key_ ## NAME (const proc_t* P) { \
+    return (unsigned long long)(long long)(int)(P->NAME) ^ KEY_SIGN; \
+}
+
+#define SORT_FIELDS \
+  INT(rtprio) \
+  SMALL(sched) \
+  INT(cutime) \
+  INT(cstime) \
+  SMALL(priority)                                             /* nice */ \
+  SMALL(nlwp) \
+  SMALL(nlwp_run) /* threads in state R */ \
+  SMALL(nice)                                                 /* priority */ \
+  INT(rss)      /* resident set size from stat file */ /* vm_rss, resident */ \
+  INT(alarm) \
+  INT(size)      /* total pages */                     /* vm_size, vsize */ \
+  INT(resident)  /* resident pages */                     /* vm_rss, rss */ \
+  INT(share)     /* shared pages */ \
+  INT(trs)       /* executable pages */ \
+  INT(lrs)       /* obsolete "library" pages above 0x60000000 */ \
+  INT(drs)       /* other pages (assumed data?) */ \
+  INT(dt)        /* dirty pages */ \
+  INT(vm_size)    /* kB VM */                             /* size, vsize */ \
+  INT(vm_lock)    /* kB locked */ \
+  INT(vm_rss)     /* kB rss */                          /* rss, resident */ \
+  INT(vm_data)    /* kB "data" == data-stack */ \
+  INT(vm_stack)   /* kB stack */ \
+  INT(vm_exe)     /* kB "exec" == exec-lib */ \
+  INT(vm_lib)     /* kB "libraries" */ \
+  INT(pss)        /* kB proportional set size */ \
+  INT(uss)        /* kB unique set size */ \
+  INT(swap_pss)   /* kB proportional swap */ \
+  INT(anon_huge)  /* kB transparent huge pages */ \
+  INT(hugetlb)    /* kB hugetlbfs */ \
+  INT(numa_remote) /* kB away from the node it last ran on */ \
+  SMALL(numa_node) \
+  INT(vsize)      /* pages VM */                        /* size, vm_size */ \
+  INT(rss_rlim) \
+  SMALL(flags) \
+  INT(min_flt) \
+  INT(maj_flt) \
+  INT(cmin_flt) \
+  INT(cmaj_flt) \
+  INT(nvcsw)      /* voluntary context switches */ \
+  INT(nivcsw)     /* involuntary context switches */ \
+  INT(rchar)      /* /proc/#/io, which needs ptrace access */ \
+  INT(wchar) \
+  INT(syscr) \
+  INT(syscw) \
+  INT(read_bytes) \
+  INT(write_bytes) \
+  INT(cancelled_write_bytes) \
+  INT(cpu_delay)  /* taskstats, or /proc/#/schedstat */ \
+  INT(blkio_delay) \
+  INT(swapin_delay) \
+  INT(utime) \
+  INT(stime)    /* Old: sort by systime. New: show start time. Uh oh. */ \
+  INT(start_code) \
+  INT(end_code) \
+  INT(start_stack) \
+  INT(kstk_esp) \
+  INT(kstk_eip) \
+  INT(start_time) \
+  INT(wchan) \
+  /* CMP_STR(*environ) */ \
+  /* CMP_STR(*cmdline) */ \
+  STR(ruser) \
+  STR(euser) \
+  STR(suser) \
+  STR(fuser) \
+  STR(rgroup) \
+  STR(egroup) \
+  STR(sgroup) \
+  STR(fgroup) \
+  STR(cmd) \
+  /* CMP_STR(ttyc) */    /* FIXME -- use strncmp with 8 max */ \
+  INT(ruid) \
+  INT(rgid) \
+  INT(euid) \
+  INT(egid) \
+  INT(suid) \
+  INT(sgid) \
+  INT(fuid) \
+  INT(fgid) \
+  SMALL(tid) \
+  SMALL(tgid) \
+  SMALL(ppid) \
+  SMALL(pgrp) \
+  SMALL(session) \
+  INT(tty) \
+  SMALL(tpgid) \
+  SMALL(pcpu) \
+  SMALL(state)
+
+#define INT(NAME)   CMP_INT(NAME)
+#define SMALL(NAME) CMP_SMALL(NAME)
+#define STR(NAME)   CMP_STR(NAME)
+SORT_FIELDS
+#undef INT
+#undef SMALL
+#undef STR
 
 /* approximation to: kB of address space that could end up in swap */
 static int sr_swapable(const proc_t* P, const proc_t* Q) {
@@ -193,6 +249,77 @@ static int sr_swapable(const proc_t* P, const proc_t* Q) {
   if (p_swapable > q_swapable) return  1;
   return 0;
 }
+static unsigned long long key_swapable(const proc_t* P) {
+  return P->vm_data + P->vm_stack;
+}
+
+/* per-mill, like %cpu: the busiest thread's time over that thread's life */
+static unsigned long long key_thcpu(const proc_t* P) {
+  unsigned long long seconds = seconds_since_boot - P->thr_start / Hertz;
+  if(!seconds) return 0;
+  return (P->thr_time * 1000ULL / Hertz) / seconds;
+}
+static int sr_thcpu(const proc_t* P, const proc_t* Q) {
+  unsigned long long p = key_thcpu(P), q = key_thcpu(Q);
+  return (p > q) - (p < q);
+}
+
+/* With --interval, a counter's growth since the first sample; all the
+ * rates share a divisor, so the growth sorts the same.  It is 0 for a
+ * task that wasn't there the first time, which shows "-". */
+#define RATE_FIELDS \
+  RATE(minflt_rate, min_flt) \
+  RATE(majflt_rate, maj_flt) \
+  RATE(nvcsw_rate,  nvcsw) \
+  RATE(nivcsw_rate, nivcsw) \
+  RATE(rbytes_rate, read_bytes) \
+  RATE(wbytes_rate, write_bytes)
+
+#define RATE(NAME,FIELD) \
+static unsigned long long key_ ## NAME (const proc_t* P) { \
+    const sample_t *s = find_sample(P); \
+    if (!s || P->FIELD < s->FIELD) return 0; \
+    return (unsigned long long)(P->FIELD - s->FIELD) + 1; \
+} \
+static int sr_ ## NAME (const proc_t* P, const proc_t* Q) { \
+    unsigned long long p = key_ ## NAME (P), q = key_ ## NAME (Q); \
+    return (p > q) - (p < q); \
+}
+RATE_FIELDS
+#undef RATE
+
+#define INT(NAME)   { sr_ ## NAME, key_ ## NAME, NULL },
+#define SMALL(NAME) { sr_ ## NAME, key_ ## NAME, NULL },
+#define STR(NAME)   { sr_ ## NAME, key_ ## NAME, sr_ ## NAME },
+/* the path, with tasks that have none sorted first */
+static int sr_cgroup(const proc_t* P, const proc_t* Q) {
+  return strcmp(P->cgroup ? P->cgroup : "", Q->cgroup ? Q->cgroup : "");
+}
+static unsigned long long key_cgroup(const proc_t* P) {
+  return key_prefix(P->cgroup ? P->cgroup : "");
+}
+
+#define RATE(NAME,FIELD) { sr_ ## NAME, key_ ## NAME, NULL },
+static const sort_key_struct sort_key_array[] = {
+SORT_FIELDS
+RATE_FIELDS
+  { sr_swapable, key_swapable, NULL },
+  { sr_thcpu,    key_thcpu,    NULL },
+  { sr_cgroup,   key_cgroup,   sr_cgroup },
+  { sr_nop,      key_nop,      NULL },
+};
+#undef INT
+#undef SMALL
+#undef STR
+#undef RATE
+
+/* the key function for a sort function, or NULL */
+const sort_key_struct *search_sort_key(int (*sr)(const proc_t* P, const proc_t* Q)){
+  const sort_key_struct *walk = sort_key_array;
+  const sort_key_struct *const end = walk + sizeof sort_key_array / sizeof sort_key_array[0];
+  for(; walk < end; walk++) if(walk->sr == sr) return walk;
+  return NULL;
+}
 
 
 /***************************************************************************/
@@ -286,7 +413,7 @@ static int forest_helper(char *restrict const outbuf){
   char *p = forest_prefix;
   char *q = outbuf;
   int rightward=max_rightward;
-  if(!*p) return 0;
+  if(!*p || jsonl_output) return 0;
   /* Arrrgh! somebody defined unix as 1 */
   if(forest_type == 'u') goto unixy;
   while(*p){
@@ -892,6 +1019,90 @@ static int pr_majflt(char *restrict const outbuf, const proc_t *restrict const p
     return snprintf(outbuf, COLWID, "%ld", flt);
 }
 
+static int pr_nvcsw(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->nvcsw);
+}
+
+static int pr_nivcsw(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->nivcsw);
+}
+
+/* per second since --interval's first sample, in pidstat's format */
+static int pr_rate(char *restrict const outbuf, unsigned long long key, double scale){
+  if(!key) return snprintf(outbuf, COLWID, "%c", '-');
+  return snprintf(outbuf, COLWID, "%.2f", (double)(key - 1) * scale / sample_secs);
+}
+
+static int pr_minflt_rate(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_rate(outbuf, key_minflt_rate(pp), 1.0);
+}
+
+static int pr_majflt_rate(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_rate(outbuf, key_majflt_rate(pp), 1.0);
+}
+
+static int pr_nvcsw_rate(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_rate(outbuf, key_nvcsw_rate(pp), 1.0);
+}
+
+static int pr_nivcsw_rate(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_rate(outbuf, key_nivcsw_rate(pp), 1.0);
+}
+
+static int pr_rbytes_rate(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_rate(outbuf, key_rbytes_rate(pp), 1.0 / 1024);
+}
+
+static int pr_wbytes_rate(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_rate(outbuf, key_wbytes_rate(pp), 1.0 / 1024);
+}
+
+/* these come from /proc/#/io, which needs ptrace access to the process */
+static int pr_rchar(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%llu", pp->rchar);
+}
+
+static int pr_wchar(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%llu", pp->wchar);
+}
+
+static int pr_syscr(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%llu", pp->syscr);
+}
+
+static int pr_syscw(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%llu", pp->syscw);
+}
+
+static int pr_rbytes(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%llu", pp->read_bytes);
+}
+
+static int pr_wbytes(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%llu", pp->write_bytes);
+}
+
+static int pr_cwbytes(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%llu", pp->cancelled_write_bytes);
+}
+
+/* delays come in ns; seconds to the millisecond are plenty */
+static int pr_delay(char *restrict const outbuf, unsigned long long ns){
+  return snprintf(outbuf, COLWID, "%llu.%03llu", ns / 1000000000ull, ns / 1000000ull % 1000ull);
+}
+
+static int pr_cpudelay(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_delay(outbuf, pp->cpu_delay);
+}
+
+static int pr_iodelay(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_delay(outbuf, pp->blkio_delay);
+}
+
+static int pr_swapdelay(char *restrict const outbuf, const proc_t *restrict const pp){
+  return pr_delay(outbuf, pp->swapin_delay);
+}
+
 static int pr_lim(char *restrict const outbuf, const proc_t *restrict const pp){
     if(pp->rss_rlim == RLIM_INFINITY){
       outbuf[0] = 'x';
@@ -911,6 +1122,41 @@ static int pr_rss(char *restrict const outbuf, const proc_t *restrict const pp){
   return snprintf(outbuf, COLWID, "%lu", pp->vm_rss);
 }
 
+/* these come from smaps_rollup, which needs ptrace access to the process */
+static int pr_pss(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->pss);
+}
+static int pr_thp(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->anon_huge);
+}
+static int pr_hugetlb(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->hugetlb);
+}
+
+/* kB on each NUMA node, node 0 first, up to the last one with any */
+static int pr_numa(char *restrict const outbuf, const proc_t *restrict const pp){
+  int last = PROC_NODES - 1, i, n = 0;
+  while(last > 0 && !pp->node_kb[last]) last--;
+  for(i = 0; i <= last; i++)
+    n += snprintf(outbuf+n, COLWID-n, i ? ",%lu" : "%lu", pp->node_kb[i]);
+  return n;
+}
+static int pr_numa_node(char *restrict const outbuf, const proc_t *restrict const pp){
+  if(pp->numa_node < 0) return snprintf(outbuf, COLWID, "-");
+  return snprintf(outbuf, COLWID, "%d", pp->numa_node);
+}
+static int pr_numa_remote(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->numa_remote);
+}
+
+static int pr_uss(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->uss);
+}
+
+static int pr_swappss(char *restrict const outbuf, const proc_t *restrict const pp){
+  return snprintf(outbuf, COLWID, "%lu", pp->swap_pss);
+}
+
 /* pp->vm_rss * 1000 would overflow on 32-bit systems with 64 GB memory */
 static int pr_pmem(char *restrict const outbuf, const proc_t *restrict const pp){
   unsigned long pmem = 0;
@@ -1098,6 +1344,17 @@ static int pr_thread(char *restrict const outbuf, const proc_t *restrict const p
 static int pr_nlwp(char *restrict const outbuf, const proc_t *restrict const pp){
     return snprintf(outbuf, COLWID, "%d", pp->nlwp);
 }
+// threads that are running (or runnable)
+static int pr_nlwp_run(char *restrict const outbuf, const proc_t *restrict const pp){
+    return snprintf(outbuf, COLWID, "%d", pp->nlwp_run);
+}
+// %cpu of the thread that has used the most, over its own life
+static int pr_thcpu(char *restrict const outbuf, const proc_t *restrict const pp){
+  unsigned pcpu = key_thcpu(pp);   /* scaled %cpu, 999 means 99.9% */
+  if (pcpu > 999U)
+    return snprintf(outbuf, COLWID, "%u", pcpu/10U);
+  return snprintf(outbuf, COLWID, "%u.%u", pcpu/10U, pcpu%10U);
+}
 
 static int pr_sess(char *restrict const outbuf, const proc_t *restrict const pp){
   return snprintf(outbuf, COLWID, "%u", pp->session);
@@ -1183,6 +1440,19 @@ static int pr_context(char *restrict const outbuf, const proc_t *restrict const
 #endif
 
 
+/* cgroup paths get long, so like args this takes what room there is */
+static int pr_cgroup(char *restrict const outbuf, const proc_t *restrict const pp){
+  int rightward = max_rightward;
+
+  if(!pp->cgroup){
+    outbuf[0] = '-';
+    outbuf[1] = '\0';
+    return 1;
+  }
+  escape_str(outbuf, pp->cgroup, OUTBUF_SIZE, &rightward);
+  return max_rightward-rightward;
+}
+
 ////////////////////////////// Test code /////////////////////////////////
 
 // like "args"
@@ -1270,6 +1540,17 @@ static int pr_t_left2(char *restrict const outbuf, const proc_t *restrict const
 #define USR PROC_FILLUSR     /* uid_t -> user names */
 #define GRP PROC_FILLGRP     /* gid_t -> group names */
 #define WCH PROC_FILLWCHAN   /* do WCHAN lookup */
+#define TIM PROC_FIELD_TIMES /* stat: times, faults, priority, nice, nlwp */
+#define VM  PROC_FIELD_VM    /* stat+status: sizes, addresses */
+#define SCH PROC_FIELD_SCHED /* stat: wchan, processor, policy */
+#define SIG PROC_FIELD_SIGS  /* status: signal masks */
+#define SMA PROC_FILLSMAPS   /* read smaps_rollup (slow) */
+#define CSW PROC_FIELD_CSW   /* status: context switch counts */
+#define IO  PROC_FILLIO      /* read io */
+#define DLY PROC_FILLDELAY   /* taskstats netlink (CAP_NET_ADMIN) */
+#define CGR PROC_FILLCGROUP  /* read cgroup */
+#define TSU PROC_FILLTSUM    /* read every thread's stat */
+#define NUM PROC_FILLNUMA    /* read numa_maps (slow) */
 
 
 /* TODO
@@ -1285,8 +1566,8 @@ static int pr_t_left2(char *restrict const outbuf, const proc_t *restrict const
 /* Many of these are placeholders for unsupported options. */
 static const format_struct format_array[] = {
 /* code       header     print()      sort()    width need vendor flags  */
-{"%cpu",      "%CPU",    pr_pcpu,     sr_pcpu,    4,   0,    BSD, ET|RIGHT}, /*pcpu*/
-{"%mem",      "%MEM",    pr_pmem,     sr_nop,     4,   0,    BSD, PO|RIGHT}, /*pmem*/
+{"%cpu",      "%CPU",    pr_pcpu,     sr_pcpu,    4, TIM,    BSD, ET|RIGHT}, /*pcpu*/
+{"%mem",      "%MEM",    pr_pmem,     sr_nop,     4,  VM,    BSD, PO|RIGHT}, /*pmem*/
 {"_left",     "LLLLLLLL", pr_t_left,  sr_nop,     8,   0,    TST, ET|LEFT},
 {"_left2",    "L2L2L2L2", pr_t_left2, sr_nop,     8,   0,    TST, ET|LEFT},
 {"_right",    "RRRRRRRRRRR", pr_t_right, sr_nop, 11,   0,    TST, ET|RIGHT},
@@ -1297,52 +1578,56 @@ static const format_struct format_array[] = {
 {"acflg",     "ACFLG",   pr_nop,      sr_nop,     5,   0,    BSD, AN|RIGHT}, /*acflag*/
 {"addr",      "ADDR",    pr_nop,      sr_nop,     4,   0,    XXX, AN|RIGHT},
 {"addr_1",    "ADDR",    pr_nop,      sr_nop,     1,   0,    LNX, AN|LEFT},
-{"alarm",     "ALARM",   pr_alarm,    sr_alarm,   5,   0,    LNX, AN|RIGHT},
+{"alarm",     "ALARM",   pr_alarm,    sr_alarm,   5, TIM,    LNX, AN|RIGHT},
 {"argc",      "ARGC",    pr_nop,      sr_nop,     4,   0,    LNX, PO|RIGHT},
 {"args",      "COMMAND", pr_args,     sr_cmd,    27, ARG,    U98, PO|UNLIMITED}, /*command*/
-{"atime",     "TIME",    pr_time,     sr_nop,     8,   0,    SOE, ET|RIGHT}, /*cputime*/ /* was 6 wide */
-{"blocked",   "BLOCKED", pr_sigmask,  sr_nop,     9,   0,    BSD, TO|SIGNAL}, /*sigmask*/
+{"atime",     "TIME",    pr_time,     sr_nop,     8, TIM,    SOE, ET|RIGHT}, /*cputime*/ /* was 6 wide */
+{"blocked",   "BLOCKED", pr_sigmask,  sr_nop,     9, SIG,    BSD, TO|SIGNAL}, /*sigmask*/
 {"bnd",       "BND",     pr_nop,      sr_nop,     1,   0,    AIX, TO|RIGHT},
-{"bsdstart",  "START",   pr_bsdstart, sr_nop,     6,   0,    LNX, ET|RIGHT},
-{"bsdtime",   "TIME",    pr_bsdtime,  sr_nop,     6,   0,    LNX, ET|RIGHT},
-{"c",         "C",       pr_c,        sr_pcpu,    2,   0,    SUN, ET|RIGHT},
-{"caught",    "CAUGHT",  pr_sigcatch, sr_nop,     9,   0,    BSD, TO|SIGNAL}, /*sigcatch*/
-{"class",     "CLS",     pr_class,    sr_sched,   3,   0,    XXX, TO|LEFT},
-{"cls",       "CLS",     pr_class,    sr_sched,   3,   0,    HPU, TO|RIGHT}, /*says HPUX or RT*/
-{"cmaj_flt",  "-",       pr_nop,      sr_cmaj_flt, 1,  0,    LNX, AN|RIGHT},
+{"bsdstart",  "START",   pr_bsdstart, sr_nop,     6, TIM,    LNX, ET|RIGHT},
+{"bsdtime",   "TIME",    pr_bsdtime,  sr_nop,     6, TIM,    LNX, ET|RIGHT},
+{"c",         "C",       pr_c,        sr_pcpu,    2, TIM,    SUN, ET|RIGHT},
+{"caught",    "CAUGHT",  pr_sigcatch, sr_nop,     9, SIG,    BSD, TO|SIGNAL}, /*sigcatch*/
+{"cgroup",    "CGROUP",  pr_cgroup,   sr_cgroup, 27, CGR,    LNX, ET|UNLIMITED},
+{"class",     "CLS",     pr_class,    sr_sched,   3, SCH,    XXX, TO|LEFT},
+{"cls",       "CLS",     pr_class,    sr_sched,   3, SCH,    HPU, TO|RIGHT}, /*says HPUX or RT*/
+{"cmaj_flt",  "-",       pr_nop,      sr_cmaj_flt, 1, TIM,    LNX, AN|RIGHT},
 {"cmd",       "CMD",     pr_args,     sr_cmd,    27, ARG,    DEC, PO|UNLIMITED}, /*ucomm*/
-{"cmin_flt",  "-",       pr_nop,      sr_cmin_flt, 1,  0,    LNX, AN|RIGHT},
+{"cmin_flt",  "-",       pr_nop,      sr_cmin_flt, 1, TIM,    LNX, AN|RIGHT},
 {"cnswap",    "-",       pr_nop,      sr_nop,     1,   0,    LNX, AN|RIGHT},
 {"comm",      "COMMAND", pr_comm,     sr_cmd,    15, COM,    U98, PO|UNLIMITED}, /*ucomm*/
 {"command",   "COMMAND", pr_args,     sr_cmd,    27, ARG,    XXX, PO|UNLIMITED}, /*args*/
 {"context",   "CONTEXT", pr_context,  sr_nop,    31,   0,    LNX, ET|LEFT},
-{"cp",        "CP",      pr_cp,       sr_pcpu,    3,   0,    DEC, ET|RIGHT}, /*cpu*/
+{"cp",        "CP",      pr_cp,       sr_pcpu,    3, TIM,    DEC, ET|RIGHT}, /*cpu*/
 {"cpu",       "CPU",     pr_nop,      sr_nop,     3,   0,    BSD, AN|RIGHT}, /* FIXME ... HP-UX wants this as the CPU number for SMP? */
-{"cpuid",     "CPUID",   pr_psr,      sr_nop,     5,   0,    BSD, TO|RIGHT}, // OpenBSD: 8 wide!
-{"cputime",   "TIME",    pr_time,     sr_nop,     8,   0,    DEC, ET|RIGHT}, /*time*/
-{"cstime",    "-",       pr_nop,      sr_cstime,  1,   0,    LNX, AN|RIGHT},
+{"cpudelay",  "CPUDELAY", pr_cpudelay, sr_cpu_delay, 8, DLY, LNX, AN|RIGHT},
+{"cpuid",     "CPUID",   pr_psr,      sr_nop,     5, SCH,    BSD, TO|RIGHT}, // OpenBSD: 8 wide!
+{"cputime",   "TIME",    pr_time,     sr_nop,     8, TIM,    DEC, ET|RIGHT}, /*time*/
+{"cstime",    "-",       pr_nop,      sr_cstime,  1, TIM,    LNX, AN|RIGHT},
+{"cswch/s",   "CSWCH/S", pr_nvcsw_rate, sr_nvcsw_rate, 8, CSW|TIM, LNX, AN|RIGHT}, /* pidstat */
 {"ctid",      "CTID",    pr_nop,      sr_nop,     5,   0,    SUN, ET|RIGHT}, // resource contracts?
 {"cursig",    "CURSIG",  pr_nop,      sr_nop,     6,   0,    DEC, AN|RIGHT},
-{"cutime",    "-",       pr_nop,      sr_cutime,  1,   0,    LNX, AN|RIGHT},
+{"cutime",    "-",       pr_nop,      sr_cutime,  1, TIM,    LNX, AN|RIGHT},
+{"cwbytes",   "CWBYTES", pr_cwbytes,  sr_cancelled_write_bytes, 7, IO, LNX, AN|RIGHT},
 {"cwd",       "CWD",     pr_nop,      sr_nop,     3,   0,    LNX, AN|LEFT},
-{"drs",       "DRS",     pr_drs,      sr_drs,     5, MEM,    LNX, PO|RIGHT},
-{"dsiz",      "DSIZ",    pr_dsiz,     sr_nop,     4,   0,    LNX, PO|RIGHT},
+{"drs",       "DRS",     pr_drs,      sr_drs,     5, MEM|VM, LNX, PO|RIGHT},
+{"dsiz",      "DSIZ",    pr_dsiz,     sr_nop,     4,  VM,    LNX, PO|RIGHT},
 {"egid",      "EGID",    pr_egid,     sr_egid,    5,   0,    LNX, ET|RIGHT},
 {"egroup",    "EGROUP",  pr_egroup,   sr_egroup,  8, GRP,    LNX, ET|USER},
-{"eip",       "EIP",     pr_eip,      sr_kstk_eip, 8,  0,    LNX, TO|RIGHT},
+{"eip",       "EIP",     pr_eip,      sr_kstk_eip, 8, VM,    LNX, TO|RIGHT},
 {"emul",      "EMUL",    pr_nop,      sr_nop,    13,   0,    BSD, PO|LEFT}, /* "FreeBSD ELF32" and such */
-{"end_code",  "E_CODE",  pr_nop,      sr_end_code, 8,  0,    LNx, PO|RIGHT},
+{"end_code",  "E_CODE",  pr_nop,      sr_end_code, 8, VM,    LNx, PO|RIGHT},
 {"environ","ENVIRONMENT",pr_nop,      sr_nop,    11, ENV,    LNx, PO|UNLIMITED},
-{"esp",       "ESP",     pr_esp,      sr_kstk_esp, 8,  0,    LNX, TO|RIGHT},
-{"etime",     "ELAPSED", pr_etime,    sr_nop,    11,   0,    U98, ET|RIGHT}, /* was 7 wide */
-{"etimes",    "ELAPSED", pr_etimes,   sr_nop,     7,   0,    BSD, ET|RIGHT}, /* FreeBSD */
+{"esp",       "ESP",     pr_esp,      sr_kstk_esp, 8, VM,    LNX, TO|RIGHT},
+{"etime",     "ELAPSED", pr_etime,    sr_nop,    11, TIM,    U98, ET|RIGHT}, /* was 7 wide */
+{"etimes",    "ELAPSED", pr_etimes,   sr_nop,     7, TIM,    BSD, ET|RIGHT}, /* FreeBSD */
 {"euid",      "EUID",    pr_euid,     sr_euid,    5,   0,    LNX, ET|RIGHT},
 {"euser",     "EUSER",   pr_euser,    sr_euser,   8, USR,    LNX, ET|USER},
-{"f",         "F",       pr_flag,     sr_flags,   1,   0,    XXX, ET|RIGHT}, /*flags*/
+{"f",         "F",       pr_flag,     sr_flags,   1, TIM,    XXX, ET|RIGHT}, /*flags*/
 {"fgid",      "FGID",    pr_fgid,     sr_fgid,    5,   0,    LNX, ET|RIGHT},
 {"fgroup",    "FGROUP",  pr_fgroup,   sr_fgroup,  8, GRP,    LNX, ET|USER},
-{"flag",      "F",       pr_flag,     sr_flags,   1,   0,    DEC, ET|RIGHT},
-{"flags",     "F",       pr_flag,     sr_flags,   1,   0,    BSD, ET|RIGHT}, /*f*/ /* was FLAGS, 8 wide */
+{"flag",      "F",       pr_flag,     sr_flags,   1, TIM,    DEC, ET|RIGHT},
+{"flags",     "F",       pr_flag,     sr_flags,   1, TIM,    BSD, ET|RIGHT}, /*f*/ /* was FLAGS, 8 wide */
 {"fname",     "COMMAND", pr_fname,    sr_nop,     8,   0,    SUN, PO|LEFT},
 {"fsgid",     "FSGID",   pr_fgid,     sr_fgid,    5,   0,    LNX, ET|RIGHT},
 {"fsgroup",   "FSGROUP", pr_fgroup,   sr_fgroup,  8, GRP,    LNX, ET|USER},
@@ -1352,144 +1637,164 @@ static const format_struct format_array[] = {
 {"fuser",     "FUSER",   pr_fuser,    sr_fuser,   8, USR,    LNX, ET|USER},
 {"gid",       "GID",     pr_egid,     sr_egid,    5,   0,    SUN, ET|RIGHT},
 {"group",     "GROUP",   pr_egroup,   sr_egroup,  8, GRP,    U98, ET|USER},
-{"ignored",   "IGNORED", pr_sigignore,sr_nop,     9,   0,    BSD, TO|SIGNAL}, /*sigignore*/
+{"hugetlb",   "HUGETLB", pr_hugetlb,  sr_hugetlb, 7, SMA,    LNX, PO|RIGHT},
+{"ignored",   "IGNORED", pr_sigignore,sr_nop,     9, SIG,    BSD, TO|SIGNAL}, /*sigignore*/
 {"inblk",     "INBLK",   pr_nop,      sr_nop,     5,   0,    BSD, AN|RIGHT}, /*inblock*/
 {"inblock",   "INBLK",   pr_nop,      sr_nop,     5,   0,    DEC, AN|RIGHT}, /*inblk*/
-{"intpri",    "PRI",     pr_opri,     sr_priority, 3,  0,    HPU, TO|RIGHT},
+{"intpri",    "PRI",     pr_opri,     sr_priority, 3, TIM,    HPU, TO|RIGHT},
+{"iodelay",   "IODELAY", pr_iodelay,  sr_blkio_delay, 7, DLY,  LNX, AN|RIGHT},
 {"jid",       "JID",     pr_nop,      sr_nop,     1,   0,    SGI, PO|RIGHT},
 {"jobc",      "JOBC",    pr_nop,      sr_nop,     4,   0,    XXX, AN|RIGHT},
+{"kB_rd/s",   "KB_RD/S", pr_rbytes_rate, sr_rbytes_rate, 8, IO|TIM, LNX, AN|RIGHT}, /* pidstat */
+{"kB_wr/s",   "KB_WR/S", pr_wbytes_rate, sr_wbytes_rate, 8, IO|TIM, LNX, AN|RIGHT}, /* pidstat */
 {"ktrace",    "KTRACE",  pr_nop,      sr_nop,     8,   0,    BSD, AN|RIGHT},
 {"ktracep",   "KTRACEP", pr_nop,      sr_nop,     8,   0,    BSD, AN|RIGHT},
 {"label",     "LABEL",   pr_context,  sr_nop,    31,  0,     SGI, ET|LEFT},
-{"lastcpu",   "C",       pr_psr,      sr_nop,     3,   0,    BSD, TO|RIGHT}, // DragonFly
-{"lim",       "LIM",     pr_lim,      sr_rss_rlim, 5,  0,    BSD, AN|RIGHT},
+{"lastcpu",   "C",       pr_psr,      sr_nop,     3, SCH,    BSD, TO|RIGHT}, // DragonFly
+{"lim",       "LIM",     pr_lim,      sr_rss_rlim, 5, VM,    BSD, AN|RIGHT},
 {"login",     "LOGNAME", pr_nop,      sr_nop,     8,   0,    BSD, AN|LEFT}, /*logname*/   /* double check */
 {"logname",   "LOGNAME", pr_nop,      sr_nop,     8,   0,    XXX, AN|LEFT}, /*login*/
 {"longtname", "TTY",     pr_tty8,     sr_tty,     8,   0,    DEC, PO|LEFT},
-{"lstart",    "STARTED", pr_lstart,   sr_nop,    24,   0,    XXX, ET|RIGHT},
+{"lstart",    "STARTED", pr_lstart,   sr_nop,    24, TIM,    XXX, ET|RIGHT},
 {"luid",      "LUID",    pr_nop,      sr_nop,     5,   0,    LNX, ET|RIGHT}, /* login ID */
 {"luser",     "LUSER",   pr_nop,      sr_nop,     8, USR,    LNX, ET|USER}, /* login USER */
 {"lwp",       "LWP",     pr_thread,   sr_tid,     5,   0,    SUN, TO|PIDMAX|RIGHT},
-{"m_drs",     "DRS",     pr_drs,      sr_drs,     5, MEM,    LNx, PO|RIGHT},
+{"m_drs",     "DRS",     pr_drs,      sr_drs,     5, MEM|VM, LNx, PO|RIGHT},
 {"m_dt",      "DT",      pr_nop,      sr_dt,      4, MEM,    LNx, PO|RIGHT},
 {"m_lrs",     "LRS",     pr_nop,      sr_lrs,     5, MEM,    LNx, PO|RIGHT},
 {"m_resident", "RES",    pr_nop,      sr_resident, 5,MEM,    LNx, PO|RIGHT},
 {"m_share",   "SHRD",    pr_nop,      sr_share,   5, MEM,    LNx, PO|RIGHT},
 {"m_size",    "SIZE",    pr_size,     sr_size,    5, MEM,    LNX, PO|RIGHT},
 {"m_swap",    "SWAP",    pr_nop,      sr_nop,     5,   0,    LNx, PO|RIGHT},
-{"m_trs",     "TRS",     pr_trs,      sr_trs,     5, MEM,    LNx, PO|RIGHT},
-{"maj_flt",   "MAJFL",   pr_majflt,   sr_maj_flt, 6,   0,    LNX, AN|RIGHT},
-{"majflt",    "MAJFLT",  pr_majflt,   sr_maj_flt, 6,   0,    XXX, AN|RIGHT},
-{"min_flt",   "MINFL",   pr_minflt,   sr_min_flt, 6,   0,    LNX, AN|RIGHT},
-{"minflt",    "MINFLT",  pr_minflt,   sr_min_flt, 6,   0,    XXX, AN|RIGHT},
+{"m_trs",     "TRS",     pr_trs,      sr_trs,     5, MEM|VM, LNx, PO|RIGHT},
+{"maj_flt",   "MAJFL",   pr_majflt,   sr_maj_flt, 6, TIM,    LNX, AN|RIGHT},
+{"majflt",    "MAJFLT",  pr_majflt,   sr_maj_flt, 6, TIM,    XXX, AN|RIGHT},
+{"majflt/s",  "MAJFLT/S", pr_majflt_rate, sr_majflt_rate, 8, TIM, LNX, AN|RIGHT}, /* pidstat */
+{"min_flt",   "MINFL",   pr_minflt,   sr_min_flt, 6, TIM,    LNX, AN|RIGHT},
+{"minflt",    "MINFLT",  pr_minflt,   sr_min_flt, 6, TIM,    XXX, AN|RIGHT},
+{"minflt/s",  "MINFLT/S", pr_minflt_rate, sr_minflt_rate, 8, TIM, LNX, AN|RIGHT}, /* pidstat */
 {"msgrcv",    "MSGRCV",  pr_nop,      sr_nop,     6,   0,    XXX, AN|RIGHT},
 {"msgsnd",    "MSGSND",  pr_nop,      sr_nop,     6,   0,    XXX, AN|RIGHT},
 {"mwchan",    "MWCHAN",  pr_nop,      sr_nop,     6, WCH,    BSD, TO|WCHAN}, /* mutex (FreeBSD) */
-{"ni",        "NI",      pr_nice,     sr_nice,    3,   0,    BSD, TO|RIGHT}, /*nice*/
-{"nice",      "NI",      pr_nice,     sr_nice,    3,   0,    U98, TO|RIGHT}, /*ni*/
-{"nivcsw",    "IVCSW",   pr_nop,      sr_nop,     5,   0,    XXX, AN|RIGHT},
-{"nlwp",      "NLWP",    pr_nlwp,     sr_nlwp,    4,   0,    SUN, PO|RIGHT},
+{"ni",        "NI",      pr_nice,     sr_nice,    3, TIM|SCH, BSD, TO|RIGHT}, /*nice*/
+{"nice",      "NI",      pr_nice,     sr_nice,    3, TIM|SCH, U98, TO|RIGHT}, /*ni*/
+{"nivcsw",    "IVCSW",   pr_nivcsw,   sr_nivcsw,  5, CSW,    XXX, AN|RIGHT},
+{"nlwp",      "NLWP",    pr_nlwp,     sr_nlwp,    4, TIM,    SUN, PO|RIGHT},
+{"nlwpr",     "RLWP",    pr_nlwp_run, sr_nlwp_run, 4, TIM|TSU, LNX, PO|RIGHT},
+{"node",      "NODE",    pr_numa_node, sr_numa_node, 4, NUM,  LNX, PO|RIGHT},
 {"nsignals",  "NSIGS",   pr_nop,      sr_nop,     5,   0,    DEC, AN|RIGHT}, /*nsigs*/
 {"nsigs",     "NSIGS",   pr_nop,      sr_nop,     5,   0,    BSD, AN|RIGHT}, /*nsignals*/
 {"nswap",     "NSWAP",   pr_nop,      sr_nop,     5,   0,    XXX, AN|RIGHT},
-{"nvcsw",     "VCSW",    pr_nop,      sr_nop,     5,   0,    XXX, AN|RIGHT},
-{"nwchan",    "WCHAN",   pr_nwchan,   sr_nop,     6,   0,    XXX, TO|RIGHT},
-{"opri",      "PRI",     pr_opri,     sr_priority, 3,  0,    SUN, TO|RIGHT},
+{"numa",      "NUMA",    pr_numa,     sr_nop,    12, NUM,    LNX, PO|RIGHT},
+{"nvcsw",     "VCSW",    pr_nvcsw,    sr_nvcsw,   5, CSW,    XXX, AN|RIGHT},
+{"nvcswch/s", "NVCSWCH/S", pr_nivcsw_rate, sr_nivcsw_rate, 9, CSW|TIM, LNX, AN|RIGHT}, /* pidstat */
+{"nwchan",    "WCHAN",   pr_nwchan,   sr_nop,     6, SCH,    XXX, TO|RIGHT},
+{"opri",      "PRI",     pr_opri,     sr_priority, 3, TIM,    SUN, TO|RIGHT},
 {"osz",       "SZ",      pr_nop,      sr_nop,     2,   0,    SUN, PO|RIGHT},
 {"oublk",     "OUBLK",   pr_nop,      sr_nop,     5,   0,    BSD, AN|RIGHT}, /*oublock*/
 {"oublock",   "OUBLK",   pr_nop,      sr_nop,     5,   0,    DEC, AN|RIGHT}, /*oublk*/
 {"p_ru",      "P_RU",    pr_nop,      sr_nop,     6,   0,    BSD, AN|RIGHT},
 {"paddr",     "PADDR",   pr_nop,      sr_nop,     6,   0,    BSD, AN|RIGHT},
-{"pagein",    "PAGEIN",  pr_majflt,   sr_maj_flt, 6,   0,    XXX, AN|RIGHT},
-{"pcpu",      "%CPU",    pr_pcpu,     sr_pcpu,    4,   0,    U98, ET|RIGHT}, /*%cpu*/
-{"pending",   "PENDING", pr_sig,      sr_nop,     9,   0,    BSD, ET|SIGNAL}, /*sig*/
+{"pagein",    "PAGEIN",  pr_majflt,   sr_maj_flt, 6, TIM,    XXX, AN|RIGHT},
+{"pcpu",      "%CPU",    pr_pcpu,     sr_pcpu,    4, TIM,    U98, ET|RIGHT}, /*%cpu*/
+{"pending",   "PENDING", pr_sig,      sr_nop,     9, SIG,    BSD, ET|SIGNAL}, /*sig*/
 {"pgid",      "PGID",    pr_pgid,     sr_pgrp,    5,   0,    U98, PO|PIDMAX|RIGHT},
 {"pgrp",      "PGRP",    pr_pgid,     sr_pgrp,    5,   0,    LNX, PO|PIDMAX|RIGHT},
 {"pid",       "PID",     pr_pid,      sr_tgid,    5,   0,    U98, PO|PIDMAX|RIGHT},
-{"pmem",      "%MEM",    pr_pmem,     sr_nop,     4,   0,    XXX, PO|RIGHT}, /*%mem*/
+{"pmem",      "%MEM",    pr_pmem,     sr_nop,     4,  VM,    XXX, PO|RIGHT}, /*%mem*/
 {"poip",      "-",       pr_nop,      sr_nop,     1,   0,    BSD, AN|RIGHT},
-{"policy",    "POL",     pr_class,    sr_sched,   3,   0,    DEC, TO|LEFT},
+{"policy",    "POL",     pr_class,    sr_sched,   3, SCH,    DEC, TO|LEFT},
 {"ppid",      "PPID",    pr_ppid,     sr_ppid,    5,   0,    U98, PO|PIDMAX|RIGHT},
-{"pri",       "PRI",     pr_pri,      sr_nop,     3,   0,    XXX, TO|RIGHT},
-{"pri_api",   "API",     pr_pri_api,  sr_nop,     3,   0,    LNX, TO|RIGHT},
-{"pri_bar",   "BAR",     pr_pri_bar,  sr_nop,     3,   0,    LNX, TO|RIGHT},
-{"pri_baz",   "BAZ",     pr_pri_baz,  sr_nop,     3,   0,    LNX, TO|RIGHT},
-{"pri_foo",   "FOO",     pr_pri_foo,  sr_nop,     3,   0,    LNX, TO|RIGHT},
-{"priority",  "PRI",     pr_priority, sr_priority, 3,  0,    LNX, TO|RIGHT},
+{"pri",       "PRI",     pr_pri,      sr_nop,     3, TIM,    XXX, TO|RIGHT},
+{"pri_api",   "API",     pr_pri_api,  sr_nop,     3, TIM,    LNX, TO|RIGHT},
+{"pri_bar",   "BAR",     pr_pri_bar,  sr_nop,     3, TIM,    LNX, TO|RIGHT},
+{"pri_baz",   "BAZ",     pr_pri_baz,  sr_nop,     3, TIM,    LNX, TO|RIGHT},
+{"pri_foo",   "FOO",     pr_pri_foo,  sr_nop,     3, TIM,    LNX, TO|RIGHT},
+{"priority",  "PRI",     pr_priority, sr_priority, 3, TIM,    LNX, TO|RIGHT},
 {"prmgrp",    "PRMGRP",  pr_nop,      sr_nop,    12,   0,    HPU, PO|RIGHT},
 {"prmid",     "PRMID",   pr_nop,      sr_nop,    12,   0,    HPU, PO|RIGHT},
 {"project",   "PROJECT", pr_nop,      sr_nop,    12,   0,    SUN, PO|LEFT}, // see prm* andctid
 {"projid",    "PROJID",  pr_nop,      sr_nop,     5,   0,    SUN, PO|RIGHT},
 {"pset",      "PSET",    pr_nop,      sr_nop,     4,   0,    DEC, TO|RIGHT},
-{"psr",       "PSR",     pr_psr,      sr_nop,     3,   0,    DEC, TO|RIGHT},
+{"psr",       "PSR",     pr_psr,      sr_nop,     3, SCH,    DEC, TO|RIGHT},
+{"pss",       "PSS",     pr_pss,      sr_pss,     5, SMA,    LNX, PO|RIGHT},
 {"psxpri",    "PPR",     pr_nop,      sr_nop,     3,   0,    DEC, TO|RIGHT},
+{"rbytes",    "RBYTES",  pr_rbytes,   sr_read_bytes, 7, IO,   LNX, AN|RIGHT},
+{"rchars",    "RCHARS",  pr_rchar,    sr_rchar,   7,  IO,    LNX, AN|RIGHT},
 {"re",        "RE",      pr_nop,      sr_nop,     3,   0,    BSD, AN|RIGHT},
+{"remote",    "REMOTE",  pr_numa_remote, sr_numa_remote, 6, NUM|SCH, LNX, PO|RIGHT},
 {"resident",  "RES",     pr_nop,      sr_resident, 5,MEM,    LNX, PO|RIGHT},
 {"rgid",      "RGID",    pr_rgid,     sr_rgid,    5,   0,    XXX, ET|RIGHT},
 {"rgroup",    "RGROUP",  pr_rgroup,   sr_rgroup,  8, GRP,    U98, ET|USER}, /* was 8 wide */
 {"rlink",     "RLINK",   pr_nop,      sr_nop,     8,   0,    BSD, AN|RIGHT},
-{"rss",       "RSS",     pr_rss,      sr_rss,     5,   0,    XXX, PO|RIGHT}, /* was 5 wide */
-{"rssize",    "RSS",     pr_rss,      sr_vm_rss,  5,   0,    DEC, PO|RIGHT}, /*rsz*/
-{"rsz",       "RSZ",     pr_rss,      sr_vm_rss,  5,   0,    BSD, PO|RIGHT}, /*rssize*/
-{"rtprio",    "RTPRIO",  pr_rtprio,   sr_rtprio,  6,   0,    BSD, TO|RIGHT},
+{"rss",       "RSS",     pr_rss,      sr_rss,     5,  VM,    XXX, PO|RIGHT}, /* was 5 wide */
+{"rssize",    "RSS",     pr_rss,      sr_vm_rss,  5,  VM,    DEC, PO|RIGHT}, /*rsz*/
+{"rsz",       "RSZ",     pr_rss,      sr_vm_rss,  5,  VM,    BSD, PO|RIGHT}, /*rssize*/
+{"rtprio",    "RTPRIO",  pr_rtprio,   sr_rtprio,  6, SCH,    BSD, TO|RIGHT},
 {"ruid",      "RUID",    pr_ruid,     sr_ruid,    5,   0,    XXX, ET|RIGHT},
 {"ruser",     "RUSER",   pr_ruser,    sr_ruser,   8, USR,    U98, ET|USER},
 {"s",         "S",       pr_s,        sr_state,   1,   0,    SUN, TO|LEFT}, /*stat,state*/
-{"sched",     "SCH",     pr_sched,    sr_sched,   3,   0,    AIX, TO|RIGHT},
+{"sched",     "SCH",     pr_sched,    sr_sched,   3, SCH,    AIX, TO|RIGHT},
 {"scnt",      "SCNT",    pr_nop,      sr_nop,     4,   0,    DEC, AN|RIGHT},  /* man page misspelling of scount? */
 {"scount",    "SC",      pr_nop,      sr_nop,     4,   0,    AIX, AN|RIGHT},  /* scnt==scount, DEC claims both */
 {"sess",      "SESS",    pr_sess,     sr_session, 5,   0,    XXX, PO|PIDMAX|RIGHT},
 {"session",   "SESS",    pr_sess,     sr_session, 5,   0,    LNX, PO|PIDMAX|RIGHT},
-{"sgi_p",     "P",       pr_sgi_p,    sr_nop,     1,   0,    LNX, TO|RIGHT}, /* "cpu" number */
-{"sgi_rss",   "RSS",     pr_rss,      sr_nop,     4,   0,    LNX, PO|LEFT}, /* SZ:RSS */
+{"sgi_p",     "P",       pr_sgi_p,    sr_nop,     1, SCH,    LNX, TO|RIGHT}, /* "cpu" number */
+{"sgi_rss",   "RSS",     pr_rss,      sr_nop,     4,  VM,    LNX, PO|LEFT}, /* SZ:RSS */
 {"sgid",      "SGID",    pr_sgid,     sr_sgid,    5,   0,    LNX, ET|RIGHT},
 {"sgroup",    "SGROUP",  pr_sgroup,   sr_sgroup,  8, GRP,    LNX, ET|USER},
 {"share",     "-",       pr_nop,      sr_share,   1, MEM,    LNX, PO|RIGHT},
 {"sid",       "SID",     pr_sess,     sr_session, 5,   0,    XXX, PO|PIDMAX|RIGHT}, /* Sun & HP */
-{"sig",       "PENDING", pr_sig,      sr_nop,     9,   0,    XXX, ET|SIGNAL}, /*pending -- Dragonfly uses this for whole-proc and "tsig" for thread */
-{"sig_block", "BLOCKED",  pr_sigmask, sr_nop,     9,   0,    LNX, TO|SIGNAL},
-{"sig_catch", "CATCHED", pr_sigcatch, sr_nop,     9,   0,    LNX, TO|SIGNAL},
-{"sig_ignore", "IGNORED",pr_sigignore, sr_nop,    9,   0,    LNX, TO|SIGNAL},
-{"sig_pend",  "SIGNAL",   pr_sig,     sr_nop,     9,   0,    LNX, ET|SIGNAL},
-{"sigcatch",  "CAUGHT",  pr_sigcatch, sr_nop,     9,   0,    XXX, TO|SIGNAL}, /*caught*/
-{"sigignore", "IGNORED", pr_sigignore,sr_nop,     9,   0,    XXX, TO|SIGNAL}, /*ignored*/
-{"sigmask",   "BLOCKED", pr_sigmask,  sr_nop,     9,   0,    XXX, TO|SIGNAL}, /*blocked*/
-{"size",      "SZ",      pr_swapable, sr_swapable, 5,  0,    SCO, PO|RIGHT},
+{"sig",       "PENDING", pr_sig,      sr_nop,     9, SIG,    XXX, ET|SIGNAL}, /*pending -- Dragonfly uses this for whole-proc and "tsig" for thread */
+{"sig_block", "BLOCKED",  pr_sigmask, sr_nop,     9, SIG,    LNX, TO|SIGNAL},
+{"sig_catch", "CATCHED", pr_sigcatch, sr_nop,     9, SIG,    LNX, TO|SIGNAL},
+{"sig_ignore", "IGNORED",pr_sigignore, sr_nop,    9, SIG,    LNX, TO|SIGNAL},
+{"sig_pend",  "SIGNAL",   pr_sig,     sr_nop,     9, SIG,    LNX, ET|SIGNAL},
+{"sigcatch",  "CAUGHT",  pr_sigcatch, sr_nop,     9, SIG,    XXX, TO|SIGNAL}, /*caught*/
+{"sigignore", "IGNORED", pr_sigignore,sr_nop,     9, SIG,    XXX, TO|SIGNAL}, /*ignored*/
+{"sigmask",   "BLOCKED", pr_sigmask,  sr_nop,     9, SIG,    XXX, TO|SIGNAL}, /*blocked*/
+{"size",      "SZ",      pr_swapable, sr_swapable, 5, VM,    SCO, PO|RIGHT},
 {"sl",        "SL",      pr_nop,      sr_nop,     3,   0,    XXX, AN|RIGHT},
 {"spid",      "SPID",    pr_thread,   sr_tid,     5,   0,    SGI, TO|PIDMAX|RIGHT},
-{"stackp",    "STACKP",  pr_stackp,   sr_start_stack, 8, 0,  LNX, PO|RIGHT}, /*start_stack*/
-{"start",     "STARTED", pr_start,    sr_nop,     8,   0,    XXX, ET|RIGHT},
-{"start_code", "S_CODE",  pr_nop,     sr_start_code, 8, 0,   LNx, PO|RIGHT},
-{"start_stack", "STACKP", pr_stackp,  sr_start_stack, 8, 0,  LNX, PO|RIGHT}, /*stackp*/
-{"start_time", "START",  pr_stime,    sr_start_time, 5, 0,   LNx, ET|RIGHT},
-{"stat",      "STAT",    pr_stat,     sr_state,   4,   0,    BSD, TO|LEFT}, /*state,s*/
+{"stackp",    "STACKP",  pr_stackp,   sr_start_stack, 8, VM,  LNX, PO|RIGHT}, /*start_stack*/
+{"start",     "STARTED", pr_start,    sr_nop,     8, TIM,    XXX, ET|RIGHT},
+{"start_code", "S_CODE",  pr_nop,     sr_start_code, 8, VM,   LNx, PO|RIGHT},
+{"start_stack", "STACKP", pr_stackp,  sr_start_stack, 8, VM,  LNX, PO|RIGHT}, /*stackp*/
+{"start_time", "START",  pr_stime,    sr_start_time, 5, TIM,   LNx, ET|RIGHT},
+{"stat",      "STAT",    pr_stat,     sr_state,   4, TIM|VM, BSD, TO|LEFT}, /*state,s*/
 {"state",     "S",       pr_s,        sr_state,   1,   0,    XXX, TO|LEFT}, /*stat,s*/ /* was STAT */
 {"status",    "STATUS",  pr_nop,      sr_nop,     6,   0,    DEC, AN|RIGHT},
-{"stime",     "STIME",   pr_stime,    sr_stime,   5,   0,    XXX, ET|RIGHT}, /* was 6 wide */
+{"stime",     "STIME",   pr_stime,    sr_stime,   5, TIM,    XXX, ET|RIGHT}, /* was 6 wide */
 {"suid",      "SUID",    pr_suid,     sr_suid,    5,   0,    LNx, ET|RIGHT},
 {"suser",     "SUSER",   pr_suser,    sr_suser,   8, USR,    LNx, ET|USER},
 {"svgid",     "SVGID",   pr_sgid,     sr_sgid,    5,   0,    XXX, ET|RIGHT},
 {"svgroup",   "SVGROUP", pr_sgroup,   sr_sgroup,  8, GRP,    LNX, ET|USER},
 {"svuid",     "SVUID",   pr_suid,     sr_suid,    5,   0,    XXX, ET|RIGHT},
 {"svuser",    "SVUSER",  pr_suser,    sr_suser,   8, USR,    LNX, ET|USER},
+{"swapdelay", "SWAPDELAY", pr_swapdelay, sr_swapin_delay, 9, DLY, LNX, AN|RIGHT},
+{"swappss",   "SWPSS",   pr_swappss,  sr_swap_pss, 5, SMA,   LNX, PO|RIGHT},
+{"syscr",     "SYSCR",   pr_syscr,    sr_syscr,   7,  IO,    LNX, AN|RIGHT},
+{"syscw",     "SYSCW",   pr_syscw,    sr_syscw,   7,  IO,    LNX, AN|RIGHT},
 {"systime",   "SYSTEM",  pr_nop,      sr_nop,     6,   0,    DEC, ET|RIGHT},
-{"sz",        "SZ",      pr_sz,       sr_nop,     5,   0,    HPU, PO|RIGHT},
+{"sz",        "SZ",      pr_sz,       sr_nop,     5,  VM,    HPU, PO|RIGHT},
 {"taskid",    "TASKID",  pr_nop,      sr_nop,     5,   0,    SUN, TO|PIDMAX|RIGHT}, // is this a thread ID?
 {"tdev",      "TDEV",    pr_nop,      sr_nop,     4,   0,    XXX, AN|RIGHT},
-{"thcount",   "THCNT",   pr_nlwp,     sr_nlwp,    5,   0,    AIX, PO|RIGHT},
+{"thcount",   "THCNT",   pr_nlwp,     sr_nlwp,    5, TIM,    AIX, PO|RIGHT},
+{"thcpu",     "%THCPU",  pr_thcpu,    sr_thcpu,   6, TIM|TSU, LNX, PO|RIGHT},
+{"thp",       "THP",     pr_thp,      sr_anon_huge, 5, SMA,   LNX, PO|RIGHT},
 {"tid",       "TID",     pr_thread,   sr_tid,     5,   0,    AIX, TO|PIDMAX|RIGHT},
-{"time",      "TIME",    pr_time,     sr_nop,     8,   0,    U98, ET|RIGHT}, /*cputime*/ /* was 6 wide */
+{"time",      "TIME",    pr_time,     sr_nop,     8, TIM,    U98, ET|RIGHT}, /*cputime*/ /* was 6 wide */
 {"timeout",   "TMOUT",   pr_nop,      sr_nop,     5,   0,    LNX, AN|RIGHT}, // 2.0.xx era
 {"tmout",     "TMOUT",   pr_nop,      sr_nop,     5,   0,    LNX, AN|RIGHT}, // 2.0.xx era
 {"tname",     "TTY",     pr_tty8,     sr_tty,     8,   0,    DEC, PO|LEFT},
 {"tpgid",     "TPGID",   pr_tpgid,    sr_tpgid,   5,   0,    XXX, PO|PIDMAX|RIGHT},
-{"trs",       "TRS",     pr_trs,      sr_trs,     4, MEM,    AIX, PO|RIGHT},
-{"trss",      "TRSS",    pr_trs,      sr_trs,     4, MEM,    BSD, PO|RIGHT}, /* 4.3BSD NET/2 */
+{"trs",       "TRS",     pr_trs,      sr_trs,     4, MEM|VM, AIX, PO|RIGHT},
+{"trss",      "TRSS",    pr_trs,      sr_trs,     4, MEM|VM, BSD, PO|RIGHT}, /* 4.3BSD NET/2 */
 {"tsess",     "TSESS",   pr_nop,      sr_nop,     5,   0,    BSD, PO|PIDMAX|RIGHT},
 {"tsession",  "TSESS",   pr_nop,      sr_nop,     5,   0,    DEC, PO|PIDMAX|RIGHT},
 {"tsid",      "TSID",    pr_nop,      sr_nop,     5,   0,    BSD, PO|PIDMAX|RIGHT},
-{"tsig",      "PENDING", pr_tsig,     sr_nop,     9,   0,    BSD, ET|SIGNAL}, /* Dragonfly used this for thread-specific, and "sig" for whole-proc */
-{"tsiz",      "TSIZ",    pr_tsiz,     sr_nop,     4,   0,    BSD, PO|RIGHT},
+{"tsig",      "PENDING", pr_tsig,     sr_nop,     9, SIG,    BSD, ET|SIGNAL}, /* Dragonfly used this for thread-specific, and "sig" for whole-proc */
+{"tsiz",      "TSIZ",    pr_tsiz,     sr_nop,     4,  VM,    BSD, PO|RIGHT},
 {"tt",        "TT",      pr_tty8,     sr_tty,     8,   0,    BSD, PO|LEFT},
 {"tty",       "TT",      pr_tty8,     sr_tty,     8,   0,    U98, PO|LEFT}, /* Unix98 requires "TT" but has "TTY" too. :-( */  /* was 3 wide */
 {"tty4",      "TTY",     pr_tty4,     sr_tty,     4,   0,    LNX, PO|LEFT},
@@ -1506,17 +1811,20 @@ static const format_struct format_array[] = {
 {"user",      "USER",    pr_euser,    sr_euser,   8, USR,    U98, ET|USER}, /* BSD n forces this to UID */
 {"usertime",  "USER",    pr_nop,      sr_nop,     4,   0,    DEC, ET|RIGHT},
 {"usrpri",    "UPR",     pr_nop,      sr_nop,     3,   0,    DEC, TO|RIGHT}, /*upr*/
-{"util",      "C",       pr_c,        sr_pcpu,    2,   0,    SGI, ET|RIGHT}, // not sure about "C"
-{"utime",     "UTIME",   pr_nop,      sr_utime,   6,   0,    LNx, ET|RIGHT},
-{"vm_data",   "DATA",    pr_nop,      sr_vm_data, 5,   0,    LNx, PO|RIGHT},
-{"vm_exe",    "EXE",     pr_nop,      sr_vm_exe,  5,   0,    LNx, PO|RIGHT},
-{"vm_lib",    "LIB",     pr_nop,      sr_vm_lib,  5,   0,    LNx, PO|RIGHT},
-{"vm_lock",   "LCK",     pr_nop,      sr_vm_lock, 3,   0,    LNx, PO|RIGHT},
-{"vm_stack",  "STACK",   pr_nop,      sr_vm_stack, 5,  0,    LNx, PO|RIGHT},
-{"vsize",     "VSZ",     pr_vsz,      sr_vsize,   6,   0,    DEC, PO|RIGHT}, /*vsz*/
-{"vsz",       "VSZ",     pr_vsz,      sr_vm_size, 6,   0,    U98, PO|RIGHT}, /*vsize*/
-{"wchan",     "WCHAN",   pr_wchan,    sr_wchan,   6, WCH,    XXX, TO|WCHAN}, /* BSD n forces this to nwchan */ /* was 10 wide */
-{"wname",     "WCHAN",   pr_wname,    sr_nop,     6, WCH,    SGI, TO|WCHAN}, /* opposite of nwchan */
+{"uss",       "USS",     pr_uss,      sr_uss,     5, SMA,    LNX, PO|RIGHT},
+{"util",      "C",       pr_c,        sr_pcpu,    2, TIM,    SGI, ET|RIGHT}, // not sure about "C"
+{"utime",     "UTIME",   pr_nop,      sr_utime,   6, TIM,    LNx, ET|RIGHT},
+{"vm_data",   "DATA",    pr_nop,      sr_vm_data, 5,  VM,    LNx, PO|RIGHT},
+{"vm_exe",    "EXE",     pr_nop,      sr_vm_exe,  5,  VM,    LNx, PO|RIGHT},
+{"vm_lib",    "LIB",     pr_nop,      sr_vm_lib,  5,  VM,    LNx, PO|RIGHT},
+{"vm_lock",   "LCK",     pr_nop,      sr_vm_lock, 3,  VM,    LNx, PO|RIGHT},
+{"vm_stack",  "STACK",   pr_nop,      sr_vm_stack, 5, VM,    LNx, PO|RIGHT},
+{"vsize",     "VSZ",     pr_vsz,      sr_vsize,   6,  VM,    DEC, PO|RIGHT}, /*vsz*/
+{"vsz",       "VSZ",     pr_vsz,      sr_vm_size, 6,  VM,    U98, PO|RIGHT}, /*vsize*/
+{"wbytes",    "WBYTES",  pr_wbytes,   sr_write_bytes, 7, IO,  LNX, AN|RIGHT},
+{"wchan",     "WCHAN",   pr_wchan,    sr_wchan,   6, WCH|SCH, XXX, TO|WCHAN}, /* BSD n forces this to nwchan */ /* was 10 wide */
+{"wchars",    "WCHARS",  pr_wchar,    sr_wchar,   7,  IO,    LNX, AN|RIGHT},
+{"wname",     "WCHAN",   pr_wname,    sr_nop,     6, WCH|SCH, SGI, TO|WCHAN}, /* opposite of nwchan */
 {"xstat",     "XSTAT",   pr_nop,      sr_nop,     5,   0,    BSD, AN|RIGHT},
 {"zone",      "ZONE",    pr_context,  sr_nop,    31,   0,    SUN, ET|LEFT}, // Solaris zone == Linux context?
 {"zoneid",    "ZONEID",  pr_nop,      sr_nop,    31,   0,    SUN, ET|RIGHT},// Linux only offers context names
@@ -1774,7 +2082,147 @@ static void check_header_width(void){
 
 static char *saved_outbuf;
 
+/* Rows are built up here and go out with one write() when it fills,
+ * rather than one stdio call per column. */
+#define ROWBUF_SIZE (2 * OUTBUF_SIZE + 2 * SPACE_AMOUNT)
+static char *rowbuf;
+static unsigned rowlen;
+
+static void flush_rows(void){
+  const char *p = rowbuf;
+  fflush(stdout);  /* in case anything went through stdio */
+  while(rowlen){
+    ssize_t w = write(STDOUT_FILENO, p, rowlen);
+    if(w < 0){
+      if(errno == EINTR) continue;
+      break;  /* nothing to do about it, same as with stdio */
+    }
+    p += w;
+    rowlen -= w;
+  }
+  rowlen = 0;
+}
+
+/* padding and then data; never more than a column's worth */
+static void put_column(int space, const char *restrict data, int sz){
+  if(unlikely(rowlen + space + sz > ROWBUF_SIZE)) flush_rows();
+  memset(rowbuf + rowlen, ' ', space);
+  memcpy(rowbuf + rowlen + space, data, sz);
+  rowlen += space + sz;
+}
+
+static void show_row(const proc_t *restrict const p, const format_node *restrict fmt);
+
+/* a JSON string body, with room checked as we go: escapes can be 6 bytes */
+static void put_json_chars(const char *restrict s, int sz){
+  static const char hexdigits[] = "0123456789abcdef";
+  while(sz--){
+    unsigned c = (unsigned char)*s++;
+    char *restrict q;
+    if(unlikely(rowlen + 6 > ROWBUF_SIZE)) flush_rows();
+    q = rowbuf + rowlen;
+    if(c == '"' || c == '\\'){
+      q[0] = '\\';
+      q[1] = c;
+      rowlen += 2;
+    }else if(c < 0x20){
+      memcpy(q, "\\u00", 4);
+      q[4] = hexdigits[c >> 4];
+      q[5] = hexdigits[c & 0xf];
+      rowlen += 6;
+    }else{
+      q[0] = c;
+      rowlen++;
+    }
+  }
+}
+
+/* is it exactly what JSON allows for a number? ("007" and "1." aren't) */
+static int json_number(const char *restrict s, int sz){
+  const char *restrict const end = s + sz;
+  if(s < end && *s == '-') s++;
+  if(s >= end || (unsigned)(*s - '0') > 9u) return 0;
+  if(*s == '0') s++;
+  else while(s < end && (unsigned)(*s - '0') <= 9u) s++;
+  if(s < end && *s == '.'){
+    s++;
+    if(s >= end || (unsigned)(*s - '0') > 9u) return 0;
+    while(s < end && (unsigned)(*s - '0') <= 9u) s++;
+  }
+  return s == end;
+}
+
+/* --jsonl: {"spec":value,...} per row, straight from the pr_* functions.
+ * There's nothing to line up, so none of the column arithmetic below. */
+static void show_jsonl(const proc_t *restrict const p, const format_node *restrict fmt){
+  char *restrict const outbuf = saved_outbuf;
+  char sep = '{';
+
+  max_rightward = OUTBUF_SIZE;
+  max_leftward  = OUTBUF_SIZE;
+  for(; fmt; fmt = fmt->next){
+    const char *restrict val = outbuf;
+    int sz;
+    if(!fmt->pr || !fmt->spec) continue;  /* AIX filler text */
+    (*fmt->pr)(outbuf,p);
+    sz = strlen(outbuf);
+    while(sz && *val == ' ') val++, sz--;
+    while(sz && val[sz-1] == ' ') sz--;
+    put_column(0, &sep, 1);
+    put_column(0, "\"", 1);
+    put_json_chars(fmt->spec, strlen(fmt->spec));
+    if(json_number(val, sz)){
+      put_column(0, "\":", 2);
+      put_column(0, val, sz);
+    }else{
+      put_column(0, "\":\"", 3);
+      put_json_chars(val, sz);
+      put_column(0, "\"", 1);
+    }
+    sep = ',';
+  }
+  if(sep == '{') put_column(0, "{", 1);
+  put_column(0, "}\n", 2);
+}
+
 void show_one_proc(const proc_t *restrict const p, const format_node *restrict fmt){
+  static int did_stuff = 0;  /* have we ever printed anything? */
+  cost_mark cm;
+
+  if(unlikely(-1==(long)p)){    /* true only once, at the end */
+    if(!did_stuff){
+      /* have _never_ printed anything, but might need a header */
+      if(!jsonl_output && !--lines_to_next_header) show_row(NULL,fmt);
+      flush_rows();
+      /* fprintf(stderr, "No processes available.\n"); */  /* legal? */
+      exit(1);
+    }
+    COST_START(cm);
+    flush_rows();
+    COST_STOP(COST_OUTPUT, cm);
+    return;
+  }
+  COST_START(cm);
+  if(jsonl_output){
+    if(likely(p)){  /* no headers */
+      did_stuff = 1;
+      show_jsonl(p,fmt);
+    }
+    COST_STOP(COST_OUTPUT, cm);
+    return;
+  }
+  if(likely(p)){  /* not header, maybe we should show one first */
+    if(unlikely(!--lines_to_next_header)){
+      lines_to_next_header = header_gap;
+      show_row(NULL,fmt);
+    }
+  }
+  did_stuff = 1;
+  show_row(p,fmt);
+  COST_STOP(COST_OUTPUT, cm);
+}
+
+static void show_row(const proc_t *restrict const p, const format_node *restrict fmt){
   /* unknown: maybe set correct & actual to 1, remove +/- 1 below */
   int correct  = 0;  /* screen position we should be at */
   int actual   = 0;  /* screen position we are at */
@@ -1786,25 +2234,7 @@ void show_one_proc(const proc_t *restrict const p, const format_node *restrict f
   int sz       = 0;  /* real size of data in outbuffer */
   int tmpspace = 0;
   char *restrict const outbuf = saved_outbuf;
-  static int did_stuff = 0;  /* have we ever printed anything? */
 
-  if(unlikely(-1==(long)p)){    /* true only once, at the end */
-    if(did_stuff) return;
-    /* have _never_ printed anything, but might need a header */
-    if(!--lines_to_next_header){
-      lines_to_next_header = header_gap;
-      show_one_proc(NULL,fmt);
-    }
-    /* fprintf(stderr, "No processes available.\n"); */  /* legal? */
-    exit(1);
-  }
-  if(likely(p)){  /* not header, maybe we should call ourselves for it */
-    if(unlikely(!--lines_to_next_header)){
-      lines_to_next_header = header_gap;
-      show_one_proc(NULL,fmt);
-    }
-  }
-  did_stuff = 1;
   if(unlikely(active_cols>(int)OUTBUF_SIZE)) fprintf(stderr,"Fix bigness error.\n");
 
   /* print row start sequence */
@@ -1904,11 +2334,11 @@ void show_one_proc(const proc_t *restrict const p, const format_node *restrict f
     if(unlikely(!fmt->next)){
       /* Last column. Write padding + data + newline all together. */
       outbuf[sz] = '\n';
-      fwrite(outbuf-space, space+sz+1, 1, stdout);
+      put_column(space, outbuf, sz+1);
       break;
     }
     /* Not the last column. Write padding + data together. */
-    fwrite(outbuf-space, space+sz, 1, stdout);
+    put_column(space, outbuf, sz);
     actual  += space+amount;
     correct += fmt->width;
     correct += legit;        /* adjust for SIGNAL expansion */
@@ -1974,6 +2404,7 @@ void init_output(void){
   mprotect(outbuf + page_size*outbuf_pages, page_size, PROT_NONE); // gaurd page
   saved_outbuf = outbuf + SPACE_AMOUNT;
   // available space:  page_size*outbuf_pages-SPACE_AMOUNT
+  rowbuf = xmalloc(ROWBUF_SIZE);
 
   seconds_since_1970 = time(NULL);
   time_of_boot = seconds_since_1970 - seconds_since_boot;
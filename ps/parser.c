@@ -27,6 +27,8 @@
 
 #include "common.h"
 #include "../proc/version.h"
+#include "../proc/costs.h"
+#include "../proc/alloc.h"
 
 #define ARG_GNU  0
 #define ARG_END  1
@@ -204,6 +206,7 @@ static const char *parse_list(const char *arg, const char *(*parse_fn)(char *, s
     walk = sep_loc + 1; /* point to next item, if any */
   }
   free(buf);
+  node->set = NULL;
   node->next = selection_list;
   selection_list = node;
   return NULL;
@@ -776,6 +779,10 @@ static int compare_gnu_table_structs(const void *a, const void *b){
   return strcmp(((const gnu_table_struct*)a)->name,((const gnu_table_struct*)b)->name);
 }
 
+static void report_costs(void){
+  costs_report(stderr, "ps");
+}
+
 /* Option arguments are after ':', after '=', or in argv[n+1] */
 static const char *parse_gnu_option(void){
   const char *arg;
@@ -792,17 +799,22 @@ static const char *parse_gnu_option(void){
   {"columns",       &&case_columns},
   {"context",       &&case_context},
   {"cumulative",    &&case_cumulative},
+  {"debug-stats",   &&case_debug_stats},
   {"deselect",      &&case_deselect},    /* -N */
   {"forest",        &&case_forest},      /* f -H */
   {"format",        &&case_format},
   {"group",         &&case_group},       /* egid */
+  {"group-by",      &&case_group_by},
   {"header",        &&case_header},
   {"headers",       &&case_headers},
   {"heading",       &&case_heading},
   {"headings",      &&case_headings},
   {"help",          &&case_help},
   {"info",          &&case_info},
+  {"interval",      &&case_interval},
+  {"jsonl",         &&case_jsonl},
   {"lines",         &&case_lines},
+  {"max-rows",      &&case_max_rows},
   {"no-header",     &&case_no_header},
   {"no-headers",    &&case_no_headers},
   {"no-heading",    &&case_no_heading},
@@ -920,6 +932,20 @@ static const char *parse_gnu_option(void){
     if(err) return err;
     selection_list->typecode = SEL_EGID;
     return NULL;
+  case_debug_stats:
+    trace("--debug-stats\n");
+    if(s[sl]) return "Option --debug-stats does not take an argument.";
+    costs_enable(1);
+    atexit(report_costs);
+    return NULL;
+  case_group_by:
+    trace("--group-by\n");
+    arg = grab_gnu_arg();
+    if(arg && !strcmp(arg, "cgroup")){
+      group_by_cgroup = 1;
+      return NULL;
+    }
+    return "Only \"cgroup\" may follow --group-by.";
   case_help:
     trace("--help\n");
     exclusive("--help");
@@ -932,6 +958,37 @@ static const char *parse_gnu_option(void){
     self_info();
     exit(0);
     return NULL;
+  case_interval:
+    trace("--interval\n");
+    arg = grab_gnu_arg();
+    if(arg && *arg){
+      long t;
+      char *endptr;
+      t = strtol(arg, &endptr, 0);
+      if(!*endptr && (t>0) && (t<86400)){
+        sample_interval = (int)t;
+        return NULL;
+      }
+    }
+    return "Number of seconds must follow --interval.";
+  case_jsonl:
+    trace("--jsonl\n");
+    if(s[sl]) return "Option --jsonl does not take an argument.";
+    jsonl_output = 1;
+    return NULL;
+  case_max_rows:
+    trace("--max-rows\n");
+    arg = grab_gnu_arg();
+    if(arg && *arg){
+      long t;
+      char *endptr;
+      t = strtol(arg, &endptr, 0);
+      if(!*endptr && (t>0) && (t<2000000000)){
+        max_rows = (int)t;
+        return NULL;
+      }
+    }
+    return "Number of processes must follow --max-rows.";
   case_pid:
     trace("--pid\n");
     arg = grab_gnu_arg();
@@ -1172,6 +1229,66 @@ static const char *thread_option_check(void){
   return NULL;
 }
 
+/*
+ * Hash each long list of numbers, so that want_this_proc() doesn't have to
+ * scan a list of thousands for every process.  Must wait until the lists
+ * have their typecodes, which parse_list() callers set afterwards.
+ */
+#define SET_MIN 8  /* shorter lists are scanned */
+static void compile_selection(void){
+  selection_node *sn;
+  for(sn = selection_list; sn; sn = sn->next){
+    unsigned size = 16;
+    int i;
+    if(sn->n < SET_MIN) continue;
+    switch(sn->typecode){
+    case SEL_RUID: case SEL_EUID: case SEL_SUID: case SEL_FUID:
+    case SEL_RGID: case SEL_EGID: case SEL_SGID: case SEL_FGID:
+    case SEL_PGRP: case SEL_PID:  case SEL_PPID: case SEL_TTY:
+    case SEL_SESS:
+      break;
+    default:  /* command names, and the unimplemented */
+      continue;
+    }
+    while(size < 2u * (unsigned)sn->n) size *= 2;
+    sn->set = xcalloc(NULL, size * sizeof *sn->set);
+    sn->set_mask = size - 1;
+    sn->set_zero = 0;
+    for(i = 0; i < sn->n; i++){
+      unsigned val, h;
+      switch(sn->typecode){
+      case SEL_RUID: case SEL_EUID: case SEL_SUID: case SEL_FUID:
+        val = (unsigned)sn->u[i].uid;
+        break;
+      case SEL_RGID: case SEL_EGID: case SEL_SGID: case SEL_FGID:
+        val = (unsigned)sn->u[i].gid;
+        break;
+      case SEL_PPID:
+        val = (unsigned)sn->u[i].ppid;
+        break;
+      case SEL_TTY:
+        val = (unsigned)sn->u[i].tty;
+        break;
+      default:
+        val = (unsigned)sn->u[i].pid;
+        break;
+      }
+      if(!val){
+        sn->set_zero = 1;
+        continue;
+      }
+      h = (val * 2654435761u) & sn->set_mask;
+      while(sn->set[h] && sn->set[h] != val) h = (h + 1) & sn->set_mask;
+      sn->set[h] = val;
+    }
+  }
+}
+
+static const char *max_rows_check(void){
+  if(max_rows && forest_type) return "The --max-rows option conflicts with forest display.";
+  return NULL;
+}
+
 int arg_parse(int argc, char *argv[]){
   const char *err = NULL;
   const char *err2 = NULL;
@@ -1185,11 +1302,14 @@ int arg_parse(int argc, char *argv[]){
   if(err) goto try_bsd;
   err = thread_option_check();
   if(err) goto try_bsd;
+  err = max_rows_check();
+  if(err) goto try_bsd;
   err = process_sf_options(!not_pure_unix);
   if(err) goto try_bsd;
   err = select_bits_setup();
   if(err) goto try_bsd;
 
+  compile_selection();
   choose_dimensions();
   return 0;
 
@@ -1215,6 +1335,8 @@ try_bsd:
   if(err2) goto total_failure;
   err2 = thread_option_check();
   if(err2) goto total_failure;
+  err2 = max_rows_check();
+  if(err2) goto total_failure;
   err2 = process_sf_options(!not_pure_unix);
   if(err2) goto total_failure;
   err2 = select_bits_setup();
@@ -1237,6 +1359,7 @@ try_bsd:
   // the issues. The same goes for other stuff too, BTW. Please ask.
   // I'm happy to justify various implementation choices.
 
+  compile_selection();
   choose_dimensions();
   return 0;
 
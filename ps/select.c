@@ -16,6 +16,7 @@
 #include "common.h"
 #include "../proc/readproc.h"
 #include "../proc/procps.h"
+#include "../proc/alloc.h"
 
 //#define process_group_leader(p) ((p)->pgid    == (p)->tgid)
 //#define some_other_user(p)      ((p)->euid    != cached_euid)
@@ -66,59 +67,110 @@ const char *select_bits_setup(void){
 }
 
 /***** selected by simple option? */
-static int table_accept(proc_t *buf){
+static int table_accept_as(const proc_t *buf, int our_euid){
   unsigned proc_index;
-  proc_index = (has_our_euid(buf)    <<0)
+  proc_index = (our_euid             <<0)
              | (session_leader(buf)  <<1)
              | (without_a_tty(buf)   <<2)
              | (on_our_tty(buf)      <<3);
-  return (select_bits & (1<<proc_index));
+  return !!(select_bits & (1<<proc_index));
 }
 
-/***** selected by some kind of list? */
-static int proc_was_listed(proc_t *buf){
-  selection_node *sn = selection_list;
-  int i;
-  if(!sn) return 0;
-  while(sn){
-    switch(sn->typecode){
-    default:
-      printf("Internal error in ps! Please report this bug.\n");
-
-#define return_if_match(foo,bar) \
-        i=sn->n; while(i--) \
-        if((unsigned)(buf->foo) == (unsigned)(*(sn->u+i)).bar) \
-        return 1
-
-    break; case SEL_RUID: return_if_match(ruid,uid);
-    break; case SEL_EUID: return_if_match(euid,uid);
-    break; case SEL_SUID: return_if_match(suid,uid);
-    break; case SEL_FUID: return_if_match(fuid,uid);
-
-    break; case SEL_RGID: return_if_match(rgid,gid);
-    break; case SEL_EGID: return_if_match(egid,gid);
-    break; case SEL_SGID: return_if_match(sgid,gid);
-    break; case SEL_FGID: return_if_match(fgid,gid);
-
-    break; case SEL_PGRP: return_if_match(pgrp,pid);
-    break; case SEL_PID : return_if_match(tgid,pid);
-    break; case SEL_PPID: return_if_match(ppid,ppid);
-    break; case SEL_TTY : return_if_match(tty,tty);
-    break; case SEL_SESS: return_if_match(session,pid);
+static int table_accept(proc_t *buf){
+  return table_accept_as(buf, has_our_euid(buf));
+}
 
-    break; case SEL_COMM: i=sn->n; while(i--)
-    if(!strncmp( buf->cmd, (*(sn->u+i)).cmd, 15 )) return 1;
+/***** is this value in a list hashed by compile_selection()? */
+static int selection_has(const selection_node *sn, unsigned val){
+  unsigned h;
+  if(!val) return sn->set_zero;
+  h = (val * 2654435761u) & sn->set_mask;
+  while(sn->set[h]){
+    if(sn->set[h] == val) return 1;
+    h = (h + 1) & sn->set_mask;
+  }
+  return 0;
+}
 
+/***** does this one list select it? */
+static int node_has(const selection_node *sn, const proc_t *buf){
+  int i;
+  switch(sn->typecode){
+  default:
+    printf("Internal error in ps! Please report this bug.\n");
+    return 0;
 
+#define return_if_match(foo,bar) \
+      if(sn->set) return selection_has(sn, (unsigned)(buf->foo)); \
+      i=sn->n; while(i--) \
+      if((unsigned)(buf->foo) == (unsigned)(*(sn->u+i)).bar) \
+      return 1; \
+      return 0
+
+  case SEL_RUID: return_if_match(ruid,uid);
+  case SEL_EUID: return_if_match(euid,uid);
+  case SEL_SUID: return_if_match(suid,uid);
+  case SEL_FUID: return_if_match(fuid,uid);
+
+  case SEL_RGID: return_if_match(rgid,gid);
+  case SEL_EGID: return_if_match(egid,gid);
+  case SEL_SGID: return_if_match(sgid,gid);
+  case SEL_FGID: return_if_match(fgid,gid);
+
+  case SEL_PGRP: return_if_match(pgrp,pid);
+  case SEL_PID : return_if_match(tgid,pid);
+  case SEL_PPID: return_if_match(ppid,ppid);
+  case SEL_TTY : return_if_match(tty,tty);
+  case SEL_SESS: return_if_match(session,pid);
+
+  case SEL_COMM: i=sn->n; while(i--){
+      if(!strncmp( buf->cmd, (*(sn->u+i)).cmd, 15 )) return 1;
+    }
+    return 0;
 
 #undef return_if_match
 
-    }
+  }
+}
+
+/***** selected by some kind of list? */
+static int proc_was_listed(proc_t *buf){
+  selection_node *sn = selection_list;
+  while(sn){
+    if(node_has(sn, buf)) return 1;
     sn = sn->next;
   }
   return 0;
 }
 
+/***** for openproc(PROC_PID): the listed pids, if nothing else selects */
+static int pid_cmp(const void *a, const void *b){
+  pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+  return (x > y) - (x < y);
+}
+
+pid_t *selected_pids(void){
+  const selection_node *sn;
+  pid_t *pids;
+  int n = 0, i, j;
+  /* "ps -p 1 -u 0" is an "or", and -N wants everything else */
+  if(all_processes || simple_select || negate_selection || !selection_list) return NULL;
+  for(sn = selection_list; sn; sn = sn->next){
+    if(sn->typecode != SEL_PID) return NULL;
+    n += sn->n;
+  }
+  pids = xmalloc((n + 1) * sizeof *pids);
+  for(n = 0, sn = selection_list; sn; sn = sn->next){
+    for(i = 0; i < sn->n; i++) pids[n++] = sn->u[i].pid;
+  }
+  /* in /proc's order, once each */
+  qsort(pids, n, sizeof *pids, pid_cmp);
+  for(i = j = 0; i < n; i++){
+    if(!j || pids[j-1] != pids[i]) pids[j++] = pids[i];
+  }
+  pids[j] = 0;
+  return pids;
+}
 
 /***** This must satisfy Unix98 and as much BSD as possible */
 int want_this_proc(proc_t *buf){
@@ -144,3 +196,58 @@ finish:
   if(negate_selection) return !accepted_proc;
   return accepted_proc;
 }
+
+/***** openproc's prefilter: turn down what want_this_proc() will, from stat alone */
+
+/* Only the stat fields are in, and /proc/# belongs to root, not to the
+ * euid, when the process isn't dumpable.  So each test gives yes, no
+ * or "can't tell yet", and only a sure "no" skips the rest of the reading. */
+#define MAYBE 2
+
+static int maybe_or(int a, int b){
+  if(a==1 || b==1) return 1;
+  return (a||b) ? MAYBE : 0;
+}
+
+static int table_at_stat(const proc_t *buf){
+  int accept;
+  if(buf->euid) return table_accept_as(buf, has_our_euid(buf));
+  accept = table_accept_as(buf, 0);
+  return accept == table_accept_as(buf, 1) ? accept : MAYBE;
+}
+
+static int listed_at_stat(const proc_t *buf){
+  const selection_node *sn;
+  int maybe = 0;
+  for(sn = selection_list; sn; sn = sn->next){
+    switch(sn->typecode){
+    case SEL_EUID:
+      if(!buf->euid){ maybe = 1; continue; }
+      break;
+    case SEL_EGID:
+      if(!buf->egid){ maybe = 1; continue; }
+      break;
+    case SEL_RUID: case SEL_SUID: case SEL_FUID:
+    case SEL_RGID: case SEL_SGID: case SEL_FGID:
+      maybe = 1;  /* those come from status */
+      continue;
+    }
+    if(node_has(sn, buf)) return 1;
+  }
+  return maybe ? MAYBE : 0;
+}
+
+int prefilter_this_proc(const proc_t *restrict const buf){
+  int accepted_proc = 1;
+  if(all_processes) goto finish;
+  accepted_proc = 0;
+  if((simple_select || !selection_list)){
+    accepted_proc = table_at_stat(buf);
+    if(accepted_proc == 1) goto finish;
+  }
+  accepted_proc = maybe_or(accepted_proc, listed_at_stat(buf));
+finish:
+  if(running_only && !running(buf)) accepted_proc = 0;
+  if(negate_selection) return accepted_proc != 1;
+  return accepted_proc != 0;
+}
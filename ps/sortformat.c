@@ -56,6 +56,7 @@ static format_node *do_one_spec(const char *spec, const char *override){
       thisnode->name = malloc(strlen(fs->head)+1);
       strcpy(thisnode->name, fs->head);
     }
+    thisnode->spec = fs->spec;
     thisnode->pr = fs->pr;
     thisnode->need = fs->need;
     thisnode->vendor = fs->vendor;
@@ -182,6 +183,7 @@ double_percent:
       fnode->width = len;
       fnode->name = malloc(len+1);
       strcpy(fnode->name, buf);
+      fnode->spec = NULL;
       fnode->pr = NULL;     /* checked for */
       fnode->need = 0;
       fnode->vendor = AIX;
@@ -689,6 +691,7 @@ static const char *generate_sysv_list(void){
       fn->width = 1;
       fn->name = malloc(2);
       strcpy(fn->name, ":");
+      fn->spec = NULL;
       fn->pr = NULL;     /* checked for */
       fn->need = 0;
       fn->vendor = AIX;   /* yes, for SGI weirdness */
@@ -10,7 +10,6 @@
  */
 #include <fcntl.h>
 #include <pwd.h>
-#include <dirent.h>
 #include <errno.h>
 #include <signal.h>
 #include <stdio.h>
@@ -18,12 +17,14 @@
 #include <string.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include "proc/pwcache.h"
 #include "proc/sig.h"
 #include "proc/devname.h"
+#include "proc/readproc.h"
 #include "proc/procps.h"  /* char *user_from_uid(uid_t uid) */
 #include "proc/version.h" /* procps_version */
 
@@ -73,16 +74,65 @@ static void display_kill_version(void){
   }
 }
 
+/***** start_time from the stat of an open /proc/PID, or 0 */
+static unsigned long long start_time_at(int dirfd){
+  char buf[1024];
+  char *tmp;
+  int fd, n, i;
+  fd = openat(dirfd, "stat", O_RDONLY);
+  if(fd==-1) return 0;
+  n = read(fd, buf, sizeof buf - 1);
+  close(fd);
+  if(n<=0) return 0;
+  buf[n] = '\0';
+  tmp = strrchr(buf, ')');
+  if(!tmp) return 0;
+  i = 20; while(i--) if(!(tmp = strchr(tmp+1, ' '))) return 0; /* to field 22 */
+  return strtoull(tmp, NULL, 10);
+}
+
+/***** kill or nice it by way of /proc/PID, so a PID reused since the scan is safe */
+static int do_hurt(const proc_t *restrict const p){
+  char path[32];
+  int dirfd;
+  int ret;
+  snprintf(path, sizeof path, "/proc/%d", p->XXXID);
+  dirfd = open(path, O_RDONLY|O_DIRECTORY);
+  if(dirfd==-1){
+    errno = ESRCH;  /* gone already */
+    return -1;
+  }
+  /* the directory stays with the task it was opened for, so this
+     tells whether that's still the one the scan chose */
+  if(start_time_at(dirfd) != p->start_time){
+    close(dirfd);
+    errno = ESRCH;
+    return -1;
+  }
+  if(program==PROG_SKILL){
+#ifdef SYS_pidfd_send_signal
+    ret = syscall(SYS_pidfd_send_signal, dirfd, sig_or_pri, NULL, 0);
+    if(ret==-1 && errno==ENOSYS)
+#endif
+    ret = kill(p->XXXID, sig_or_pri);
+  }else{
+    ret = setpriority(PRIO_PROCESS, p->XXXID, sig_or_pri); /* no pidfd call for this */
+  }
+  close(dirfd);
+  return ret;
+}
+
 /***** kill or nice a process */
-static void hurt_proc(int tty, int uid, int pid, const char *restrict const cmd){
+static void hurt_proc(const proc_t *restrict const p){
   int failed;
   int saved_errno;
   char dn_buf[1000];
-  dev_to_tty(dn_buf, 999, tty, pid, ABBREV_DEV);
+  int pid = p->XXXID;
+  dev_to_tty(dn_buf, 999, p->tty, pid, ABBREV_DEV);
   if(i_flag){
     char buf[8];
     fprintf(stderr, "%-8s %-8s %5d %-16.16s   ? ",
-      (char*)dn_buf,user_from_uid(uid),pid,cmd
+      (char*)dn_buf,user_from_uid(p->euid),pid,p->cmd
     );
     if(!fgets(buf,7,stdin)){
       printf("\n");
@@ -91,12 +141,11 @@ static void hurt_proc(int tty, int uid, int pid, const char *restrict const cmd)
     if(*buf!='y' && *buf!='Y') return;
   }
   /* do the actual work */
-  if(program==PROG_SKILL) failed=kill(pid,sig_or_pri);
-  else                    failed=setpriority(PRIO_PROCESS,pid,sig_or_pri);
+  failed = do_hurt(p);
   saved_errno = errno;
   if(w_flag && failed){
     fprintf(stderr, "%-8s %-8s %5d %-16.16s   ",
-      (char*)dn_buf,user_from_uid(uid),pid,cmd
+      (char*)dn_buf,user_from_uid(p->euid),pid,p->cmd
     );
     errno = saved_errno;
     perror("");
@@ -105,7 +154,7 @@ static void hurt_proc(int tty, int uid, int pid, const char *restrict const cmd)
   if(i_flag) return;
   if(v_flag){
     printf("%-8s %-8s %5d %-16.16s\n",
-      (char*)dn_buf,user_from_uid(uid),pid,cmd
+      (char*)dn_buf,user_from_uid(p->euid),pid,p->cmd
     );
     return;
   }
@@ -116,53 +165,40 @@ static void hurt_proc(int tty, int uid, int pid, const char *restrict const cmd)
 }
 
 
-/***** check one process */
-static void check_proc(int pid){
-  char buf[128];
-  struct stat statbuf;
-  char *tmp;
-  int tty;
-  int fd;
-  int i;
-  if(pid==my_pid) return;
-  sprintf(buf, "/proc/%d/stat", pid); /* pid (cmd) state ppid pgrp session tty */
-  fd = open(buf,O_RDONLY);
-  if(fd==-1){  /* process exited maybe */
-    if(pids && w_flag) printf("WARNING: process %d could not be found.",pid);
-    return;
+/***** -w: complain about listed PIDs that are gone */
+static pid_t *listed;  /* the -p list for openproc, in the old order */
+static int listed_seen;
+
+static void missing_until(int pid){
+  while(listed[listed_seen] && listed[listed_seen]!=pid){
+    if(w_flag) printf("WARNING: process %d could not be found.\n",listed[listed_seen]);
+    listed_seen++;
   }
-  fstat(fd, &statbuf);
-  if(uids){  /* check the EUID */
+  if(listed[listed_seen]) listed_seen++;
+}
+
+/***** readproc prefilter: everything it needs is in /proc/#/stat */
+static int check_proc(const proc_t *restrict const p){
+  int i;
+  if(listed) missing_until(p->XXXID);
+  if(p->XXXID==my_pid) return 0;
+  if(uids && listed){  /* openproc got the PIDs, so check the EUID here */
     i=uid_count;
-    while(i--) if(uids[i]==statbuf.st_uid) break;
-    if(i==-1) goto closure;
+    while(i--) if(uids[i]==(uid_t)p->euid) break;
+    if(i==-1) return 0;
   }
-  read(fd,buf,128);
-  buf[127] = '\0';
-  tmp = strrchr(buf, ')');
-  *tmp++ = '\0';
-  i = 5; while(i--) while(*tmp++!=' '); /* scan to find tty */
-  tty = atoi(tmp);
   if(ttys){
     i=tty_count;
-    while(i--) if(ttys[i]==tty) break;
-    if(i==-1) goto closure;
+    while(i--) if(ttys[i]==p->tty) break;
+    if(i==-1) return 0;
   }
-  tmp = strchr(buf, '(') + 1;
   if(cmds){
     i=cmd_count;
     /* fast comparison trick -- useful? */
-    while(i--) if(cmds[i][0]==*tmp && !strcmp(cmds[i],tmp)) break;
-    if(i==-1) goto closure;
+    while(i--) if(cmds[i][0]==*p->cmd && !strcmp(cmds[i],p->cmd)) break;
+    if(i==-1) return 0;
   }
-  /* This is where we kill/nice something. */
-/*  fprintf(stderr, "PID %d, UID %d, TTY %d,%d, COMM %s\n",
-    pid, statbuf.st_uid, tty>>8, tty&0xf, tmp
-  );
-*/
-  hurt_proc(tty, statbuf.st_uid, pid, tmp);
-closure:
-  close(fd); /* kill/nice _first_ to avoid PID reuse */
+  return 1;
 }
 
 
@@ -202,31 +238,35 @@ static void show_lists(void){
 
 /***** iterate over all PIDs */
 static void iterate(void){
-  int pid;
-  DIR *d;
-  struct dirent *de;
-  if(pids){
-    pid = pid_count;
-    while(pid--) check_proc(pids[pid]);
-    return;
-  }
+  PROCTAB *ptp;
+  proc_t task;
+  int flags = PROC_FILLSTAT | PROC_FIELD_BASIC | PROC_FIELD_TIMES;
+  int i;
 #if 0
   /* could setuid() and kill -1 to have the kernel wipe out a user */
   if(!ttys && !cmds && !pids && !i_flag){
   }
 #endif
-  d = opendir("/proc");
-  if(!d){
+  if(pids){
+    listed = malloc((pid_count+1) * sizeof *listed);
+    if(!listed) fprintf(stderr,"No memory.\n"),exit(2);
+    for(i=0; i<pid_count; i++) listed[i] = pids[pid_count-1-i];
+    listed[pid_count] = 0;
+    ptp = openproc(flags | PROC_PID, listed);
+  }else if(uids){
+    ptp = openproc(flags | PROC_UID, uids, uid_count);
+  }else{
+    ptp = openproc(flags);
+  }
+  if(!ptp){
     perror("/proc");
     exit(1);
   }
-  while(( de = readdir(d) )){
-    if(de->d_name[0] > '9') continue;
-    if(de->d_name[0] < '1') continue;
-    pid = atoi(de->d_name);
-    if(pid) check_proc(pid);
-  }
-  closedir (d);
+  ptp->prefilter = check_proc;
+  memset(&task, 0, sizeof task);
+  while(readproc(ptp, &task)) hurt_proc(&task);
+  closeproc(ptp);
+  if(listed) missing_until(0);
 }
 
 /***** kill help */
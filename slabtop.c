@@ -26,59 +26,31 @@
 #include <unistd.h>
 
 #include "proc/slab.h"
+#include "proc/interval.h"
 #include "proc/version.h"
 
 #define DEF_SORT_FUNC		sort_nr_objs
-#define SLAB_STAT_ZERO		{ nr_objs: 0 }
 
 static unsigned short cols, rows;
 static struct termios saved_tty;
-static long delay = 3;
+static double delay = 3;
+static int slab_flags;
 static int (*sort_func)(const struct slab_info *, const struct slab_info *);
 
-static struct slab_info *merge_objs(struct slab_info *a, struct slab_info *b)
-{
-	struct slab_info sorted_list;
-	struct slab_info *curr = &sorted_list;
-
-	while ((a != NULL) && (b != NULL)) {
-		if (sort_func(a, b)) {
-			curr->next = a;
-			curr = a;
-			a = a->next;
-		} else {
-			curr->next = b;
-			curr = b;
-			b = b->next;
-		}
-	}
-
-	curr->next = (a == NULL) ? b : a;
-	return sorted_list.next;
-}
-
-/* 
- * slabsort - merge sort the slab_info linked list based on sort_func
+/*
+ * compare_slabs - qsort() order for sort_func, which only says "greater".
+ * Equal records stay in the kernel's order.
  */
-static struct slab_info *slabsort(struct slab_info *list)
+static int compare_slabs(const void *a, const void *b)
 {
-	struct slab_info *a, *b;
-
-	if ((list == NULL) || (list->next == NULL))
-		return list;
-
-	a = list;
-	b = list->next;
-
-	while ((b != NULL) && (b->next != NULL)) {
-		list = list->next;
-		b = b->next->next;
-	}
-	
-	b = list->next;
-	list->next = NULL;
-
-	return merge_objs(slabsort(a), slabsort(b));
+	const struct slab_info *x = *(const struct slab_info *const *)a;
+	const struct slab_info *y = *(const struct slab_info *const *)b;
+
+	if (sort_func(x, y))
+		return -1;
+	if (sort_func(y, x))
+		return 1;
+	return (x > y) - (x < y);
 }
 
 /*
@@ -146,6 +118,11 @@ static int sort_cache_size(const struct slab_info *a, const struct slab_info *b)
 	return (a->cache_size > b->cache_size);
 }
 
+static int sort_rate(const struct slab_info *a, const struct slab_info *b)
+{
+	return (a->active_objs_delta > b->active_objs_delta);
+}
+
 /*
  * term_size - set the globals 'cols' and 'rows' to the current terminal size
  */
@@ -180,6 +157,8 @@ static void usage(const char *cmd)
 		"only display once, then exit\n");
 	fprintf(stderr, "  --sort=S, -s S     "
 		"specify sort criteria S (see below)\n");
+	fprintf(stderr, "  --sysfs, -S        "
+		"read /sys/kernel/slab, not /proc/slabinfo\n");
 	fprintf(stderr, "  --version, -V      "
 		"display version information and exit\n");
 	fprintf(stderr, "  --help             display this help and exit\n\n");
@@ -192,6 +171,7 @@ static void usage(const char *cmd)
 	fprintf(stderr, "  n: sort by name\n");
 	fprintf(stderr, "  o: sort by number of objects\n");
 	fprintf(stderr, "  p: sort by pages per slab\n");
+	fprintf(stderr, "  r: sort by change in active objects per second\n");
 	fprintf(stderr, "  s: sort by object size\n");
 	fprintf(stderr, "  u: sort by cache utilization\n");
 }
@@ -221,6 +201,8 @@ static void * set_sort_func(char key)
 		return sort_nr_active_slabs;
 	case 'c':
 		return sort_cache_size;
+	case 'r':
+		return sort_rate;
 	case 'u':
 		return sort_use;
 	default:
@@ -256,6 +238,9 @@ static void parse_input(char c)
 	case 'P':
 		sort_func = sort_pages_per_slab;
 		break;
+	case 'R':
+		sort_func = sort_rate;
+		break;
 	case 'S':
 		sort_func = sort_obj_size;
 		break;
@@ -272,11 +257,15 @@ int main(int argc, char *argv[])
 {
 	int o;
 	unsigned short old_rows;
-	struct slab_info *slab_list = NULL;
+	slabs_t slabs;
+	interval_t tick;
+	struct slab_info **order = NULL;
+	int order_size = 0;
 
 	struct option longopts[] = {
 		{ "delay",	1, NULL, 'd' },
 		{ "sort",	1, NULL, 's' },
+		{ "sysfs",	0, NULL, 'S' },
 		{ "once",	0, NULL, 'o' },
 		{ "help",	0, NULL, 'h' },
 		{ "version",	0, NULL, 'V' },
@@ -285,15 +274,15 @@ int main(int argc, char *argv[])
 
 	sort_func = DEF_SORT_FUNC;
 
-	while ((o = getopt_long(argc, argv, "d:s:ohV", longopts, NULL)) != -1) {
+	while ((o = getopt_long(argc, argv, "d:s:SohV", longopts, NULL)) != -1) {
 		int ret = 1;
 
 		switch (o) {
 		case 'd':
 			errno = 0;
-			delay = strtol(optarg, NULL, 10);
+			delay = strtod(optarg, NULL);
 			if (errno) {
-				perror("strtoul");
+				perror("strtod");
 				return 1;
 			}
 			if (delay < 0) {
@@ -305,6 +294,9 @@ int main(int argc, char *argv[])
 		case 's':
 			sort_func = set_sort_func(optarg[0]);
 			break;
+		case 'S':
+			slab_flags |= SLABS_SYSFS;
+			break;
 		case 'o':
 			delay = 0;
 			break;
@@ -319,6 +311,8 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	memset(&slabs, 0, sizeof slabs);
+
 	if (tcgetattr(0, &saved_tty) == -1)
 		perror("tcgetattr");
 
@@ -328,17 +322,18 @@ int main(int argc, char *argv[])
 	resizeterm(rows, cols);
 	signal(SIGWINCH, term_size);
 	signal(SIGINT, sigint_handler);
+	interval_start(&tick, delay);
 
 	do {
-		struct slab_info *curr;
-		struct slab_stat stats = SLAB_STAT_ZERO;
+		struct slab_stat stats;
 		struct timeval tv;
 		fd_set readfds;
 		char c;
-		int i;
+		int i, name_width, longest, show_rate;
 
-		if (get_slabinfo(&slab_list, &stats))
+		if (read_slabs(&slabs, slab_flags))
 			break;
+		stats = slabs.stats;
 
 		if (old_rows != rows) {
 			resizeterm(rows, cols);
@@ -358,40 +353,81 @@ int main(int argc, char *argv[])
 			stats.min_obj_size / 1024.0, stats.avg_obj_size / 1024.0, stats.max_obj_size / 1024.0
 		);
 
-		slab_list = slabsort(slab_list);
+		/* sort pointers, so the records stay put for the next read */
+		if (slabs.n > order_size) {
+			order_size = slabs.n;
+			order = realloc(order, order_size * sizeof *order);
+			if (!order) {
+				perror("realloc");
+				break;
+			}
+		}
+		for (i = 0; i < slabs.n; i++)
+			order[i] = &slabs.slab[i];
+		qsort(order, slabs.n, sizeof *order, compare_slabs);
+
+		/*
+		 * The name gets what's left, so that lines don't wrap.  Names
+		 * are what people look for, so ACTV/S goes before one is cut.
+		 */
+		longest = 4;
+		for (i = 0; i < slabs.n; i++)
+			if ((int) strlen(slabs.slab[i].name) > longest)
+				longest = strlen(slabs.slab[i].name);
+		name_width = cols - 56;
+		show_rate = name_width - 8 >= longest;
+		if (show_rate)
+			name_width -= 8;
+		if (name_width < 4)
+			name_width = 4;
 
 		attron(A_REVERSE);
-		printw(	"%6s %6s %4s %8s %6s %8s %10s %-23s\n",
+		printw(	"%6s %6s %4s %8s %6s %8s %10s ",
 			"OBJS", "ACTIVE", "USE", "OBJ SIZE", "SLABS",
-			"OBJ/SLAB", "CACHE SIZE", "NAME");
+			"OBJ/SLAB", "CACHE SIZE");
+		if (show_rate)
+			printw("%7s ", "ACTV/S");
+		printw("%-*.*s\n", name_width, name_width, "NAME");
 		attroff(A_REVERSE);
 
-		curr = slab_list;
-		for (i = 0; i < rows - 8 && curr->next; i++) {
-			printw("%6u %6u %3u%% %7.2fK %6u %8u %9uK %-23s\n",
+		for (i = 0; i < rows - 8 && i < slabs.n; i++) {
+			const struct slab_info *curr = order[i];
+			char rate[16];
+
+			if (slabs.elapsed > 0)
+				snprintf(rate, sizeof rate, "%+.0f",
+					curr->active_objs_delta / slabs.elapsed);
+			else
+				strcpy(rate, "-");
+			printw("%6u %6u %3u%% %7.2fK %6u %8u %9uK ",
 				curr->nr_objs, curr->nr_active_objs, curr->use,
 				curr->obj_size / 1024.0, curr->nr_slabs,
-				curr->objs_per_slab, (unsigned)(curr->cache_size / 1024),
-				curr->name);
-			curr = curr->next;
+				curr->objs_per_slab, (unsigned)(curr->cache_size / 1024));
+			if (show_rate)
+				printw("%7s ", rate);
+			printw("%-.*s\n", name_width, curr->name);
 		}
+		clrtobot();
 
 		refresh();
-		put_slabinfo(slab_list);
 
 		FD_ZERO(&readfds);
 		FD_SET(0, &readfds);
-		tv.tv_sec = delay;
-		tv.tv_usec = 0;
-		if (select(1, &readfds, NULL, NULL, &tv) > 0) {
+		i = delay ? interval_left(&tick) : 0;
+		tv.tv_sec = i / 1000;
+		tv.tv_usec = i % 1000 * 1000;
+		i = select(1, &readfds, NULL, NULL, &tv);
+		if (i > 0) {
 			if (read(0, &c, 1) != 1)
 				break;
 			parse_input(c);
-		}
+		} else if (i == 0 && delay)
+			interval_tick(&tick);
 	} while (delay);
 
 	tcsetattr(0, TCSAFLUSH, &saved_tty);
-	free_slabinfo(slab_list);
+	free(order);
+	free_slabs(&slabs);
 	endwin();
 	return 0;
 }
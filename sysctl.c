@@ -25,6 +25,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
@@ -50,6 +53,13 @@ static bool PrintName;
 static bool PrintNewline;
 static bool IgnoreError;
 static bool Quiet;
+static bool Parallel;
+static bool OnlyChanged;
+
+/* what -c did with the settings it was given */
+typedef struct Tally {
+   unsigned changed, unchanged, failed;
+} Tally;
 
 /* error messages */
 static const char ERR_UNKNOWN_PARAMETER[] = "error: Unknown parameter \"%s\"\n";
@@ -61,7 +71,9 @@ static const char ERR_UNKNOWN_READING[] = "error: \"%s\" reading key \"%s\"\n";
 static const char ERR_PERMISSION_DENIED[] = "error: permission denied on key '%s'\n";
 static const char ERR_OPENING_DIR[] = "error: unable to open directory \"%s\"\n";
 static const char ERR_PRELOAD_FILE[] = "error: unable to open preload file \"%s\"\n";
+static const char ERR_NO_MEMORY[] = "error: out of memory\n";
 static const char WARN_BAD_LINE[] = "warning: %s(%d): invalid syntax, continuing...\n";
+static const char MSG_SUMMARY[] = "%u changed, %u unchanged, %u failed\n";
 
 
 static void slashdot(char *restrict p, char old, char new){
@@ -76,6 +88,16 @@ static void slashdot(char *restrict p, char old, char new){
   }
 }
 
+/* realloc(), or if there's no memory, give up */
+static void *Realloc(void *p, size_t size) {
+   p = realloc(p, size);
+   if (!p) {
+      fputs(ERR_NO_MEMORY, stderr);
+      exit(1);
+   }
+   return p;
+}
+
 
 
 /*
@@ -84,9 +106,9 @@ static void slashdot(char *restrict p, char old, char new){
  */
 static int Usage(const char *restrict const name) {
    printf("usage:  %s [-n] [-e] variable ... \n"
-          "        %s [-n] [-e] [-q] -w variable=value ... \n" 
-          "        %s [-n] [-e] -a \n" 
-          "        %s [-n] [-e] [-q] -p <file>   (default /etc/sysctl.conf) \n"
+          "        %s [-n] [-e] [-q] [-c] -w variable=value ... \n" 
+          "        %s [-n] [-e] [-j] -a \n" 
+          "        %s [-n] [-e] [-q] [-c] [-j] -p <file>   (default /etc/sysctl.conf) \n"
           "        %s [-n] [-e] -A\n", name, name, name, name, name);
    return -1;
 }
@@ -214,44 +236,341 @@ static int ReadSetting(const char *restrict const name) {
 
 
 /*
- *     Display all the sysctl settings 
+ *     Print one setting's value, already read in, as ReadSetting() does
  *
  */
-static int DisplayAll(const char *restrict const path) {
+static void PrintValue(FILE *restrict out, const char *restrict outname,
+                       const char *buf, size_t n) {
+   const char *end = buf + n;
+
+   while (buf < end) {
+      const char *nl = memchr(buf, '\n', end - buf);
+      size_t len = nl ? (size_t)(nl - buf) + 1 : (size_t)(end - buf);
+
+      if (NameOnly) {
+         fprintf(out, "%s\n", outname);
+      } else if (PrintName) {
+         fprintf(out, "%s = %.*s", outname, (int)len, buf);
+      } else {
+         fwrite(buf, 1, (!PrintNewline && nl) ? len - 1 : len, out);
+      }
+      buf += len;
+   }
+}
+
+/*
+ *     Read the setting 'file' in the directory dfd; name is its path
+ *     under /proc/sys, with slashes
+ *
+ */
+static int ReadSettingAt(int dfd, const char *restrict file,
+                         const char *restrict name, FILE *restrict out) {
+   char outname[PATH_MAX];
+   char inbuf[4096];
+   char *buf = inbuf;
+   size_t size = sizeof inbuf, n = 0;
+   ssize_t got;
+   int rc = 0;
+   int fd;
+
+   snprintf(outname, sizeof outname, "%s", name);
+   slashdot(outname,'/','.'); /* change / to . */
+
+   fd = openat(dfd, file, O_RDONLY|O_CLOEXEC);
+   if (fd == -1) {
+      switch(errno) {
+      case ENOENT:
+         if (!IgnoreError) {
+            fprintf(stderr, ERR_INVALID_KEY, outname);
+            rc = -1;
+         }
+         break;
+      case EACCES:
+         fprintf(stderr, ERR_PERMISSION_DENIED, outname);
+         rc = -1;
+         break;
+      default:
+         fprintf(stderr, ERR_UNKNOWN_READING, strerror(errno), outname);
+         rc = -1;
+         break;
+      }
+      return rc;
+   }
+   // the whole value, however many reads that takes
+   while ((got = read(fd, buf + n, size - n)) > 0) {
+      n += got;
+      if (n < size) continue;
+      size *= 2;
+      if (buf == inbuf) {
+         buf = Realloc(NULL, size);
+         memcpy(buf, inbuf, n);
+      } else {
+         buf = Realloc(buf, size);
+      }
+   }
+   if (got == -1) {
+      if (errno == EACCES)
+         fprintf(stderr, ERR_PERMISSION_DENIED, outname);
+      else
+         fprintf(stderr, ERR_UNKNOWN_READING, strerror(errno), outname);
+      rc = -1;
+   } else {
+      PrintValue(out, outname, buf, n);
+   }
+   if (buf != inbuf) free(buf);
+   close(fd);
+   return rc;
+}
+
+static int WalkDir(int dfd, char *restrict name, size_t len, FILE *restrict out);
+
+/*
+ *     One entry of a directory: a setting, or a directory to go into.
+ *     d_type saves the stat() almost always; /proc fills it in.
+ *
+ */
+static int WalkEntry(int dfd, const struct dirent *restrict de,
+                     char *restrict name, size_t len, FILE *restrict out) {
+   size_t nlen = strlen(de->d_name);
+   unsigned char type = de->d_type;
+   struct stat ts;
+   int fd;
+
+   if (len + nlen + 2 > PATH_MAX)
+      return 0;
+   memcpy(name + len, de->d_name, nlen + 1);
+   if (type == DT_UNKNOWN) {
+      if (fstatat(dfd, de->d_name, &ts, 0) != 0) {
+         perror(name);
+         return 0;
+      }
+      type = S_ISDIR(ts.st_mode) ? DT_DIR : DT_REG;
+   }
+   if (type != DT_DIR)
+      return ReadSettingAt(dfd, de->d_name, name, out);
+   fd = openat(dfd, de->d_name, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+   if (fd == -1) {
+      fprintf(stderr, ERR_OPENING_DIR, name);
+      return 0;
+   }
+   name[len + nlen] = '/';
+   name[len + nlen + 1] = '\0';
+   WalkDir(fd, name, len + nlen + 1, out);
+   return 0;         /* as ever, trouble further down isn't ours */
+}
+
+static bool IsDots(const char *restrict d_name) {
+   return d_name[0] == '.' && (!d_name[1] || (d_name[1] == '.' && !d_name[2]));
+}
+
+/*
+ *     Everything under the directory dfd (which this closes); name holds
+ *     its path under /proc/sys, len long, and is used to build the rest
+ *
+ */
+static int WalkDir(int dfd, char *restrict name, size_t len, FILE *restrict out) {
    int rc = 0;
-   int rc2;
    DIR *restrict dp;
    struct dirent *restrict de;
-   struct stat ts;
 
-   dp = opendir(path);
+   dp = fdopendir(dfd);
+   if (!dp) {
+      close(dfd);
+      fprintf(stderr, ERR_OPENING_DIR, name);
+      return -1;
+   }
+   while (( de = readdir(dp) )) {
+      if (IsDots(de->d_name))
+         continue;
+      rc |= WalkEntry(dirfd(dp), de, name, len, out);
+   }
+   closedir(dp);
+   return rc;
+}
+
+/*
+ *     -j's threads: one per CPU, up to MAX_THREADS, each taking the next
+ *     item nobody has yet until there are none left
+ *
+ */
+#define MAX_THREADS 16
+
+typedef struct Pool {
+   char *items;
+   size_t each;
+   unsigned n;
+   unsigned next;
+   void *(*work)(void *);
+} Pool;
+
+static void *PoolWorker(void *arg) {
+   Pool *restrict p = arg;
+   unsigned i;
+
+   while ((i = __sync_fetch_and_add(&p->next, 1)) < p->n)
+      p->work(p->items + i * p->each);
+   return NULL;
+}
 
+static void RunPool(void *items, size_t each, unsigned n, void *(*work)(void *)) {
+   pthread_t tid[MAX_THREADS];
+   Pool p = { items, each, n, 0, work };
+   long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   unsigned nt, started = 0, i;
+
+   nt = cpus < 1 ? 1 : cpus > MAX_THREADS ? MAX_THREADS : cpus;
+   if (nt > n)
+      nt = n;
+   // the caller makes one of them, and does it all if no thread starts
+   while (started + 1 < nt && !pthread_create(&tid[started], NULL, PoolWorker, &p))
+      started++;
+   PoolWorker(&p);
+   for (i = 0; i < started; i++)
+      pthread_join(tid[i], NULL);
+}
+
+/*
+ *     For -j: each entry at the top gets a buffer of its own, the pool
+ *     walks them, and the buffers are written out in order.
+ *
+ */
+typedef struct Subtree {
+   struct dirent de;
+   const char *prefix;   /* the path of the directory they're all in */
+   size_t len;
+   char *buf;
+   size_t size;
+   int dfd;
+   int rc;
+} Subtree;
+
+static void *WalkSubtree(void *arg) {
+   Subtree *restrict t = arg;
+   char name[PATH_MAX];
+   FILE *out = open_memstream(&t->buf, &t->size);
+
+   if (!out) {
+      t->rc = -1;
+      return NULL;
+   }
+   memcpy(name, t->prefix, t->len + 1);
+   t->rc = WalkEntry(t->dfd, &t->de, name, t->len, out);
+   fclose(out);
+   return NULL;
+}
+
+static int WalkParallel(int dfd, char *restrict name, size_t len) {
+   int rc = 0;
+   DIR *restrict dp;
+   struct dirent *restrict de;
+   Subtree *trees = NULL;
+   unsigned n = 0, i;
+
+   dp = fdopendir(dfd);
    if (!dp) {
+      close(dfd);
+      fprintf(stderr, ERR_OPENING_DIR, name);
+      return -1;
+   }
+   while (( de = readdir(dp) )) {
+      if (IsDots(de->d_name))
+         continue;
+      trees = Realloc(trees, (n + 1) * sizeof *trees);
+      memset(&trees[n], 0, sizeof trees[n]);
+      trees[n].dfd = dirfd(dp);
+      trees[n].de = *de;
+      trees[n].prefix = name;
+      trees[n].len = len;
+      n++;
+   }
+   RunPool(trees, sizeof *trees, n, WalkSubtree);
+   for (i = 0; i < n; i++) {
+      if (trees[i].buf)
+         fwrite(trees[i].buf, 1, trees[i].size, stdout);
+      free(trees[i].buf);
+      rc |= trees[i].rc;
+   }
+   free(trees);
+   closedir(dp);
+   return rc;
+}
+
+/*
+ *     Display all the sysctl settings 
+ *
+ *     Each directory is opened relative to the one it's in, so the kernel
+ *     never walks a whole path again, and the settings are printed into
+ *     stdio with a large buffer instead of being flushed one by one.
+ *
+ */
+static int DisplayAll(const char *restrict const path) {
+   static char obuf[65536];
+   char name[PATH_MAX];
+   size_t len;
+   int dfd;
+
+   dfd = open(path, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+   if (dfd == -1) {
       fprintf(stderr, ERR_OPENING_DIR, path);
-      rc = -1;
-   } else {
-      readdir(dp);  // skip .
-      readdir(dp);  // skip ..
-      while (( de = readdir(dp) )) {
-         char *restrict tmpdir;
-         tmpdir = (char *restrict)malloc(strlen(path)+strlen(de->d_name)+2);
-         sprintf(tmpdir, "%s%s", path, de->d_name);
-         rc2 = stat(tmpdir, &ts);
-         if (rc2 != 0) {
-            perror(tmpdir);
-         } else {
-            if (S_ISDIR(ts.st_mode)) {
-               strcat(tmpdir, "/");
-               DisplayAll(tmpdir);
-            } else {
-               rc |= ReadSetting(tmpdir+strlen(PROC_PATH));
-            }
-         }
-         free(tmpdir);
+      return -1;
+   }
+   if (!strcmp(path, PROC_PATH))   /* -a, before anything is printed */
+      setvbuf(stdout, obuf, _IOFBF, sizeof obuf);
+   /* the name of a setting starts after /proc/sys/ */
+   snprintf(name, sizeof name, "%s", path + strlen(PROC_PATH));
+   len = strlen(name);
+   return Parallel ? WalkParallel(dfd, name, len) : WalkDir(dfd, name, len, stdout);
+}
+
+
+/*
+ *     Squeeze each run of blanks to one space and drop them at the ends,
+ *     so "4096 87380 6291456" and the kernel's tab-separated form match
+ *
+ */
+static void SqueezeBlanks(char *restrict s) {
+   char *const start = s;
+   char *d = s;
+   bool blank = true;       /* drops the leading ones */
+
+   for (; *s; s++) {
+      if (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') {
+         if (!blank) *d++ = ' ';
+         blank = true;
+      } else {
+         *d++ = *s;
+         blank = false;
       }
-      closedir(dp);
    }
-   return rc;
+   if (d > start && d[-1] == ' ') d--;
+   *d = '\0';
+}
+
+/*
+ *     For -c: is the setting already 'value'?  No if it can't be read
+ *     back (write-only keys like vm.drop_caches), so those are written.
+ *
+ */
+static bool IsCurrent(const char *restrict path, const char *restrict value) {
+   char now[4096];
+   char want[4096];
+   ssize_t n;
+   int fd;
+
+   if (strlen(value) >= sizeof want)
+      return false;
+   fd = open(path, O_RDONLY|O_CLOEXEC);
+   if (fd == -1)
+      return false;
+   n = read(fd, now, sizeof now - 1);
+   close(fd);
+   if (n <= 0 || n == sizeof now - 1)
+      return false;
+   now[n] = '\0';
+   strcpy(want, value);
+   SqueezeBlanks(now);
+   SqueezeBlanks(want);
+   return !strcmp(now, want);
 }
 
 
@@ -259,7 +578,7 @@ static int DisplayAll(const char *restrict const path) {
  *     Write a sysctl setting 
  *
  */
-static int WriteSetting(const char *setting) {
+static int WriteSetting(const char *setting, FILE *restrict out, Tally *restrict tally) {
    int rc = 0;
    const char *name = setting;
    const char *value;
@@ -299,6 +618,13 @@ static int WriteSetting(const char *setting) {
    outname[equals-name] = 0;
    slashdot(outname,'/','.'); /* change / to . */
  
+   if (OnlyChanged && IsCurrent(tmpname, value)) {
+      tally->unchanged++;
+      free(tmpname);
+      free(outname);
+      return 0;
+   }
+
    fp = fopen(tmpname, "w");
 
    if (!fp) {
@@ -328,21 +654,25 @@ static int WriteSetting(const char *setting) {
          if (rc != 0) 
             fprintf(stderr, ERR_UNKNOWN_WRITING, strerror(errno), outname);
       }
+      if (rc==0)
+         tally->changed++;
       if (rc==0 && !Quiet) {
          if (NameOnly) {
-            fprintf(stdout, "%s\n", outname);
+            fprintf(out, "%s\n", outname);
          } else {
             if (PrintName) {
-               fprintf(stdout, "%s = %s\n", outname, value);
+               fprintf(out, "%s = %s\n", outname, value);
             } else {
                if (PrintNewline)
-                  fprintf(stdout, "%s\n", value);
+                  fprintf(out, "%s\n", value);
                else
-                  fprintf(stdout, "%s", value);
+                  fprintf(out, "%s", value);
             }
          }
       }
    }
+   if (rc != 0)
+      tally->failed++;
 
    free(tmpname);
    free(outname);
@@ -351,6 +681,80 @@ static int WriteSetting(const char *setting) {
 
 
 
+/*
+ *     For -j with -p: the settings under one name at the top (net, vm,
+ *     kernel ...), written in file order, a batch at a time for the pool
+ *
+ */
+typedef struct Batch {
+   char **settings;
+   char *buf;
+   size_t size;
+   Tally tally;
+   unsigned n;
+   int rc;
+} Batch;
+
+static size_t TopLen(const char *restrict setting) {
+   return strcspn(setting, "./=");
+}
+
+static void AddToBatch(Batch **restrict batches, unsigned *restrict n, const char *restrict setting) {
+   size_t len = TopLen(setting);
+   Batch *b;
+   unsigned i;
+
+   for (i = 0; i < *n; i++) {
+      const char *first = (*batches)[i].settings[0];
+      if (TopLen(first) == len && !strncmp(first, setting, len))
+         break;
+   }
+   if (i == *n) {
+      *batches = Realloc(*batches, (*n + 1) * sizeof **batches);
+      memset(&(*batches)[i], 0, sizeof **batches);
+      (*n)++;
+   }
+   b = &(*batches)[i];
+   b->settings = Realloc(b->settings, (b->n + 1) * sizeof *b->settings);
+   b->settings[b->n++] = strcpy(Realloc(NULL, strlen(setting) + 1), setting);
+}
+
+static void *WriteBatch(void *arg) {
+   Batch *restrict b = arg;
+   FILE *out = open_memstream(&b->buf, &b->size);
+   unsigned i;
+
+   for (i = 0; i < b->n; i++)
+      b->rc |= WriteSetting(b->settings[i], out ? out : stdout, &b->tally);
+   if (out)
+      fclose(out);
+   return NULL;
+}
+
+static int WriteBatches(Batch *restrict batches, unsigned n, Tally *restrict tally) {
+   int rc = 0;
+   unsigned i, j;
+
+   RunPool(batches, sizeof *batches, n, WriteBatch);
+   for (i = 0; i < n; i++) {
+      Batch *restrict b = &batches[i];
+      if (b->buf)
+         fwrite(b->buf, 1, b->size, stdout);
+      free(b->buf);
+      for (j = 0; j < b->n; j++)
+         free(b->settings[j]);
+      free(b->settings);
+      tally->changed   += b->tally.changed;
+      tally->unchanged += b->tally.unchanged;
+      tally->failed    += b->tally.failed;
+      rc |= b->rc;
+   }
+   free(batches);
+   return rc;
+}
+
+
+
 /*
  *     Preload the sysctl's from the conf file
  *           - we parse the file and then reform it (strip out whitespace)
@@ -364,6 +768,9 @@ static int Preload(const char *restrict const filename) {
    int n = 0;
    int rc = 0;
    char *name, *value;
+   Tally tally = { 0, 0, 0 };
+   Batch *batches = NULL;
+   unsigned nbatches = 0;
 
    fp = (filename[0]=='-' && !filename[1])
       ? stdin
@@ -404,10 +811,19 @@ static int Preload(const char *restrict const filename) {
 
       // should NameOnly affect this?
       sprintf(buffer, "%s=%s", name, value);
-      rc |= WriteSetting(buffer);
+      if (Parallel)
+         AddToBatch(&batches, &nbatches, buffer);
+      else
+         rc |= WriteSetting(buffer, stdout, &tally);
    }
 
    fclose(fp);
+   if (nbatches)
+      rc |= WriteBatches(batches, nbatches, &tally);
+   if (OnlyChanged) {
+      fflush(stdout);
+      fprintf(stderr, MSG_SUMMARY, tally.changed, tally.unchanged, tally.failed);
+   }
    return rc;
 }
 
@@ -423,6 +839,7 @@ int main(int argc, char *argv[]) {
    bool WriteMode = false;
    int ReturnCode = 0;
    const char *preloadfile = DEFAULT_PRELOAD;
+   Tally tally = { 0, 0, 0 };
 
    PrintName = true;
    PrintNewline = true;
@@ -479,6 +896,12 @@ int main(int argc, char *argv[]) {
 	 case 'q':
 	      Quiet = true;
 	   break;
+         case 'j':  // -a and -p share the top-level trees out to threads
+              Parallel = true;
+           break;
+         case 'c':  // -p and -w leave settings that already have the value
+              OnlyChanged = true;
+           break;
 	 case 'o':  // BSD: binary values too, 1st 16 bytes in hex
 	 case 'x':  // BSD: binary values too, whole thing in hex
 	      /* does nothing */ ;
@@ -504,7 +927,7 @@ int main(int argc, char *argv[]) {
             return Usage(me);
          SwitchesAllowed = false;
          if (WriteMode || index(*argv, '='))
-            ReturnCode = WriteSetting(*argv);
+            ReturnCode = WriteSetting(*argv, stdout, &tally);
          else
             ReturnCode = ReadSetting(*argv);
       }
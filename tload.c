@@ -11,6 +11,7 @@
  */
 #include "proc/version.h"
 #include "proc/sysinfo.h"
+#include "proc/interval.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <setjmp.h>
@@ -22,24 +23,19 @@
 #include <sys/ioctl.h>
 
 static char *screen;
+static char *marks;		/* for each row, '-' where a scale line is ('=' for two), else ' ' */
+static double marks_scale;	/* what marks was worked out for */
 
 static int nrows = 25;
 static int ncols = 80;
 static int scr_size;
 static int fd=1;
-static int dly=5;
+static double dly=5;
 static jmp_buf jb;
 
 extern int optind;
 extern char *optarg;
 
-static void alrm(int signo)
-{
-    (void)signo;
-    signal(SIGALRM, alrm);
-    alarm(dly);
-}
-
 static void setsize(int i)
 {
     struct winsize win;
@@ -57,7 +53,9 @@ static void setsize(int i)
     else
     	screen = (char *) realloc(screen, scr_size);
 
-    if (screen == NULL) {
+    marks = (char *) realloc(marks, nrows);
+    marks_scale = 0;
+    if (screen == NULL || marks == NULL) {
 	perror("");
 	exit(1);
     }
@@ -67,6 +65,22 @@ static void setsize(int i)
 	longjmp(jb, 0);
 }
 
+/* the scale lines only move when the scale or the size does */
+static void set_marks(double scale_fact)
+{
+    int i, row;
+
+    memset(marks, ' ', nrows);
+    for (i = 1; ; ++i) {
+	row = nrows - (i * scale_fact);
+	if (row < 0 || scale_fact <= 0)
+	    break;
+	if (row < nrows)		/* two on one row make a '=' */
+	    marks[row] = marks[row] == ' ' ? '-' : '=';
+    }
+    marks_scale = scale_fact;
+}
+
 int main(int argc, char **argv)
 {
     int lines, row, col=0;
@@ -74,12 +88,14 @@ int main(int argc, char **argv)
     double av[3];
     static double max_scale, scale_fact;
     char *scale_arg = NULL;
+    interval_t tick;
 
     while ((opt = getopt(argc, argv, "s:d:V")) != -1)
 	switch (opt) {
 	    case 's': scale_arg = optarg; break;
-	    case 'd': dly = atoi(optarg); break;
 	    case 'V': display_version(); exit(0); break;
+	    case 'd': dly = strtod(optarg, NULL); if (dly > 0) break;
+	    /* fall through */
 	    default:
 		printf("usage: tload [-V] [-d delay] [-s scale] [tty]\n");
 		exit(1);
@@ -101,9 +117,9 @@ int main(int argc, char **argv)
 
     scale_fact = max_scale;
 
+    interval_start(&tick, dly);
     setjmp(jb);
     col = 0;
-    alrm(0);
 
     while (1) {
 
@@ -112,30 +128,15 @@ int main(int argc, char **argv)
 
 	loadavg(&av[0], &av[1], &av[2]);
 
-    repeat:
-	lines = av[0] * scale_fact;
-	row = nrows-1;
+	while ((lines = av[0] * scale_fact) >= nrows)
+	    scale_fact /= 2.0;
+	if (scale_fact != marks_scale)
+	    set_marks(scale_fact);
 
-	while (--lines >= 0) {
-	    *(screen + row * ncols + col) = '*';
-	    if (--row < 0) {
-		scale_fact /= 2.0;
-		goto repeat;
-	    }
-	}
-	while (row >= 0)
-	    *(screen + row-- * ncols + col) = ' ';
-
-	for (i = 1; ; ++i) {
-	    char *p;
-	    row = nrows - (i * scale_fact);
-	    if (row < 0)
-		break;
-	    if (*(p = screen + row * ncols + col) == ' ')
-		*p = '-';
-	    else
-		*p = '=';
-	}
+	/* the bar is the bottom 'lines' rows; a scale line over it is '=' */
+	for (row = 0; row < nrows; row++)
+	    *(screen + row * ncols + col) = row < nrows - lines
+		? marks[row] : marks[row] == ' ' ? '*' : '=';
 
 	if (++col == ncols) {
 	    --col;
@@ -151,6 +152,6 @@ int main(int argc, char **argv)
 
 	write(fd, "\033[H", 3);
 	write(fd, screen, scr_size - 1);
-	pause();
+	interval_wait(&tick);
     }
 }
@@ -20,12 +20,14 @@
  * Changes by Albert Cahalan, 2002-2004.
  */
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <ctype.h>
 #include <curses.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -43,9 +45,13 @@
 #include <unistd.h>
 #include <values.h>
 
+#include "proc/alloc.h"
+#include "proc/cgroup.h"
+#include "proc/costs.h"
 #include "proc/devname.h"
 #include "proc/wchan.h"
 #include "proc/procps.h"
+#include "proc/procev.h"
 #include "proc/readproc.h"
 #include "proc/escape.h"
 #include "proc/sig.h"
@@ -54,6 +60,7 @@
 #include "proc/whattime.h"
 
 #include "top.h"
+#include "topring.h"
 
 /*######  Miscellaneous global stuff  ####################################*/
 
@@ -77,6 +84,11 @@ static unsigned page_to_kb_shift;
 
         /* SMP Irix/Solaris mode */
 static int  Cpu_tot;
+        /* NUMA nodes (always at least 1) and the node index of each cpu id */
+static int  Node_tot = 1;
+static int *Node_ids;
+static int *Cpu_node;
+static int  Cpu_node_siz;
 static double pcpu_max_value;  // usually 99.9, for %CPU display
         /* assume no IO-wait stats, overridden if linux 2.5.41 */
 static const char *States_fmts = STATES_line2x4;
@@ -85,6 +97,10 @@ static const char *States_fmts = STATES_line2x4;
 static pid_t Monpids [MONPIDMAX] = { 0 };
 static int   Monpidsidx = 0;
 
+        /* The live processes, from proc connector events, if we get them */
+static proclive_t *Live_procs;
+static int         Live_tried;
+
         /* A postponed error message */
 static char Msg_delayed [SMLBUFSIZ];
 static int  Msg_awaiting = 0;
@@ -143,10 +159,14 @@ static int   Cap_can_goto = 0;
 static char *Pseudo_scrn;
 static int   Pseudo_row, Pseudo_cols, Pseudo_size;
 #ifndef STDOUT_IOLBF
-        // less than stdout's normal buffer but with luck mostly '\n' anyway
-static char  Stdout_buf[2048];
+        // room for a whole frame, so that it goes out in one write
+static char  Stdout_buf[65536];
 #endif
 
+        // With '-r', frames go into this file rather than to a screen
+static const char *Ring_path;
+static ring_head  *Ring;
+
 
         /* ////////////////////////////////////////////////////////////// */
         /* Special Section: multiple windows/field groups  ---------------*/
@@ -162,6 +182,7 @@ static WIN_t Winstk [GROUPSMAX],
            and/or that are simply more efficiently handled as globals
            (first 2 persist beyond a single frame, changed infrequently) */
 static int       Frames_libflags;       // PROC_FILLxxx flags (0 = need new)
+static int       Frames_lazyflags;      // those put off until a row's shown
 //atic int       Frames_maxcmdln;       // the largest from the 4 windows
 static unsigned  Frame_maxtask;         // last known number of active tasks
                                         // ie. current 'size' of proc table
@@ -170,9 +191,15 @@ static unsigned  Frame_running,         // state categories for this frame
                  Frame_stopped,
                  Frame_zombied;
 static float     Frame_tscale;          // so we can '*' vs. '/' WHEN 'pcpu'
+static float     Frame_etime;           // seconds since the previous frame
+static unsigned  Frame_count;           // frames so far (for the cgroup view)
 static int       Frame_srtflg,          // the subject window's sort direction
                  Frame_ctimes,          // the subject window's ctimes flag
-                 Frame_cmdlin;          // the subject window's cmdlin flag
+                 Frame_cmdlin,          // the subject window's cmdlin flag
+                 Frame_smaps,           // pss & uss were read (not carried)
+                 Frame_threads;         // the proc_t's came from readtask
+static costs_t   Frame_costs;           // the last frame's, with '$' (hidden)
+static unsigned long long Frame_costns; //   and how long that frame took
         /* ////////////////////////////////////////////////////////////// */
 
 
@@ -240,13 +267,9 @@ static int sort_P_CMD (const proc_t **P, const proc_t **Q)
 
 SCB_NUM1(P_WCH, wchan)
 SCB_NUM1(P_FLG, flags)
-
-        /* ///////////////////////////////// special sort for prochlp() ! */
-static int sort_HST_t (const HST_t *P, const HST_t *Q)
-{
-   return P->pid - Q->pid;
-}
-
+SCB_NUM1(P_PSS, pss)
+SCB_NUM1(P_USS, uss)
+SCB_NUM1(P_SPS, swap_pss)
 
 /*######  Tiny useful routine(s)  ########################################*/
 
@@ -317,6 +340,114 @@ static const char *tg2 (int x, int y)
 }
 
 
+// One piece of a frame row, for puff_row: how many bytes it is and, in
+// *cells, how many columns it takes up.  Returns 0 for something we can't
+// vouch the width of (non-ASCII, which may be wide) or that moves the
+// cursor or erases (anything but SGR, charset shifts, '\n' and delays).
+static int row_token (const char *s, int *cells)
+{
+   int n;
+
+   *cells = 0;
+   if ((unsigned char)(*s - ' ') < 0x7f - ' ') {
+      if ('$' != *s || '<' != s[1]) {
+         *cells = 1;
+         return 1;
+      }
+      // a terminfo delay, which putp consumes
+      for (n = 2; s[n] && s[n] != '>'; n++)
+         if (!strchr("0123456789.*/", s[n])) {
+            *cells = 1;
+            return 1;
+         }
+      return s[n] ? n + 1 : 0;
+   }
+   if ('\n' == *s || '\016' == *s || '\017' == *s) return 1;
+   if ('\033' != *s) return 0;
+   if ('[' == s[1]) {
+      for (n = 2; (unsigned char)(s[n] - 0x20) < 0x20; n++) ;
+      return ('m' == s[n]) ? n + 1 : 0;
+   }
+   if ('(' == s[1] || ')' == s[1]) return s[2] ? 3 : 0;
+   return 0;
+}
+
+
+// Is it all plain text: one column a byte, no escapes and no delays?
+static int row_plain (const char *s, int n)
+{
+   while (n--) {
+      if ((unsigned char)(*s - ' ') >= 0x7f - ' ' || '$' == *s) return 0;
+      s++;
+   }
+   return 1;
+}
+
+
+// Write a changed frame row.  'old' is what the row was last frame.
+// Where the two agree at the front, only the escapes are sent (so the
+// colors come out right) and the cursor is moved past the text.  Where
+// they agree at the back too, and what's between is plain text of the
+// same width, the text at the back is left as it is on the screen.
+static void puff_row (const char *old, const char *str)
+{
+   char out[ROWBUFSIZ * 2];
+   const char *cuf;
+   int beg, end, oldlen, len, col, cells, n, o, t;
+
+   len = strlen(str);
+   oldlen = strlen(old);
+   for (beg = 0; beg < len && old[beg] == str[beg]; beg++) ;
+
+   for (n = col = o = 0; n < beg; n += t) {
+      if (!(t = row_token(str + n, &cells)) || n + t > beg) break;
+      if (cells) col += cells;
+      else {
+         if ('\n' == str[n]) col = 0;
+         memcpy(out + o, str + n, t);
+         o += t;
+      }
+   }
+   beg = n;
+   if (col < 8 || !parm_right_cursor) {
+      putp(str);                        // not worth moving the cursor for
+      return;
+   }
+   cuf = tparm(parm_right_cursor, col);
+   t = strlen(cuf);
+   memcpy(out + o, cuf, t);
+   o += t;
+
+   for (n = 0; n < len - beg && n < oldlen - beg && old[oldlen - 1 - n] == str[len - 1 - n]; n++) ;
+   end = len - n;
+   if (len != oldlen || !row_plain(str + beg, end - beg) || !row_plain(old + beg, end - beg))
+      end = len;
+   memcpy(out + o, str + beg, end - beg);
+   o += end - beg;
+
+   // past the change: the escapes again, but not a clear to the end of
+   // the line, which would now land short of the text left in place.  If
+   // there's something we can't tell the width of, all of it.
+   for (n = end; n < len; n += t)
+      if (!(t = row_token(str + n, &cells))) {
+         if (!*Cap_clr_eol || strncmp(str + n, Cap_clr_eol, strlen(Cap_clr_eol))) break;
+         t = strlen(Cap_clr_eol);
+      }
+   if (n < len) {
+      memcpy(out + o, str + end, len - end);
+      o += len - end;
+   } else for (n = end; n < len; n += t) {
+      if (!(t = row_token(str + n, &cells))) t = strlen(Cap_clr_eol);
+      else if (!cells) {
+         memcpy(out + o, str + n, t);
+         o += t;
+      }
+   }
+   out[o] = '\0';
+   putp(out);
+}
+
+
 /*######  Exit/Interrput routines  #######################################*/
 
 // The usual program end -- called only by functions in this section.
@@ -325,11 +456,14 @@ static void bye_bye (FILE *fp, int eno, const char *str)
 {
    if (!Batch)
       tcsetattr(STDIN_FILENO, TCSAFLUSH, &Savedtty);
-   putp(tg2(0, Screen_rows));
-   putp(Cap_curs_norm);
-   putp(Cap_smam);
-   putp("\n");
+   if (!Ring_path) {
+      putp(tg2(0, Screen_rows));
+      putp(Cap_curs_norm);
+      putp(Cap_smam);
+      putp("\n");
+   }
    fflush(stdout);
+   proclive_close(Live_procs);      // or the kernel goes on making events
 
 //#define ATEOJ_REPORT
 #ifdef ATEOJ_REPORT
@@ -749,6 +883,56 @@ static int get_int (const char *prompt)
 }
 
 
+        /*
+         * Integer to text, without the printf family: 'end' gets the '\0'
+         * and the digits go in backwards in front of it.  Returns where
+         * they start. */
+static char *num_rev (char *end, unsigned long num)
+{
+   *end = '\0';
+   do *--end = '0' + num % 10; while (num /= 10);
+   return end;
+}
+
+
+        /*
+         * The two digits of 'nn' (under 100) at 'buf', as "%02u" would. */
+static char *two_digits (char *buf, unsigned nn)
+{
+   *buf++ = '0' + nn / 10;
+   *buf++ = '0' + nn % 10;
+   return buf;
+}
+
+
+        /*
+         * A column of 'width' plus its leading space, with 'len' bytes of
+         * 'str' right justified in it, as " %*.*s" would -- though a number
+         * is never cut short, same as " %*u". */
+static void col_text (char *buf, int width, const char *str, int len)
+{
+   *buf++ = ' ';
+   if (len < width) {
+      memset(buf, ' ', width - len);
+      buf += width - len;
+   }
+   memcpy(buf, str, len);
+   buf[len] = '\0';
+}
+
+
+        /*
+         * The same for a number, as " %*u" or " %*d" would. */
+static void col_num (char *buf, int width, unsigned long num, int minus)
+{
+   char tmp[TNYBUFSIZ];
+   char *p = num_rev(tmp + sizeof(tmp) - 1, num);
+
+   if (minus) *--p = '-';
+   col_text(buf, width, p, tmp + sizeof(tmp) - 1 - p);
+}
+
+
         /*
          * Do some scaling stuff.
          * We'll interpret 'num' as one of the following types and
@@ -757,11 +941,11 @@ static int get_int (const char *prompt)
          *    SK_Kb (1) it's kilobytes
          *    SK_Mb (2) it's megabytes
          *    SK_Gb (3) it's gigabytes
-         *    SK_Tb (4) it's terabytes  */
+         *    SK_Tb (4) it's terabytes
+         * Each unit is 1024 of the last one, so it's all shifts -- the
+         * tenths get rounded the way "%.1f" would have (to even on a tie). */
 static const char *scale_num (unsigned long num, const int width, const unsigned type)
 {
-      /* kilobytes, megabytes, gigabytes, terabytes, duh! */
-   static double scale[] = { 1024.0, 1024.0*1024, 1024.0*1024*1024, 1024.0*1024*1024*1024, 0 };
       /* kilo, mega, giga, tera, none */
 #ifdef CASEUP_SCALE
    static char nextup[] =  { 'K', 'M', 'G', 'T', 0 };
@@ -769,20 +953,33 @@ static const char *scale_num (unsigned long num, const int width, const unsigned
    static char nextup[] =  { 'k', 'm', 'g', 't', 0 };
 #endif
    static char buf[TNYBUFSIZ];
-   double *dp;
-   char *up;
+   char *end = buf + sizeof(buf) - 1;
+   char *p, *up;
+   unsigned shift;
 
       /* try an unscaled version first... */
-   if (width >= snprintf(buf, sizeof(buf), "%lu", num)) return buf;
+   p = num_rev(end, num);
+   if (width >= end - p) return p;
 
       /* now try successively higher types until it fits */
-   for (up = nextup + type, dp = scale; *dp; ++dp, ++up) {
+   for (up = nextup + type, shift = 10; shift <= 40; shift += 10, ++up) {
+      unsigned long long tenths = (unsigned long long)num * 10;
+      unsigned long long half = 1ull << (shift - 1);
+      unsigned long long rem = tenths & ((half << 1) - 1);
+
+      tenths >>= shift;
+      if (rem > half || (rem == half && (tenths & 1))) ++tenths;
          /* the most accurate version */
-      if (width >= snprintf(buf, sizeof(buf), "%.1f%c", num / *dp, *up))
-         return buf;
+      end[-1] = *up;
+      end[-2] = '0' + tenths % 10;
+      p = num_rev(end - 3, tenths / 10);
+      end[-3] = '.';
+      if (width >= end - p) return p;
          /* the integer version */
-      if (width >= snprintf(buf, sizeof(buf), "%ld%c", (unsigned long)(num / *dp), *up))
-         return buf;
+      end[-1] = *up;
+      p = num_rev(end - 1, num >> shift);
+      end[-1] = *up;
+      if (width >= end - p) return p;
    }
       /* well shoot, this outta' fit... */
    return "?";
@@ -795,41 +992,61 @@ static const char *scale_num (unsigned long num, const int width, const unsigned
 static const char *scale_tics (TIC_t tics, const int width)
 {
 #ifdef CASEUP_SCALE
-#define HH "%uH"
-#define DD "%uD"
-#define WW "%uW"
+#define HH 'H'
+#define DD 'D'
+#define WW 'W'
 #else
-#define HH "%uh"
-#define DD "%ud"
-#define WW "%uw"
+#define HH 'h'
+#define DD 'd'
+#define WW 'w'
 #endif
    static char buf[TNYBUFSIZ];
+   char *end = buf + sizeof(buf) - 1;
+   char *p;
    unsigned long nt;    // narrow time, for speed on 32-bit
    unsigned cc;         // centiseconds
    unsigned nn;         // multi-purpose whatever
 
+   *end = '\0';
    nt  = (tics * 100ull) / Hertz;
    cc  = nt % 100;                              // centiseconds past second
    nt /= 100;                                   // total seconds
    nn  = nt % 60;                               // seconds past the minute
    nt /= 60;                                    // total minutes
-   if (width >= snprintf(buf, sizeof(buf), "%lu:%02u.%02u", nt, nn, cc))
-      return buf;
-   if (width >= snprintf(buf, sizeof buf, "%lu:%02u", nt, nn))
-      return buf;
+   p = num_rev(end - 6, nt);
+   if (width >= end - p) {                      // "%lu:%02u.%02u"
+      end[-6] = ':';
+      two_digits(end - 5, nn);
+      end[-3] = '.';
+      two_digits(end - 2, cc);
+      return p;
+   }
+   p = num_rev(end - 3, nt);
+   if (width >= end - p) {                      // "%lu:%02u"
+      end[-3] = ':';
+      two_digits(end - 2, nn);
+      return p;
+   }
    nn  = nt % 60;                               // minutes past the hour
    nt /= 60;                                    // total hours
-   if (width >= snprintf(buf, sizeof buf, "%lu,%02u", nt, nn))
-      return buf;
+   p = num_rev(end - 3, nt);
+   if (width >= end - p) {                      // "%lu,%02u"
+      end[-3] = ',';
+      two_digits(end - 2, nn);
+      return p;
+   }
    nn = nt;                                     // now also hours
-   if (width >= snprintf(buf, sizeof buf, HH, nn))
-      return buf;
+   p = num_rev(end - 1, nn);
+   end[-1] = HH;
+   if (width >= end - p) return p;
    nn /= 24;                                    // now days
-   if (width >= snprintf(buf, sizeof buf, DD, nn))
-      return buf;
+   p = num_rev(end - 1, nn);
+   end[-1] = DD;
+   if (width >= end - p) return p;
    nn /= 7;                                     // now weeks
-   if (width >= snprintf(buf, sizeof buf, WW, nn))
-      return buf;
+   p = num_rev(end - 1, nn);
+   end[-1] = WW;
+   if (width >= end - p) return p;
       // well shoot, this outta' fit...
    return "?";
 
@@ -912,50 +1129,73 @@ static void *alloc_r (void *q, unsigned numb)
 }
 
 
+        /*
+         * Parse up to 8 tics from a /proc/stat cpu line (just past the
+         * "cpu" or "cpuN"), returning how many were there */
+static int cpu_tics (char **b, CPU_t *cpu)
+{
+   TIC_t *const slot[] = { &cpu->u, &cpu->n, &cpu->s, &cpu->i, &cpu->w, &cpu->x, &cpu->y, &cpu->z };
+   char *p = *b, *e;
+   int num, got;
+
+   for (num = 0; num < 8; num++) {
+      *slot[num] = strtoull(p, &e, 10);
+      if (e == p) break;
+      p = e;
+   }
+   got = num;
+   // FIXME: can't tell by kernel version number which ones are missing
+   while (num < 8) *slot[num++] = 0;
+   *b = p;
+   return got;
+}
+
+
         /*
          * This guy's modeled on libproc's 'five_cpu_numbers' function except
          * we preserve all cpu data in our CPU_t array which is organized
          * as follows:
          *    cpus[0] thru cpus[n] == tics for each separate cpu
-         *    cpus[Cpu_tot]        == tics from the 1st /proc/stat line */
+         *    cpus[Cpu_tot]        == tics from the 1st /proc/stat line
+         *    cpus[Cpu_tot+1] on   == tics summed for each of Node_tot nodes
+         * The whole file is read at once into a buffer that grows as needed,
+         * then all the cpu lines are parsed in a single pass. */
 static CPU_t *cpus_refresh (CPU_t *cpus)
 {
-   static FILE *fp = NULL;
-   int i;
-   int num;
-   // enough for a /proc/stat CPU line (not the intr line)
-   char buf[SMLBUFSIZ];
+   static int fd = -1;
+   static char *buf;
+   static unsigned bufsiz = BIGBUFSIZ;
+   CPU_t *nodes;
+   char *b;
+   int i, k;
+   ssize_t num;
 
    /* by opening this file once, we'll avoid the hit on minor page faults
       (sorry Linux, but you'll have to close it for us) */
-   if (!fp) {
-      if (!(fp = fopen("/proc/stat", "r")))
+   if (fd < 0) {
+      if ((fd = open("/proc/stat", O_RDONLY)) < 0)
          std_err(fmtmk("Failed /proc/stat open: %s", strerror(errno)));
-      /* note: we allocate one more CPU_t than Cpu_tot so that the last slot
-               can hold tics representing the /proc/stat cpu summary (the first
-               line read) -- that slot supports our View_CPUSUM toggle */
-      cpus = alloc_c((1 + Cpu_tot) * sizeof(CPU_t));
-   }
-   rewind(fp);
-   fflush(fp);
-
-   // first value the last slot with the cpu summary line
-   if (!fgets(buf, sizeof(buf), fp)) std_err("failed /proc/stat read");
-   cpus[Cpu_tot].x = 0;  // FIXME: can't tell by kernel version number
-   cpus[Cpu_tot].y = 0;  // FIXME: can't tell by kernel version number
-   cpus[Cpu_tot].z = 0;  // FIXME: can't tell by kernel version number
-   num = sscanf(buf, "cpu %Lu %Lu %Lu %Lu %Lu %Lu %Lu %Lu",
-      &cpus[Cpu_tot].u,
-      &cpus[Cpu_tot].n,
-      &cpus[Cpu_tot].s,
-      &cpus[Cpu_tot].i,
-      &cpus[Cpu_tot].w,
-      &cpus[Cpu_tot].x,
-      &cpus[Cpu_tot].y,
-      &cpus[Cpu_tot].z
-   );
-   if (num < 4)
-         std_err("failed /proc/stat read");
+      /* note: we allocate one more CPU_t than Cpu_tot so that the slot after
+               the cpus can hold tics representing the /proc/stat cpu summary
+               (the first line read) -- that slot supports our View_CPUSUM
+               toggle, while the per node slots after it support View_NODSUM */
+      cpus = alloc_c((1 + Cpu_tot + Node_tot) * sizeof(CPU_t));
+      buf = alloc_c(bufsiz);
+   }
+   // a read that fills the buffer may have been cut short, so grow it
+   while ((num = pread(fd, buf, bufsiz - 1, 0)) >= (ssize_t)bufsiz - 1) {
+      bufsiz *= 2;
+      buf = alloc_r(buf, bufsiz);
+   }
+   if (num < 0) std_err("failed /proc/stat read");
+   buf[num] = '\0';
+
+   // first value the summary slot with the cpu summary line
+   b = buf;
+   if (strncmp(b, "cpu ", 4)) std_err("failed /proc/stat read");
+   b += 3;
+   if (cpu_tics(&b, &cpus[Cpu_tot]) < 4)
+      std_err("failed /proc/stat read");
 
    // and just in case we're 2.2.xx compiled without SMP support...
    if (Cpu_tot == 1) {
@@ -963,23 +1203,197 @@ static CPU_t *cpus_refresh (CPU_t *cpus)
       memcpy(cpus, &cpus[1], sizeof(CPU_t));
    }
 
-   // now value each separate cpu's tics
+   // now value each separate cpu's tics, on the lines that follow
    for (i = 0; 1 < Cpu_tot && i < Cpu_tot; i++) {
-      if (!fgets(buf, sizeof(buf), fp)) std_err("failed /proc/stat read");
-      cpus[i].x = 0;  // FIXME: can't tell by kernel version number
-      cpus[i].y = 0;  // FIXME: can't tell by kernel version number
-      cpus[i].z = 0;  // FIXME: can't tell by kernel version number
-      num = sscanf(buf, "cpu%u %Lu %Lu %Lu %Lu %Lu %Lu %Lu %Lu",
-         &cpus[i].id,
-         &cpus[i].u, &cpus[i].n, &cpus[i].s, &cpus[i].i, &cpus[i].w, &cpus[i].x, &cpus[i].y, &cpus[i].z
-      );
-      if (num < 4)
-            std_err("failed /proc/stat read");
+      if (!(b = strchr(b, '\n')) || strncmp(++b, "cpu", 3) || !isdigit(b[3]))
+         std_err("failed /proc/stat read");
+      cpus[i].id = strtoul(b + 3, &b, 10);
+      if (cpu_tics(&b, &cpus[i]) < 4)
+         std_err("failed /proc/stat read");
+   }
+
+   // lastly, sum the cpus of each node (a single node is just the summary)
+   nodes = &cpus[Cpu_tot + 1];
+   if (Node_tot == 1) {
+      CPU_t *sum = &cpus[Cpu_tot];
+      nodes->u = sum->u; nodes->n = sum->n; nodes->s = sum->s; nodes->i = sum->i;
+      nodes->w = sum->w; nodes->x = sum->x; nodes->y = sum->y; nodes->z = sum->z;
+      return cpus;
+   }
+   for (k = 0; k < Node_tot; k++) {
+      nodes[k].u = nodes[k].n = nodes[k].s = nodes[k].i = 0;
+      nodes[k].w = nodes[k].x = nodes[k].y = nodes[k].z = 0;
+   }
+   for (i = 0; i < Cpu_tot; i++) {
+      CPU_t *cpu = &cpus[i];
+      CPU_t *node;
+      if (cpu->id >= (unsigned)Cpu_node_siz || Cpu_node[cpu->id] < 0) continue;
+      node = &nodes[Cpu_node[cpu->id]];
+      node->u += cpu->u; node->n += cpu->n; node->s += cpu->s; node->i += cpu->i;
+      node->w += cpu->w; node->x += cpu->x; node->y += cpu->y; node->z += cpu->z;
    }
    return cpus;
 }
 
 
+        /*
+         * Learn which cpus belong to which NUMA node, from sysfs.  Without
+         * that (not NUMA, or no sysfs) everything is node 0. */
+static void nodes_init (void)
+{
+   struct dirent **ents;
+   char path[OURPATHSZ], list[BIGBUFSIZ];
+   unsigned node, lo, hi;
+   int n, e, i;
+   char *p;
+   FILE *fp;
+
+   // versionsort, so that node10 comes after node9
+   if ((n = scandir("/sys/devices/system/node", &ents, NULL, versionsort)) < 0)
+      return;
+   Node_tot = 0;
+   for (e = 0; e < n; e++) {
+      if (sscanf(ents[e]->d_name, "node%u", &node) != 1) continue;
+      snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", ents[e]->d_name);
+      if (!(fp = fopen(path, "r"))) continue;
+      p = fgets(list, sizeof(list), fp);
+      fclose(fp);
+      if (!p || !isdigit(*p)) continue;   // memory-only node
+      // the list looks like "0-7,16-23"
+      while (isdigit(*p)) {
+         lo = hi = strtoul(p, &p, 10);
+         if (*p == '-') hi = strtoul(p + 1, &p, 10);
+         if (hi >= (unsigned)Cpu_node_siz) {
+            i = Cpu_node_siz;
+            Cpu_node_siz = hi + 1;
+            Cpu_node = alloc_r(Cpu_node, Cpu_node_siz * sizeof(int));
+            while (i < Cpu_node_siz) Cpu_node[i++] = -1;
+         }
+         while (lo <= hi) Cpu_node[lo++] = Node_tot;
+         if (*p == ',') ++p;
+      }
+      Node_ids = alloc_r(Node_ids, (Node_tot + 1) * sizeof(int));
+      Node_ids[Node_tot++] = node;
+   }
+   for (e = 0; e < n; e++) free(ents[e]);
+   free(ents);
+   if (!Node_tot) Node_tot = 1;
+}
+
+
+        /*
+         * The previous and current frame's HST_t's are each indexed by a
+         * hash table of chain heads, keyed on the tid, so that prochlp can
+         * find last frame's tics for a task in constant time.  The tables
+         * just swap roles each frame, like the HST_t arrays they index. */
+static HST_t *Hist_sav, *Hist_new;
+static int *Hhash_sav, *Hhash_new;
+static unsigned Hhash_siz;              // power of 2, at least the HST_t's
+#define HHASH(pid)  ((unsigned)(pid) & (Hhash_siz - 1))
+
+static inline const HST_t *hist_get (const HST_t *hist, int pid)
+{
+   int i = Hhash_sav[HHASH(pid)];
+
+   while (i >= 0) {
+      if (hist[i].pid == pid) return &hist[i];
+      i = hist[i].lnk;
+   }
+   return NULL;
+}
+
+static inline void hist_put (int *hash, HST_t *hist, int idx)
+{
+   unsigned h = HHASH(hist[idx].pid);
+
+   hist[idx].lnk = hash[h];
+   hash[h] = idx;
+}
+
+        /*
+         * This frame's record, for what's only worked out once a task is
+         * to be displayed (its cmdline) and then kept for the next frame. */
+static inline HST_t *hist_cur (int pid)
+{
+   int i = Hhash_new[HHASH(pid)];
+
+   while (i >= 0) {
+      if (Hist_new[i].pid == pid) return &Hist_new[i];
+      i = Hist_new[i].lnk;
+   }
+   return NULL;
+}
+
+static void hist_rehash (int *hash, HST_t *hist, unsigned n)
+{
+   unsigned i;
+
+   memset(hash, 0xff, Hhash_siz * sizeof(int));   // all -1
+   for (i = 0; i < n; i++) hist_put(hash, hist, i);
+}
+
+
+        /*
+         * Only the totals go in an HST_t -- a rate comes from the previous
+         * frame's record when (and if) its task is displayed or sorted. */
+static proc_t  *Cg_rows;                // the cgroup view's rows, see cgview_make
+static unsigned Cg_nrows;
+
+static unsigned long io_rate (const proc_t *p)
+{
+   const HST_t *ptr;
+   unsigned long long io = p->read_bytes + p->write_bytes;
+
+   // a cgroup's row has its tasks' rates, already added up
+   if (unlikely(p >= Cg_rows && p < Cg_rows + Cg_nrows)) return (unsigned long)p->rchar;
+   ptr = hist_get(Hist_sav, p->tid);
+   if (!ptr || io < ptr->io || Frame_etime <= 0.0f) return 0;
+   return (unsigned long)((float)((io - ptr->io) >> 10) / Frame_etime);
+}
+
+        /*
+         * A task's command line comes from its HST_t, which has kept it
+         * since the frame it was first displayed (or sorted) -- rather
+         * than from reading /proc/#/cmdline for every task every frame. */
+static void cmdline_fill (proc_t *p)
+{
+   HST_t *ptr;
+
+   if (unlikely(p >= Cg_rows && p < Cg_rows + Cg_nrows)) return;
+   if (!(ptr = hist_cur(p->tid))) return;
+   if (!ptr->cmdread) {
+      ptr->cmdline = read_cmdline_vec(p->tid);
+      ptr->cmdread = 1;
+   }
+   p->cmdline = ptr->cmdline;
+}
+
+        /*
+         * The second half of a task's refresh, for just the rows shown:
+         * what reframewins found only the columns need (not the sort, the
+         * selection or the summary), and only once they're known to be
+         * among the lucky few.  Any window showing the task first does it. */
+static void procs_fill (proc_t *p)
+{
+   HST_t *ptr;
+
+   if (!Frames_lazyflags) return;
+   if (unlikely(p >= Cg_rows && p < Cg_rows + Cg_nrows)) return;
+   if (!(ptr = hist_cur(p->tid)) || ptr->filled) return;
+   ptr->filled = 1;
+   fillproc(p, Frames_lazyflags | PROC_CACHEFD, Frame_threads);
+}
+
+static int sort_P_IOR (const proc_t **P, const proc_t **Q)
+{
+   unsigned long p = io_rate(*P), q = io_rate(*Q);
+
+   if (        p < q  ) return SORT_lt;
+   if (likely( p > q )) return SORT_gt;
+   return SORT_eq;
+}
+
+
         /*
          * Refresh procs *Helper* function to eliminate yet one more need
          * to loop through our darn proc_t table.  He's responsible for:
@@ -989,8 +1403,6 @@ static CPU_t *cpus_refresh (CPU_t *cpus)
          *    4) establishing the total number tasks for this frame */
 static void prochlp (proc_t *this)
 {
-   static HST_t    *hist_sav = NULL;
-   static HST_t    *hist_new = NULL;
    static unsigned  hist_siz = 0;       // number of structs
    static unsigned  maxt_sav;           // prior frame's max tasks
    TIC_t tics;
@@ -1000,6 +1412,7 @@ static void prochlp (proc_t *this)
       struct timeval timev;
       struct timezone timez;
       HST_t *hist_tmp;
+      int *hash_tmp;
       float et;
 
       gettimeofday(&timev, &timez);
@@ -1007,18 +1420,31 @@ static void prochlp (proc_t *this)
          + (float)(timev.tv_usec - oldtimev.tv_usec) / 1000000.0;
       oldtimev.tv_sec = timev.tv_sec;
       oldtimev.tv_usec = timev.tv_usec;
+      Frame_etime = et;
+      Frame_count++;
 
       // if in Solaris mode, adjust our scaling for all cpus
       Frame_tscale = 100.0f / ((float)Hertz * (float)et * (Rc.mode_irixps ? 1 : Cpu_tot));
+      // command lines the frame just done didn't carry forward belong
+      // to tasks now gone (or exec'd), and their HST_t's get reused
+      while (maxt_sav--) {
+         const HST_t *old = &Hist_sav[maxt_sav];
+         const HST_t *now;
+         if (!old->cmdread || !old->cmdline) continue;
+         now = hist_cur(old->pid);
+         if (!now || now->cmdline != old->cmdline) free(old->cmdline[0]);
+      }
       maxt_sav = Frame_maxtask;
       Frame_maxtask = Frame_running = Frame_sleepin = Frame_stopped = Frame_zombied = 0;
 
       // reuse memory each time around
-      hist_tmp = hist_sav;
-      hist_sav = hist_new;
-      hist_new = hist_tmp;
-      // prep for our binary search by sorting the last frame's HST_t's
-      qsort(hist_sav, maxt_sav, sizeof(HST_t), (QFP_t)sort_HST_t);
+      hist_tmp = Hist_sav;
+      Hist_sav = Hist_new;
+      Hist_new = hist_tmp;
+      hash_tmp = Hhash_sav;
+      Hhash_sav = Hhash_new;
+      Hhash_new = hash_tmp;
+      if (Hhash_new) memset(Hhash_new, 0xff, Hhash_siz * sizeof(int));
       return;
    }
 
@@ -1040,42 +1466,51 @@ static void prochlp (proc_t *this)
 
    if (unlikely(Frame_maxtask+1 >= hist_siz)) {
       hist_siz = hist_siz * 5 / 4 + 100;  // grow by at least 25%
-      hist_sav = alloc_r(hist_sav, sizeof(HST_t) * hist_siz);
-      hist_new = alloc_r(hist_new, sizeof(HST_t) * hist_siz);
+      Hist_sav = alloc_r(Hist_sav, sizeof(HST_t) * hist_siz);
+      Hist_new = alloc_r(Hist_new, sizeof(HST_t) * hist_siz);
+      // keep the chains short: at least as many buckets as HST_t's
+      if (Hhash_siz < hist_siz) {
+         while (Hhash_siz < hist_siz) Hhash_siz = Hhash_siz ? Hhash_siz * 2 : 1024;
+         Hhash_sav = alloc_r(Hhash_sav, sizeof(int) * Hhash_siz);
+         Hhash_new = alloc_r(Hhash_new, sizeof(int) * Hhash_siz);
+         hist_rehash(Hhash_sav, Hist_sav, maxt_sav);
+         hist_rehash(Hhash_new, Hist_new, Frame_maxtask);
+      }
    }
    /* calculate time in this process; the sum of user time (utime) and
       system time (stime) -- but PLEASE dont waste time and effort on
       calcs and saves that go unused, like the old top! */
-   hist_new[Frame_maxtask].pid  = this->tid;
-   hist_new[Frame_maxtask].tics = tics = (this->utime + this->stime);
+   Hist_new[Frame_maxtask].pid  = this->tid;
+   Hist_new[Frame_maxtask].tics = tics = (this->utime + this->stime);
+   Hist_new[Frame_maxtask].io   = this->read_bytes + this->write_bytes;
 
-#if 0
-{  int i;
-   int lo = 0;
-   int hi = maxt_sav - 1;
-
-   // find matching entry from previous frame and make ticks elapsed
-   while (lo <= hi) {
-      i = (lo + hi) / 2;
-      if (this->tid < hist_sav[i].pid)
-         hi = i - 1;
-      else if (likely(this->tid > hist_sav[i].pid))
-         lo = i + 1;
-      else {
-         tics -= hist_sav[i].tics;
-         break;
-      }
-   }
-}
-#else
+   hist_put(Hhash_new, Hist_new, Frame_maxtask);
 {
-   HST_t tmp;
-   const HST_t *ptr;
-   tmp.pid = this->tid;
-   ptr = bsearch(&tmp, hist_sav, maxt_sav, sizeof tmp, sort_HST_t);
-   if(ptr) tics -= ptr->tics;
+   const HST_t *ptr = hist_get(Hist_sav, this->tid);
+   if (ptr) tics -= ptr->tics;
+   // between smaps reads, a task keeps the pss & uss it had last time
+   if (!Frame_smaps) {
+      this->pss      = ptr ? ptr->pss : 0;
+      this->uss      = ptr ? ptr->uss : 0;
+      this->swap_pss = ptr ? ptr->swap_pss : 0;
+   }
+   Hist_new[Frame_maxtask].pss      = this->pss;
+   Hist_new[Frame_maxtask].uss      = this->uss;
+   Hist_new[Frame_maxtask].swap_pss = this->swap_pss;
+   // the same tid started at the same time is the same task, and until
+   // an exec changes its name it has the same command line
+   Hist_new[Frame_maxtask].start_time = this->start_time;
+   memcpy(Hist_new[Frame_maxtask].cmd, this->cmd, sizeof this->cmd);
+   if (ptr && ptr->cmdread && ptr->start_time == this->start_time
+   && !strcmp(ptr->cmd, this->cmd)) {
+      Hist_new[Frame_maxtask].cmdline = ptr->cmdline;
+      Hist_new[Frame_maxtask].cmdread = 1;
+   } else {
+      Hist_new[Frame_maxtask].cmdline = NULL;
+      Hist_new[Frame_maxtask].cmdread = 0;
+   }
+   Hist_new[Frame_maxtask].filled = 0;
 }
-#endif
 
    // we're just saving elapsed tics, to be converted into %cpu if
    // this task wins it's displayable screen row lottery... */
@@ -1098,29 +1533,37 @@ static proc_t **procs_refresh (proc_t **table, int flags)
    proc_t *ptsk = (proc_t *)-1;         // first time, Force: (ii)
    unsigned curmax = 0;                 // every time  (jeeze)
    PROCTAB* PT;
-   static int show_threads_was_enabled = 0; // optimization
 
    prochlp(NULL);                       // prep for a new frame
+   // keep the per-task /proc files open from one frame to the next
+   flags |= PROC_CACHEFD;
+   // smaps is expensive enough that, with a short delay, reading it could
+   // be most of what top does -- so just now and then
+   if (flags & PROC_FILLSMAPS) {
+      static time_t smaps_last;
+      time_t now = time(NULL);
+      if (now - smaps_last < SMAPS_SECS) flags &= ~PROC_FILLSMAPS;
+      else smaps_last = now;
+   }
+   Frame_smaps = !!(flags & PROC_FILLSMAPS);
+   Frame_threads = CHKw(Curwin, Show_THREADS);
    if (Monpidsidx)
       PT = openproc(flags, Monpids);
-   else
-      PT = openproc(flags);
+   else {
+      // with fork and exit events, no need to read all of /proc for pids
+      if (!Live_tried) {
+         Live_procs = proclive_open();
+         Live_tried = 1;
+      }
+      if (Live_procs)
+         PT = openproc(flags | PROC_PID, proclive_pids(Live_procs));
+      else
+         PT = openproc(flags);
+   }
 
    // i) Allocated Chunks:  *Existing* table;  refresh + reuse
    if (!(CHKw(Curwin, Show_THREADS))) {
       while (curmax < savmax) {
-         if (table[curmax]->cmdline) {
-            unsigned idx;
-            // Skip if Show_THREADS was never enabled
-            if (show_threads_was_enabled) {
-               for (idx = curmax + 1; idx < savmax; idx++) {
-                  if (table[idx]->cmdline == table[curmax]->cmdline)
-                     table[idx]->cmdline = NULL;
-               }
-            }
-            free(*table[curmax]->cmdline);
-            table[curmax]->cmdline = NULL;
-         }
          if (unlikely(!(ptsk = readproc(PT, table[curmax])))) break;
          prochlp(ptsk);                    // tally & complete this proc_t
          ++curmax;
@@ -1130,19 +1573,7 @@ static proc_t **procs_refresh (proc_t **table, int flags)
       while (curmax < savmax) {
          proc_t *ttsk;
          if (unlikely(!(ptsk = readproc(PT, NULL)))) break;
-         show_threads_was_enabled = 1;
          while (curmax < savmax) {
-            unsigned idx;
-            if (table[curmax]->cmdline) {
-               // threads share the same cmdline storage.  'table' is
-               // qsort()ed, so must look through the rest of the table.
-               for (idx = curmax + 1; idx < savmax; idx++) {
-                  if (table[idx]->cmdline == table[curmax]->cmdline)
-                     table[idx]->cmdline = NULL;
-               }
-               free(*table[curmax]->cmdline);  // only free once
-               table[curmax]->cmdline = NULL;
-            }
             if (!(ttsk = readtask(PT, ptsk, table[curmax]))) break;
             prochlp(ttsk);
             ++curmax;
@@ -1167,7 +1598,6 @@ static proc_t **procs_refresh (proc_t **table, int flags)
       while (ptsk) {
          proc_t *ttsk;
          if (likely(ptsk = readproc(PT, NULL))) {
-            show_threads_was_enabled = 1;
             while (1) {
                table = alloc_r(table, (curmax + 1) * PTRsz);
                if (!(ttsk = readtask(PT, ptsk, NULL))) break;
@@ -1203,8 +1633,10 @@ static proc_t **procs_refresh (proc_t **table, int flags)
 // (own identifiers as documentation and protection against changes)
 #define L_stat     PROC_FILLSTAT
 #define L_statm    PROC_FILLMEM
+#define L_smaps    PROC_FILLSMAPS
+#define L_io       PROC_FILLIO
 #define L_status   PROC_FILLSTATUS
-#define L_CMDLINE  L_EITHER | PROC_FILLARG
+#define L_CMDLINE  L_EITHER          // the cmdline itself: see cmdline_fill
 #define L_EUSER    PROC_FILLUSR
 #define L_RUSER    L_status | PROC_FILLUSR
 #define L_GROUP    L_status | PROC_FILLGRP
@@ -1257,6 +1689,11 @@ static FLD_t Fieldstab[] = {
    { "YyUu", " WCHAN    ",  " %-9.9s",  -1,    -1, SF(WCH), "Sleeping in Function", L_stat   },
    // next entry's special: the 0's will be replaced with '.'!
    { "ZzZz", " Flags   ",   " %08lx",   -1,    -1, SF(FLG), "Task Flags <sched.h>", L_stat   },
+   // these came after the letters ran out, and the old formats never had them
+   { "[{..", "  PSS",       " %4.4s",    4, SK_Kb, SF(PSS), "Prop. Set Size (kb)",  L_smaps  },
+   { "\\|..", "  USS",       " %4.4s",    4, SK_Kb, SF(USS), "Unique Set Size (kb)", L_smaps  },
+   { "]}..", " SPSS",       " %4.4s",    4, SK_Kb, SF(SPS), "Prop. Swap Size (kb)", L_smaps  },
+   { "^~..", " IO/s",       " %4.4s",    4, SK_Kb, SF(IOR), "I/O rate (kb/s)",      L_io     },
 #if 0
    { "..Qq", "   A",        " %4.4s",    4, SK_no, SF(PID), "Accessed Page count",  L_stat   },
    { "..Nn", "  TRS",       " %4.4s",    4, SK_Kb, SF(PID), "Code in memory (kb)",  L_stat   },
@@ -1403,7 +1840,8 @@ static int rc_read_new (const char *const buf, RCF_t *rc) {
       cnt = sscanf(cp, "%3s\tfieldscur=%31s\n", ptr->winname, ptr->fieldscur);
       if (cnt != 2) return 5+100*i;  // OK to have less than 4 windows
       if (WINNAMSIZ <= strlen(ptr->winname)) return -6;
-      if (strlen(DEF_FIELDS) != strlen(ptr->fieldscur)) return -7;
+      // older tops had fewer fields: confighlp will add the new ones
+      if (strlen(DEF_FIELDS) < strlen(ptr->fieldscur)) return -7;
       cp = strchr(cp, '\n');
       if (!cp++) return -(8+100*i);
 
@@ -1609,6 +2047,7 @@ static void before (char *me)
 
       /* establish cpu particulars -- even bigger! */
    Cpu_tot = smp_num_cpus;
+   nodes_init();
    if (linux_version_code > LINUX_VERSION(2, 5, 41))
       States_fmts = STATES_line2x5;
    if (linux_version_code >= LINUX_VERSION(2, 6, 0))  // grrr... only some 2.6.0-testX :-(
@@ -1626,6 +2065,14 @@ static void before (char *me)
 
    pcpu_max_value = 99.9;
 
+      /* libproc keeps 3 files open per task between frames, if it can */
+   {  struct rlimit rl;
+      if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max) {
+         rl.rlim_cur = rl.rlim_max;
+         setrlimit(RLIMIT_NOFILE, &rl);
+      }
+   }
+
    Fieldstab[P_CPN].head = " P";
    Fieldstab[P_CPN].fmts = " %1u";
    if(smp_num_cpus>9){
@@ -1673,12 +2120,12 @@ static void confighlp (char *fields) {
    for (;;) {
       c = *cp++;
       if (!c) break;
-      if(isupper(c)) upper[c&0x1f]++;
-      else           lower[c&0x1f]++;
+      if(FLDon(c)) upper[c&0x1f]++;
+      else         lower[c&0x1f]++;
    }
 
    c = 'a';
-   while (c <= 'z') {
+   while (FLDoff(c)) {
       if (upper[c&0x1f] && lower[c&0x1f]) {
          lower[c&0x1f] = 0;             // got both, so wipe out unseen column
          for (;;) {
@@ -1694,7 +2141,7 @@ static void confighlp (char *fields) {
       }
       while (upper[c&0x1f] > 1) {               // got too many A..Z
          upper[c&0x1f]--;
-         cp = strchr(fields, toupper(c));
+         cp = strchr(fields, c - 'a' + 'A');
          memmove(cp, cp+1, strlen(cp));
       }
       if (!upper[c&0x1f] && !lower[c&0x1f]) {   // both missing
@@ -1812,7 +2259,7 @@ static void parse_args (char **args)
       .  bunched args are actually handled properly and none are ignored
       .  we tolerate NO whitespace and NO switches -- maybe too tolerant? */
    static const char usage[] =
-      " -hv | -bcisSH -d delay -n iterations [-u user | -U user] -p pid [,pid ...]";
+      " -hv | -bcisSH -d delay -n iterations [-u user | -U user] -p pid [,pid ...] -r file";
    float tmp_delay = MAXFLOAT;
    char *p;
 
@@ -1874,6 +2321,14 @@ static void parse_args (char **args)
                   cp = p;
                } while (*cp);
                break;
+            case 'r':
+               if (cp[1]) ++cp;
+               else if (*args) cp = *args++;
+               else std_err("-r requires argument");
+               Ring_path = cp;
+               Batch = 1;
+               cp += strlen(cp);
+               break;
             case 's':
                Secure_mode = 1;
                break;
@@ -1981,7 +2436,7 @@ static void display_fields (const char *fields, const char *xtra)
    putp(Curwin->cap_bold);
    for (i = 0; fields[i]; ++i) {
       const FLD_t *f = ft_get_ptr(FT_NEW_fmt, fields[i]);
-      int b = isupper(fields[i]);
+      int b = FLDon(fields[i]);
 
       if (!f) continue;                 // hey, should be std_err!
       for (p = f->head; ' ' == *p; ++p) // advance past any leading spaces
@@ -2029,10 +2484,10 @@ static void fields_reorder (void)
          , Cap_home, Curwin->rc.fieldscur, Curwin->grpname, prompt));
       chin(0, &c, 1);
       if (!ft_get_ptr(FT_NEW_fmt, c)) break;
-      i = toupper(c) - 'A';
+      i = FLDidx(c);
       if (((p = strchr(Curwin->rc.fieldscur, i + 'A')))
       || ((p = strchr(Curwin->rc.fieldscur, i + 'a')))) {
-         if (isupper(c)) p--;
+         if (FLDon(c)) p--;
          if (('\0' != p[1]) && (p >= Curwin->rc.fieldscur)) {
             c    = p[0];
             p[0] = p[1];
@@ -2058,13 +2513,13 @@ static void fields_sort (void)
    putp(Cap_curs_huge);
    for (;;) {
       p  = phoney + i;
-      *p = toupper(*p);
+      *p = i + 'A';
       display_fields(phoney, SORT_xtra);
       show_special(1, fmtmk(SORT_fields, Cap_home, *p, Curwin->grpname, prompt));
       chin(0, &c, 1);
       if (!ft_get_ptr(FT_NEW_fmt, c)) break;
-      i = toupper(c) - 'A';
-      *p = tolower(*p);
+      *p = i + 'a';
+      i = FLDidx(c);
       x = i;
    }
    if ((p = strchr(Curwin->rc.fieldscur, x + 'a')))
@@ -2089,7 +2544,7 @@ static void fields_toggle (void)
       show_special(1, fmtmk(FIELDS_current, Cap_home, Curwin->rc.fieldscur, Curwin->grpname, prompt));
       chin(0, &c, 1);
       if (!ft_get_ptr(FT_NEW_fmt, c)) break;
-      i = toupper(c) - 'A';
+      i = FLDidx(c);
       if ((p = strchr(Curwin->rc.fieldscur, i + 'A')))
          *p = i + 'a';
       else if ((p = strchr(Curwin->rc.fieldscur, i + 'a')))
@@ -2110,7 +2565,7 @@ static void reframewins (void)
    WIN_t *w;
    char *s;
    const char *h;
-   int i, needpsdb = 0;
+   int i, needpsdb = 0, eager = 0;
 
 // Frames_libflags = 0;  // should be called only when it's zero
 // Frames_maxcmdln = 0;  // to become largest from up to 4 windows, if visible
@@ -2119,7 +2574,7 @@ static void reframewins (void)
       if (!Rc.mode_altscr || CHKw(w, VISIBLE_tsk)) {
          // build window's procflags array and establish a tentative maxpflgs
          for (i = 0, w->maxpflgs = 0; w->rc.fieldscur[i]; i++) {
-            if (isupper(w->rc.fieldscur[i]))
+            if (FLDon(w->rc.fieldscur[i]))
                w->procflags[w->maxpflgs++] = w->rc.fieldscur[i] - 'A';
          }
 
@@ -2151,7 +2606,8 @@ static void reframewins (void)
             h = Fieldstab[w->procflags[i]].head;
             if (P_WCH == w->procflags[i]) needpsdb = 1;
             if (P_CMD == w->procflags[i]) {
-               s = scat(s, fmtmk(Fieldstab[P_CMD].fmts+advance, w->maxcmdln, w->maxcmdln, "COMMAND"/*h*/  ));
+               s = scat(s, fmtmk(Fieldstab[P_CMD].fmts+advance, w->maxcmdln, w->maxcmdln,
+                  CHKw(w, Show_CGROUP) ? "CGROUP" : "COMMAND"/*h*/  ));
                if (CHKw(w, Show_CMDLIN)) {
                   Frames_libflags |= L_CMDLINE;
 //                if (w->maxcmdln > Frames_maxcmdln) Frames_maxcmdln = w->maxcmdln;
@@ -2161,6 +2617,11 @@ static void reframewins (void)
             Frames_libflags |= Fieldstab[w->procflags[i]].lflg;
          }
          if (Rc.mode_altscr) w->columnhdr[0] = w->winnum + '0';
+         if (CHKw(w, Show_CGROUP)) Frames_libflags |= PROC_FILLCGROUP;
+         // what's needed of every task, not just the ones shown: the sort
+         // key -- or, for the cgroup view's rows made from them, all of it
+         eager |= Fieldstab[w->rc.sortindx].lflg;
+         if (CHKw(w, Show_CGROUP)) eager = ~0;
       }
       if (Rc.mode_altscr) w = w->next;
    } while (w != Curwin);
@@ -2176,13 +2637,26 @@ static void reframewins (void)
       }
    }
 
-   if (selection_type=='U') Frames_libflags |= L_status;
+   if (selection_type=='U') {
+      Frames_libflags |= L_status;
+      eager |= L_status;
+   }
 
    if (Frames_libflags & L_EITHER) {
       Frames_libflags &= ~L_EITHER;
-      if (!(Frames_libflags & L_stat)) Frames_libflags |= L_status;
+      // then status has the state, which the summary counts
+      if (!(Frames_libflags & L_stat)) {
+         Frames_libflags |= L_status;
+         eager |= L_status;
+      }
    }
-   if (!Frames_libflags) Frames_libflags = L_DEFAULT;
+   // anything else can wait for procs_fill -- and names from status must
+   // wait with status, if it can (io and smaps must not: they're history)
+   Frames_lazyflags = Frames_libflags & (L_statm | L_status | PROC_FILLUSR | PROC_FILLGRP) & ~eager;
+   if (Frames_lazyflags & L_status)
+      Frames_lazyflags |= Frames_libflags & (PROC_FILLUSR | PROC_FILLGRP);
+   Frames_libflags &= ~Frames_lazyflags;
+   if (!(Frames_libflags & ~PROC_FILLCGROUP)) Frames_libflags |= L_DEFAULT;
    if (selection_type=='p') Frames_libflags |= PROC_PID;
 }
 
@@ -2424,7 +2898,10 @@ static void wins_resize (void)
    //       when not Batch, our buffer will contain 1 extra 'line' since
    //       Msg_row is never represented -- but it's nice to have some space
    //       between us and the great-beyond...
-   Pseudo_cols = Screen_cols + CLRBUFSIZ + 1;
+   // note: a row is as long as PUFF can make it, since the escapes in one
+   //       (with their terminfo delays) can run well past CLRBUFSIZ, and a
+   //       row spilling into the next one would get both repainted
+   Pseudo_cols = ROWBUFSIZ;
    if (Batch) Pseudo_size = ROWBUFSIZ + 1;
    else       Pseudo_size = Pseudo_cols * Screen_rows;
    Pseudo_scrn = alloc_r(Pseudo_scrn, Pseudo_size);
@@ -2497,6 +2974,10 @@ static void do_key (unsigned c)
 
    switch (c) {
       case '1':
+         if (CHKw(Curwin, View_NODSUM)) {
+            OFFw(Curwin, View_NODSUM);
+            break;
+         }
          if (Cpu_tot+7 > Screen_rows && CHKw(Curwin, View_CPUSUM)) {
             show_msg(err_num_cpus);
             break;
@@ -2509,6 +2990,14 @@ static void do_key (unsigned c)
 #endif
          break;
 
+      case '2':
+         if (Node_tot+7 > Screen_rows && !CHKw(Curwin, View_NODSUM)) {
+            show_msg(err_num_cpus);
+            break;
+         }
+         TOGw(Curwin, View_NODSUM);
+         break;
+
       case 'a':
          if (Rc.mode_altscr) Curwin = Curwin->next;
          break;
@@ -2570,6 +3059,14 @@ static void do_key (unsigned c)
          win_select(0);
          break;
 
+      case 'C':
+         if (VIZCHKc) {
+            TOGw(Curwin, Show_CGROUP);
+            show_msg(fmtmk("Show cgroups %s"
+               , CHKw(Curwin, Show_CGROUP) ? "On" : "Off"));
+         }
+         break;
+
       case 'H':
          if (VIZCHKc) {
             TOGw(Curwin, Show_THREADS);
@@ -2662,6 +3159,10 @@ static void do_key (unsigned c)
          TOGw(Curwin, View_MEMORY);
          break;
 
+      case '$':         // not in the help: a line of what each phase
+         costs_enable(!costs_on);       // of the last frame cost
+         break;
+
       case 'n':
       case '#':
          if (VIZCHKc) {
@@ -2996,7 +3497,15 @@ static proc_t **summary_show (void)
 
       smpcpu = cpus_refresh(smpcpu);
 
-      if (CHKw(Curwin, View_CPUSUM)) {
+      if (CHKw(Curwin, View_NODSUM)) {
+         int i;
+         char tmp[SMLBUFSIZ];
+         // display each numa node's states, summed over its cpus
+         for (i = 0; i < Node_tot; i++) {
+            snprintf(tmp, sizeof(tmp), "Node%-2d:", Node_ids ? Node_ids[i] : 0);
+            summaryhlp(&smpcpu[Cpu_tot + 1 + i], tmp);
+         }
+      } else if (CHKw(Curwin, View_CPUSUM)) {
          // display just the 1st /proc/stat line
          summaryhlp(&smpcpu[Cpu_tot], "Cpu(s):");
       } else {
@@ -3020,6 +3529,16 @@ static proc_t **summary_show (void)
       Msg_row += 2;
    }
 
+   // Display what the last frame cost, when asked (hidden)
+   if (costs_on) {
+      show_special(0, fmtmk(COSTS_line
+         , Frame_costs.ns[COST_READ] / 1e6, Frame_costs.ns[COST_PARSE] / 1e6
+         , Frame_costs.ns[COST_NAMES] / 1e6, Frame_costs.ns[COST_TTY] / 1e6
+         , Frame_costs.ns[COST_WCHAN] / 1e6, Frame_costs.ns[COST_SORT] / 1e6
+         , Frame_costs.ns[COST_OUTPUT] / 1e6, Frame_costns / 1e6));
+      Msg_row += 1;
+   }
+
    SETw(Curwin, NEWFRAM_cwo);
    return p_table;
 }
@@ -3030,22 +3549,40 @@ static proc_t **summary_show (void)
 // the following macro is our means to 'inline' emitting a column -- next to
 // procs_refresh, that's the most frequent and costly part of top's job !
 #define MKCOL(va...) do {                                                    \
-   if(likely(!(   CHKw(q, Show_HICOLS)  &&  q->rc.sortindx==i   ))) {        \
-      snprintf(cbuf, sizeof(cbuf), f, ## va);                                \
-   } else {                                                                  \
-      snprintf(_z, sizeof(_z), f, ## va);                                    \
-      snprintf(cbuf, sizeof(cbuf), "%s%s%s",                                 \
+   snprintf(cbuf, sizeof(cbuf), f, ## va);                                   \
+   HICOL();                                                                  \
+} while (0)
+
+// and these skip the printf family for what's already text or a number,
+// right justified into the width of the column's heading
+#define MKTXT(str) do {                                                      \
+   const char *_s = (str);                                                   \
+   int _n = strlen(_s);                                                      \
+   if (_n > (int)w) _n = w;                                                  \
+   col_text(cbuf, w, _s, _n);                                                \
+   HICOL();                                                                  \
+} while (0)
+#define MKNUM(num,minus) do {                                                \
+   col_num(cbuf, strlen(Fieldstab[i].head) - 1, num, minus);                 \
+   HICOL();                                                                  \
+} while (0)
+
+// the sort column, when it's to be highlighted
+#define HICOL() do {                                                         \
+   if(unlikely(   CHKw(q, Show_HICOLS)  &&  q->rc.sortindx==i   )) {        \
+      snprintf(_z, sizeof(_z), "%s%s%s",                                     \
          q->capclr_rowhigh,                                                  \
-         _z,                                                                 \
+         cbuf,                                                               \
          !(CHKw(q, Show_HIROWS) && 'R' == p->state) ? q->capclr_rownorm : "" \
       );                                                                     \
+      strcpy(cbuf, _z);                                                      \
       pad += q->len_rowhigh;                                                 \
       if (!(CHKw(q, Show_HIROWS) && 'R' == p->state)) pad += q->len_rownorm; \
    }                                                                         \
 } while (0)
 
 // Display information for a single task row.
-static void task_show (const WIN_t *q, const proc_t *p)
+static void task_show (const WIN_t *q, proc_t *p)
 {
    char rbuf[ROWBUFSIZ];
    char *rp = rbuf;
@@ -3072,15 +3609,20 @@ static void task_show (const WIN_t *q, const proc_t *p)
 	    int maxcmd = q->maxcmdln;
             if (CHKw(q, Show_CMDLIN)) flags = ESC_DEFUNCT | ESC_BRACKETS | ESC_ARGS;
             else                      flags = ESC_DEFUNCT;
-            escape_command(tmp, p, sizeof tmp, &maxcmd, flags);
+            if (CHKw(q, Show_CGROUP))
+               escape_str(tmp, p->cgroup ? p->cgroup : "-", sizeof tmp, &maxcmd);
+            else {
+               if (CHKw(q, Show_CMDLIN)) cmdline_fill(p);
+               escape_command(tmp, p, sizeof tmp, &maxcmd, flags);
+            }
             MKCOL(q->maxcmdln, q->maxcmdln, tmp);
          }
             break;
          case P_COD:
-            MKCOL(scale_num(PAGES_TO_KB(p->trs), w, s));
+            MKTXT(scale_num(PAGES_TO_KB(p->trs), w, s));
             break;
          case P_CPN:
-            MKCOL((unsigned)p->processor);
+            MKNUM((unsigned)p->processor, 0);
             break;
          case P_CPU:
          {  float u = (float)p->pcpu * Frame_tscale;
@@ -3089,10 +3631,10 @@ static void task_show (const WIN_t *q, const proc_t *p)
          }
             break;
          case P_DAT:
-            MKCOL(scale_num(PAGES_TO_KB(p->drs), w, s));
+            MKTXT(scale_num(PAGES_TO_KB(p->drs), w, s));
             break;
          case P_DRT:
-            MKCOL(scale_num((unsigned)p->dt, w, s));
+            MKTXT(scale_num((unsigned)p->dt, w, s));
             break;
          case P_FLG:
          {  char tmp[TNYBUFSIZ];
@@ -3103,7 +3645,7 @@ static void task_show (const WIN_t *q, const proc_t *p)
          }
             break;
          case P_FLT:
-            MKCOL(scale_num(p->maj_flt, w, s));
+            MKTXT(scale_num(p->maj_flt, w, s));
             break;
          case P_GRP:
             MKCOL(p->egroup);
@@ -3112,39 +3654,49 @@ static void task_show (const WIN_t *q, const proc_t *p)
             MKCOL((float)PAGES_TO_KB(p->resident) * 100 / kb_main_total);
             break;
          case P_NCE:
-            MKCOL((int)p->nice);
+            MKNUM(p->nice < 0 ? -(long)p->nice : p->nice, p->nice < 0);
+            break;
+         case P_IOR:
+            MKTXT(scale_num(io_rate(p), w, s));
             break;
          case P_PID:
-            MKCOL((unsigned)p->XXXID);
+            MKNUM((unsigned)p->XXXID, 0);
             break;
          case P_PPD:
-            MKCOL((unsigned)p->ppid);
+            MKNUM((unsigned)p->ppid, 0);
             break;
          case P_PRI:
             if (unlikely(-99 > p->priority) || unlikely(999 < p->priority)) {
                f = "  RT";
                MKCOL("");
             } else
-               MKCOL((int)p->priority);
+               MKNUM(p->priority < 0 ? -(long)p->priority : p->priority, p->priority < 0);
+            break;
+         case P_PSS:
+            MKTXT(scale_num(p->pss, w, s));
             break;
          case P_RES:
-            MKCOL(scale_num(PAGES_TO_KB(p->resident), w, s));
+            MKTXT(scale_num(PAGES_TO_KB(p->resident), w, s));
             break;
          case P_SHR:
-            MKCOL(scale_num(PAGES_TO_KB(p->share), w, s));
+            MKTXT(scale_num(PAGES_TO_KB(p->share), w, s));
+            break;
+         case P_SPS:
+            MKTXT(scale_num(p->swap_pss, w, s));
             break;
          case P_STA:
-            MKCOL(p->state);
+            col_text(cbuf, 1, &p->state, 1);
+            HICOL();
             break;
          case P_SWP:
-            MKCOL(scale_num(PAGES_TO_KB(p->size - p->resident), w, s));
+            MKTXT(scale_num(PAGES_TO_KB(p->size - p->resident), w, s));
             break;
          case P_TME:
          case P_TM2:
          {  TIC_t t = p->utime + p->stime;
             if (CHKw(q, Show_CTIMES))
                t += (p->cutime + p->cstime);
-            MKCOL(scale_tics(t, w));
+            MKTXT(scale_tics(t, w));
          }
             break;
          case P_TTY:
@@ -3154,7 +3706,7 @@ static void task_show (const WIN_t *q, const proc_t *p)
          }
             break;
          case P_UID:
-            MKCOL((unsigned)p->euid);
+            MKNUM((unsigned)p->euid, 0);
             break;
          case P_URE:
             MKCOL(p->euser);
@@ -3162,8 +3714,11 @@ static void task_show (const WIN_t *q, const proc_t *p)
          case P_URR:
             MKCOL(p->ruser);
             break;
+         case P_USS:
+            MKTXT(scale_num(p->uss, w, s));
+            break;
          case P_VRT:
-            MKCOL(scale_num(PAGES_TO_KB(p->size), w, s));
+            MKTXT(scale_num(PAGES_TO_KB(p->size), w, s));
             break;
          case P_WCH:
             if (No_ksyms) {
@@ -3189,6 +3744,220 @@ static void task_show (const WIN_t *q, const proc_t *p)
    );
 
 #undef MKCOL
+#undef MKTXT
+#undef MKNUM
+#undef HICOL
+}
+
+
+// Would this task get a row in the window (idle and user filters)?
+static inline int row_shown (const WIN_t *q, const proc_t *p)
+{
+   return (CHKw(q, Show_IDLEPS) || ('S' != p->state && 'Z' != p->state && 'T' != p->state))
+      && good_uid(p);
+}
+
+
+// The window's sort, with ties broken by tid so rows don't trade places
+// from one frame to the next.
+static QFP_t Frame_sort;
+
+static int sort_rows_cmp (const void *P, const void *Q)
+{
+   int r = Frame_sort(P, Q);
+   if (r) return r;
+   return (*(proc_t *const *)P)->tid - (*(proc_t *const *)Q)->tid;
+}
+
+static void sort_rows_sift (proc_t **h, int i, int n)
+{
+   proc_t *t;
+   int c;
+
+   // a max-heap by sort order: the worst row we're keeping is at h[0]
+   while ((c = 2 * i + 1) < n) {
+      if (c + 1 < n && sort_rows_cmp(&h[c + 1], &h[c]) > 0) ++c;
+      if (sort_rows_cmp(&h[i], &h[c]) >= 0) break;
+      t = h[i]; h[i] = h[c]; h[c] = t;
+      i = c;
+   }
+}
+
+
+// Put the tasks in display order, though only the first 'rows' of those
+// that will be shown need be right.  When that's just a screenful out of
+// many tasks, the shown ones are moved up front and a heap picks out the
+// best 'rows' of them, so only those few ever get sorted.
+static void sort_rows (proc_t **ppt, unsigned total, const WIN_t *q, int rows)
+{
+   proc_t *t;
+   int i, n;
+
+   Frame_sort = Fieldstab[q->rc.sortindx].sort;
+   if (rows < 1 || (unsigned)rows * 4 >= total) {
+      qsort(ppt, total, sizeof(proc_t *), sort_rows_cmp);
+      return;
+   }
+   for (i = n = 0; (unsigned)i < total; i++) {
+      if (!row_shown(q, ppt[i])) continue;
+      t = ppt[n]; ppt[n++] = ppt[i]; ppt[i] = t;
+   }
+   if (rows > n) rows = n;
+   for (i = rows / 2 - 1; i >= 0; i--)
+      sort_rows_sift(ppt, i, rows);
+   for (i = rows; i < n; i++) {
+      if (sort_rows_cmp(&ppt[i], &ppt[0]) >= 0) continue;
+      t = ppt[0]; ppt[0] = ppt[i]; ppt[i] = t;
+      sort_rows_sift(ppt, 0, rows);
+   }
+   qsort(ppt, rows, sizeof(proc_t *), sort_rows_cmp);
+}
+
+
+        /*
+         * The cgroup view ('C'): a row per cgroup, the sum of the tasks in
+         * it that the window would show (less the idle test, which is then
+         * put to the rows -- a cgroup is running if any of its tasks is).
+         * PID counts the tasks and COMMAND is the cgroup.  The rest comes
+         * from one of its tasks, but for what can be added up: memory,
+         * times, faults, threads, I/O rate and %CPU.  With no user or pid
+         * selection, %CPU is what cgroupfs counted for the whole cgroup
+         * since the last frame, where it's there: that takes in the tasks
+         * that came and went in between, as with a make -j.  */
+typedef struct CGU_t {
+   struct CGU_t       *next;
+   const char         *cgroup;          // libproc's copy, so compare pointers
+   unsigned long long  usec;            // usage_usec as of 'frame'
+   unsigned long long  tics;            // the growth to it, if 'frame' was the one before
+   unsigned            frame;
+   int                 valid;           // tics can be used
+} CGU_t;
+
+#define CGU_HASH(cg)  ( ((unsigned long)(cg) >> 4) & 255 )
+
+// the cgroup's cpu.stat growth since the frame before, into *tics
+static int cgview_tics (const char *cgroup, unsigned long long *tics)
+{
+   static CGU_t *hash[256];
+   CGU_t *e;
+   cgstat_t st;
+
+   for (e = hash[CGU_HASH(cgroup)]; e; e = e->next)
+      if (e->cgroup == cgroup) break;
+   if (!e) {
+      e = alloc_c(sizeof(CGU_t));
+      e->cgroup = cgroup;
+      e->next = hash[CGU_HASH(cgroup)];
+      hash[CGU_HASH(cgroup)] = e;
+   }
+   if (e->frame != Frame_count) {
+      int prior = e->frame + 1 == Frame_count && e->usec;
+      e->valid = 0;
+      if (cgroup_stat(cgroup, &st) & CGSTAT_CPU) {
+         if (prior && st.usage_usec >= e->usec) {
+            e->tics = (st.usage_usec - e->usec) * Hertz / 1000000;
+            e->valid = 1;
+         }
+         e->usec = st.usage_usec;
+      } else
+         e->usec = 0;
+      e->frame = Frame_count;
+   }
+   if (e->valid) *tics = e->tics;
+   return e->valid;
+}
+
+// by path, which puts a cgroup's descendants in the rows right after it
+static int cgview_cmp (const void *P, const void *Q)
+{
+   const char *p = (*(proc_t *const *)P)->cgroup, *q = (*(proc_t *const *)Q)->cgroup;
+   if (p == q) return 0;
+   if (!p || !q) return p ? 1 : -1;
+   return strcmp(p, q);
+}
+
+// cgroupfs counts a cgroup's descendants in with it, which the tasks
+// in a row don't -- so the cgroup's own usage is only good for a leaf
+static int cgview_leaf (unsigned r)
+{
+   const char *cg = Cg_rows[r].cgroup;
+   size_t len = strlen(cg);
+   unsigned i;
+
+   if (1 == len) return r + 1 == Cg_nrows;      // "/", with nothing below
+   for (i = r + 1; i < Cg_nrows && !strncmp(Cg_rows[i].cgroup, cg, len); i++)
+      if ('/' == Cg_rows[i].cgroup[len]) return 0;
+   return 1;
+}
+
+// Roll up a frame's tasks by cgroup: returns the rows, 'eot' terminated
+// like procs_refresh's table, and their number in *n.
+static proc_t **cgview_make (proc_t **ppt, unsigned *n)
+{
+   static proc_t **tasks, **rows;
+   static unsigned alloc;
+   unsigned i, j, k;
+
+   if (alloc < Frame_maxtask + 1) {
+      alloc = Frame_maxtask + 1 + Frame_maxtask / 4;
+      tasks = alloc_r(tasks, alloc * sizeof(proc_t *));
+      rows  = alloc_r(rows,  alloc * sizeof(proc_t *));
+      Cg_rows = alloc_r(Cg_rows, alloc * sizeof(proc_t));
+   }
+   for (i = k = 0; i < Frame_maxtask; i++)
+      if (good_uid(ppt[i])) tasks[k++] = ppt[i];
+   qsort(tasks, k, sizeof(proc_t *), cgview_cmp);
+
+   Cg_nrows = 0;
+   for (i = 0; i < k; i = j) {
+      proc_t *r = &Cg_rows[Cg_nrows];
+      *r = *tasks[i];
+      r->tid = 0;
+      r->rchar = 0;
+      r->state = 'S';
+      r->nlwp = 0;
+      r->pcpu = 0;
+      r->size = r->resident = r->share = r->trs = r->drs = r->dt = 0;
+      r->vm_swap = r->pss = r->uss = r->swap_pss = 0;
+      r->utime = r->stime = r->cutime = r->cstime = 0;
+      r->maj_flt = r->min_flt = 0;
+      r->cmdline = NULL;
+      for (j = i; j < k && tasks[j]->cgroup == r->cgroup; j++) {
+         const proc_t *t = tasks[j];
+         r->tid++;
+         if ('R' == t->state) r->state = 'R';
+         r->nlwp     += t->nlwp ? t->nlwp : 1;
+         r->pcpu     += t->pcpu;
+         r->size     += t->size;
+         r->resident += t->resident;
+         r->share    += t->share;
+         r->trs      += t->trs;
+         r->drs      += t->drs;
+         r->dt       += t->dt;
+         r->vm_swap  += t->vm_swap;
+         r->pss      += t->pss;
+         r->uss      += t->uss;
+         r->swap_pss += t->swap_pss;
+         r->utime    += t->utime;
+         r->stime    += t->stime;
+         r->cutime   += t->cutime;
+         r->cstime   += t->cstime;
+         r->maj_flt  += t->maj_flt;
+         r->min_flt  += t->min_flt;
+         r->rchar    += io_rate(t);
+      }
+      rows[Cg_nrows++] = r;
+   }
+   if (!selection_type) {
+      for (i = 0; i < Cg_nrows; i++) {
+         unsigned long long tics;
+         if (Cg_rows[i].cgroup && cgview_leaf(i) && cgview_tics(Cg_rows[i].cgroup, &tics))
+            Cg_rows[i].pcpu = (unsigned)tics;
+      }
+   }
+   rows[Cg_nrows] = ppt[Frame_maxtask];        // that 'eot' entry
+   *n = Cg_nrows;
+   return rows;
 }
 
 
@@ -3202,7 +3971,11 @@ static void window_show (proc_t **ppt, WIN_t *q, int *lscr)
    static FLG_t sav_indx = 0;
    static int   sav_flgs = -1;
 #endif
+   unsigned total = Frame_maxtask;
    int i, lwin;
+   cost_mark cm;
+
+   if (CHKw(q, Show_CGROUP)) ppt = cgview_make(ppt, &total);
 
    // Display Column Headings -- and distract 'em while we sort (maybe)
    PUFF("\n%s%s%s%s", q->capclr_hdr, q->columnhdr, Caps_off, Cap_clr_eol);
@@ -3218,7 +3991,15 @@ static void window_show (proc_t **ppt, WIN_t *q, int *lscr)
       else                      Frame_srtflg = -1;
       Frame_ctimes = CHKw(q, Show_CTIMES);        // this and next, only maybe
       Frame_cmdlin = CHKw(q, Show_CMDLIN);
-      qsort(ppt, Frame_maxtask, sizeof(proc_t *), Fieldstab[q->rc.sortindx].sort);
+      // sorting on command lines needs them all, not just the ones shown
+      if (Frame_cmdlin && P_CMD == q->rc.sortindx && !CHKw(q, Show_CGROUP))
+         for (i = 0; ppt[i]->tid != -1; i++) cmdline_fill(ppt[i]);
+      // the rows left below the column headings
+      i = Max_lines - (*lscr + 1);
+      if (q->winlines && q->winlines < i) i = q->winlines;
+      COST_START(cm);
+      sort_rows(ppt, total, q, i);
+      COST_STOP(COST_SORT, cm);
 #ifdef SORT_SUPRESS
    }
 #endif
@@ -3228,10 +4009,12 @@ static void window_show (proc_t **ppt, WIN_t *q, int *lscr)
    i = 0;
 
    while ( ppt[i]->tid != -1 && *lscr < Max_lines  &&  (!q->winlines || (lwin <= q->winlines)) ) {
-      if ((CHKw(q, Show_IDLEPS) || ('S' != ppt[i]->state && 'Z' != ppt[i]->state && 'T' != ppt[i]->state))
-      && good_uid(ppt[i]) ) {
+      if (row_shown(q, ppt[i])) {
          // Display a process Row
+         procs_fill(ppt[i]);
+         COST_START(cm);
          task_show(q, ppt[i]);
+         COST_STOP(COST_OUTPUT, cm);
          (*lscr)++;
          ++lwin;
       }
@@ -3247,6 +4030,106 @@ static void window_show (proc_t **ppt, WIN_t *q, int *lscr)
 }
 
 
+/*######  Headless ring buffer output  ###################################*/
+
+        /*
+         * Make the ring file and map it, once the first frame has said
+         * how many tasks there are: room for twice that (at least 1024)
+         * in each slot, and a minute's worth of slots (at least 16). */
+static void ring_open (unsigned ntasks)
+{
+   ring_head *h;
+   size_t slot_size, size;
+   unsigned nslots, nrecs, i;
+   int fd;
+
+   nrecs = ntasks < 512 ? 1024 : ntasks * 2;
+   nslots = 1024;
+   if (Rc.delay_time * 1024 > 60) nslots = 60 / Rc.delay_time;
+   if (nslots < 16) nslots = 16;
+   slot_size = sizeof(ring_frame) + nrecs * sizeof(ring_task);
+   size = sizeof(ring_head) + nslots * slot_size;
+
+   if (0 > (fd = open(Ring_path, O_RDWR | O_CREAT, 0644))
+   || ftruncate(fd, size)
+   || MAP_FAILED == (h = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)))
+      std_err(fmtmk("%s: %s", Ring_path, strerror(errno)));
+   close(fd);
+
+   // a file that's being reused may still say it's a ring, so the
+   // magic goes in last and the slots all start out unwritten
+   memset(h->magic, 0, sizeof(h->magic));
+   __sync_synchronize();
+   h->version = RING_VERSION;
+   h->head_size = sizeof(ring_head);
+   h->slot_size = slot_size;
+   h->nslots = nslots;
+   h->max_recs = nrecs;
+   h->hertz = Hertz;
+   h->frames = 0;
+   for (i = 0; i < nslots; i++)
+      ((ring_frame *)((char *)h + sizeof(ring_head) + i * slot_size))->seq = 0;
+   __sync_synchronize();
+   memcpy(h->magic, RING_MAGIC, sizeof(h->magic));
+   Ring = h;
+}
+
+
+        /*
+         * The headless frame: the same procs_refresh/prochlp pass a
+         * screen frame starts with, then one ring_task per task into the
+         * next slot instead of any formatting.  Nothing here allocates,
+         * once the task table is as big as it's going to get. */
+static void ring_make (void)
+{
+   static proc_t **table;
+   static struct timeval oldtimev;
+   struct timeval timev;
+   ring_frame *f;
+   ring_task *t;
+   uint64_t k;
+   unsigned i, n;
+   int flags = L_stat | PROC_FIELD_TIMES | PROC_FIELD_VM;
+
+   if (selection_type == 'p') flags |= PROC_PID;
+   if (selection_type == 'U') flags |= L_status;
+   table = procs_refresh(table, flags);
+   gettimeofday(&timev, NULL);
+   if (!Ring) ring_open(Frame_maxtask);
+
+   k = Ring->frames;
+   f = (ring_frame *)((char *)Ring + Ring->head_size + (k % Ring->nslots) * Ring->slot_size);
+   f->seq = 2 * k + 1;
+   __sync_synchronize();
+
+   t = (ring_task *)(f + 1);
+   for (i = n = 0; -1 != table[i]->tid; i++) {
+      const proc_t *p = table[i];
+      if (!good_uid(p)) continue;
+      if (n < Ring->max_recs) {
+         t[n].pid   = p->XXXID;
+         t[n].tics  = p->pcpu;
+         t[n].res   = PAGES_TO_KB(p->rss);
+         t[n].state = p->state;
+      }
+      n++;
+   }
+   f->stamp    = timev.tv_sec * 1000000ull + timev.tv_usec;
+   f->elapsed  = k ? (timev.tv_sec - oldtimev.tv_sec) * 1000000 + (timev.tv_usec - oldtimev.tv_usec) : 0;
+   f->ntasks   = n;
+   f->nrecs    = n < Ring->max_recs ? n : Ring->max_recs;
+   f->running  = Frame_running;
+   f->sleeping = Frame_sleepin;
+   f->stopped  = Frame_stopped;
+   f->zombie   = Frame_zombied;
+   oldtimev = timev;
+
+   __sync_synchronize();
+   f->seq = 2 * k + 2;
+   Ring->frames = k + 1;
+}
+
+
 /*######  Entry point plus two  ##########################################*/
 
 // This guy's just a *Helper* function who apportions the
@@ -3304,6 +4187,7 @@ static void frame_make (void)
       memset(Pseudo_scrn, '\0', Pseudo_size);
    }
    Pseudo_row = Msg_row = scrlins = 0;
+   if (costs_on) costs_reset();
    ppt = summary_show();
    Max_lines = (Screen_rows - Msg_row) - 1;
 
@@ -3338,6 +4222,10 @@ static void frame_make (void)
       Cap_clr_eol
    );
    fflush(stdout);
+   if (costs_on) {
+      Frame_costs = costs;
+      Frame_costns = costs_now() - costs.since;
+   }
 }
 
 
@@ -3369,7 +4257,8 @@ int main (int dont_care_argc, char *argv[])
          need_resize = 0;
          wins_resize();
       }
-      frame_make();
+      if (Ring_path) ring_make();
+      else frame_make();
 
       if (Msg_awaiting) show_msg(Msg_delayed);
       if (Loops > 0) --Loops;
@@ -44,6 +44,9 @@
 // The default delay twix updates
 #define DEF_DELAY  3.0
 
+// PSS and USS come from smaps, which is slow -- refresh them this often
+#define SMAPS_SECS  10
+
 // The length of time a 'message' is displayed
 #define MSG_SLEEP  2
 
@@ -126,7 +129,7 @@
 // - for more permanent frame-oriented 'update' output
 // - may NOT contain cursor motion terminfo escapes
 // - assumed to represent a complete screen ROW
-// - subject to optimization, thus MAY be discarded
+// - subject to optimization, thus MAY be discarded, or only partly sent
 
 // The evil version   (53892 byte stripped top, oddly enough)
 #define _PUFF(fmt,arg...)                               \
@@ -147,16 +150,17 @@ do {                                                     \
    char _str[ROWBUFSIZ];                                   \
    char *_ptr;                                               \
    int _len = 1 + snprintf(_str, sizeof(_str), fmt, ## arg);   \
-   if (Batch) _ptr = _str;                                   \
+   if (_len > (int)sizeof(_str)) _len = sizeof(_str);          \
+   if (Batch) putp(_str);                                  \
    else {                                                 \
       _ptr = &Pseudo_scrn[Pseudo_row++ * Pseudo_cols];  \
       if (memcmp(_ptr, _str, _len)) {                \
+         puff_row(_ptr, _str);                    \
          memcpy(_ptr, _str, _len);                \
       } else {                                 \
-         _ptr = "\n";                       \
+         putp("\n");                        \
       }                                 \
    }                                \
-   putp(_ptr);                   \
 } while (0)
 
 
@@ -204,7 +208,15 @@ typedef struct FLD_t {
 // and save data that goes unused
 typedef struct HST_t {
    TIC_t tics;
+   unsigned long long io;               // read_bytes + write_bytes
    int   pid;
+   int   lnk;   // next on this hash chain, or -1
+   unsigned long pss, uss, swap_pss;    // from the last smaps read
+   unsigned long long start_time;       // with cmd, says it's the same program
+   char **cmdline;                      // read when first shown, kept till exec
+   int   cmdread;                       // cmdline was read (it may be NULL)
+   char  cmd[16];
+   int   filled;                        // this frame's procs_fill was done
 } HST_t;
 
 // This structure stores a frame's cpu tics used in history
@@ -250,9 +262,18 @@ enum pflag {
    P_CPN, P_CPU, P_TME, P_TM2,
    P_MEM, P_VRT, P_SWP, P_RES, P_COD, P_DAT, P_SHR,
    P_FLT, P_DRT,
-   P_STA, P_CMD, P_WCH, P_FLG
+   P_STA, P_CMD, P_WCH, P_FLG,
+   P_PSS, P_USS, P_SPS, P_IOR,
+   P_MAXPFLGS
 };
 
+// Field keys are 'A' for P_PID on up, so after 'Z' they carry on with
+// '[', '\', ']' ...  An upper case key means the field is displayed, and
+// the 'lower case' of each is 0x20 above it -- just like the letters.
+#define FLDon(c)   ((c) >= 'A' && (c) < 'A' + P_MAXPFLGS)
+#define FLDoff(c)  ((c) >= 'a' && (c) < 'a' + P_MAXPFLGS)
+#define FLDidx(c)  (FLDon(c) ? (c) - 'A' : (c) - 'a')
+
 
 ///////////////////////////////////////////////////////////////////////////
 // Special Section: multiple windows/field groups  -------------
@@ -270,6 +291,7 @@ enum pflag {
 // letter shown is the corresponding 'command' toggle
 
 // 'View_' flags affect the summary (minimum), taken from 'Curwin'
+#define View_NODSUM  0x20000    // '2' - show cpu stats per numa node
 #define View_CPUSUM  0x8000     // '1' - show combined cpu stats (vs. each)
 #define View_LOADAV  0x4000     // 'l' - display load avg and uptime summary
 #define View_STATES  0x2000     // 't' - display task/cpu(s) states summary
@@ -277,6 +299,7 @@ enum pflag {
 #define View_NOBOLD  0x0001     // 'B' - disable 'bold' attribute globally
 
 // 'Show_' & 'Qsrt_' flags are for task display in a visible window
+#define Show_CGROUP  0x40000    // 'C' - show a row per cgroup (vs. per task)
 #define Show_THREADS 0x10000    // 'H' - show threads in each task
 #define Show_COLORS  0x0800     // 'z' - show in color (vs. mono)
 #define Show_HIBOLD  0x0400     // 'b' - rows and/or cols bold (vs. reverse)
@@ -350,13 +373,13 @@ typedef struct WIN_t {
 #define RCF_DEPRECATED  "Id:a, "
 
 // The default fields displayed and their order,
-#define DEF_FIELDS  "AEHIOQTWKNMbcdfgjplrsuvyzX"
+#define DEF_FIELDS  "AEHIOQTWKNMbcdfgjplrsuvyz{|}~X"
 // Pre-configured field groupss
-#define JOB_FIELDS  "ABcefgjlrstuvyzMKNHIWOPQDX"
-#define MEM_FIELDS  "ANOPQRSTUVbcdefgjlmyzWHIKX"
-#define USR_FIELDS  "ABDECGfhijlopqrstuvyzMKNWX"
+#define JOB_FIELDS  "ABcefgjlrstuvyz{|}~MKNHIWOPQDX"
+#define MEM_FIELDS  "ANOPQRSTUVbcdefgjlmyz{|}~WHIKX"
+#define USR_FIELDS  "ABDECGfhijlopqrstuvyz{|}~MKNWX"
 // Used by fields_sort, placed here for peace-of-mind
-#define NUL_FIELDS  "abcdefghijklmnopqrstuvwxyz"
+#define NUL_FIELDS  "abcdefghijklmnopqrstuvwxyz{|}~"
 
 
 // The default values for the local config file
@@ -391,6 +414,8 @@ typedef struct WIN_t {
    " %#4.1f%% \02us,\03 %#4.1f%% \02sy,\03 %#4.1f%% \02ni,\03 %#4.1f%% \02id,\03 %#4.1f%% \02wa,\03 %#4.1f%% \02hi,\03 %#4.1f%% \02si\03\n"
 #define STATES_line2x7  "%s\03" \
    "%#5.1f%%\02us,\03%#5.1f%%\02sy,\03%#5.1f%%\02ni,\03%#5.1f%%\02id,\03%#5.1f%%\02wa,\03%#5.1f%%\02hi,\03%#5.1f%%\02si,\03%#5.1f%%\02st\03\n"
+#define COSTS_line  "Cost ms:\03" \
+   " %.1f \02read,\03 %.1f \02parse,\03 %.1f \02names,\03 %.1f \02tty,\03 %.1f \02wchan,\03 %.1f \02sort,\03 %.1f \02show,\03 %.1f \02frame\03\n"
 #ifdef CASEUP_SUMMK
 #define MEMORY_line1  "Mem: \03" \
    " %8luK \02total,\03 %8luK \02used,\03 %8luK \02free,\03 %8luK \02buffers\03\n"
@@ -411,12 +436,12 @@ typedef struct WIN_t {
    "\n" \
    "  Z\05,\01B\05       Global: '\01Z\02' change color mappings; '\01B\02' disable/enable bold\n" \
    "  l,t,m     Toggle Summaries: '\01l\02' load avg; '\01t\02' task/cpu stats; '\01m\02' mem info\n" \
-   "  1,I       Toggle SMP view: '\0011\02' single/separate states; '\01I\02' Irix/Solaris mode\n" \
+   "  1,2,I     Toggle SMP view: '\0011\02' single/separate states; '\0012\02' numa nodes; '\01I\02' Irix mode\n" \
    "\n" \
    "  f,o     . Fields/Columns: '\01f\02' add or remove; '\01o\02' change display order\n" \
    "  F or O  . Select sort field\n" \
    "  <,>     . Move sort field: '\01<\02' next col left; '\01>\02' next col right\n" \
-   "  R,H     . Toggle: '\01R\02' normal/reverse sort; '\01H\02' show threads\n" \
+   "  R,H,C   . Toggle: '\01R\02' normal/reverse sort; '\01H\02' show threads; '\01C\02' cgroups\n" \
    "  c,i,S   . Toggle: '\01c\02' cmd name/line; '\01i\02' idle tasks; '\01S\02' cumulative time\n" \
    "  x\05,\01y\05     . Toggle highlights: '\01x\02' sort field; '\01y\02' running tasks\n" \
    "  z\05,\01b\05     . Toggle: '\01z\02' color/mono; '\01b\02' bold/reverse (only if 'x' or 'y')\n" \
@@ -0,0 +1,58 @@
+// topring.h - the file 'top -r' keeps its frames in
+//
+// This file may be used subject to the terms and conditions of the
+// GNU Library General Public License Version 2, or any later version
+// at your option, as published by the Free Software Foundation.
+//
+// The file is a ring_head, then nslots slots of slot_size bytes.  Frame
+// k (counting from 0) goes in slot k % nslots as a ring_frame followed by
+// nrecs ring_task's.  Everything is in the host's byte order.
+//
+// Readers map the file and take no locks.  To read a frame:
+//    1. k = head->frames - 1 (the newest) -- or any k at most nslots back
+//    2. s = the slot's frame->seq; it must be 2k+2, or the frame is being
+//       (or has been) overwritten
+//    3. copy what you want out of the slot
+//    4. read frame->seq again; if it isn't still s, the copy is bad
+// with a read barrier between 2 and 3 and between 3 and 4.  top writes
+// 2k+1 into seq before it touches a slot and 2k+2 when it's done.
+
+#ifndef _Itopring
+#define _Itopring
+
+#include <stdint.h>
+
+#define RING_MAGIC    "topring"         // with its '\0', 8 bytes
+#define RING_VERSION  1
+
+typedef struct ring_head {
+   char     magic [8];
+   uint32_t version;
+   uint32_t head_size;          // sizeof(ring_head), where slot 0 starts
+   uint32_t slot_size;
+   uint32_t nslots;
+   uint32_t max_recs;           // ring_task's a slot has room for
+   uint32_t hertz;              // clock ticks per second, for the tics
+   volatile uint64_t frames;    // frames written, and complete, so far
+} ring_head;
+
+typedef struct ring_frame {
+   volatile uint64_t seq;       // 2k+1 while frame k is written, then 2k+2
+   uint64_t stamp;              // gettimeofday, in microseconds
+   uint32_t elapsed;            // microseconds since the frame before
+   uint32_t ntasks;             // tasks seen this frame...
+   uint32_t nrecs;              // ...and how many fit in the slot
+   uint32_t running, sleeping, stopped, zombie;
+   uint32_t pad;
+} ring_frame;
+
+// one per task, its fields in the order of top's field table
+typedef struct ring_task {
+   int32_t  pid;                // P_PID (the tid, with threads shown)
+   uint32_t tics;               // P_CPU, as utime+stime since the frame before
+   uint32_t res;                // P_RES, in kilobytes
+   char     state;              // P_STA
+   char     pad [3];
+} ring_task;
+
+#endif /* _Itopring */
@@ -1,17 +1,65 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "proc/whattime.h"
+#include "proc/sysinfo.h"
+#include "proc/interval.h"
 #include "proc/version.h"
 
+static void usage(void) NORETURN;
+static void usage(void) {
+    fprintf(stderr,
+        "usage: uptime [-V] [-d delay] [-c count]\n"
+        "    -V    display version\n"
+        "    -d    update every [delay] seconds\n"
+        "    -c    update [count] times (every second, without -d)\n");
+    exit(1);
+}
+
 int main(int argc, char *argv[]) {
-    if(argc == 1) {
+    double delay = 0;
+    unsigned long count = 0;
+    interval_t tick;
+    sysinfo_snap s;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "Vd:c:")) != -1)
+        switch (opt) {
+        case 'V':
+            display_version();
+            return 0;
+        case 'd':
+            delay = strtod(optarg, NULL);
+            if (delay <= 0) usage();
+            break;
+        case 'c':
+            count = strtoul(optarg, NULL, 10);
+            if (!count) usage();
+            break;
+        default:
+            usage();
+        }
+    if (optind < argc) usage();
+
+    if (!delay && !count) {
         print_uptime();
         return 0;
     }
-    if((argc == 2) && (!strcmp(argv[1], "-V"))) {
-        display_version();
-        return 0;
+    if (!delay) delay = 1;
+
+    // /proc/uptime and /proc/loadavg stay open; each line is a pread() of
+    // each, on a schedule that the time taken doesn't push back
+    interval_start(&tick, delay);
+    for (;;) {
+        if (sysinfo_snapshot(&s, SNAP_UPTIME|SNAP_LOADAVG|SNAP_SHARED)) {
+            fputs("uptime: can't read /proc/uptime or /proc/loadavg\n", stderr);
+            return 1;
+        }
+        printf("%s\n", sprint_uptime_snap(&s));
+        fflush(stdout);
+        if (count && !--count) break;
+        interval_wait(&tick);
     }
-    fprintf(stderr, "usage: uptime [-V]\n    -V    display version\n");
-    return 1;
+    return 0;
 }
@@ -27,6 +27,8 @@
 #include <dirent.h>
 
 #include "proc/sysinfo.h"
+#include "proc/interval.h"
+#include "proc/alloc.h"
 #include "proc/version.h"
 
 static unsigned long dataUnit=1024;
@@ -51,11 +53,12 @@ static int statMode=VMSTAT;
 
 static int a_option; /* "-a" means "show active/inactive" */
 
-static unsigned sleep_time = 1;
+static double sleep_time = 1;   // seconds, may be fractional
 static unsigned long num_updates;
 
 static unsigned int height;   // window height
 static unsigned int moreheaders=TRUE;
+static const char **disk_only;   // -I: the devices -d and -D look at, else all
 
 
 /////////////////////////////////////////////////////////////////////////
@@ -69,10 +72,11 @@ static void usage(void) {
   fprintf(stderr,"              -d prints disk statistics\n");
   fprintf(stderr,"              -D prints disk table\n");
   fprintf(stderr,"              -p prints disk partition statistics\n");
+  fprintf(stderr,"              -I dev,... limits -d and -D to those devices\n");
   fprintf(stderr,"              -s prints vm table\n");
   fprintf(stderr,"              -m prints slabinfo\n");
   fprintf(stderr,"              -S unit size\n");
-  fprintf(stderr,"              delay is the delay between updates in seconds. \n");
+  fprintf(stderr,"              delay is the delay between updates in seconds, which may be fractional.\n");
   fprintf(stderr,"              unit size k:1000 K:1024 m:1000000 M:1048576 (default is K)\n");
   fprintf(stderr,"              count is the number of updates.\n");
   exit(EXIT_FAILURE);
@@ -172,48 +176,57 @@ static unsigned long unitConvert(unsigned int size){
 
 ////////////////////////////////////////////////////////////////////////////
 
+static void snapshot(sysinfo_snap *s) {
+  if(sysinfo_snapshot(s, SNAP_STAT|SNAP_MEMINFO)){
+    perror("/proc");
+    exit(EXIT_FAILURE);
+  }
+}
+
+// the next tick; a sample that ran past the one after says so on stderr,
+// since the lines it didn't print leave a gap in the times
+static void wait_tick(interval_t *restrict tick) {
+  if(!interval_wait(tick)) return;
+  fflush(stdout);
+  fprintf(stderr, "vmstat: %lu sample%s missed (%lu so far)\n",
+          tick->missed, tick->missed == 1 ? "" : "s", tick->total_missed);
+}
+
 static void new_format(void) {
   const char format[]="%2u %2u %6lu %6lu %6lu %6lu %4u %4u %5u %5u %4u %4u %2u %2u %2u %2u\n";
-  unsigned int tog=0; /* toggle switch for cleaner code */
   unsigned int i;
   unsigned int hz = Hertz;
-  unsigned int running,blocked,dummy_1,dummy_2;
-  jiff cpu_use[2], cpu_nic[2], cpu_sys[2], cpu_idl[2], cpu_iow[2], cpu_xxx[2], cpu_yyy[2], cpu_zzz[2];
+  sysinfo_snap prev, now, d;
   jiff duse, dsys, didl, diow, dstl, Div, divo2;
-  unsigned long pgpgin[2], pgpgout[2], pswpin[2], pswpout[2];
-  unsigned int intr[2], ctxt[2];
-  unsigned int sleep_half; 
+  interval_t tick;
+  double secs;
   unsigned long kb_per_page = sysconf(_SC_PAGESIZE) / 1024ul;
   int debt = 0;  // handle idle ticks running backwards
 
-  sleep_half=(sleep_time/2);
   new_header();
-  meminfo();
 
-  getstat(cpu_use,cpu_nic,cpu_sys,cpu_idl,cpu_iow,cpu_xxx,cpu_yyy,cpu_zzz,
-	  pgpgin,pgpgout,pswpin,pswpout,
-	  intr,ctxt,
-	  &running,&blocked,
-	  &dummy_1, &dummy_2);
-
-  duse= *cpu_use + *cpu_nic; 
-  dsys= *cpu_sys + *cpu_xxx + *cpu_yyy;
-  didl= *cpu_idl;
-  diow= *cpu_iow;
-  dstl= *cpu_zzz;
+  memset(&prev, 0, sizeof prev);  // so the 1st line is the average since boot
+  snapshot(&now);
+  sysinfo_delta(&d, &now, &prev);
+
+  duse= d.cpu_use + d.cpu_nic; 
+  dsys= d.cpu_sys + d.cpu_xxx + d.cpu_yyy;
+  didl= d.cpu_idl;
+  diow= d.cpu_iow;
+  dstl= d.cpu_zzz;
   Div= duse+dsys+didl+diow+dstl;
   divo2= Div/2UL;
   printf(format,
-	 running, blocked,
-	 unitConvert(kb_swap_used), unitConvert(kb_main_free),
-	 unitConvert(a_option?kb_inactive:kb_main_buffers),
-	 unitConvert(a_option?kb_active:kb_main_cached),
-	 (unsigned)( (*pswpin  * unitConvert(kb_per_page) * hz + divo2) / Div ),
-	 (unsigned)( (*pswpout * unitConvert(kb_per_page) * hz + divo2) / Div ),
-	 (unsigned)( (*pgpgin                * hz + divo2) / Div ),
-	 (unsigned)( (*pgpgout               * hz + divo2) / Div ),
-	 (unsigned)( (*intr                  * hz + divo2) / Div ),
-	 (unsigned)( (*ctxt                  * hz + divo2) / Div ),
+	 d.running-1, d.blocked,   // exclude vmstat itself
+	 unitConvert(d.kb_swap_used), unitConvert(d.kb_main_free),
+	 unitConvert(a_option?d.kb_inactive:d.kb_main_buffers),
+	 unitConvert(a_option?d.kb_active:d.kb_main_cached),
+	 (unsigned)( (d.vm_pswpin  * unitConvert(kb_per_page) * hz + divo2) / Div ),
+	 (unsigned)( (d.vm_pswpout * unitConvert(kb_per_page) * hz + divo2) / Div ),
+	 (unsigned)( (d.vm_pgpgin                * hz + divo2) / Div ),
+	 (unsigned)( (d.vm_pgpgout               * hz + divo2) / Div ),
+	 (unsigned)( (d.intr                     * hz + divo2) / Div ),
+	 (unsigned)( (d.ctxt                     * hz + divo2) / Div ),
 	 (unsigned)( (100*duse                    + divo2) / Div ),
 	 (unsigned)( (100*dsys                    + divo2) / Div ),
 	 (unsigned)( (100*didl                    + divo2) / Div ),
@@ -221,24 +234,23 @@ static void new_format(void) {
 	 (unsigned)( (100*dstl                    + divo2) / Div ) */
   );
 
+  interval_start(&tick, sleep_time);
   for(i=1;i<num_updates;i++) { /* \\\\\\\\\\\\\\\\\\\\ main loop ////////////////// */
-    sleep(sleep_time);
+    wait_tick(&tick);
     if (moreheaders && ((i%height)==0)) new_header();
-    tog= !tog;
 
-    meminfo();
+    prev = now;
+    snapshot(&now);
+    sysinfo_delta(&d, &now, &prev);
+    /* per second over the time it really took, not what was asked for */
+    secs= d.tv.tv_sec + d.tv.tv_usec / 1000000.0;
+    if(secs <= 0) secs = sleep_time;
 
-    getstat(cpu_use+tog,cpu_nic+tog,cpu_sys+tog,cpu_idl+tog,cpu_iow+tog,cpu_xxx+tog,cpu_yyy+tog,cpu_zzz+tog,
-	  pgpgin+tog,pgpgout+tog,pswpin+tog,pswpout+tog,
-	  intr+tog,ctxt+tog,
-	  &running,&blocked,
-	  &dummy_1,&dummy_2);
-
-    duse= cpu_use[tog]-cpu_use[!tog] + cpu_nic[tog]-cpu_nic[!tog];
-    dsys= cpu_sys[tog]-cpu_sys[!tog] + cpu_xxx[tog]-cpu_xxx[!tog] + cpu_yyy[tog]-cpu_yyy[!tog];
-    didl= cpu_idl[tog]-cpu_idl[!tog];
-    diow= cpu_iow[tog]-cpu_iow[!tog];
-    dstl= cpu_zzz[tog]-cpu_zzz[!tog];
+    duse= d.cpu_use + d.cpu_nic;
+    dsys= d.cpu_sys + d.cpu_xxx + d.cpu_yyy;
+    didl= d.cpu_idl;
+    diow= d.cpu_iow;
+    dstl= d.cpu_zzz;
 
     /* idle can run backwards for a moment -- kernel "feature" */
     if(debt){
@@ -253,16 +265,16 @@ static void new_format(void) {
     Div= duse+dsys+didl+diow+dstl;
     divo2= Div/2UL;
     printf(format,
-           running, blocked,
-	   unitConvert(kb_swap_used),unitConvert(kb_main_free),
-	   unitConvert(a_option?kb_inactive:kb_main_buffers),
-	   unitConvert(a_option?kb_active:kb_main_cached),
-	   (unsigned)( ( (pswpin [tog] - pswpin [!tog])*unitConvert(kb_per_page)+sleep_half )/sleep_time ), /*si*/
-	   (unsigned)( ( (pswpout[tog] - pswpout[!tog])*unitConvert(kb_per_page)+sleep_half )/sleep_time ), /*so*/
-	   (unsigned)( (  pgpgin [tog] - pgpgin [!tog]             +sleep_half )/sleep_time ), /*bi*/
-	   (unsigned)( (  pgpgout[tog] - pgpgout[!tog]             +sleep_half )/sleep_time ), /*bo*/
-	   (unsigned)( (  intr   [tog] - intr   [!tog]             +sleep_half )/sleep_time ), /*in*/
-	   (unsigned)( (  ctxt   [tog] - ctxt   [!tog]             +sleep_half )/sleep_time ), /*cs*/
+           d.running-1, d.blocked,   // exclude vmstat itself
+	   unitConvert(d.kb_swap_used),unitConvert(d.kb_main_free),
+	   unitConvert(a_option?d.kb_inactive:d.kb_main_buffers),
+	   unitConvert(a_option?d.kb_active:d.kb_main_cached),
+	   (unsigned)( d.vm_pswpin *unitConvert(kb_per_page)/secs + 0.5 ), /*si*/
+	   (unsigned)( d.vm_pswpout*unitConvert(kb_per_page)/secs + 0.5 ), /*so*/
+	   (unsigned)( d.vm_pgpgin                          /secs + 0.5 ), /*bi*/
+	   (unsigned)( d.vm_pgpgout                         /secs + 0.5 ), /*bo*/
+	   (unsigned)( d.intr                               /secs + 0.5 ), /*in*/
+	   (unsigned)( d.ctxt                               /secs + 0.5 ), /*cs*/
 	   (unsigned)( (100*duse+divo2)/Div ), /*us*/
 	   (unsigned)( (100*dsys+divo2)/Div ), /*sy*/
 	   (unsigned)( (100*didl+divo2)/Div ), /*id*/
@@ -281,55 +293,34 @@ static void diskpartition_header(const char *partition_name){
 ////////////////////////////////////////////////////////////////////////////
 
 static int diskpartition_format(const char* partition_name){
-    FILE *fDiskstat;
-    struct disk_stat *disks;
-    struct partition_stat *partitions, *current_partition=NULL;
-    unsigned long ndisks, j, k, npartitions;
+    const char *only[] = { partition_name, NULL };
+    diskstats_t *ds;
+    interval_t tick;
+    unsigned long j;
     const char format[] = "%20u %10llu %10u %10u\n";
 
-    fDiskstat=fopen("/proc/diskstats","rb");
-    if(!fDiskstat){
+    ds=diskstats_open(only);
+    if(!ds){
         fprintf(stderr, "Your kernel doesn't support diskstat. (2.5.70 or above required)\n"); 
         exit(EXIT_FAILURE);
     }
-
-    fclose(fDiskstat);
-    ndisks=getdiskstat(&disks,&partitions);
-    npartitions=getpartitions_num(disks, ndisks);
-    for(k=0; k<npartitions; k++){
-       if(!strcmp(partition_name, partitions[k].partition_name)){
-                current_partition=&(partitions[k]); 
-       }	
-    }
-    if(!current_partition){
-         return -1;
-    }
-    diskpartition_header(partition_name);
-    printf (format,
-       current_partition->reads,current_partition->reads_sectors,current_partition->writes,current_partition->requested_writes);
-    fflush(stdout);
-    free(disks);
-    free(partitions);
-    for(j=1; j<num_updates; j++){ 
-        if (moreheaders && ((j%height)==0)) diskpartition_header(partition_name);
-        sleep(sleep_time);
-        ndisks=getdiskstat(&disks,&partitions);
-        npartitions=getpartitions_num(disks, ndisks);
-	current_partition=NULL;
-        for(k=0; k<npartitions; k++){
-          if(!strcmp(partition_name, partitions[k].partition_name)){
-                  current_partition=&(partitions[k]); 
-          }	
-        }
-        if(!current_partition){
+    interval_start(&tick, sleep_time);
+    for(j=0; !j || j<num_updates; j++){ 
+        const struct partition_stat *current_partition;
+        if(j) wait_tick(&tick);
+        diskstats_read(ds);
+        if(!ds->npartitions){
+           diskstats_close(ds);
            return -1;
         }
+        current_partition=&ds->partitions[0];
+        if(!j) diskpartition_header(partition_name);
+        else if (moreheaders && ((j%height)==0)) diskpartition_header(partition_name);
         printf (format,
         current_partition->reads,current_partition->reads_sectors,current_partition->writes,current_partition->requested_writes);
         fflush(stdout);
-        free(disks);
-        free(partitions);
     }
+    diskstats_close(ds);
     return 0;
 }
 
@@ -346,62 +337,42 @@ static void diskheader(void){
 ////////////////////////////////////////////////////////////////////////////
 
 static void diskformat(void){
-  FILE *fDiskstat;
-  struct disk_stat *disks;
-  struct partition_stat *partitions;
-  unsigned long ndisks,i,j,k;
+  diskstats_t *ds;
+  interval_t tick;
+  unsigned long i,j,k;
   const char format[]="%-5s %6u %6u %7llu %7u %6u %6u %7llu %7u %6u %6u\n";
-  if ((fDiskstat=fopen("/proc/diskstats", "rb"))){
-    fclose(fDiskstat);
-    ndisks=getdiskstat(&disks,&partitions);
-    for(k=0; k<ndisks; k++){
+
+  ds=diskstats_open(disk_only);
+  if(!ds){
+    fprintf(stderr, "Your kernel doesn't support diskstat (2.5.70 or above required)\n"); 
+    exit(EXIT_FAILURE);
+  } 
+  interval_start(&tick, sleep_time);
+  for(j=0,k=0; !j || j<num_updates; j++){ 
+    const struct disk_stat *disks;
+    if(j) wait_tick(&tick);
+    diskstats_read(ds);
+    disks=ds->disks;
+    for(i=0; i<ds->ndisks; i++,k++){
       if (moreheaders && ((k%height)==0)) diskheader();
       printf(format,
-        disks[k].disk_name,
-        disks[k].reads,
-        disks[k].merged_reads,
-        disks[k].reads_sectors,
-        disks[k].milli_reading,
-        disks[k].writes,
-        disks[k].merged_writes,
-        disks[k].written_sectors,
-        disks[k].milli_writing,
-        disks[k].inprogress_IO?disks[k].inprogress_IO/1000:0,
-        disks[k].milli_spent_IO?disks[k].milli_spent_IO/1000:0/*,
+        disks[i].disk_name,
+        disks[i].reads,
+        disks[i].merged_reads,
+        disks[i].reads_sectors,
+        disks[i].milli_reading,
+        disks[i].writes,
+        disks[i].merged_writes,
+        disks[i].written_sectors,
+        disks[i].milli_writing,
+        disks[i].inprogress_IO?disks[i].inprogress_IO/1000:0,
+        disks[i].milli_spent_IO?disks[i].milli_spent_IO/1000:0/*,
         disks[i].weighted_milli_spent_IO/1000*/
       );
       fflush(stdout);
     }
-    free(disks);
-    free(partitions);
-    for(j=1; j<num_updates; j++){ 
-      sleep(sleep_time);
-      ndisks=getdiskstat(&disks,&partitions);
-      for(i=0; i<ndisks; i++,k++){
-        if (moreheaders && ((k%height)==0)) diskheader();
-        printf(format,
-          disks[i].disk_name,
-          disks[i].reads,
-          disks[i].merged_reads,
-          disks[i].reads_sectors,
-          disks[i].milli_reading,
-          disks[i].writes,
-          disks[i].merged_writes,
-          disks[i].written_sectors,
-          disks[i].milli_writing,
-          disks[i].inprogress_IO?disks[i].inprogress_IO/1000:0,
-          disks[i].milli_spent_IO?disks[i].milli_spent_IO/1000:0/*,
-          disks[i].weighted_milli_spent_IO/1000*/
-        );
-        fflush(stdout);
-      }
-      free(disks);
-      free(partitions);
-    }
-  }else{
-    fprintf(stderr, "Your kernel doesn't support diskstat (2.5.70 or above required)\n"); 
-    exit(EXIT_FAILURE);
-  } 
+  }
+  diskstats_close(ds);
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -415,6 +386,7 @@ static void slabheader(void){
 static void slabformat (void){
   FILE *fSlab;
   struct slab_cache *slabs;
+  interval_t tick;
   unsigned long nSlab,i,j,k;
   const char format[]="%-24s %6u %6u %6u %6u\n";
 
@@ -436,8 +408,9 @@ static void slabformat (void){
     );
   }
   free(slabs);
+  interval_start(&tick, sleep_time);
   for(j=1,k=1; j<num_updates; j++) { 
-    sleep(sleep_time);
+    wait_tick(&tick);
     nSlab = getslabinfo(&slabs);
     for(i=0; i<nSlab; i++,k++){
       if (moreheaders && ((k%height)==0)) slabheader();
@@ -457,10 +430,9 @@ static void slabformat (void){
 
 static void disksum_format(void) {
 
-  FILE *fDiskstat;
-  struct disk_stat *disks;
-  struct partition_stat *partitions;
-  int ndisks, i;
+  diskstats_t *ds;
+  const struct disk_stat *disks;
+  unsigned i;
   unsigned long reads, merged_reads, read_sectors, milli_reading, writes,
                 merged_writes, written_sectors, milli_writing, inprogress_IO,
                 milli_spent_IO, weighted_milli_spent_IO;
@@ -469,13 +441,13 @@ static void disksum_format(void) {
   written_sectors=milli_writing=inprogress_IO=milli_spent_IO= \
   weighted_milli_spent_IO=0;
 
-  if ((fDiskstat=fopen("/proc/diskstats", "rb"))){
-    fclose(fDiskstat);
-    ndisks=getdiskstat(&disks, &partitions);
-    printf("%13d disks \n", ndisks);
-    printf("%13d partitions \n", getpartitions_num(disks, ndisks));
+  if ((ds=diskstats_open(disk_only))){
+    diskstats_read(ds);
+    disks=ds->disks;
+    printf("%13d disks \n", ds->ndisks);
+    printf("%13d partitions \n", ds->npartitions);
 
-    for(i=0; i<ndisks; i++){
+    for(i=0; i<ds->ndisks; i++){
          reads+=disks[i].reads;
          merged_reads+=disks[i].merged_reads;
          read_sectors+=disks[i].reads_sectors;
@@ -499,8 +471,7 @@ static void disksum_format(void) {
     printf("%13lu inprogress IO\n",inprogress_IO);
     printf("%13lu milli spent IO\n",milli_spent_IO);
 
-    free(disks);
-    free(partitions);
+    diskstats_close(ds);
   }
 }
 
@@ -611,6 +582,21 @@ int main(int argc, char *argv[]) {
       case 'D':
         statMode |= DISKSUMSTAT; 	
 	break;
+      case 'I':
+	if (argv[1]){
+	  char *cp = *++argv;
+	  unsigned n = 0;
+	  disk_only = xmalloc((strlen(cp) / 2 + 2) * sizeof *disk_only);
+	  for(cp = strtok(cp, ","); cp; cp = strtok(NULL, ",")){
+	    if(!memcmp(cp,"/dev/",5)) cp += 5;
+	    disk_only[n++] = cp;
+	  }
+	  disk_only[n] = NULL;
+	}else{
+	  fprintf(stderr, "-I requires an argument\n");
+          exit(EXIT_FAILURE);
+	}
+        break;
       case 'n':
 	/* print only one header */
 	moreheaders=FALSE;
@@ -652,7 +638,7 @@ int main(int argc, char *argv[]) {
       argc++;
       switch (argc) {
       case 1:
-        if ((sleep_time = atoi(*argv)) == 0)
+        if ((sleep_time = strtod(*argv, NULL)) <= 0)
          usage();
        num_updates = ULONG_MAX;
        break;
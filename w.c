@@ -12,6 +12,7 @@
 #include "proc/procps.h"
 #include "proc/sysinfo.h"
 #include "proc/escape.h"
+#include "proc/alloc.h"
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -22,7 +23,6 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <pwd.h>
 #include <time.h>
 #include <unistd.h>
 #include <utmp.h>
@@ -31,9 +31,29 @@
 
 static int ignoreuser = 0;	/* for '-u' */
 static proc_t **procs;		/* our snapshot of the process table */
+static unsigned nprocs;
 
 typedef struct utmp utmp_t;
 
+/* The processes by tty, each tty's in table order, and the CPU time
+ * of each tty's lot; and by tgid.  Built once, so that each utmp entry
+ * looks at its own tty's processes instead of all of them.
+ */
+typedef struct ttyrun {
+    unsigned long long jcpu;
+    int tty;
+    unsigned first, count;	/* in by_tty[] */
+} ttyrun;
+
+static unsigned *by_tty;	/* indexes into procs[] */
+static unsigned *by_tgid;
+static ttyrun *runs;
+static unsigned nruns;
+
+/* the login processes of the utmp entries to be shown, sorted */
+static pid_t *ut_pids;
+static unsigned nut_pids;
+
 #ifdef W_SHOWFROM
 #   define FROM_STRING "on"
 #else
@@ -120,39 +140,140 @@ static void print_logintime(time_t logt, FILE* fout) {
 }
 
 
+static int cmp_pid(const void *a, const void *b) {
+    pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_tty(const void *a, const void *b) {
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    if (procs[x]->tty != procs[y]->tty)
+	return procs[x]->tty < procs[y]->tty ? -1 : 1;
+    return (x > y) - (x < y);		/* keep table order */
+}
+
+static int cmp_tgid(const void *a, const void *b) {
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return (procs[x]->tgid > procs[y]->tgid) - (procs[x]->tgid < procs[y]->tgid);
+}
+
+/* readproc's prefilter: only processes on a tty, and the utmp entries'
+ * own, matter to w -- and that is known from /proc/#/stat alone
+ */
+static int wanted(const proc_t *restrict const p) {
+    return p->tty != 0 || bsearch(&p->tgid, ut_pids, nut_pids, sizeof *ut_pids, cmp_pid);
+}
+
+/* read in what the utmp entries need, and index it */
+static void load_procs(void) {
+    PROCTAB *PT;
+    proc_t *p;
+    unsigned i, room = 0;
+
+    qsort(ut_pids, nut_pids, sizeof *ut_pids, cmp_pid);
+    PT = openproc(PROC_FILLCOM | PROC_FILLSTAT | PROC_FILLSTATUS | PROC_FIELD_BASIC | PROC_FIELD_TIMES | PROC_SHARED);
+    if (!PT) {
+	perror("/proc");
+	exit(1);
+    }
+    PT->prefilter = wanted;
+    while ((p = readproc(PT, NULL))) {
+	if (nprocs == room) {
+	    room = room * 2 + 64;
+	    procs = xrealloc(procs, room * sizeof *procs);
+	}
+	procs[nprocs++] = p;
+    }
+    closeproc(PT);
+
+    by_tty  = xmalloc((nprocs + 1) * sizeof *by_tty);
+    by_tgid = xmalloc((nprocs + 1) * sizeof *by_tgid);
+    runs    = xmalloc((nprocs + 1) * sizeof *runs);
+    for (i = 0; i < nprocs; i++)
+	by_tty[i] = by_tgid[i] = i;
+    qsort(by_tty, nprocs, sizeof *by_tty, cmp_tty);
+    qsort(by_tgid, nprocs, sizeof *by_tgid, cmp_tgid);
+    for (i = 0; i < nprocs; i++) {
+	const proc_t *tmp = procs[by_tty[i]];
+	if (!tmp->tty)
+	    continue;
+	if (!nruns || runs[nruns-1].tty != tmp->tty) {
+	    runs[nruns].tty = tmp->tty;
+	    runs[nruns].first = i;
+	    runs[nruns].count = 0;
+	    runs[nruns].jcpu = 0;
+	    nruns++;
+	}
+	runs[nruns-1].count++;
+	runs[nruns-1].jcpu += tmp->utime + tmp->stime;
+    }
+}
+
+/* where the process tgid is in procs[], or -1 */
+static int find_tgid(pid_t tgid) {
+    unsigned lo = 0, hi = nprocs;
+    while (lo < hi) {
+	unsigned mid = (lo + hi) / 2;
+	pid_t t = procs[by_tgid[mid]]->tgid;
+	if (t == tgid)
+	    return by_tgid[mid];
+	if (t < tgid)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return -1;
+}
+
+static const ttyrun *find_run(int tty) {
+    unsigned lo = 0, hi = nruns;
+    while (lo < hi) {
+	unsigned mid = (lo + hi) / 2;
+	if (runs[mid].tty == tty)
+	    return &runs[mid];
+	if (runs[mid].tty < tty)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return NULL;
+}
+
 /* This function scans the process table accumulating total cpu times for
  * any processes "associated" with this login session.  It also searches
  * for the "best" process to report as "(w)hat" the user for that login
  * session is doing currently.  This the essential core of 'w'.
  */
 static const proc_t *getproc(const utmp_t *restrict const u, const char *restrict const tty, unsigned long long *restrict const jcpu, int *restrict const found_utpid) {
-    int line;
-    proc_t **pptr = procs;
+    int line, utp;
+    const ttyrun *run;
     const proc_t *best = NULL;
     const proc_t *secondbest = NULL;
     unsigned uid = ~0U;
+    unsigned k;
 
     *found_utpid = 0;
     if(!ignoreuser){
 	char buf[UT_NAMESIZE+1];
-	struct passwd *passwd_data;   /* pointer to static data */
+	uid_t uu;
 	strncpy(buf,u->ut_user,UT_NAMESIZE);
 	buf[UT_NAMESIZE] = '\0';
-	passwd_data = getpwnam(buf);
-	if(!passwd_data) return NULL;
-	uid = passwd_data->pw_uid;
-	/* OK to have passwd_data go out of scope here */
+	if(uid_from_user(buf, &uu)) return NULL;
+	uid = uu;
     }
     line = tty_to_dev(tty);
-    *jcpu = 0;
-    for(; *pptr; pptr++) {
-	const proc_t *restrict const tmp = *pptr;
-	if(unlikely(tmp->tgid == u->ut_pid)) {
-	    *found_utpid = 1;
-	    best = tmp;
+    utp = find_tgid(u->ut_pid);
+    *found_utpid = utp != -1;
+    run = find_run(line);
+    *jcpu = run ? run->jcpu : 0;
+    /* the tty's processes, and the utmp entry's among them in table order */
+    for(k = 0; run && k < run->count; k++) {
+	int i = by_tty[run->first + k];
+	const proc_t *restrict const tmp = procs[i];
+	if(unlikely(utp != -1 && utp <= i)) {
+	    best = procs[utp];
+	    utp = -1;
 	}
-	if(tmp->tty != line) continue;
-	(*jcpu) += tmp->utime + tmp->stime;
 	secondbest = tmp;
 	/* same time-logic here as for "best" below */
 	if(!  (secondbest && tmp->start_time <= secondbest->start_time)  ){
@@ -163,6 +284,8 @@ static const proc_t *getproc(const utmp_t *restrict const u, const char *restric
 	if(best && tmp->start_time <= best->start_time) continue;
     	best = tmp;
     }
+    if(utp != -1)			/* it came after all of them */
+	best = procs[utp];
     return best ? best : secondbest;
 }
 
@@ -233,6 +356,8 @@ int main(int argc, char **argv) {
     utmp_t *u;
     struct winsize win;
     int header=1, longform=1, from=1, args, maxcmd=80, ch;
+    utmp_t *ents = NULL;
+    unsigned nents = 0, room = 0, i;
 
 #ifndef W_SHOWFROM
     from = 0;
@@ -271,7 +396,26 @@ int main(int argc, char **argv) {
     if (maxcmd < 3)
 	fprintf(stderr, "warning: screen width %d suboptimal.\n", win.ws_col);
 
-    procs = readproctab(PROC_FILLCOM | PROC_FILLUSR | PROC_FILLSTAT);
+    /* the entries to show first, so that only their processes get read */
+    utmpname(UTMP_FILE);
+    setutent();
+    for (;;) {
+	u = getutent();
+	if (unlikely(!u)) break;
+	if (u->ut_type != USER_PROCESS) continue;
+	if (user ? strncmp(u->ut_user, user, USERSZ) : !*u->ut_user) continue;
+	if (nents == room) {
+	    room = room * 2 + 16;
+	    ents = xrealloc(ents, room * sizeof *ents);
+	    ut_pids = xrealloc(ut_pids, room * sizeof *ut_pids);
+	}
+	ents[nents] = *u;
+	ut_pids[nut_pids++] = u->ut_pid;
+	nents++;
+    }
+    endutent();
+
+    load_procs();
 
     if (header) {				/* print uptime and headers */
 	print_uptime();
@@ -284,24 +428,8 @@ int main(int argc, char **argv) {
 	    printf("   IDLE WHAT\n");
     }
 
-    utmpname(UTMP_FILE);
-    setutent();
-    if (user) {
-	for (;;) {
-	    u = getutent();
-	    if (unlikely(!u)) break;
-	    if (u->ut_type != USER_PROCESS) continue;
- 	    if (!strncmp(u->ut_user, user, USERSZ)) showinfo(u, longform, maxcmd, from);
-	}
-    } else {
-	for (;;) {
-	    u = getutent();
-	    if (unlikely(!u)) break;
-	    if (u->ut_type != USER_PROCESS) continue;
- 	    if (*u->ut_user) showinfo(u, longform, maxcmd, from);
-	}
-    }
-    endutent();
+    for (i = 0; i < nents; i++)
+	showinfo(&ents[i], longform, maxcmd, from);
 
     return 0;
 }
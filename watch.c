@@ -13,19 +13,24 @@
 #define VERSION "0.2.0"
 
 #include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
 #include <signal.h>
+#include <spawn.h>
 #include <ncurses.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 #include <termios.h>
 #include <locale.h>
+#include <poll.h>
 #include "proc/procps.h"
+#include "proc/interval.h"
 
 #ifdef FORCE_8BIT
 #undef isprint
@@ -39,11 +44,12 @@ static struct option longopts[] = {
 	{"no-title", no_argument, 0, 't'},
 	{"version", no_argument, 0, 'v'},
 	{"paging", no_argument, 0, 'p'},
+	{"exec", no_argument, 0, 'x'},
 	{0, 0, 0, 0}
 };
 
 static char usage[] =
-    "Usage: %s [-dhntpv] [--differences[=cumulative]] [--help] [--interval=<n>] [--no-title] [--paging] [--version] <command>\n";
+    "Usage: %s [-dhntpvx] [--differences[=cumulative]] [--exec] [--help] [--interval=<n>] [--no-title] [--paging] [--version] <command>\n";
 
 static char *progname;
 
@@ -138,6 +144,60 @@ get_terminal_size(void)
 	}
 }
 
+/* With --exec the command is run as is, with no /bin/sh in between:
+ * that's one fork+exec per update rather than two. */
+static FILE *
+spawn_command(char *const *args, pid_t *pid)
+{
+	posix_spawn_file_actions_t actions;
+	int fds[2];
+	int err;
+
+	if (pipe(fds) == -1)
+		return NULL;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&actions, fds[0]);
+	posix_spawn_file_actions_addclose(&actions, fds[1]);
+	err = posix_spawnp(pid, args[0], &actions, NULL, args, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(fds[1]);
+	if (err) {
+		close(fds[0]);
+		errno = err;
+		return NULL;
+	}
+	return fdopen(fds[0], "r");
+}
+
+static void
+close_command(FILE *pipe, pid_t pid)
+{
+	if (!pid) {
+		pclose(pipe);
+		return;
+	}
+	fclose(pipe);
+	while (waitpid(pid, NULL, 0) == -1 && errno == EINTR)
+		;
+}
+
+/* room for 'need' chtypes in *buf, growing it by doubling */
+static chtype *
+grow_output(chtype *buf, int *size, int need)
+{
+	if (need <= *size)
+		return buf;
+	while (*size < need)
+		*size = *size ? *size * 2 : 4096;
+	buf = realloc(buf, sizeof(chtype) * *size);
+	if (buf == NULL) {
+		puts("couldn't realloc");
+		exit(1);
+	}
+	return buf;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -145,20 +205,24 @@ main(int argc, char *argv[])
 	int option_differences = 0,
 	    option_differences_cumulative = 0,
 	    option_help = 0, option_version = 0,
-	    option_paging = 0;
+	    option_paging = 0, option_exec = 0;
 	double interval = 2;
 	char *command;
 	int command_length = 0;	/* not including final \0 */
+	char **command_args;	/* for --exec, the command unjoined */
 	FILE *command_pipe = NULL;
+	pid_t command_pid = 0;	/* 0 if popen() ran it */
 	chtype *command_output = NULL;
 	int command_output_length = 0;
+	int command_output_size = 0;
 	chtype *previous_command_output = NULL;
 	int previous_command_output_length = 0;
+	int previous_command_output_size = 0;
 
 	setlocale(LC_ALL, "");
 	progname = argv[0];
 
-	while ((optc = getopt_long(argc, argv, "+d::hn:pvt", longopts, (int *) 0))
+	while ((optc = getopt_long(argc, argv, "+d::hn:pvtx", longopts, (int *) 0))
 	       != EOF) {
 		switch (optc) {
 		case 'd':
@@ -190,6 +254,9 @@ main(int argc, char *argv[])
 		case 'p':
 			option_paging = 1;
 			break;
+		case 'x':
+			option_exec = 1;
+			break;
 		default:
 			do_usage();
 			break;
@@ -210,12 +277,14 @@ main(int argc, char *argv[])
 		fputs("  -n, --interval=<seconds>\t\tseconds to wait between updates\n", stderr);
 		fputs("  -v, --version\t\t\t\tprint the version number\n", stderr);
 		fputs("  -t, --no-title\t\t\tturns off showing the header\n", stderr);
+		fputs("  -x, --exec\t\t\t\trun the command directly, not with sh -c\n", stderr);
 		exit(0);
 	}
 
 	if (optind >= argc)
 		do_usage();
 
+	command_args = argv + optind;
 	command = strdup(argv[optind++]);
 	command_length = strlen(command);
 	for (; optind < argc; optind++) {
@@ -244,15 +313,10 @@ main(int argc, char *argv[])
 	keypad(stdscr, TRUE);
 	noecho();
 	cbreak();
-	halfdelay(1);
 	curs_set(0);
 
-	struct timeval tv;
-	if (gettimeofday(&tv, NULL) == -1) {
-		puts("gettimeofday() returned -1");
-		exit(1);
-	}
-	unsigned long time_then = (tv.tv_sec * 1000000ul) + tv.tv_usec;
+	interval_t tick;
+	interval_start(&tick, interval);
 	int rerun_command = 1;
 	int max_y = -1;
 	int origin_x = 0, origin_y = 0, view_changed = 0;
@@ -283,26 +347,37 @@ main(int argc, char *argv[])
 		   again), or if the user changed the view (by paging around), then we
 		   need to redraw. */
 		if (rerun_command || view_changed) {
-			clear();
+			/* Not clear(): that would have refresh() repaint the whole
+			   terminal.  This way ncurses compares what gets drawn
+			   against what's already there and sends only the changes. */
+			erase();
 
 			if (rerun_command) {
 				// Reopen the process pipe.
 				if (command_pipe != NULL) {
-					pclose(command_pipe);
+					close_command(command_pipe, command_pid);
 				}
-				if (!(command_pipe = popen(command, "r"))) {
-					perror("popen");
+				if (option_exec)
+					command_pipe = spawn_command(command_args, &command_pid);
+				else
+					command_pipe = popen(command, "r");
+				if (!command_pipe) {
+					perror(option_exec ? command_args[0] : "popen");
 					do_exit(2);
 				}
 				max_y = -1;
 
 				// Keep previous command output so that we can do differences.
-				if (previous_command_output != NULL) {
-					free(previous_command_output);
+				// The two buffers just trade places, so nothing is copied.
+				{
+					chtype *swap_output = previous_command_output;
+					int swap_size = previous_command_output_size;
+					previous_command_output = command_output;
+					previous_command_output_size = command_output_size;
+					previous_command_output_length = command_output_length;
+					command_output = swap_output;
+					command_output_size = swap_size;
 				}
-				previous_command_output = (chtype *)malloc(sizeof(chtype) * command_output_length);
-				memcpy(previous_command_output, command_output, sizeof(chtype) * command_output_length);
-				previous_command_output_length = command_output_length;
 
 				// Reinitialize the command output buffer.
 				command_output_length = 0;
@@ -311,8 +386,14 @@ main(int argc, char *argv[])
 			if (show_title) {
 				// left justify interval and command,
 				// right justify time, clipping all to fit window width
-				asprintf(&header, "Every %.1fs: %.*s",
-					interval, min(width - 1, command_length), command);
+				// and how many runs were missed for taking too long
+				if (tick.total_missed)
+					asprintf(&header, "Every %.1fs (%lu missed): %.*s",
+						interval, tick.total_missed,
+						min(width - 1, command_length), command);
+				else
+					asprintf(&header, "Every %.1fs: %.*s",
+						interval, min(width - 1, command_length), command);
 				mvaddstr(0, 0, header);
 				if (strlen(header) > (size_t) (width - tsl - 1))
 					mvaddstr(0, width - tsl - 4, "...  ");
@@ -370,13 +451,9 @@ main(int argc, char *argv[])
 					}
 					break;
 				} else {
-					char buffer[128];
+					char buffer[4096];
 					size_t bytes_read = fread(buffer, sizeof(char), sizeof(buffer) / sizeof(char), command_pipe);
-					command_output = (chtype *)realloc(command_output, sizeof(chtype) * (command_output_length + bytes_read));
-					if (command_output == NULL) {
-						puts("couldn't realloc");
-						exit(1);
-					}
+					command_output = grow_output(command_output, &command_output_size, command_output_length + bytes_read);
 					int i;
 					for (i = 0; i < bytes_read; i++) {
 						command_output[command_output_length + i] = buffer[i];
@@ -403,8 +480,13 @@ main(int argc, char *argv[])
 			refresh();
 		}
 
-		// Get input for paging.
+		// Get input for paging, or just wait, until the next run is due.
 		view_changed = 0;
+		int left = interval_left(&tick);
+		if (option_paging)
+			timeout(left);
+		else if (left)
+			poll(NULL, 0, left);	// a SIGWINCH cuts it short
 		if (option_paging && ((c = getch()) != ERR)) {
 			switch (c) {
 			case KEY_UP:
@@ -448,13 +530,9 @@ main(int argc, char *argv[])
 		}
 
 		// Check if interval passed: do we need to run the command again?
-		if (gettimeofday(&tv, NULL) == -1) {
-			puts("gettimeofday() returned -1");
-			exit(1);
-		}
-		unsigned long time_now = (tv.tv_sec * 1000000ul) + tv.tv_usec;
-		if (time_now - time_then >= interval * 1000000) {
-			time_then = time_now;
+		// The runs keep to their schedule however long each one takes.
+		if (!interval_left(&tick)) {
+			interval_tick(&tick);
 			rerun_command = 1;
 		} else {
 			rerun_command = 0;